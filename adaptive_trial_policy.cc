@@ -0,0 +1,108 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "adaptive_trial_policy.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const double kOutlierZScore = 3.5;
+// MAD of a normal distribution over its standard deviation
+const double kMadScale = 0.6745;
+
+// Two-sided 95% quantiles of Student's t, by degrees of freedom from 1
+const double kStudentT95[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+const double kNormal95 = 1.960;
+
+double StudentT95(size_t degrees_of_freedom) {
+  const size_t table_size = sizeof(kStudentT95) / sizeof(kStudentT95[0]);
+  return degrees_of_freedom <= table_size ? kStudentT95[degrees_of_freedom - 1] : kNormal95;
+}
+
+double Median(std::vector<double> values) {
+  size_t middle = values.size() / 2;
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+  double median = values[middle];
+  if (values.size() % 2 == 0)
+    median = (median + *std::max_element(values.begin(), values.begin() + middle)) / 2;
+  return median;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+AdaptiveTrialPolicy::Config::Config()
+  : min_trials(3),
+    max_trials(20),
+    target_relative_half_width(0.05) {
+}
+
+AdaptiveTrialPolicy::AdaptiveTrialPolicy(const Config& config)
+  : config_(config) {
+}
+
+bool AdaptiveTrialPolicy::Done(const std::vector<double>& values) const {
+  // Outliers count here: the trials are bounded whatever they measure
+  if (values.size() >= config_.max_trials)
+    return true;
+
+  std::vector<bool> outliers = Outliers(values);
+  std::vector<double> kept;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (!outliers[i])
+      kept.push_back(values[i]);
+  }
+
+  return kept.size() >= config_.min_trials &&
+      RelativeHalfWidth(kept) <= config_.target_relative_half_width;
+}
+
+// static
+std::vector<bool> AdaptiveTrialPolicy::Outliers(const std::vector<double>& values) {
+  std::vector<bool> outliers(values.size(), false);
+  if (values.size() < 3)
+    return outliers;
+
+  double median = Median(values);
+  std::vector<double> deviations(values.size());
+  for (size_t i = 0; i < values.size(); ++i)
+    deviations[i] = fabs(values[i] - median);
+  double mad = Median(deviations);
+  if (mad == 0)
+    return outliers;
+
+  for (size_t i = 0; i < values.size(); ++i)
+    outliers[i] = kMadScale * deviations[i] / mad > kOutlierZScore;
+  return outliers;
+}
+
+// static
+double AdaptiveTrialPolicy::RelativeHalfWidth(const std::vector<double>& values) {
+  size_t n = values.size();
+  if (n < 2)
+    return std::numeric_limits<double>::infinity();
+
+  double sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    sum += values[i];
+  double mean = sum / n;
+  if (mean == 0)
+    return std::numeric_limits<double>::infinity();
+
+  double square_sum = 0;
+  for (size_t i = 0; i < n; ++i)
+    square_sum += (values[i] - mean) * (values[i] - mean);
+  double standard_error = sqrt(square_sum / (n - 1) / n);
+  return StudentT95(n - 1) * standard_error / fabs(mean);
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,50 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_ADAPTIVE_TRIAL_POLICY_H_
+#define BROWSER_PROFILER_ADAPTIVE_TRIAL_POLICY_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace browser_profiler {
+
+// Sequential stopping of the trials of a url (and command line): stop as soon as the
+// 95% confidence interval of the mean is narrow enough, within min and max trials
+// Outliers, by the median absolute deviation, do not count: each one is run again
+// Warm-up trials are left to the caller, they are never given as values
+class AdaptiveTrialPolicy {
+ public:
+  struct Config {
+    Config();
+
+    size_t min_trials;
+    size_t max_trials;
+    // Half width of the confidence interval over the mean
+    double target_relative_half_width;
+  };
+
+  explicit AdaptiveTrialPolicy(const Config& config);
+
+  const Config& config() const { return config_; }
+
+  // values: the measured trials of the url so far, in order
+  // Return true if the url needs no more trials
+  bool Done(const std::vector<double>& values) const;
+
+  // Modified z-score above 3.5 (Iglewicz and Hoaglin), none if fewer than 3 values
+  // or if more than half of them are equal
+  static std::vector<bool> Outliers(const std::vector<double>& values);
+
+  // Relative half width of the 95% confidence interval of the mean (Student's t),
+  // infinite if it is undefined, e.g., fewer than 2 values or a zero mean
+  static double RelativeHalfWidth(const std::vector<double>& values);
+
+ private:
+  Config config_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_ADAPTIVE_TRIAL_POLICY_H_
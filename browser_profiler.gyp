@@ -12,6 +12,8 @@
         '.'
       ],
       'sources': [
+        'adaptive_trial_policy.cc',
+        'adaptive_trial_policy.h',
         'browser_profiler_impl.cc',
         'browser_profiler_impl.h',
         'browser_profiler_impl_constants.cc',
@@ -20,12 +22,71 @@
         'browser_profiler_impl_state.h',
         'browser_profiler_impl_switches.cc',
         'browser_profiler_impl_switches.h',
+        'browser_restart_monitor.cc',
+        'browser_restart_monitor.h',
+        'campaign_manifest.cc',
+        'campaign_manifest.h',
+        'clock_aligner.cc',
+        'clock_aligner.h',
+        'clock_domain.cc',
+        'clock_domain.h',
+        'cpu_utilization_sampler.cc',
+        'cpu_utilization_sampler.h',
+        'cpu_utilization_tracer.cc',
+        'cpu_utilization_tracer.h',
+        'crc32.cc',
+        'crc32.h',
         'experiment_result.cc',
         'experiment_result.h',
+        'experiment_result_store.cc',
+        'experiment_result_store.h',
+        'experiment_scheduler.cc',
+        'experiment_scheduler.h',
+        'ftrace_controller.cc',
+        'ftrace_controller.h',
+        'ftrace_tracer.cc',
+        'ftrace_tracer.h',
+        'internal_tracing_tracer.cc',
+        'internal_tracing_tracer.h',
+        'packet_capture.cc',
+        'packet_capture.h',
+        'packet_capture_tracer.cc',
+        'packet_capture_tracer.h',
+        'power_sample_recorder.cc',
+        'power_sample_recorder.h',
+        'power_sample_sink.h',
         'power_tool_connection_impl.cc',
         'power_tool_connection_impl.h',
         'power_tool_controller.cc',
         'power_tool_controller.h',
+        'power_tool_protocol.cc',
+        'power_tool_protocol.h',
+        'power_tracer.cc',
+        'power_tracer.h',
+        'power_window_integrator.cc',
+        'power_window_integrator.h',
+        'result_aggregator.cc',
+        'result_aggregator.h',
+        'root_command_runner.cc',
+        'root_command_runner.h',
+        'root_helper_protocol.cc',
+        'root_helper_protocol.h',
+        'script_tracer.cc',
+        'script_tracer.h',
+        'sync_pattern.cc',
+        'sync_pattern.h',
+        'sysfs_power_connection.cc',
+        'sysfs_power_connection.h',
+        'sysfs_power_sampler.cc',
+        'sysfs_power_sampler.h',
+        'timeline_tracer.cc',
+        'timeline_tracer.h',
+        'tracer.cc',
+        'tracer.h',
+        'tracer_launcher.cc',
+        'tracer_launcher.h',
+        'tracer_registry.cc',
+        'tracer_registry.h',
         'public/browser_profiler.cc',
         'public/browser_profiler.h',
         'public/internal_tracing_controller.h',
@@ -33,5 +94,187 @@
         'public/power_tool_connection.h',
       ],
     },
+    {
+      # Long-lived root helper, pushed to bp/bin/ next to cpu_configurer
+      'target_name': 'root_helper',
+      'type': 'executable',
+      'toolsets': ['target'],
+      'include_dirs': [
+        '.'
+      ],
+      'sources': [
+        'root_helper_protocol.cc',
+        'root_helper_protocol.h',
+        'tools/root_helper/root_helper_main.cc',
+      ],
+    },
+    {
+      # Converts out/experiment_result.bpr back to the tab-separated log, runs on the PC
+      'target_name': 'result_store_to_tsv',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'sources': [
+        'crc32.cc',
+        'crc32.h',
+        'experiment_result_store.cc',
+        'experiment_result_store.h',
+        'tools/result_store_to_tsv/result_store_to_tsv_main.cc',
+      ],
+    },
+    {
+      # Stands in for the power tool server, runs on the PC
+      'target_name': 'power_tool_mock_server',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'sources': [
+        'clock_domain.cc',
+        'clock_domain.h',
+        'power_tool_protocol.cc',
+        'power_tool_protocol.h',
+        'tools/power_tool_mock_server/power_tool_mock_server_main.cc',
+      ],
+    },
+    {
+      # Keeps one connection to the power tool server for a campaign, pushed to bp/bin/
+      'target_name': 'power_tool_relay',
+      'type': 'executable',
+      'toolsets': ['host', 'target'],
+      'include_dirs': [
+        '.'
+      ],
+      'sources': [
+        'power_tool_protocol.cc',
+        'power_tool_protocol.h',
+        'tools/power_tool_relay/power_tool_relay_main.cc',
+      ],
+    },
+    {
+      # Runs a campaign on several browser instances at once, on the host
+      'target_name': 'parallel_runner',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'sources': [
+        'clock_domain.cc',
+        'clock_domain.h',
+        'crc32.cc',
+        'crc32.h',
+        'experiment_result_store.cc',
+        'experiment_result_store.h',
+        'root_helper_protocol.cc',
+        'root_helper_protocol.h',
+        'tools/parallel_runner/parallel_runner_main.cc',
+      ],
+    },
+    {
+      # Phase breakdown of the itrace.json artifacts of a campaign, runs on the PC
+      'target_name': 'itrace_index',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'ldflags': [
+        '-pthread',
+      ],
+      'sources': [
+        'clock_domain.cc',
+        'clock_domain.h',
+        'itrace_index.cc',
+        'itrace_index.h',
+        'tools/itrace_index/itrace_index_main.cc',
+      ],
+    },
+    {
+      # Decodes the ftrace.dat artifacts of a campaign into per-cpu events, runs on the PC
+      'target_name': 'ftrace_decode',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'ldflags': [
+        '-pthread',
+      ],
+      'sources': [
+        'ftrace_decoder.cc',
+        'ftrace_decoder.h',
+        'tools/ftrace_decode/ftrace_decode_main.cc',
+      ],
+    },
+    {
+      # Captures packets into a pcap file, e.g., on loopback, or as root on the device
+      'target_name': 'packet_capture',
+      'type': 'executable',
+      'toolsets': ['host', 'target'],
+      'include_dirs': [
+        '.'
+      ],
+      'ldflags': [
+        '-pthread',
+      ],
+      'sources': [
+        'clock_domain.cc',
+        'clock_domain.h',
+        'packet_capture.cc',
+        'packet_capture.h',
+        'tools/packet_capture/packet_capture_main.cc',
+      ],
+    },
+    {
+      # Merges the artifacts of a trial into one timeline, runs on the PC
+      'target_name': 'timeline_merge',
+      'type': 'executable',
+      'toolsets': ['host'],
+      'include_dirs': [
+        '.'
+      ],
+      'ldflags': [
+        '-pthread',
+      ],
+      'sources': [
+        'clock_domain.cc',
+        'clock_domain.h',
+        'ftrace_decoder.cc',
+        'ftrace_decoder.h',
+        'itrace_index.cc',
+        'itrace_index.h',
+        'timeline_merger.cc',
+        'timeline_merger.h',
+        'timeline_sources.cc',
+        'timeline_sources.h',
+        'tools/timeline_merge/timeline_merge_main.cc',
+      ],
+    },
+    {
+      # Latency and throughput of PowerToolConnectionImpl, e.g., against the mock server
+      'target_name': 'power_tool_benchmark',
+      'type': 'executable',
+      'toolsets': ['host', 'target'],
+      'include_dirs': [
+        '../../../',
+        '.'
+      ],
+      'dependencies': [
+        '../../../base/base.gyp:base',
+      ],
+      'sources': [
+        'power_tool_connection_impl.cc',
+        'power_tool_connection_impl.h',
+        'power_tool_protocol.cc',
+        'power_tool_protocol.h',
+        'public/power_tool_connection.cc',
+        'public/power_tool_connection.h',
+        'tools/power_tool_benchmark/power_tool_benchmark_main.cc',
+      ],
+    },
   ],
 }
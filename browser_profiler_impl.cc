@@ -3,15 +3,23 @@
 
 #include "browser_profiler_impl.h"
 
-#include <iomanip>
+#include <algorithm>
+#include <ctime>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <unistd.h>
 
+#include "adaptive_trial_policy.h"
 #include "browser_profiler_impl_constants.h"
 #include "browser_profiler_impl_switches.h"
-#include "power_tool_controller.h"
+#include "browser_restart_monitor.h"
+#include "clock_domain.h"
+#include "experiment_result_store.h"
+#include "experiment_scheduler.h"
+#include "result_aggregator.h"
+#include "root_command_runner.h"
+#include "tracer_launcher.h"
 #include "base/command_line.h"
 #include "base/logging.h"
 #include "base/files/file_path.h"
@@ -24,24 +32,58 @@
 #include "base/strings/string_util.h"
 #include "base/strings/string_split.h"
 #include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/sys_info.h"
 #include "base/threading/platform_thread.h"
 #include "base/third_party/android_cpu_tools/src/cpu_configurer/cpu_configurer_switches.h"
 #include "base/third_party/android_cpu_tools/src/cpu_info/cpu_info.h"
-#include "base/third_party/android_cpu_tools/src/workload_generator/workload_generator.h"
 #include "base/time/time.h"
 
 
 namespace {
 
-const int kNanosecondsPerSecond = 1000000000;
-
 // TODO: read home dir from file or command line
 //const char kBrowserProfilerHomeDir[] = "/sdcard/ducalpha/bp/";
 const char kBrowserProfilerHomeDir[] = "/data/local/tmp/my_home/android_env/bp/";
 
 const char kBrowserProfilerWritableDir[] = "/sdcard/bp/";
 
+// rsync of all logs of a campaign to the PC
+const uint32_t kSyncOutToPcTimeoutMillis = 30 * 60 * 1000;
+
+// The client kills this browser and starts a new one, retry if none is ready in time
+const int kMaxRestartAttempts = 5;
+const int kRestartAttemptTimeoutMillis = 5000;
+
+// The new browser kills the old one if it does not exit by then
+const int kOldBrowserExitTimeoutMillis = 2000;
+
+typedef void (browser_profiler::Tracer::*TracerStep)(const browser_profiler::TracerContext&,
+    const browser_profiler::Tracer::DoneCallback&);
+
+// Run Start() or Stop() of a tracer as a launcher task, which returns when the step is done,
+// or its root commands in the batch of the stage
+void AddTracerStep(browser_profiler::TracerLauncher* launcher, int stage,
+    browser_profiler::Tracer* tracer, TracerStep step,
+    const std::vector<std::string>& root_commands,
+    const browser_profiler::TracerContext* context) {
+  if (!root_commands.empty()) {
+    launcher->AddRootCommands(stage, tracer->name(), root_commands);
+    return;
+  }
+
+  browser_profiler::TracerLauncher::Task task = [tracer, step, context]() {
+    base::WaitableEvent done(false, false);
+    (tracer->*step)(*context, [&done]() { done.Signal(); });
+    done.Wait();
+  };
+
+  if (tracer->runs_on_calling_thread())
+    launcher->AddOnCallingThread(stage, tracer->name(), task);
+  else
+    launcher->Add(stage, tracer->name(), task);
+}
+
 // Prefix file so that files are sorted by experiment time
 // Unfortunately, FilePath does not have a convenient way to prefix a filename
 void PrefixFile(const base::FilePath& file_path, const std::string& prefix) {
@@ -84,67 +126,9 @@ bool CheckedWriteStringToFile(const base::FilePath& file_path, const std::string
   return true;
 }
 
-// Execute a shell command like system() in C++
-// Because any failure will make an experiment fail,
-// use FATAL here
-bool ExecuteCommand(const base::CommandLine& cmd) {
-  VLOG(1) << "Execute command: " << cmd.GetCommandLineString();
-
-  base::Process process = base::LaunchProcess(cmd, base::LaunchOptions());
-  if (!process.IsValid()) {
-    LOG(ERROR) << "Cannot run command " << cmd.GetCommandLineString();
-    return false;
-  }
-
-  int exit_code;
-  if (!process.WaitForExit(&exit_code)) {
-    LOG(ERROR) << "Cannot get return code for command " << cmd.GetCommandLineString();
-    return false;
-  }
-
-  if (exit_code != 0) {
-    LOG(ERROR) << "Running " << cmd.GetCommandLineString()
-        << " failed with code " << exit_code;
-    return false;
-  }
-
-  return true;
-}
-
-bool ExecuteCommand(const std::string& cmd_str) {
-  std::vector<std::string> cmd_argv =
-      base::SplitString(cmd_str, " ", base::WhitespaceHandling::TRIM_WHITESPACE,
-                        base::SplitResult::SPLIT_WANT_NONEMPTY);
-
-  return ExecuteCommand(base::CommandLine(cmd_argv));
-}
-
-// Run a command as root
-bool ExecuteCommandAsRoot(const std::string& cmd) {
-  return ExecuteCommand("su -c " + cmd);
-}
-
-bool ExecuteCommandAsRoot(const base::CommandLine& cmd) {
-  base::CommandLine su_cmd(cmd);
-  su_cmd.PrependWrapper("su -c");
-  return ExecuteCommand(su_cmd);
-}
-
-bool ExecuteCommandAsRoot(const base::FilePath& cmd) {
-  return ExecuteCommandAsRoot(cmd.value());
-}
-
-// Use directly clock_gettime
-// Don't want to depend on Chromium base::TimeTicks::ToInternalValue() which may change over time
-double MonotonicNow() {
-  struct timespec now;
-  clock_gettime(CLOCK_MONOTONIC, &now);
-  return (double) now.tv_sec + (double) now.tv_nsec / kNanosecondsPerSecond;
-}
-
-bool EnsureInitializeCpuInfoCommandLine(const base::FilePath& cpu_info_cmd,
-    const base::FilePath& cpu_info_command_line_file) {
-  if (!ExecuteCommandAsRoot(cpu_info_cmd.value() + " > " + cpu_info_command_line_file.value())) {
+bool EnsureInitializeCpuInfoCommandLine(browser_profiler::RootCommandRunner* root_runner,
+    const base::FilePath& cpu_info_cmd, const base::FilePath& cpu_info_command_line_file) {
+  if (!root_runner->Run(cpu_info_cmd.value() + " > " + cpu_info_command_line_file.value())) {
     LOG(ERROR) << "Cannot initialize cpu info command line file";
     return false;
   }
@@ -194,9 +178,33 @@ std::string HostInUrl(std::string url) {
   return url;
 }
 
-base::FilePath GenerateBackupFileName(const base::FilePath& original_file) {
+// Parallel instances keep their own backup
+base::FilePath GenerateBackupFileName(const base::FilePath& original_file, int instance_index) {
   //return original_file.InsertBeforeExtension("bak");
-  return base::FilePath(std::string(kBrowserProfilerWritableDir) + original_file.BaseName().value() + "-bak");
+  std::string backup_file = std::string(kBrowserProfilerWritableDir) + original_file.BaseName().value() + "-bak";
+  if (instance_index >= 0)
+    backup_file.append("-" + base::IntToString(instance_index));
+  return base::FilePath(backup_file);
+}
+
+// Index of this browser among parallel instances, -1 if it runs the campaign alone
+int ParallelInstanceIndex() {
+  const base::CommandLine& command_line = *base::CommandLine::ForCurrentProcess();
+  unsigned num_instances = 0;
+  unsigned instance_index = 0;
+  if (!base::StringToUint(command_line.GetSwitchValueASCII(
+          switches::kNumInstances), &num_instances) ||
+      num_instances <= 1) {
+    return -1;
+  }
+
+  if (!base::StringToUint(command_line.GetSwitchValueASCII(
+          switches::kInstanceIndex), &instance_index) ||
+      instance_index >= num_instances) {
+    LOG(FATAL) << "Invalid --" << switches::kInstanceIndex << " of "
+        << num_instances << " instances";
+  }
+  return instance_index;
 }
 
 // Don't want to have dependency on Chromium's base string_number_conversions
@@ -218,11 +226,6 @@ namespace browser_profiler {
 struct BrowserProfilerImpl::Setting {
   Setting();
 
-  bool capture_packets;
-  bool do_ftrace;
-  bool do_itrace;
-  std::string tracing_categories;
-  bool measure_power;
   unsigned num_try_per_url;
 
   bool need_clear_cache;
@@ -233,27 +236,78 @@ struct BrowserProfilerImpl::Setting {
   bool rsync_logs_after_all;
   bool clean_logs_after_all;
 
-  bool screen_record;
-  bool monitor_cpu_utilization;
-
   bool test_hot_load;
 
+  bool use_root_helper;
+
+  bool in_session_trials;
+
+  // Parallel instances, see switches::kNumInstances; instance_index is -1 if alone
+  int instance_index;
+  unsigned num_instances;
+
+  // Adaptive trials, null if the number of trials is fixed
+  std::unique_ptr<AdaptiveTrialPolicy> adaptive_trial_policy;
+  ExperimentResult::Metric adaptive_trial_metric;
+  unsigned warm_up_try_per_url;
+
+  // Applied when a campaign starts
+  ExperimentScheduler::Policy schedule_policy;
+  uint64_t schedule_seed;
+
   std::string browser_config_name;
 };
 
 BrowserProfilerImpl::BrowserProfilerImpl(BrowserProfilerClient* client)
   : BrowserProfiler(client),
-    constants_(base::FilePath(kBrowserProfilerHomeDir), base::FilePath(kBrowserProfilerWritableDir)),
+    constants_(base::FilePath(kBrowserProfilerHomeDir), base::FilePath(kBrowserProfilerWritableDir),
+        ParallelInstanceIndex()),
+    restart_monitor_(constants_.kBrowserRestartRequestFile, constants_.kBrowserReadyFile),
     default_cpu_setup_command_(constants_.kCpuConfigurerExecutable),
     sync_workload_cpu_setup_command_(constants_.kCpuConfigurerExecutable),
+    pending_async_stops_(0),
+    session_trial_(0),
     prepared_(false) {
-  chrome_tracing_started_ = false;
+  tracer_context_.constants = &constants_;
+  tracer_context_.root_runner = &root_runner_;
+  tracer_context_.client = client_.get();
+  tracer_context_.browser_profiler = this;
+  tracer_context_.default_cpu_setup_command = &default_cpu_setup_command_;
+  tracer_context_.sync_workload_cpu_setup_command = &sync_workload_cpu_setup_command_;
+  tracer_context_.experiment_result = &experiment_result_;
 }
 
 void BrowserProfilerImpl::Initialize(const base::FilePath& browser_command_line_file,
     const base::FilePath& cpu_info_command_line_file) {
   browser_command_line_file_ = browser_command_line_file;
 
+  // Always re-read settings from the command line
+  setting_.reset(new Setting());
+
+  // This browser may answer a restart: the old one waits for it
+  double restart_latency_millis;
+  restart_monitor_.AnnounceReady(
+      base::TimeDelta::FromMilliseconds(kOldBrowserExitTimeoutMillis), &restart_latency_millis);
+  if (restart_latency_millis >= 0) {
+    VLOG(1) << "Browser restarted in " << restart_latency_millis << " ms";
+    experiment_result_.SetDouble(ExperimentResult::kBrowserRestartTime, restart_latency_millis);
+  }
+
+  if (setting_->instance_index >= 0) {
+    if (base::CommandLine::ForCurrentProcess()->HasSwitch(switches::kMeasurePower))
+      LOG(FATAL) << "Power is measured for the whole device, run a single instance";
+    if (!base::CreateDirectory(constants_.kBpInstanceTmpDir) ||
+        !base::CreateDirectory(constants_.kBpOutDir)) {
+      LOG(FATAL) << "Cannot create the directories of instance " << setting_->instance_index;
+    }
+  }
+
+  // The helper outlives browser restarts, later processes just reconnect
+  if (setting_->use_root_helper &&
+      !root_runner_.ConnectOrLaunchHelper(constants_.kRootHelperExecutable)) {
+    LOG(WARNING) << "Root helper is not available, run root commands through su";
+  }
+
   // Try to load state from the state file first
   if (!state_.LoadFromFile(constants_.kBpStateFile) ||
         state_.start_new_experiments) {
@@ -261,7 +315,8 @@ void BrowserProfilerImpl::Initialize(const base::FilePath& browser_command_line_
 		if (!base::PathExists(cpu_info_command_line_file)) {
 
       // Initialize cpu info if needed
-      if (!EnsureInitializeCpuInfoCommandLine(constants_.kCpuInfoExecutable, cpu_info_command_line_file)) {
+      if (!EnsureInitializeCpuInfoCommandLine(&root_runner_, constants_.kCpuInfoExecutable,
+              cpu_info_command_line_file)) {
         LOG(FATAL) << "Fail to initialize cpu info file";
       } else {
         // Restart web browser so that Browser Profiler Client
@@ -271,13 +326,29 @@ void BrowserProfilerImpl::Initialize(const base::FilePath& browser_command_line_
     }
 
     VLOG(1) << "Initialize state";
-    state_.Initialize(constants_.kExperimentCommandLineFile, constants_.kBpUrlListFile);
+    state_.Initialize(constants_.kExperimentCommandLineFile, constants_.kBpUrlListFile,
+        constants_.kBpStateFile.DirName());
+    // Instances share the browser command line file but run different command lines
+    if (setting_->instance_index >= 0 &&
+        (state_.manifest.num_command_lines() > 1 || setting_->test_hot_load)) {
+      LOG(FATAL) << "Instances share the browser command line file, run a single instance "
+          "for several command lines or hot loads";
+    }
+    StartSchedule();
+    if (!state_.all_experiments_finished && !IsOwnCell())
+      AdvanceToOwnCell();
+    base::DeleteFile(constants_.kAllExperimentsFinishedFile, false);
+    base::DeleteFile(constants_.kResultAggregateFile, false);
+  } else {
+    transition_costs_.Load(constants_.kScheduleCostFile);
+    BuildSchedule();
+    // None until the first trial of the campaign succeeds
+    if (base::PathExists(constants_.kResultAggregateFile))
+      result_aggregator_.LoadFromFile(constants_.kResultAggregateFile);
   }
 
-  // Always re-read settings from the command line
-  setting_.reset(new Setting());
-
   InitializeCpuSetupCommands();
+  InitializeTracers();
 }
 
 bool BrowserProfilerImpl::Prepare(std::string *experiment_url) {
@@ -293,7 +364,7 @@ bool BrowserProfilerImpl::Prepare(std::string *experiment_url) {
   }
 
   // First time to do the experiment with a list of command lines
-  if (!state_.started && !state_.experiment_command_lines.empty()) {
+  if (!state_.started && state_.manifest.num_command_lines() > 0) {
     VLOG(1) << "First experiment, restart";
     // Restart content shell to use the next command line list
     state_.started = true;
@@ -309,25 +380,23 @@ bool BrowserProfilerImpl::Prepare(std::string *experiment_url) {
 
   state_.started = true;
 
-  // Reset to default power management which may have been changed due to other experiments
-  ExecuteCommandAsRoot(default_cpu_setup_command_);
-
-  if (setting_->measure_power) {
-    // Use Delegation/Factory method design pattern when there is another power tool controller
-    power_tool_controller_.reset(
-        new PowerToolController(constants_.kPowerToolServerConfigFile));
-
-    // Connect here, at preparation step to avoid delay later
-    power_tool_controller_->Connect();
-  }
+  RecordTransitionCost();
 
-  StartTracers();
+  root_runner_.ResetCounters();
 
-  *experiment_url = state_.experiment_urls[state_.current_url_index];
+  *experiment_url = state_.manifest.Url(state_.current_url_index);
   VLOG(1) << "Experiment url: " << *experiment_url;
 
+  // Tracers name their output files after the experiment id
   experiment_id_ = GenerateExperimentId(*experiment_url);
   VLOG(1) << "Generated experiment id: " << experiment_id_;
+  tracer_context_.experiment_id = experiment_id_;
+
+  // Prepare here, before the tracers start, to avoid delay later
+  for (size_t i = 0; i < tracers_.size(); ++i)
+    tracers_[i]->Prepare(tracer_context_);
+
+  StartTracers();
 
   return true;
 }
@@ -367,114 +436,260 @@ void BrowserProfilerImpl::DelayedTaskCallback() {
 }
 
 void BrowserProfilerImpl::PostProcessInternal() {
-  // Write the experiment result here, after all, to avoid noise to the experiment
-  bool first_experiment = state_.current_url_try_done == 0 &&
-                          state_.current_url_index == 0 &&
-                          state_.experiment_command_line_index == 0;
-  experiment_result_.WriteToFile(constants_.kExperimentResultFile, first_experiment);
-
   StopTracers();
 }
 
 
 void BrowserProfilerImpl::PostProcessInternalSecondHalf() {
+  // Drop the result and keep the indexes: the same experiment runs again
+  if (experiment_result_.failed()) {
+    LOG(ERROR) << "Discard experiment " << experiment_id_ << ": "
+        << experiment_result_.failure_reason();
+    WriteTracerLatencies();
+    if (!state_.SaveToFile(constants_.kBpStateFile))
+      LOG(FATAL) << "Cannot save browser profiler state to file";
+    RestartBrowser();
+    return;
+  }
+
+  // Write the experiment result here, after all, to avoid noise to the experiment
+  // Tracers have stopped so their results (e.g., ftrace overruns) are included
+  bool first_experiment = IsFirstTrial();
+  experiment_result_.SetDouble(ExperimentResult::kRootCommandTime,
+      root_runner_.elapsed_millis());
+  experiment_result_.SetUint64(ExperimentResult::kRootCommandRoundTrips,
+      root_runner_.num_round_trips());
+  experiment_result_.WriteToFile(constants_.kExperimentResultFile, first_experiment);
+  experiment_result_.AppendToStore(constants_.kExperimentResultStoreFile);
+  WriteTracerLatencies();
+
+  // Only successful trials, with the metrics of the tracers
+  result_aggregator_.Add(experiment_result_);
+  if (!result_aggregator_.SaveToFile(constants_.kResultAggregateFile))
+    LOG(ERROR) << "Cannot save result aggregate to " << constants_.kResultAggregateFile.value();
+
+  RecordAdaptiveTrialValue();
+
   // Update experiment index only when experiment is successful
+  std::string command_line = BrowserCommandLine();
+  ExperimentScheduler::Cell cell(state_.experiment_command_line_index,
+      state_.current_url_index, state_.current_url_try_done);
   UpdateExperimentIndexAndCommandLine();
+  bool command_line_changed = BrowserCommandLine() != command_line;
+
+  // The dead time until the next trial starts is the cost of this transition
+  state_.pending_transition = state_.all_experiments_finished ?
+      ExperimentScheduler::kNoTransition :
+      ExperimentScheduler::TransitionBetween(cell, ExperimentScheduler::Cell(
+          state_.experiment_command_line_index, state_.current_url_index,
+          state_.current_url_try_done));
+  state_.last_trial_end_time = MonotonicNow();
 
   state_.last_experiment_id = experiment_id_;
   LOG(INFO) << "Last experiment id: " << state_.last_experiment_id;
   if (!state_.SaveToFile(constants_.kBpStateFile))
     LOG(FATAL) << "Cannot save browser profiler state to file";
 
+  // A new command line only applies to a new browser process
+  if (!command_line_changed && ContinueInSession())
+    return;
+
   RestartBrowser();
 }
 
-void BrowserProfilerImpl::StartTracers() {
-  if (setting_->clear_dns_cache)
-    ClearDnsCache();
+bool BrowserProfilerImpl::ContinueInSession() {
+  if (!setting_->in_session_trials || state_.all_experiments_finished)
+    return false;
 
-  // Might break app --> start this first, if it breaks, other things have not been started
-  if (setting_->measure_power) {
-    StartPowerSampling();
+  // The cache switch is only applied when the browser creates its cache
+  if (setting_->need_clear_cache && !client_->ClearHttpCache()) {
+    VLOG(1) << "Client cannot clear the cache in process, restart the browser";
+    return false;
   }
 
-  // don't want to include screen record into ftrace
-  if (setting_->screen_record)
-    StartScreenRecord(experiment_id_);
+  experiment_result_.Clear();
+  prepared_ = false;
+  ++session_trial_;
 
-  if (setting_->monitor_cpu_utilization)
-    StartCpuUtilizationMonitor(experiment_id_);
+  client_->CloseActiveShell();
+  if (!client_->OpenExperimentShell()) {
+    LOG(WARNING) << "Client cannot open a shell in process, restart the browser";
+    return false;
+  }
+  return true;
+}
 
-  if (setting_->do_ftrace)
-    StartFtrace();
+void BrowserProfilerImpl::InitializeTracers() {
+  // The columns of the whole campaign, in the same order in every browser process,
+  // so that the rows of all command lines fit under one header
+  for (size_t i = 0; i < state_.manifest.num_command_lines(); ++i) {
+    base::CommandLine command_line(base::SplitString(state_.manifest.CommandLine(i), " \t\n",
+        base::WhitespaceHandling::TRIM_WHITESPACE, base::SplitResult::SPLIT_WANT_NONEMPTY));
+    std::vector<std::unique_ptr<Tracer>> campaign_tracers;
+    tracer_registry_.CreateEnabledTracers(command_line, constants_, &campaign_tracers);
+    for (size_t j = 0; j < campaign_tracers.size(); ++j)
+      campaign_tracers[j]->RegisterMetrics(&experiment_result_);
+  }
+
+  std::vector<std::unique_ptr<Tracer>> tracers;
+  tracer_registry_.CreateEnabledTracers(*base::CommandLine::ForCurrentProcess(),
+      constants_, &tracers);
+
+  tracers_.clear();
+  for (size_t i = 0; i < tracers.size(); ++i) {
+    // Already registered by the campaign, unless the tracer is only enabled in this process
+    tracers[i]->RegisterMetrics(&experiment_result_);
+    if (!tracers[i]->Initialize(tracer_context_)) {
+      LOG(WARNING) << "Tracer " << tracers[i]->name() << " is disabled";
+      continue;
+    }
 
-  if (setting_->do_itrace)
-    StartInternalTracing();
+    std::string artifacts;
+    std::vector<std::string> output_artifacts = tracers[i]->output_artifacts();
+    for (size_t j = 0; j < output_artifacts.size(); ++j)
+      artifacts.append(" " + output_artifacts[j]);
+    VLOG(1) << "Tracer " << tracers[i]->name() << ", overhead: "
+        << Tracer::OverheadName(tracers[i]->expected_overhead())
+        << ", artifacts:" << artifacts;
 
-  if (setting_->capture_packets)
-    StartCapturePackets(experiment_id_);
+    tracers_.push_back(std::move(tracers[i]));
+  }
 }
 
-void BrowserProfilerImpl::StopTracers() {
-  if (setting_->do_itrace && chrome_tracing_started_
-      && internal_tracing_controller_ != nullptr) {
-    VLOG(0) << "Stop ChromeTracing";
+// Independent tracers start concurrently, stage by stage
+void BrowserProfilerImpl::StartTracers() {
+  TracerLauncher launcher(&root_runner_);
 
-    base::FilePath output_file(
-        constants_.kBpOutDir.Append(experiment_id_).value() + "." + constants_.kItraceBaseName);
+  // Reset to default power management which may have been changed due to other experiments
+  launcher.AddRootCommands(Tracer::kEnvironmentStage, "cpu setup",
+      std::vector<std::string>(1, default_cpu_setup_command_.GetCommandLineString()));
 
-    // We call internal tracing and ChromeTracing interchangebly
-    // if ETracingAsync is OK, onTracingStopped will be called after done
-    if (!internal_tracing_controller_->StopTracing(output_file))
-      StopTracersSecondHalf(); // fallback to normal flow if internal tracing not supported
-  } else {
-    StopTracersSecondHalf();
+  if (setting_->clear_dns_cache) {
+    launcher.AddRootCommands(Tracer::kEnvironmentStage, "dns flush",
+        std::vector<std::string>(1, constants_.kClearDnsCacheCommand));
+  }
+
+  started_tracers_.clear();
+  for (size_t i = 0; i < tracers_.size(); ++i) {
+    Tracer* tracer = tracers_[i].get();
+    if (!tracer->IsReady()) {
+      LOG(ERROR) << "Tracer " << tracer->name() << " is not ready, skip it in " << experiment_id_;
+      continue;
+    }
+
+    started_tracers_.push_back(tracer);
+    AddTracerStep(&launcher, tracer->start_stage(), tracer, &Tracer::Start,
+        tracer->StartRootCommands(tracer_context_), &tracer_context_);
   }
+
+  launcher.Run();
+
+  tracer_latencies_.clear();
+  RecordTracerLatencies("start", launcher);
+  experiment_result_.SetDouble(ExperimentResult::kTracerStartTime, launcher.total_millis());
+}
+
+// Asynchronous tracers stop first, the staged stops follow when all of them are done
+void BrowserProfilerImpl::StopTracers() {
+  // Held until all asynchronous stops are issued, in case one completes right away
+  pending_async_stops_ = 1;
+  async_stop_start_time_ = base::TimeTicks::Now();
+
+  for (size_t i = 0; i < started_tracers_.size(); ++i) {
+    if (!started_tracers_[i]->stops_asynchronously())
+      continue;
+
+    ++pending_async_stops_;
+    std::string name = started_tracers_[i]->name();
+    started_tracers_[i]->Stop(tracer_context_,
+        [this, name]() { OnAsyncTracerStopped(name); });
+  }
+
+  OnAsyncTracerStopped(std::string());
 }
 
 void BrowserProfilerImpl::OnInternalTracingStopped() {
-  StopTracersSecondHalf();
+  for (size_t i = 0; i < started_tracers_.size(); ++i)
+    started_tracers_[i]->OnInternalTracingStopped();
 }
 
-void BrowserProfilerImpl::StopTracersSecondHalf() {
-  if (setting_->measure_power) {
-    client_->CloseActiveShell(); // reduce power noise
+void BrowserProfilerImpl::OnAsyncTracerStopped(const std::string& name) {
+  if (!name.empty()) {
+    TracerLauncher::Latency latency;
+    latency.name = "stop " + name;
+    latency.millis = (base::TimeTicks::Now() - async_stop_start_time_).InMillisecondsF();
+    tracer_latencies_.push_back(latency);
+  }
 
-    // wait 500ms for other threads to finish
-    // hotfix: sleep on Java layer instead of here?
-    // base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(500));
+  if (--pending_async_stops_ == 0)
+    StopTracersSecondHalf();
+}
 
-    StopPowerSampling();
+void BrowserProfilerImpl::StopTracersSecondHalf() {
+  TracerLauncher launcher(&root_runner_);
 
-    // set back to default power management in case we test other things
-    ExecuteCommandAsRoot(default_cpu_setup_command_);
+  for (size_t i = 0; i < started_tracers_.size(); ++i) {
+    Tracer* tracer = started_tracers_[i];
+    if (!tracer->stops_asynchronously()) {
+      AddTracerStep(&launcher, tracer->stop_stage(), tracer, &Tracer::Stop,
+          tracer->StopRootCommands(tracer_context_), &tracer_context_);
+    }
   }
 
-  // don't want to include screen record into ftrace
-  if (setting_->screen_record)
-    StopScreenRecord();
+  launcher.Run();
 
-  if (setting_->monitor_cpu_utilization)
-    StopCpuUtilizationMonitor();
+  RecordTracerLatencies("stop", launcher);
+  experiment_result_.SetDouble(ExperimentResult::kTracerStopTime, launcher.total_millis());
 
-  if (setting_->do_ftrace)
-    StopFtrace(experiment_id_); // synchronous Ftrace stop
-
-  if (setting_->capture_packets)
-    StopCapturePackets();
+  for (size_t i = 0; i < started_tracers_.size(); ++i)
+    started_tracers_[i]->Flush(tracer_context_);
 
   PostProcessInternalSecondHalf();
 }
 
+void BrowserProfilerImpl::RecordTracerLatencies(const std::string& phase,
+    const TracerLauncher& launcher) {
+  for (size_t i = 0; i < launcher.latencies().size(); ++i) {
+    TracerLauncher::Latency latency = launcher.latencies()[i];
+    latency.name = phase + " " + latency.name;
+    tracer_latencies_.push_back(latency);
+  }
+}
+
+void BrowserProfilerImpl::WriteTracerLatencies() {
+  // One line per tracer and phase: experiment id, phase and tracer, latency (ms)
+  std::string lines;
+  for (size_t i = 0; i < tracer_latencies_.size(); ++i) {
+    lines.append(experiment_id_ + "\t" + tracer_latencies_[i].name + "\t" +
+        DoubleToString(tracer_latencies_[i].millis) + "\n");
+  }
+
+  if (lines.empty())
+    return;
+
+  // AppendToFile does not create the file
+  bool written = base::PathExists(constants_.kTracerLatencyFile) ?
+      base::AppendToFile(constants_.kTracerLatencyFile, lines.c_str(), lines.length()) :
+      CheckedWriteStringToFile(constants_.kTracerLatencyFile, lines);
+  if (!written)
+    LOG(ERROR) << "Cannot write tracer latencies at " << constants_.kTracerLatencyFile.value();
+}
+
 void BrowserProfilerImpl::RestartBrowser() {
-  const int max_restart_trial = 10;
+  if (!restart_monitor_.RecordRequest())
+    LOG(ERROR) << "Cannot record the restart request, the restart time is unknown";
 
-  for (int restart_trial = 0; restart_trial < max_restart_trial; ++restart_trial) {
+  for (int attempt = 1; attempt <= kMaxRestartAttempts; ++attempt) {
     client_->RestartBrowser();
-    // wait 5 seconds, if still running, try to restart once more
-    // TODO: use better interface than a timeout
-    base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(5));
-    ++restart_trial;
+    // Normally this process is killed while waiting
+    if (restart_monitor_.WaitForNewBrowser(
+          base::TimeDelta::FromMilliseconds(kRestartAttemptTimeoutMillis))) {
+      // The new browser owns the state now, this one must not touch it
+      LOG(INFO) << "New browser is ready, exit the old one";
+      _exit(0);
+    }
+    LOG(WARNING) << "Browser did not restart in " << kRestartAttemptTimeoutMillis
+        << " ms, attempt " << attempt;
   }
 
   LOG(FATAL) << "Cannot restart browser";
@@ -483,22 +698,24 @@ void BrowserProfilerImpl::RestartBrowser() {
 // Does not include sync workload end time which is used for power tool controller server only
 void BrowserProfilerImpl::ConsolidateExperimentResult(const std::string& url,
       double navigation_start_monotonic_time, double load_event_end_monotonic_time) {
-  experiment_result_.Put(ExperimentResult::kBrowserConfigNameKey, setting_->browser_config_name);
-  experiment_result_.Put(ExperimentResult::kCommandLineKey, BrowserCommandLine());
-  experiment_result_.Put(ExperimentResult::kLogPrefixKey, experiment_id_);
-
-  experiment_result_.Put(ExperimentResult::kHostKey, HostInUrl(url));
-  experiment_result_.Put(ExperimentResult::kUrlKey, url);
-
-  experiment_result_.Put(ExperimentResult::kLoadStartTimeKey,
-      DoubleToString(navigation_start_monotonic_time));
-  experiment_result_.Put(ExperimentResult::kLoadEndTimeKey,
-      DoubleToString(load_event_end_monotonic_time));
-
-  experiment_result_.Put(ExperimentResult::kPageLoadTimeKey,
-      DoubleToString(load_event_end_monotonic_time - navigation_start_monotonic_time));
-  experiment_result_.Put(ExperimentResult::kUserThinkTimeKey,
-      base::UintToString(setting_->user_think_time_millis));
+  experiment_result_.SetString(ExperimentResult::kBrowserConfigName, setting_->browser_config_name);
+  experiment_result_.SetString(ExperimentResult::kCommandLine, BrowserCommandLine());
+  experiment_result_.SetString(ExperimentResult::kLogPrefix, experiment_id_);
+
+  experiment_result_.SetString(ExperimentResult::kHost, HostInUrl(url));
+  experiment_result_.SetString(ExperimentResult::kUrl, url);
+
+  experiment_result_.SetDouble(ExperimentResult::kLoadStartTime, navigation_start_monotonic_time);
+  experiment_result_.SetDouble(ExperimentResult::kLoadEndTime, load_event_end_monotonic_time);
+
+  experiment_result_.SetDouble(ExperimentResult::kPageLoadTime,
+      load_event_end_monotonic_time - navigation_start_monotonic_time);
+  experiment_result_.SetUint64(ExperimentResult::kUserThinkTime, setting_->user_think_time_millis);
+  experiment_result_.SetUint64(ExperimentResult::kSessionTrial, session_trial_);
+  if (setting_->adaptive_trial_policy) {
+    experiment_result_.SetUint64(ExperimentResult::kWarmUpTrial,
+        state_.current_url_try_done < setting_->warm_up_try_per_url);
+  }
 }
 
 /* Assume the command line has "--clear-cache --test-host-load"
@@ -539,15 +756,8 @@ void BrowserProfilerImpl::ManipulateCommandLineForHotPageLoad() {
 
 // Write next experiment command line to the browser's command line
 void BrowserProfilerImpl::ReplaceCurrentWithNextExperimentCommandLine() {
-  std::string cmd = "su -c echo '" + state_.experiment_command_lines[state_.experiment_command_line_index] +
-      "' > " + browser_command_line_file_.value();
-  // ExecuteCommandAsRoot does not work well, maybe because of the ' sign in the command
-  // E.g., The command line becomes su -c --easure-power --v=0' echo 'chrome
-  if (system(cmd.c_str()) < 0) {
-    LOG(FATAL) << "Writing next command line failed";
-  }
-  std::string change_permission = "chmod 666 " + browser_command_line_file_.value();
-  if (!ExecuteCommandAsRoot(change_permission)) {
+  if (!root_runner_.WriteFile(browser_command_line_file_,
+          state_.manifest.CommandLine(state_.experiment_command_line_index))) {
     LOG(FATAL) << "Writing next command line failed";
   }
 }
@@ -555,28 +765,33 @@ void BrowserProfilerImpl::ReplaceCurrentWithNextExperimentCommandLine() {
 void BrowserProfilerImpl::PostProcessAfterAllExperiments() {
   VLOG(1) << "PostProcessAfterAllexperiments";
   PrefixFile(constants_.kExperimentResultFile, state_.last_experiment_id);
-
-  if (setting_->measure_power) {
-    // Create a new connection when all experiments finished
-    power_tool_controller_.reset(
-        new PowerToolController(constants_.kPowerToolServerConfigFile));
-    power_tool_controller_->Connect();
-
-    if (!power_tool_controller_->FinishAllExp()) {
-      LOG(FATAL) << "Cannot send finish all experiments command";
-    }
-
-    // Disconnect the connection to the server
-    power_tool_controller_.reset();
+  if (result_aggregator_.WriteReport(constants_.kResultSummaryFile))
+    PrefixFile(constants_.kResultSummaryFile, state_.last_experiment_id);
+  // Other instances may still append to the shared store, the runner prefixes it
+  if (setting_->instance_index < 0 && base::PathExists(constants_.kExperimentResultStoreFile) &&
+      !ExperimentResultStore::Prefix(constants_.kExperimentResultStoreFile.value(),
+          state_.last_experiment_id)) {
+    PLOG(ERROR) << "Fail to prefix the experiment result store "
+        << constants_.kExperimentResultStoreFile.value();
   }
 
-  if (setting_->rsync_logs_after_all) {
-    ExecuteCommandAsRoot(constants_.kSyncOutToPcScript);
+  for (size_t i = 0; i < tracers_.size(); ++i)
+    tracers_[i]->FinishAllExperiments(tracer_context_);
 
+  if (setting_->rsync_logs_after_all) {
+    std::vector<std::string> root_commands(1, constants_.kSyncOutToPcScript.value());
     if (setting_->clean_logs_after_all)
-      ExecuteCommandAsRoot(constants_.kCleanLogsScript);
+      root_commands.push_back(constants_.kCleanLogsScript.value());
+
+    // rsync of a whole campaign takes long
+    root_runner_.RunBatch(root_commands, kSyncOutToPcTimeoutMillis);
   }
 
+  // End of the campaign, the next one launches its own helper
+  // Parallel instances share the helper, tools/parallel_runner shuts it down at the end
+  if (setting_->instance_index < 0 && root_runner_.helper_connected())
+    root_runner_.ShutdownHelper();
+
   // Reset no_further_experiment to restart experiment process
   // and do new experiments
   state_.start_new_experiments = true;
@@ -584,10 +799,16 @@ void BrowserProfilerImpl::PostProcessAfterAllExperiments() {
     LOG(FATAL) << "Cannot save browser profiler state to file";
 
   // Restore the original command line file if needed
-  if (!state_.experiment_command_lines.empty()) {
+  if (state_.manifest.num_command_lines() > 0) {
     RestoreBackupCommandLine();
   }
 
+  // The runner does not start this instance again
+  if (setting_->instance_index >= 0 &&
+      !CheckedWriteStringToFile(constants_.kAllExperimentsFinishedFile, state_.last_experiment_id)) {
+    LOG(ERROR) << "Instance " << setting_->instance_index << " cannot mark its end";
+  }
+
   client_->FinishAllExperiments();
 }
 
@@ -611,89 +832,224 @@ std::string BrowserProfilerImpl::GenerateExperimentId(
        "." + now_formatted_str + "." + hardware_model_name;
 }
 
-void BrowserProfilerImpl::StartPowerSampling() {
-  if (!power_tool_controller_->StartSampling()) {
-    LOG(FATAL) << "Cannot start sampling power"; 
+// Update experiment indexes
+// If new command line is reached, replace current command line with it
+void BrowserProfilerImpl::UpdateExperimentIndexAndCommandLine() {
+  VLOG(2) << "Current url try done: " << state_.current_url_try_done;
+  VLOG(2) << "Current url index: " << state_.current_url_index;
+  VLOG(2) << "Experiment command line index: " << state_.experiment_command_line_index;
+
+  bool use_next_command_line = false;
+
+  if (IsScheduled()) {
+    use_next_command_line = AdvanceToOwnCell();
+  } else {
+    ++state_.current_url_try_done;
+
+    if (UrlTrialsDone()) {
+      state_.current_url_try_done = 0;
+      use_next_command_line = AdvanceToOwnCell();
+    }
   }
+
+  if (use_next_command_line && !state_.all_experiments_finished)
+    ReplaceCurrentWithNextExperimentCommandLine();
+
+  /* Add/remove options to/from current command line for next expr */
+  if (setting_->test_hot_load)
+    ManipulateCommandLineForHotPageLoad();
 }
 
-void BrowserProfilerImpl::StopPowerSampling() {
-  ExecuteCommandAsRoot(sync_workload_cpu_setup_command_);
+bool BrowserProfilerImpl::UrlTrialsDone() const {
+  const AdaptiveTrialPolicy* policy = setting_->adaptive_trial_policy.get();
+  if (!policy)
+    return state_.current_url_try_done >= setting_->num_try_per_url;
 
-  // Run a single thread (avoid thread migration issues)
-  // on max core id (typically a big core)
-  // Run a 0.9 sec workload Exynos 5422
-  android_cpu_tools::WorkloadGenerator::RunWorkload(
-      std::vector<size_t>(1, android_cpu_tools::CommandLineCpuInfo::MaxCoreId()),
-      15000);
+  // Trials without the value count toward the bound too
+  if (state_.current_url_try_done < setting_->warm_up_try_per_url ||
+      (state_.current_url_try_done < setting_->warm_up_try_per_url +
+          policy->config().max_trials &&
+       !policy->Done(state_.current_url_values))) {
+    return false;
+  }
 
-  std::ostringstream sync_workload_end_time;
-  sync_workload_end_time << std::fixed << std::setprecision(6)
-      << MonotonicNow();
+  const std::vector<double>& values = state_.current_url_values;
+  std::vector<bool> outliers = AdaptiveTrialPolicy::Outliers(values);
+  std::vector<double> kept;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (!outliers[i])
+      kept.push_back(values[i]);
+  }
+  VLOG(1) << "Url " << state_.current_url_index << " done after "
+      << state_.current_url_try_done << " trials, " << values.size() - kept.size()
+      << " outliers of " << values.size() << " values, relative half width "
+      << AdaptiveTrialPolicy::RelativeHalfWidth(kept);
+  return true;
+}
 
-  // wait for cpu usage to drop
-  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1000));
+void BrowserProfilerImpl::RecordAdaptiveTrialValue() {
+  if (!setting_->adaptive_trial_policy ||
+      state_.current_url_try_done < setting_->warm_up_try_per_url) {
+    return;
+  }
 
-  ExecuteCommandAsRoot(default_cpu_setup_command_);
+  ExperimentResult::Metric metric = setting_->adaptive_trial_metric;
+  if (!experiment_result_.IsSet(metric)) {
+    LOG(WARNING) << "No " << experiment_result_.name(metric) << " for adaptive trials";
+    return;
+  }
+  if (state_.current_url_values.size() < BrowserProfilerImplState::kMaxUrlValues)
+    state_.current_url_values.push_back(experiment_result_.GetNumber(metric));
+}
 
-  // wait for cpu usage to drop
-  // base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1000));
+bool BrowserProfilerImpl::AdvanceToNextUrl() {
+  state_.current_url_values.clear();
+  ++state_.current_url_index;
+  if (state_.current_url_index < state_.manifest.num_urls())
+    return false;
 
-  // stop sampling first, avoid the rising of cpu power in the end of power trace
-  experiment_result_.Put(
-      ExperimentResult::kSyncWorkloadEndTimeKey, sync_workload_end_time.str());
+  ++state_.experiment_command_line_index;
+  state_.current_url_index = 0;
 
-  if (!power_tool_controller_->StopSampling(
-        experiment_result_.LogHeaderLine(), experiment_result_.LogLine())) {
-    LOG(FATAL) << "Cannot stop sampling power"; 
+  // When there is no experiment_urls, '>' will occur
+  if (state_.experiment_command_line_index >= state_.manifest.num_command_lines()) {
+    state_.all_experiments_finished = true;
+    return false;
   }
+  return true;
 }
 
-// Update experiment indexes
-// If new command line is reached, replace current command line with it
-void BrowserProfilerImpl::UpdateExperimentIndexAndCommandLine() {
-  VLOG(2) << "Current url try done: " << state_.current_url_try_done;
-  VLOG(2) << "Current url index: " << state_.current_url_index;
-  VLOG(2) << "Experiment command line index: " << state_.experiment_command_line_index;
+bool BrowserProfilerImpl::AdvanceInSchedule() {
+  size_t command_line_index = state_.experiment_command_line_index;
+  if (++state_.schedule_position >= schedule_.size()) {
+    state_.all_experiments_finished = true;
+    return false;
+  }
+
+  const ExperimentScheduler::Cell& cell = schedule_[state_.schedule_position];
+  state_.experiment_command_line_index = cell.command_line_index;
+  state_.current_url_index = cell.url_index;
+  state_.current_url_try_done = cell.try_index;
+  return state_.experiment_command_line_index != command_line_index;
+}
 
+bool BrowserProfilerImpl::AdvanceToOwnCell() {
   bool use_next_command_line = false;
+  do {
+    use_next_command_line |= IsScheduled() ? AdvanceInSchedule() : AdvanceToNextUrl();
+  } while (!state_.all_experiments_finished && !IsOwnCell());
+  return use_next_command_line;
+}
 
-  ++state_.current_url_try_done;
+bool BrowserProfilerImpl::IsOwnCell() const {
+  return IsOwnCell(ExperimentScheduler::Cell(state_.experiment_command_line_index,
+      state_.current_url_index, state_.current_url_try_done));
+}
 
-  if (state_.current_url_try_done >= setting_->num_try_per_url) {
-    ++state_.current_url_index;
-    state_.current_url_try_done = 0;
+// The cells of the url x command line matrix are dealt round-robin to the instances
+bool BrowserProfilerImpl::IsOwnCell(const ExperimentScheduler::Cell& cell) const {
+  if (setting_->instance_index < 0)
+    return true;
 
-    if (state_.current_url_index >= state_.experiment_urls.size()) {
-      ++state_.experiment_command_line_index;
-      state_.current_url_index = 0;
+  size_t index = cell.command_line_index * state_.manifest.num_urls() + cell.url_index;
+  return index % setting_->num_instances == static_cast<size_t>(setting_->instance_index);
+}
 
-      // When there is no experiment_urls, '>' will occur
-      if (state_.experiment_command_line_index >= state_.experiment_command_lines.size()) {
-        state_.all_experiments_finished = true;
-      } else {
-        use_next_command_line = true;
-      }
+bool BrowserProfilerImpl::IsFirstTrial() const {
+  // Blocked order: the first try of a url, no earlier url of this instance
+  if (!IsScheduled()) {
+    if (state_.current_url_try_done != 0)
+      return false;
+
+    size_t num_urls = state_.manifest.num_urls();
+    size_t position = state_.experiment_command_line_index * num_urls + state_.current_url_index;
+    for (size_t i = 0; i < position; ++i) {
+      if (IsOwnCell(ExperimentScheduler::Cell(i / num_urls, i % num_urls, 0)))
+        return false;
     }
+    return true;
   }
 
-  if (use_next_command_line)
-    ReplaceCurrentWithNextExperimentCommandLine();
+  for (size_t i = 0; i < state_.schedule_position; ++i) {
+    if (IsOwnCell(schedule_[i]))
+      return false;
+  }
+  return true;
+}
 
-  /* Add/remove options to/from current command line for next expr */
-  if (setting_->test_hot_load)
-    ManipulateCommandLineForHotPageLoad();
+bool BrowserProfilerImpl::IsScheduled() const {
+  return state_.schedule_policy != ExperimentScheduler::kBlocked;
+}
+
+void BrowserProfilerImpl::StartSchedule() {
+  ExperimentScheduler::Policy policy = setting_->schedule_policy;
+  if (policy != ExperimentScheduler::kBlocked &&
+      (setting_->adaptive_trial_policy || setting_->test_hot_load)) {
+    LOG(ERROR) << "Adaptive trials and hot load run the trials of a url in a row, "
+        << "ignore --" << switches::kSchedule;
+    policy = ExperimentScheduler::kBlocked;
+  }
+
+  // Measured in the previous campaigns, none for the first one
+  transition_costs_.Load(constants_.kScheduleCostFile);
+
+  state_.schedule_seed = setting_->schedule_seed;
+  state_.schedule_num_tries = setting_->num_try_per_url;
+  state_.schedule_policy = ExperimentScheduler::Create(policy, state_.schedule_seed,
+      ScheduledCommandLines(), state_.manifest.num_urls(), state_.schedule_num_tries,
+      transition_costs_)->policy();
+  LOG(INFO) << "Schedule: " << ExperimentScheduler::PolicyName(state_.schedule_policy);
+
+  BuildSchedule();
+  if (!IsScheduled())
+    return;
+
+  state_.schedule_position = 0;
+  if (schedule_.empty()) {
+    state_.all_experiments_finished = true;
+    return;
+  }
+  state_.experiment_command_line_index = schedule_[0].command_line_index;
+  state_.current_url_index = schedule_[0].url_index;
+  state_.current_url_try_done = schedule_[0].try_index;
+}
+
+void BrowserProfilerImpl::BuildSchedule() {
+  schedule_.clear();
+  if (!IsScheduled())
+    return;
+
+  ExperimentScheduler::Create(state_.schedule_policy, state_.schedule_seed,
+      ScheduledCommandLines(), state_.manifest.num_urls(), state_.schedule_num_tries,
+      transition_costs_)->Schedule(ScheduledCommandLines(), state_.manifest.num_urls(),
+          state_.schedule_num_tries, &schedule_);
+}
+
+// Without experiment command lines, the campaign runs on the current one
+size_t BrowserProfilerImpl::ScheduledCommandLines() const {
+  return std::max<size_t>(1, state_.manifest.num_command_lines());
+}
+
+// Parallel instances may overwrite each other's measurement, a moving average anyway
+void BrowserProfilerImpl::RecordTransitionCost() {
+  if (state_.pending_transition == ExperimentScheduler::kNoTransition)
+    return;
+
+  transition_costs_.Add(state_.pending_transition, MonotonicNow() - state_.last_trial_end_time);
+  state_.pending_transition = ExperimentScheduler::kNoTransition;
+  if (!transition_costs_.Save(constants_.kScheduleCostFile))
+    LOG(ERROR) << "Cannot save transition costs to " << constants_.kScheduleCostFile.value();
 }
 
 void BrowserProfilerImpl::BackupCurrentCommandLine() {
   if (!base::CopyFile(browser_command_line_file_,
-          GenerateBackupFileName(browser_command_line_file_))) {
+          GenerateBackupFileName(browser_command_line_file_, setting_->instance_index))) {
     LOG(ERROR) << "Cannot backup current command line";
   }
 }
 
 void BrowserProfilerImpl::RestoreBackupCommandLine() {
-    if (!base::CopyFile(GenerateBackupFileName(browser_command_line_file_),
+    if (!base::CopyFile(GenerateBackupFileName(browser_command_line_file_, setting_->instance_index),
             browser_command_line_file_)) {
       LOG(ERROR) << "Cannot restore original command line";
     }
@@ -710,22 +1066,6 @@ std::string BrowserProfilerImpl::BrowserCommandLine() {
   return current_command_line_;
 }
 
-void BrowserProfilerImpl::StartInternalTracing() {
-  VLOG(0) << "Start internal tracing";
-
-  internal_tracing_controller_ = client_->GetInternalTracingControllerInstance();
-  if (internal_tracing_controller_  == nullptr)
-    LOG(FATAL) << "Fail to initialize internal tracing controller";
-
-  if (internal_tracing_controller_ == nullptr
-      || !internal_tracing_controller_->StartTracing(this, setting_->tracing_categories,
-        "record-as-much-as-possible")) {
-    LOG(ERROR) << "Failed to start ChromeTracing";
-  } else {
-    chrome_tracing_started_ = true;
-  }
-}
-
 void BrowserProfilerImpl::InitializeCpuSetupCommands() {
   std::string num_cores =
       base::IntToString(android_cpu_tools::CommandLineCpuInfo::MaxCoreId() - android_cpu_tools::CommandLineCpuInfo::MinCoreId() + 1);
@@ -762,65 +1102,22 @@ void BrowserProfilerImpl::InitializeCpuSetupCommands() {
       << default_cpu_setup_command_.GetCommandLineString();
 }
 
-void BrowserProfilerImpl::StartFtrace() {
-  ExecuteCommandAsRoot(constants_.kStartFtraceScript);
-}
-
-void BrowserProfilerImpl::StopFtrace(const std::string& output_prefix) {
-  std::string cmd(constants_.kStopFtraceScript.value());
-  cmd.append(" " + output_prefix);
-  ExecuteCommandAsRoot(cmd);
-}
-
-void BrowserProfilerImpl::StartScreenRecord(const std::string& output_prefix) {
-  ExecuteCommandAsRoot(constants_.kStartScreenRecordScript.value() + " " + output_prefix);
-}
-
-void BrowserProfilerImpl::StopScreenRecord() {
-  ExecuteCommandAsRoot(constants_.kStopScreenRecordScript);
-}
-
-void BrowserProfilerImpl::StartCpuUtilizationMonitor(const std::string& output_prefix) {
-  ExecuteCommandAsRoot(constants_.kStartCpuUtilizationMonitorScript.value() + " " + output_prefix);
-}
-
-void BrowserProfilerImpl::StopCpuUtilizationMonitor() {
-  ExecuteCommandAsRoot(constants_.kStopCpuUtilizationMonitorScript);
-}
-
-void BrowserProfilerImpl::StartCapturePackets(const std::string& prefix) {
-  std::string pcap_file(constants_.kBpOutDir.value());
-  pcap_file.append(prefix + ".");
-  pcap_file.append(constants_.kPcapBaseName);
-
-  std::string capture_packets_cmd(constants_.kStartCapturePacketsScript.value());
-  capture_packets_cmd.append(" " + pcap_file);
-  ExecuteCommandAsRoot(capture_packets_cmd);
-}
-
-void BrowserProfilerImpl::StopCapturePackets() {
-  ExecuteCommandAsRoot(constants_.kStopCapturePacketsScript);
-}
-
-void BrowserProfilerImpl::ClearDnsCache() {
-  ExecuteCommandAsRoot(constants_.kClearDnsCacheCommand);
-}
-
 BrowserProfilerImpl::Setting::Setting()
-  : capture_packets(false),
-    do_ftrace(false),
-    do_itrace(false),
-    tracing_categories("*"),
-    measure_power(false),
-    num_try_per_url(5),
+  : num_try_per_url(5),
     need_clear_cache(false),
     clear_dns_cache(false),
     user_think_time_millis(0),
     rsync_logs_after_all(false),
     clean_logs_after_all(false),
-    screen_record(false),
-    monitor_cpu_utilization(false),
     test_hot_load(false),
+    use_root_helper(false),
+    in_session_trials(false),
+    instance_index(ParallelInstanceIndex()),
+    num_instances(1),
+    adaptive_trial_metric(ExperimentResult::kPageLoadTime),
+    warm_up_try_per_url(0),
+    schedule_policy(ExperimentScheduler::kBlocked),
+    schedule_seed(std::time(NULL)),
     browser_config_name("UnknownConfig") {
   const base::CommandLine& command_line = *base::CommandLine::ForCurrentProcess();
 
@@ -831,10 +1128,6 @@ BrowserProfilerImpl::Setting::Setting()
     }
   }
 
-  do_itrace = command_line.HasSwitch(switches::kDoItrace);
-  if (do_itrace)
-    tracing_categories = command_line.GetSwitchValueASCII(switches::kDoItrace);
-
   std::string utt_str = command_line.GetSwitchValueASCII(switches::kUserThinkTimeMillis);
   if (!utt_str.empty()) {
     if (!base::StringToUint(utt_str, &user_think_time_millis)) { 
@@ -842,19 +1135,56 @@ BrowserProfilerImpl::Setting::Setting()
     }
   }
 
-  capture_packets = command_line.HasSwitch(switches::kCapturePackets);
-  do_ftrace = command_line.HasSwitch(switches::kDoFtrace);
-  measure_power = command_line.HasSwitch(switches::kMeasurePower);
   need_clear_cache = command_line.HasSwitch(switches::kClearCache);
   clear_dns_cache = command_line.HasSwitch(switches::kClearDnsCache);
   rsync_logs_after_all = command_line.HasSwitch(switches::kRsyncLogsAfterAll);
   clean_logs_after_all = command_line.HasSwitch(switches::kCleanLogsAfterAll);
-  screen_record = command_line.HasSwitch(switches::kScreenRecord);
-  monitor_cpu_utilization = command_line.HasSwitch(switches::kMonitorCpuUtilization);
   test_hot_load = command_line.HasSwitch(switches::kTestHotLoad);
+  use_root_helper = command_line.HasSwitch(switches::kUseRootHelper);
+  in_session_trials = command_line.HasSwitch(switches::kInSessionTrials);
+  if (instance_index >= 0)
+    base::StringToUint(command_line.GetSwitchValueASCII(switches::kNumInstances), &num_instances);
 
   if (command_line.HasSwitch(switches::kBrowserConfigName))
     browser_config_name = command_line.GetSwitchValueASCII(switches::kBrowserConfigName);
+
+  std::string schedule_str = command_line.GetSwitchValueASCII(switches::kSchedule);
+  if (!schedule_str.empty() && !ExperimentScheduler::ParsePolicy(schedule_str, &schedule_policy))
+    LOG(ERROR) << "Unknown " << switches::kSchedule << ": " << schedule_str;
+
+  std::string seed_str = command_line.GetSwitchValueASCII(switches::kScheduleSeed);
+  if (!seed_str.empty() && !base::StringToUint64(seed_str, &schedule_seed))
+    LOG(ERROR) << "Cannot parse switch " << switches::kScheduleSeed << ": " << seed_str;
+
+  AdaptiveTrialPolicy::Config adaptive_config;
+  std::string target_str = command_line.GetSwitchValueASCII(switches::kAdaptiveTrialsTarget);
+  if (!target_str.empty()) {
+    unsigned max_try_per_url = adaptive_config.max_trials;
+    std::string max_try_str = command_line.GetSwitchValueASCII(switches::kMaxTryPerUrl);
+    if (!max_try_str.empty() && !base::StringToUint(max_try_str, &max_try_per_url))
+      LOG(ERROR) << "Cannot parse switch " << switches::kMaxTryPerUrl << ": " << max_try_str;
+
+    std::string warm_up_str = command_line.GetSwitchValueASCII(switches::kWarmUpTryPerUrl);
+    if (!warm_up_str.empty() && !base::StringToUint(warm_up_str, &warm_up_try_per_url))
+      LOG(ERROR) << "Cannot parse switch " << switches::kWarmUpTryPerUrl << ": " << warm_up_str;
+
+    std::string metric_str = command_line.GetSwitchValueASCII(switches::kAdaptiveTrialsMetric);
+    if (metric_str == "energy")
+      adaptive_trial_metric = ExperimentResult::kEnergy;
+    else if (!metric_str.empty() && metric_str != "page-load-time")
+      LOG(ERROR) << "Unknown " << switches::kAdaptiveTrialsMetric << ": " << metric_str;
+
+    // The values of a url are kept in the state
+    adaptive_config.min_trials = num_try_per_url;
+    adaptive_config.max_trials = std::min<size_t>(
+        std::max(max_try_per_url, num_try_per_url), BrowserProfilerImplState::kMaxUrlValues);
+    if (!base::StringToDouble(target_str, &adaptive_config.target_relative_half_width) ||
+        adaptive_config.target_relative_half_width <= 0) {
+      LOG(ERROR) << "Cannot parse switch " << switches::kAdaptiveTrialsTarget << ": " << target_str;
+    } else {
+      adaptive_trial_policy.reset(new AdaptiveTrialPolicy(adaptive_config));
+    }
+  }
 }
 
 }  // namespace browser_profiler
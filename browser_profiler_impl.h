@@ -9,11 +9,18 @@
 
 #include "browser_profiler_impl_constants.h"
 #include "browser_profiler_impl_state.h"
+#include "browser_restart_monitor.h"
 #include "experiment_result.h"
-#include "power_tool_controller.h"
+#include "experiment_scheduler.h"
+#include "result_aggregator.h"
+#include "root_command_runner.h"
+#include "tracer.h"
+#include "tracer_launcher.h"
+#include "tracer_registry.h"
 
 #include "base/command_line.h"
 #include "base/files/file_path.h"
+#include "base/time/time.h"
 
 #if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
     (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
@@ -63,10 +70,16 @@ class BrowserProfilerImpl : public BrowserProfiler {
  private:
   void PostProcessInternal();
   void PostProcessInternalSecondHalf();
+  void InitializeTracers();
   void StartTracers();
   void StopTracers();
+  void OnAsyncTracerStopped(const std::string& name);
   void StopTracersSecondHalf();
+  // Return only if it cannot restart the browser, in which case it is fatal
   void RestartBrowser();
+  // Reset the per-trial state and open a new shell for the next trial, in this process
+  // Return false if the browser must restart instead
+  bool ContinueInSession();
   void ConsolidateExperimentResult(const std::string& url,
         double navigation_start_monotonic_time, double load_event_end_monotonic_time);
 
@@ -79,52 +92,87 @@ class BrowserProfilerImpl : public BrowserProfiler {
   // and model name
   std::string GenerateExperimentId(const std::string& current_experiment_id);
 
-  void StartPowerSampling();
-  void StopPowerSampling();
   void UpdateExperimentIndexAndCommandLine();
+  // Whether the current url had enough trials, fixed or adaptive
+  bool UrlTrialsDone() const;
+  // Keep the value of the trial for adaptive trials
+  void RecordAdaptiveTrialValue();
+  // Return true if the next url is in the next command line
+  bool AdvanceToNextUrl();
+  // Move to the next trial of the schedule
+  // Return true if it is in another command line
+  bool AdvanceInSchedule();
+  // Move to the next trial of this instance, return true if the command line changes
+  bool AdvanceToOwnCell();
+  // Whether this instance runs the current (or the given) url and command line
+  bool IsOwnCell() const;
+  bool IsOwnCell(const ExperimentScheduler::Cell& cell) const;
+  // Whether no trial of this instance came before the current one
+  bool IsFirstTrial() const;
+  // Whether the trials follow schedule_, otherwise the blocked order of the indexes
+  bool IsScheduled() const;
+  // Resolve the schedule of a new campaign and move to its first trial
+  void StartSchedule();
+  void BuildSchedule();
+  size_t ScheduledCommandLines() const;
+  // Cost of the transition from the previous trial, once per trial
+  void RecordTransitionCost();
   void BackupCurrentCommandLine();
   void RestoreBackupCommandLine();
   std::string BrowserCommandLine();
-  void StartInternalTracing();
   void InitializeCpuSetupCommands();
 
-  void StartFtrace();
-  void StopFtrace(const std::string& output_prefix);
-  void StartScreenRecord(const std::string& output_prefix);
-  void StopScreenRecord();
-  void StartCpuUtilizationMonitor(const std::string& output_prefix);
-  void StopCpuUtilizationMonitor();
-  void StartCapturePackets(const std::string& prefix);
-  void StopCapturePackets();
-  void ClearDnsCache();
+  // Keep start/stop latency of each tracer of the current experiment
+  void RecordTracerLatencies(const std::string& phase, const TracerLauncher& launcher);
+  void WriteTracerLatencies();
 
   struct Setting;
 
 #if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
     (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
   std::unique_ptr<Setting> setting_;
-	std::unique_ptr<PowerToolController> power_tool_controller_;
 #else
   scoped_ptr<Setting> setting_;
-	scoped_ptr<PowerToolController> power_tool_controller_;
 #endif
 
 	BrowserProfilerImplState state_;
 
 	ExperimentResult experiment_result_;
 
+  // Summary of the successful trials of the campaign so far
+  ResultAggregator result_aggregator_;
+
   base::FilePath browser_command_line_file_;
 
   BrowserProfilerImplConstants constants_;
 
+  RootCommandRunner root_runner_;
+
+  BrowserRestartMonitor restart_monitor_;
+
   base::CommandLine default_cpu_setup_command_;
   base::CommandLine sync_workload_cpu_setup_command_;
 
   std::string experiment_id_;
 
-  std::shared_ptr<InternalTracingController> internal_tracing_controller_;
-  
-  bool chrome_tracing_started_;
+  TracerRegistry tracer_registry_;
+  TracerContext tracer_context_;
+
+  // Tracers enabled on the command line, and those started in the current experiment
+  std::vector<std::unique_ptr<Tracer>> tracers_;
+  std::vector<Tracer*> started_tracers_;
+
+  int pending_async_stops_;
+  base::TimeTicks async_stop_start_time_;
+
+  std::vector<TracerLauncher::Latency> tracer_latencies_;
+
+  // All trials of the campaign, in order; empty if blocked
+  std::vector<ExperimentScheduler::Cell> schedule_;
+  ExperimentScheduler::TransitionCosts transition_costs_;
+
+  // Trials done in this process before the current one
+  uint64_t session_trial_;
 
   // whether or not the Prepare() is executed
   // E.g., at start up , PostProcess() will be called but not Prepare()
@@ -3,6 +3,8 @@
 
 #include "browser_profiler_impl_constants.h"
 
+#include "base/strings/string_number_conversions.h"
+
 namespace {
 
 // Input and temporary files
@@ -14,25 +16,47 @@ const char kOutDirName[] = "out/";
 // Scripts and executables
 const char kBinDirName[] = "bin/";
 
+// State and logs of one of parallel instances, see tools/parallel_runner
+const char kInstanceDirPrefix[] = "instance-";
+
 } // namespace
 
 namespace browser_profiler {
 
-BrowserProfilerImplConstants::BrowserProfilerImplConstants(const base::FilePath& home_dir, const base::FilePath& writable_dir)
+BrowserProfilerImplConstants::BrowserProfilerImplConstants(const base::FilePath& home_dir, const base::FilePath& writable_dir,
+    int instance_index)
   : kBpHome(home_dir), 
     kBpTmpDir(writable_dir.Append(kTmpDirName)),
     kClearDnsCacheCommand("ndc resolver flushdefaultif"),
     kExperimentResultBaseName("experiment_result.log"),
+    kExperimentResultStoreBaseName("experiment_result.bpr"),
+    kTracerLatencyBaseName("tracer_latency.log"),
     kFtraceBaseName("ftrace.dat"),
     kItraceBaseName("itrace.json"),
     kPcapBaseName("pcap"),
+    kCpuUtilizationBaseName("cpu_util.bin"),
+    kClocksBaseName("clocks"),
     kBlankPageUrl("about:blank") {
-    kBpStateFile = kBpTmpDir.Append(std::string("browser-profiler-state"));
+    std::string instance_dir_name = instance_index >= 0 ?
+        kInstanceDirPrefix + base::IntToString(instance_index) : std::string();
+    kBpInstanceTmpDir = instance_dir_name.empty() ? kBpTmpDir : kBpTmpDir.Append(instance_dir_name);
+    kBpStateFile = kBpInstanceTmpDir.Append(std::string("browser-profiler-state"));
+    kAllExperimentsFinishedFile = kBpInstanceTmpDir.Append("all-experiments-finished");
     kPowerToolServerConfigFile = kBpTmpDir.Append("power-tool-server-config");
+    kPowerSyncCalibrationFile = kBpTmpDir.Append("power-sync-calibration");
+    kBrowserRestartRequestFile = kBpInstanceTmpDir.Append("browser-restart-request");
+    kBrowserReadyFile = kBpInstanceTmpDir.Append("browser-ready");
+    kScheduleCostFile = kBpTmpDir.Append("schedule-transition-costs");
+    kResultAggregateFile = kBpInstanceTmpDir.Append("result-aggregate");
     kExperimentCommandLineFile = kBpTmpDir.Append("experiment-command-lines");
     kBpUrlListFile = kBpTmpDir.Append("bp-url-list");
-    kBpOutDir = writable_dir.Append(kOutDirName);
+    kBpOutDir = instance_dir_name.empty() ? writable_dir.Append(kOutDirName) :
+        writable_dir.Append(kOutDirName).Append(instance_dir_name);
     kExperimentResultFile = kBpOutDir.Append(kExperimentResultBaseName);
+    // Shared by the instances
+    kExperimentResultStoreFile = writable_dir.Append(kOutDirName).Append(kExperimentResultStoreBaseName);
+    kResultSummaryFile = kBpOutDir.Append("experiment_summary.tsv");
+    kTracerLatencyFile = kBpOutDir.Append(kTracerLatencyBaseName);
     kBinDir = kBpHome.Append(kBinDirName);
     kStartFtraceScript = kBinDir.Append("start-ftrace.sh");
     kStopFtraceScript = kBinDir.Append("stop-ftrace.sh");
@@ -42,10 +66,10 @@ BrowserProfilerImplConstants::BrowserProfilerImplConstants(const base::FilePath&
     kCpuInfoExecutable = kBinDir.Append("cpu_info");
     kStartScreenRecordScript = kBinDir.Append("record_screen_start.sh");
     kStopScreenRecordScript = kBinDir.Append("record_screen_stop.sh");
-    kStartCpuUtilizationMonitorScript = kBinDir.Append("monitor_cpu_util_start.sh");
-    kStopCpuUtilizationMonitorScript = kBinDir.Append("monitor_cpu_util_stop.sh");
     kStartCapturePacketsScript = kBinDir.Append("capture-packets.sh");
     kStopCapturePacketsScript = kBinDir.Append("capture-packets-stop.sh");
+    kRootHelperExecutable = kBinDir.Append("root_helper");
+    kPowerToolRelayExecutable = kBinDir.Append("power_tool_relay");
 }
 
 } // namespace browser_profiler 
@@ -11,19 +11,34 @@
 namespace browser_profiler {
 
 struct BrowserProfilerImplConstants {
-  BrowserProfilerImplConstants(const base::FilePath& home_dir, const base::FilePath& writable_dir);
+  // instance_index: this browser is one of several running a campaign in parallel,
+  // -1 if it runs the campaign alone
+  // The instances share the inputs in tmp/ and the result store in out/, while
+  // each one keeps its state in tmp/instance-<index>/ and its logs in out/instance-<index>/
+  BrowserProfilerImplConstants(const base::FilePath& home_dir, const base::FilePath& writable_dir,
+      int instance_index);
 
   base::FilePath kBpHome;
 
   // Only out/ and tmp/ are accessible from apps
   base::FilePath kBpTmpDir;
+  base::FilePath kBpInstanceTmpDir;
   base::FilePath kBpStateFile;
+  base::FilePath kAllExperimentsFinishedFile;
   base::FilePath kPowerToolServerConfigFile;
+  base::FilePath kPowerSyncCalibrationFile;
+  base::FilePath kBrowserRestartRequestFile;
+  base::FilePath kBrowserReadyFile;
+  base::FilePath kScheduleCostFile;
+  base::FilePath kResultAggregateFile;
   base::FilePath kExperimentCommandLineFile;
   base::FilePath kBpUrlListFile;
 
   base::FilePath kBpOutDir;
   base::FilePath kExperimentResultFile;
+  base::FilePath kExperimentResultStoreFile;
+  base::FilePath kResultSummaryFile;
+  base::FilePath kTracerLatencyFile;
 
   base::FilePath kBinDir;
   base::FilePath kStartFtraceScript;
@@ -34,17 +49,21 @@ struct BrowserProfilerImplConstants {
   base::FilePath kCpuInfoExecutable;
   base::FilePath kStartScreenRecordScript;
   base::FilePath kStopScreenRecordScript;
-  base::FilePath kStartCpuUtilizationMonitorScript;
-  base::FilePath kStopCpuUtilizationMonitorScript;
   base::FilePath kStartCapturePacketsScript;
   base::FilePath kStopCapturePacketsScript;
+  base::FilePath kRootHelperExecutable;
+  base::FilePath kPowerToolRelayExecutable;
 
   std::string kClearDnsCacheCommand;
 
   std::string kExperimentResultBaseName;
+  std::string kExperimentResultStoreBaseName;
+  std::string kTracerLatencyBaseName;
   std::string kFtraceBaseName;
   std::string kItraceBaseName;
   std::string kPcapBaseName;
+  std::string kCpuUtilizationBaseName;
+  std::string kClocksBaseName;
 
   std::string kBlankPageUrl;
 };
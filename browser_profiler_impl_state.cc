@@ -3,9 +3,17 @@
 
 #include "browser_profiler_impl_state.h"
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 #include <sstream>
 
+#include "crc32.h"
+
 #include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
 #include "base/logging.h"
 #include "base/strings/string_util.h"
 #include "base/strings/string_split.h"
@@ -69,11 +77,45 @@ bool ReadExperimentUrlList(const base::FilePath& url_list_file,
   return true;
 }
 
+const char kProgressMagic[] = "BPSTATE1";
+const uint32_t kProgressVersion = 3;
+
+// Fixed-size progress of a campaign, in host byte order
+struct ProgressRecord {
+  char magic[8];
+  uint32_t version;
+  uint32_t size;
+  uint64_t manifest_hash;
+  uint64_t experiment_command_line_index;
+  uint64_t current_url_index;
+  uint64_t current_url_try_done;
+  uint8_t started;
+  uint8_t all_experiments_finished;
+  uint8_t start_new_experiments;
+  uint8_t padding[5];
+  char last_experiment_id[256];
+  uint32_t num_current_url_values;
+  uint32_t padding2;
+  double current_url_values[browser_profiler::BrowserProfilerImplState::kMaxUrlValues];
+  uint64_t schedule_seed;
+  uint64_t schedule_num_tries;
+  uint64_t schedule_position;
+  double last_trial_end_time;
+  uint8_t schedule_policy;
+  uint8_t pending_transition;
+  uint8_t padding3[2];
+  // Of all the fields above
+  uint32_t crc32;
+};
+
 }  // namespace
 
 
 namespace browser_profiler {
 
+// static
+const size_t BrowserProfilerImplState::kMaxUrlValues;
+
 BrowserProfilerImplState::BrowserProfilerImplState() {
   Reset();
 }
@@ -83,130 +125,141 @@ void BrowserProfilerImplState::Reset() {
   current_url_index = 0;
   current_url_try_done = 0;
 
-  experiment_command_lines.clear();
-  experiment_urls.clear();
-
   started = false;
   all_experiments_finished = false;
   start_new_experiments = false;
   last_experiment_id = "last_experiment_id";
+  current_url_values.clear();
+
+  schedule_policy = ExperimentScheduler::kBlocked;
+  schedule_seed = 0;
+  schedule_num_tries = 0;
+  schedule_position = 0;
+  pending_transition = ExperimentScheduler::kNoTransition;
+  last_trial_end_time = 0;
 }
 
 void BrowserProfilerImplState::Initialize(const base::FilePath& experiment_command_lines_file,
-      const base::FilePath& url_list_file) {
+      const base::FilePath& url_list_file, const base::FilePath& manifest_dir) {
   // Reset values after loading from file
   Reset();
 
+  std::vector<std::string> experiment_command_lines;
   if (!ReadExperimentCommandLines(experiment_command_lines_file,
           &experiment_command_lines)) {
     LOG(ERROR) << "Fail to read experiment command lines at " << experiment_command_lines_file.value();
   }
 
+  std::vector<std::string> experiment_urls;
   if (!ReadExperimentUrlList(url_list_file, &experiment_urls)) {
     LOG(FATAL) << "Fail to read experiment url list";
   }
-}
 
-// No exception allowed in Chromium so we need to check each write
-#define STREAM_WRITELN(stream, variable) \
-  do { \
-    stream << variable << std::endl; \
-    if (!stream.good()) { \
-      LOG(FATAL) << "Error writing string to stream"; \
-      return false; \
-    } \
- } while (0);
-
-// To save development time, use the simplest way: hardcode a format
-// In the future, may use json Chromium's pickle (with crc32 check)
-bool BrowserProfilerImplState::SaveToFile(const base::FilePath& file_name) {
-  std::ostringstream output;
-
-  STREAM_WRITELN(output, experiment_command_line_index);
-  STREAM_WRITELN(output, current_url_index);
-  STREAM_WRITELN(output, current_url_try_done);
-  STREAM_WRITELN(output, experiment_command_lines.size());
-
-  for (size_t i = 0; i < experiment_command_lines.size(); ++i) {
-    STREAM_WRITELN(output, experiment_command_lines[i]);
+  if (!manifest.Create(manifest_dir, experiment_command_lines, experiment_urls)) {
+    LOG(FATAL) << "Fail to store the campaign manifest in " << manifest_dir.value();
   }
+}
 
-  STREAM_WRITELN(output, experiment_urls.size());
-  for (size_t i = 0; i < experiment_urls.size(); ++i) {
-    STREAM_WRITELN(output, experiment_urls[i]);
+// Save only the progress: command lines and urls are in the campaign manifest
+// Written to a temporary file then renamed, a crash never leaves a half-written state
+bool BrowserProfilerImplState::SaveToFile(const base::FilePath& file_name) {
+  if (!manifest.is_open()) {
+    LOG(ERROR) << "No campaign manifest to refer to";
+    return false;
   }
 
-  STREAM_WRITELN(output, started);
-  STREAM_WRITELN(output, all_experiments_finished);
-  STREAM_WRITELN(output, start_new_experiments);
-  STREAM_WRITELN(output, last_experiment_id);
+  ProgressRecord record;
+  memset(&record, 0, sizeof(record));
+  memcpy(record.magic, kProgressMagic, sizeof(record.magic));
+  record.version = kProgressVersion;
+  record.size = sizeof(record);
+  record.manifest_hash = manifest.hash();
+  record.experiment_command_line_index = experiment_command_line_index;
+  record.current_url_index = current_url_index;
+  record.current_url_try_done = current_url_try_done;
+  record.started = started;
+  record.all_experiments_finished = all_experiments_finished;
+  record.start_new_experiments = start_new_experiments;
+
+  if (last_experiment_id.length() >= sizeof(record.last_experiment_id))
+    LOG(WARNING) << "Truncate last experiment id " << last_experiment_id;
+  strncpy(record.last_experiment_id, last_experiment_id.c_str(),
+      sizeof(record.last_experiment_id) - 1);
+
+  record.num_current_url_values = std::min(current_url_values.size(), kMaxUrlValues);
+  std::copy(current_url_values.begin(),
+      current_url_values.begin() + record.num_current_url_values, record.current_url_values);
+
+  record.schedule_policy = schedule_policy;
+  record.schedule_seed = schedule_seed;
+  record.schedule_num_tries = schedule_num_tries;
+  record.schedule_position = schedule_position;
+  record.pending_transition = pending_transition;
+  record.last_trial_end_time = last_trial_end_time;
+
+  record.crc32 = Crc32(&record, offsetof(ProgressRecord, crc32));
 
-  std::string output_str = output.str();
   // permission denied on /data/local/tmp on Android 6
   // not work because of new lines: std::string cmd = "su -c printf '" + output_str + "' > " + file_name.value();
-  return WriteFile(file_name, output_str.c_str(), output_str.length()) == output_str.length();
+  return base::ImportantFileWriter::WriteFileAtomically(file_name,
+      std::string(reinterpret_cast<const char*>(&record), sizeof(record)));
 }
 
-// No exception allowed in Chromium so we need to check each read
-// file_name and stream_str must match ones in LoadFromFile
-#define STREAM_READ(stream, variable) \
-  do { \
-    stream >> variable; \
-    if (!stream.good()) { \
-      LOG(FATAL) << "Error parsing string from state file (" << file_name.value() \
-          << "): " << state_str; \
-      return false; \
-    } \
- } while (0);
-
-// Load in the inverse order of saving
 bool BrowserProfilerImplState::LoadFromFile(const base::FilePath& file_name) {
   if (!base::PathExists(file_name)) {
     LOG(ERROR) << "State file not exist at: " << file_name.value();
     return false;
   }
 
-  std::string state_str;
-  if (!base::ReadFileToString(file_name, &state_str)) {
-    LOG(FATAL) << "Cannot read state file: " << file_name.value();
+  ProgressRecord record;
+  int record_size = base::ReadFile(file_name, reinterpret_cast<char*>(&record), sizeof(record));
+
+  // E.g., a state file of an older version, start over
+  if (record_size < static_cast<int>(offsetof(ProgressRecord, size)) ||
+      memcmp(record.magic, kProgressMagic, sizeof(record.magic)) != 0 ||
+      record.version != kProgressVersion) {
+    LOG(ERROR) << "Not a browser profiler state file of this version: " << file_name.value();
     return false;
   }
 
-  std::istringstream input(state_str);
+  if (record_size != sizeof(record) || record.size != sizeof(record) ||
+      record.crc32 != Crc32(&record, offsetof(ProgressRecord, crc32))) {
+    LOG(FATAL) << "Corrupted state file: " << file_name.value();
+    return false;
+  }
 
-  STREAM_READ(input, experiment_command_line_index);
-  STREAM_READ(input, current_url_index);
-  STREAM_READ(input, current_url_try_done);
+  if (!manifest.Open(file_name.DirName(), record.manifest_hash)) {
+    LOG(FATAL) << "Cannot open the campaign manifest of state file " << file_name.value();
+    return false;
+  }
 
-  size_t experiment_command_lines_size;
-  STREAM_READ(input, experiment_command_lines_size);
-  LOG(INFO) << "Experiment command lines size: " << experiment_command_lines_size;
-  experiment_command_lines.resize(experiment_command_lines_size);
+  experiment_command_line_index = record.experiment_command_line_index;
+  current_url_index = record.current_url_index;
+  current_url_try_done = record.current_url_try_done;
+  started = record.started;
+  all_experiments_finished = record.all_experiments_finished;
+  start_new_experiments = record.start_new_experiments;
 
-  // Skip all new lines, otherwise getline will have unexpected behavior
-  input.ignore(1000, '\n');
+  record.last_experiment_id[sizeof(record.last_experiment_id) - 1] = '\0';
+  last_experiment_id = record.last_experiment_id;
 
-  for (size_t i = 0; i < experiment_command_lines_size; ++i) {
-    std::string cmdline;
-    if (!std::getline(input, cmdline)) {
-      LOG(FATAL) << "Cannot read experiment command line";
-    }
-    LOG(INFO) << "Read command line: " << cmdline;
-    experiment_command_lines[i] = cmdline;
-  }
+  current_url_values.assign(record.current_url_values, record.current_url_values +
+      std::min<size_t>(record.num_current_url_values, kMaxUrlValues));
 
-  size_t experiment_urls_size;
-  STREAM_READ(input, experiment_urls_size);
-  experiment_urls.resize(experiment_urls_size);
-  for (size_t i = 0; i < experiment_urls_size; ++i) {
-    STREAM_READ(input, experiment_urls[i]);
+  // Same checks as for a corrupted file: the schedule is rebuilt from these
+  if (record.schedule_policy >= ExperimentScheduler::kCostMinimizing ||
+      record.pending_transition > ExperimentScheduler::kNoTransition) {
+    LOG(FATAL) << "Invalid schedule in state file: " << file_name.value();
+    return false;
   }
-
-  STREAM_READ(input, started);
-  STREAM_READ(input, all_experiments_finished);
-  STREAM_READ(input, start_new_experiments);
-  STREAM_READ(input, last_experiment_id);
-
+  schedule_policy = static_cast<ExperimentScheduler::Policy>(record.schedule_policy);
+  schedule_seed = record.schedule_seed;
+  schedule_num_tries = record.schedule_num_tries;
+  schedule_position = record.schedule_position;
+  pending_transition = static_cast<ExperimentScheduler::Transition>(record.pending_transition);
+  last_trial_end_time = record.last_trial_end_time;
+
+  LOG(INFO) << "Experiment command lines size: " << manifest.num_command_lines();
   return true;
 }
 
@@ -6,26 +6,36 @@
 #include <string>
 #include <vector>
 
+#include "campaign_manifest.h"
+#include "experiment_scheduler.h"
+
 #include "base/files/file_path.h"
 
 namespace browser_profiler {
 
 // Serializable state of BrowserProfilerImpl
+// The command lines and urls are in the campaign manifest, written once per campaign
+// The state file only keeps the progress, a small fixed-size record,
+// so saving and loading cost the same whatever the size of the campaign
 struct BrowserProfilerImplState {
+  // Bound of current_url_values, thus of adaptive trials
+  static const size_t kMaxUrlValues = 64;
+
   BrowserProfilerImplState();
 
   // Reset state
   void Reset();
 
   // Reset and read command lines and url list
+  // into a campaign manifest stored in manifest_dir
   void Initialize(const base::FilePath& experiment_command_lines_file,
-      const base::FilePath& url_list_file);
+      const base::FilePath& url_list_file, const base::FilePath& manifest_dir);
 
-  // Save to a file
+  // Save to a file, atomically: a crash leaves either the previous or the new state
   // Return true if succeed
   bool SaveToFile(const base::FilePath& file_name);
 
-  // Load from a file
+  // Load from a file, and map its campaign manifest (in the same directory)
   // Return true if succeed
   bool LoadFromFile(const base::FilePath& file_name);
 
@@ -36,8 +46,24 @@ struct BrowserProfilerImplState {
   size_t current_url_index;
   size_t current_url_try_done; // count after experiment done
 
-  std::vector<std::string> experiment_command_lines;
-  std::vector<std::string> experiment_urls;
+  // Measured values of the trials of the current url, for adaptive trials
+  std::vector<double> current_url_values;
+
+  // Resolved once per campaign, never kCostMinimizing
+  ExperimentScheduler::Policy schedule_policy;
+  uint64_t schedule_seed;
+  // Trials per url and command line, fixed for the campaign as the schedule depends on it
+  size_t schedule_num_tries;
+  // Index of the current trial in the schedule, unused if blocked
+  size_t schedule_position;
+
+  // Transition from the last successful trial, and its end on the monotonic clock,
+  // to measure the transition costs
+  ExperimentScheduler::Transition pending_transition;
+  double last_trial_end_time;
+
+  // Experiment command lines and urls
+  CampaignManifest manifest;
 
   bool started;
   bool all_experiments_finished;
@@ -47,5 +73,5 @@ struct BrowserProfilerImplState {
   std::string last_experiment_id;
 };
 
-} // namespace browser_profiler 
+} // namespace browser_profiler
 #endif // BROWSER_PROFILER_BROWSER_PROFILER_IMPL_STATE_H_
@@ -9,9 +9,26 @@ namespace switches {
 // E.g., Default, EnergySaving
 const char kBrowserConfigName[] = "browser-config-name";
 
-// Record network packets (e.g., using tcpdump)
+// Value which --adaptive-trials-target applies to: page-load-time (default) or energy
+const char kAdaptiveTrialsMetric[] = "adaptive-trials-metric";
+
+// Adaptive trials: run a url until the 95% confidence interval of its mean page load time
+// is within this fraction of the mean, e.g., 0.05
+// --num-try-per-url is then the minimum, bounded by --max-try-per-url
+const char kAdaptiveTrialsTarget[] = "adaptive-trials-target";
+
+// Classic BPF program of --capture-packets, a file of tcpdump -ddd output
+const char kCaptureFilter[] = "capture-filter";
+
+// Interface of --capture-packets, all interfaces by default
+const char kCaptureInterface[] = "capture-interface";
+
+// Record network packets, in process if possible, otherwise using tcpdump
 const char kCapturePackets[] = "capture-packets";
 
+// Bytes kept of each packet by --capture-packets
+const char kCaptureSnaplen[] = "capture-snaplen";
+
 // Automatic delete log files after all experiments finish
 const char kCleanLogsAfterAll[] = "clean-logs-after-all";
 
@@ -21,6 +38,9 @@ const char kClearCache[] = "clear-cache";
 // Clear DNS cache before each experiment
 const char kClearDnsCache[] = "clear-dns";
 
+// Samples per second of --monitor-cpu-utilization
+const char kCpuSampleRateHz[] = "cpu-sample-rate-hz";
+
 // Disable Browser Profiler
 const char kDisableBrowserProfiler[] = "disable-browser-profiler";
 
@@ -28,27 +48,83 @@ const char kDisableBrowserProfiler[] = "disable-browser-profiler";
 const char kDoItrace[] = "do-itrace";
 
 // Record Ftrace
+// Optional value: comma-separated <system>/<event> list, e.g., sched/sched_switch
 const char kDoFtrace[] = "do-ftrace";
 
+// Per-cpu ftrace buffer size in KB
+const char kFtraceBufferSizeKb[] = "ftrace-buffer-size-kb";
+
+// Ftrace clock (e.g., mono, local, global)
+const char kFtraceClock[] = "ftrace-clock";
+
+// Run consecutive trials in the same browser process, restart only when the command line
+// changes, a trial fails, or the client cannot reset itself in process
+const char kInSessionTrials[] = "in-session-trials";
+
+// Index of this browser among --num-instances, from 0
+const char kInstanceIndex[] = "instance-index";
+
+// Bound of adaptive trials per url, warm-up trials aside
+const char kMaxTryPerUrl[] = "max-try-per-url";
+
 // Measure Power
 const char kMeasurePower[] = "measure-power";
 
-// Monitor cpu utilization
+// Monitor cpu utilization and frequency, sampled in process
 const char kMonitorCpuUtilization[] = "monitor-cpu-utilization";
 
+// Do not ask the power tool server to stream its samples, which integrate the energy of the
+// load window right away and align the clocks with a short burst pattern: use the long
+// sync workload instead, as with servers which do not stream
+const char kNoStreamPowerSamples[] = "no-stream-power-samples";
+
+// Browser instances which run the campaign in parallel, each one the cells of the
+// url x command line matrix given by --instance-index, see tools/parallel_runner
+// Not with --measure-power: power is measured for the whole device
+// Nor with several command lines or --test-hot-load: instances share the command line file
+const char kNumInstances[] = "num-instances";
+
 // Total try number
 const char kNumTryPerUrl[] = "num-try-per-url";
 
+// Power samples per second of --power-sysfs-root
+const char kPowerSampleRateHz[] = "power-sample-rate-hz";
+
+// Measure power in process from powercap (RAPL) and power_supply sysfs
+// instead of the power tool server
+// Optional value: the sysfs root, e.g., a fake tree, /sys by default
+const char kPowerSysfsRoot[] = "power-sysfs-root";
+
+// Record the reference points of the clocks of each trial, for tools/timeline_merge
+// to put its artifacts on one timeline
+const char kRecordTimeline[] = "record-timeline";
+
 // Automatic rsync all logs to the PC after all experiments finish
 const char kRsyncLogsAfterAll[] = "rsync-logs-after-all";
 
+// Order of the trials: blocked (default), url-blocked, interleaved, randomized or
+// cost-minimizing, see ExperimentScheduler
+const char kSchedule[] = "schedule";
+
+// Seed of --schedule=randomized, the time of the campaign start by default
+const char kScheduleSeed[] = "schedule-seed";
+
 // Record screen
 const char kScreenRecord[] = "screen-record";
 
 // Test hot page load (with cache, load right after a visit)
 const char kTestHotLoad[] = "test-hot-load";
 
+// Run root commands through a long-lived root helper instead of su per command
+const char kUseRootHelper[] = "use-root-helper";
+
+// Reach the power tool server through a relay which lives for the whole campaign
+const char kUsePowerToolRelay[] = "use-power-tool-relay";
+
 // Wait for user think-time after load event fired before restarting
 const char kUserThinkTimeMillis[] = "user-think-time-millis";
 
+// Trials of a url which adaptive trials do not count, e.g., to fill caches
+const char kWarmUpTryPerUrl[] = "warm-up-try-per-url";
+
 }  // namespace switches
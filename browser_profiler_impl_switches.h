@@ -6,36 +6,78 @@
 
 namespace switches {
 
+extern const char kAdaptiveTrialsMetric[];
+
+extern const char kAdaptiveTrialsTarget[];
+
 extern const char kBrowserConfigName[];
 
+extern const char kCaptureFilter[];
+
+extern const char kCaptureInterface[];
+
 extern const char kCapturePackets[];
 
+extern const char kCaptureSnaplen[];
+
 extern const char kCleanLogsAfterAll[];
 
 extern const char kClearCache[];
 
 extern const char kClearDnsCache[];
 
+extern const char kCpuSampleRateHz[];
+
 extern const char kDisableBrowserProfiler[];
 
 extern const char kDoItrace[];
 
 extern const char kDoFtrace[];
 
+extern const char kFtraceBufferSizeKb[];
+
+extern const char kFtraceClock[];
+
+extern const char kInSessionTrials[];
+
+extern const char kInstanceIndex[];
+
+extern const char kMaxTryPerUrl[];
+
 extern const char kMeasurePower[];
 
 extern const char kMonitorCpuUtilization[];
 
+extern const char kNoStreamPowerSamples[];
+
+extern const char kNumInstances[];
+
 extern const char kNumTryPerUrl[];
 
+extern const char kPowerSampleRateHz[];
+
+extern const char kPowerSysfsRoot[];
+
+extern const char kRecordTimeline[];
+
 extern const char kRsyncLogsAfterAll[];
 
+extern const char kSchedule[];
+
+extern const char kScheduleSeed[];
+
 extern const char kScreenRecord[];
 
 extern const char kTestHotLoad[];
 
+extern const char kUsePowerToolRelay[];
+
+extern const char kUseRootHelper[];
+
 extern const char kUserThinkTimeMillis[];
 
+extern const char kWarmUpTryPerUrl[];
+
 }  // namespace switches
 
 #endif  // BROWSER_PROFILER_BROWSER_PROFILER_SWITCHES_H_
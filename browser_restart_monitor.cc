@@ -0,0 +1,204 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "browser_restart_monitor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "clock_domain.h"
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/logging.h"
+#include "base/threading/platform_thread.h"
+
+namespace {
+
+// A request older than this is left over by a browser which did not restart (or a reboot)
+const double kMaxRestartLatencySeconds = 60;
+
+// Fallback polling period without inotify or pidfd
+const int kPollPeriodMillis = 10;
+
+// Start time of a process in clock ticks since boot (field 22 of /proc/<pid>/stat),
+// which tells it from a later process reusing its pid
+bool ProcessStartTime(pid_t pid, unsigned long long* start_time) {
+  std::string stat;
+  if (!base::ReadFileToString(base::FilePath("/proc/" + std::to_string(pid) + "/stat"), &stat))
+    return false;
+
+  // The command name may contain spaces and parentheses, fields follow the last ')'
+  size_t fields = stat.rfind(')');
+  return fields != std::string::npos &&
+      sscanf(stat.c_str() + fields + 1,
+          " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+          start_time) == 1;
+}
+
+bool WriteRecord(const base::FilePath& file, pid_t pid, double time) {
+  unsigned long long start_time = 0;
+  if (!ProcessStartTime(pid, &start_time))
+    PLOG(ERROR) << "Cannot read the start time of process " << pid;
+
+  char record[96];
+  snprintf(record, sizeof(record), "%d %.6f %llu\n", static_cast<int>(pid), time, start_time);
+  return base::ImportantFileWriter::WriteFileAtomically(file, record);
+}
+
+bool ReadRecord(const base::FilePath& file, pid_t* pid, double* time,
+    unsigned long long* start_time) {
+  std::string record;
+  int pid_value;
+  if (!base::ReadFileToString(file, &record) ||
+      sscanf(record.c_str(), "%d %lf %llu", &pid_value, time, start_time) != 3) {
+    return false;
+  }
+  *pid = pid_value;
+  return true;
+}
+
+// The process is gone if its pid is free or reused by another process
+bool IsSameProcess(pid_t pid, unsigned long long start_time) {
+  unsigned long long current_start_time;
+  return start_time != 0 && ProcessStartTime(pid, &current_start_time) &&
+      current_start_time == start_time;
+}
+
+int RemainingMillis(base::TimeTicks deadline) {
+  int64_t remaining = (deadline - base::TimeTicks::Now()).InMilliseconds();
+  return remaining > 0 ? static_cast<int>(remaining) : 0;
+}
+
+// Return true if the process exits before the deadline, kill it otherwise
+// The old process is usually gone already (the client killed it) and its pid may be
+// reused: only a process with the recorded start time is waited for
+bool WaitForExitOrKill(pid_t pid, unsigned long long start_time, base::TimeTicks deadline) {
+#if defined(__NR_pidfd_open)
+  int pidfd = syscall(__NR_pidfd_open, pid, 0);
+  if (pidfd < 0 && errno == ESRCH)
+    return true;
+  // Checked after opening the pidfd, which then keeps referring to the same process
+  if (pidfd >= 0 && !IsSameProcess(pid, start_time)) {
+    close(pidfd);
+    return true;
+  }
+  if (pidfd >= 0) {
+    struct pollfd exited = { pidfd, POLLIN, 0 };
+    int ready;
+    do {
+      ready = poll(&exited, 1, RemainingMillis(deadline));
+    } while (ready < 0 && errno == EINTR);
+    bool killed = false;
+    if (ready == 0) {
+#if defined(__NR_pidfd_send_signal)
+      killed = syscall(__NR_pidfd_send_signal, pidfd, SIGKILL, NULL, 0) == 0;
+#else
+      killed = kill(pid, SIGKILL) == 0;
+#endif
+    }
+    close(pidfd);
+    return !killed;
+  }
+#endif
+
+  // No pidfd (kernel before 5.3), the pid may be reused between a check and a kill
+  while (IsSameProcess(pid, start_time)) {
+    if (RemainingMillis(deadline) == 0)
+      return kill(pid, SIGKILL) != 0;
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kPollPeriodMillis));
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+BrowserRestartMonitor::BrowserRestartMonitor(const base::FilePath& request_file,
+    const base::FilePath& ready_file)
+  : request_file_(request_file),
+    ready_file_(ready_file),
+    request_time_(0) {
+}
+
+bool BrowserRestartMonitor::RecordRequest() {
+  request_time_ = MonotonicNow();
+  return WriteRecord(request_file_, getpid(), request_time_);
+}
+
+bool BrowserRestartMonitor::NewBrowserIsReady() {
+  pid_t pid;
+  double ready_time;
+  unsigned long long start_time;
+  return ReadRecord(ready_file_, &pid, &ready_time, &start_time) && pid != getpid() &&
+      ready_time >= request_time_;
+}
+
+bool BrowserRestartMonitor::WaitForNewBrowser(base::TimeDelta timeout) {
+  base::TimeTicks deadline = base::TimeTicks::Now() + timeout;
+
+  // The ready file is renamed into place
+  int inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+  if (inotify_fd >= 0 && inotify_add_watch(inotify_fd, ready_file_.DirName().value().c_str(),
+        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    PLOG(ERROR) << "Cannot watch " << ready_file_.DirName().value();
+    close(inotify_fd);
+    inotify_fd = -1;
+  }
+
+  // Check after the watch is added, the new browser may already be ready
+  bool ready;
+  while (!(ready = NewBrowserIsReady()) && RemainingMillis(deadline) > 0) {
+    if (inotify_fd < 0) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kPollPeriodMillis));
+      continue;
+    }
+
+    struct pollfd changed = { inotify_fd, POLLIN, 0 };
+    if (poll(&changed, 1, RemainingMillis(deadline)) > 0) {
+      // Any change in the directory triggers a check, the events themselves do not matter
+      char events[4096];
+      while (read(inotify_fd, events, sizeof(events)) > 0) {}
+    }
+  }
+
+  if (inotify_fd >= 0)
+    close(inotify_fd);
+  return ready;
+}
+
+void BrowserRestartMonitor::AnnounceReady(base::TimeDelta old_browser_exit_timeout,
+    double* restart_latency_millis) {
+  *restart_latency_millis = -1;
+  double now = MonotonicNow();
+
+  pid_t old_pid;
+  double old_request_time;
+  unsigned long long old_start_time;
+  bool answers_request =
+      ReadRecord(request_file_, &old_pid, &old_request_time, &old_start_time) &&
+      old_pid != getpid() && now >= old_request_time &&
+      now - old_request_time <= kMaxRestartLatencySeconds;
+  if (answers_request) {
+    *restart_latency_millis = (now - old_request_time) * 1000;
+    base::DeleteFile(request_file_, false);
+  }
+
+  if (!WriteRecord(ready_file_, getpid(), now))
+    LOG(ERROR) << "Cannot announce the browser at " << ready_file_.value();
+
+  // The old browser must not run along with the experiment
+  if (answers_request && !WaitForExitOrKill(old_pid, old_start_time,
+        base::TimeTicks::Now() + old_browser_exit_timeout)) {
+    LOG(WARNING) << "Killed the old browser process " << old_pid;
+  }
+}
+
+}  // namespace browser_profiler
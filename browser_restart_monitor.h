@@ -0,0 +1,53 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_BROWSER_RESTART_MONITOR_H_
+#define BROWSER_PROFILER_BROWSER_RESTART_MONITOR_H_
+
+#include <sys/types.h>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace browser_profiler {
+
+// Restart handshake between the old and the new browser process
+// The old process records a restart request and waits until a new process announces
+// that it is ready (inotify on the ready file), instead of sleeping a fixed time
+// The new process announces itself, measures the restart latency from the request,
+// and makes sure the old process is gone (pidfd), killing it after a deadline
+// Both files hold "<pid> <CLOCK_MONOTONIC seconds> <process start time>", the clock is
+// system wide and the start time tells the process from a later one reusing its pid
+class BrowserRestartMonitor {
+ public:
+  BrowserRestartMonitor(const base::FilePath& request_file, const base::FilePath& ready_file);
+
+  // Old process, before asking the client to restart the browser
+  bool RecordRequest();
+
+  // Old process: wait until another process is ready or the timeout expires
+  // Return true if the new process is ready
+  bool WaitForNewBrowser(base::TimeDelta timeout);
+
+  // New process, once it can take requests
+  // Output the latency from the restart request if this process answers one, -1 otherwise
+  // Wait up to old_browser_exit_timeout for the old process to exit, then kill it
+  void AnnounceReady(base::TimeDelta old_browser_exit_timeout, double* restart_latency_millis);
+
+ private:
+  // True if the ready file names another process
+  bool NewBrowserIsReady();
+
+  base::FilePath request_file_;
+  base::FilePath ready_file_;
+
+  // When this process asked for the restart
+  double request_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(BrowserRestartMonitor);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_BROWSER_RESTART_MONITOR_H_
@@ -0,0 +1,188 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "campaign_manifest.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "crc32.h"
+
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/logging.h"
+
+namespace {
+
+const char kMagic[] = "BPMANIFS";
+const size_t kMagicLength = 8;
+const uint32_t kVersion = 1;
+
+// magic, version, number of command lines, number of urls, crc32, hash
+const size_t kCrcOffset = kMagicLength + 3 * sizeof(uint32_t);
+const size_t kHashOffset = kCrcOffset + sizeof(uint32_t);
+const size_t kHeaderSize = kHashOffset + sizeof(uint64_t);
+
+// FNV-1a, 64-bit
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t Fnv1a64(const char* data, size_t length, uint64_t hash) {
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+template <typename T>
+void AppendValue(std::string* buffer, T value) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T LoadValue(const char* data) {
+  T value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// The crc32 covers the header but itself
+uint32_t HeaderCrc(const char* header) {
+  uint32_t crc = browser_profiler::Crc32(header, kCrcOffset);
+  return browser_profiler::Crc32(header + kHashOffset, sizeof(uint64_t), crc);
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+CampaignManifest::CampaignManifest()
+  : hash_(0),
+    num_command_lines_(0),
+    num_urls_(0),
+    offsets_(nullptr),
+    data_(nullptr),
+    data_length_(0) {
+}
+
+CampaignManifest::~CampaignManifest() {
+}
+
+bool CampaignManifest::Create(const base::FilePath& dir,
+    const std::vector<std::string>& command_lines, const std::vector<std::string>& urls) {
+  std::string offsets;
+  std::string data;
+  for (size_t i = 0; i < command_lines.size(); ++i) {
+    AppendValue<uint64_t>(&offsets, data.length());
+    data.append(command_lines[i]);
+  }
+  for (size_t i = 0; i < urls.size(); ++i) {
+    AppendValue<uint64_t>(&offsets, data.length());
+    data.append(urls[i]);
+  }
+  AppendValue<uint64_t>(&offsets, data.length());
+
+  // The offsets encode the number and the lengths of the strings
+  uint64_t hash = Fnv1a64(offsets.data(), offsets.length(), kFnvOffsetBasis);
+  hash = Fnv1a64(reinterpret_cast<const char*>(&kVersion), sizeof(kVersion), hash);
+  uint32_t num_command_lines = command_lines.size();
+  hash = Fnv1a64(reinterpret_cast<const char*>(&num_command_lines), sizeof(num_command_lines),
+      hash);
+  hash = Fnv1a64(data.data(), data.length(), hash);
+
+  base::FilePath path = PathForHash(dir, hash);
+  if (!base::PathExists(path)) {
+    std::string manifest(kMagic, kMagicLength);
+    AppendValue<uint32_t>(&manifest, kVersion);
+    AppendValue<uint32_t>(&manifest, command_lines.size());
+    AppendValue<uint32_t>(&manifest, urls.size());
+    AppendValue<uint32_t>(&manifest, 0);
+    AppendValue<uint64_t>(&manifest, hash);
+    uint32_t crc = HeaderCrc(manifest.data());
+    memcpy(&manifest[kCrcOffset], &crc, sizeof(crc));
+    manifest.append(offsets);
+    manifest.append(data);
+
+    if (!base::ImportantFileWriter::WriteFileAtomically(path, manifest)) {
+      LOG(ERROR) << "Cannot write campaign manifest at " << path.value();
+      return false;
+    }
+  }
+
+  return Open(dir, hash);
+}
+
+bool CampaignManifest::Open(const base::FilePath& dir, uint64_t hash) {
+  base::FilePath path = PathForHash(dir, hash);
+
+  file_.reset(new base::MemoryMappedFile());
+  if (!file_->Initialize(path)) {
+    LOG(ERROR) << "Cannot map campaign manifest at " << path.value();
+    file_.reset();
+    return false;
+  }
+
+  const char* manifest = reinterpret_cast<const char*>(file_->data());
+  size_t length = file_->length();
+
+  if (length < kHeaderSize || memcmp(manifest, kMagic, kMagicLength) != 0 ||
+      LoadValue<uint32_t>(manifest + kMagicLength) != kVersion ||
+      LoadValue<uint32_t>(manifest + kCrcOffset) != HeaderCrc(manifest) ||
+      LoadValue<uint64_t>(manifest + kHashOffset) != hash) {
+    LOG(ERROR) << "Corrupted campaign manifest at " << path.value();
+    file_.reset();
+    return false;
+  }
+
+  num_command_lines_ = LoadValue<uint32_t>(manifest + kMagicLength + sizeof(uint32_t));
+  num_urls_ = LoadValue<uint32_t>(manifest + kMagicLength + 2 * sizeof(uint32_t));
+
+  size_t offsets_length = (num_command_lines_ + num_urls_ + 1) * sizeof(uint64_t);
+  if (offsets_length > length - kHeaderSize) {
+    LOG(ERROR) << "Truncated campaign manifest at " << path.value();
+    file_.reset();
+    return false;
+  }
+
+  // Offsets are 8-byte aligned: the header is 32 bytes
+  offsets_ = reinterpret_cast<const uint64_t*>(manifest + kHeaderSize);
+  data_ = manifest + kHeaderSize + offsets_length;
+  data_length_ = length - kHeaderSize - offsets_length;
+  hash_ = hash;
+  return true;
+}
+
+bool CampaignManifest::is_open() const {
+  return file_.get() != nullptr;
+}
+
+std::string CampaignManifest::CommandLine(size_t index) const {
+  DCHECK_LT(index, num_command_lines_);
+  return Entry(index);
+}
+
+std::string CampaignManifest::Url(size_t index) const {
+  DCHECK_LT(index, num_urls_);
+  return Entry(num_command_lines_ + index);
+}
+
+// static
+base::FilePath CampaignManifest::PathForHash(const base::FilePath& dir, uint64_t hash) {
+  char name[64];
+  snprintf(name, sizeof(name), "campaign-%016" PRIx64 ".manifest", hash);
+  return dir.Append(name);
+}
+
+std::string CampaignManifest::Entry(size_t index) const {
+  uint64_t begin = offsets_[index];
+  uint64_t end = offsets_[index + 1];
+  if (begin > end || end > data_length_) {
+    LOG(ERROR) << "Corrupted campaign manifest entry " << index;
+    return std::string();
+  }
+  return std::string(data_ + begin, end - begin);
+}
+
+}  // namespace browser_profiler
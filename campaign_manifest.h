@@ -0,0 +1,88 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CAMPAIGN_MANIFEST_H_
+#define BROWSER_PROFILER_CAMPAIGN_MANIFEST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
+    (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
+#include <memory>
+#else
+#include "base/memory/scoped_ptr.h"
+#endif
+
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Immutable lists of a campaign: experiment command lines and urls
+// Written once when the campaign starts, as <dir>/campaign-<content hash>.manifest,
+// then memory-mapped by every browser process of the campaign
+// Lookups are O(1) through an offset table, nothing is parsed at load
+//
+// File layout (host byte order):
+//   char[8]  magic "BPMANIFS"
+//   uint32   version
+//   uint32   number of command lines
+//   uint32   number of urls
+//   uint32   crc32 of the header and the offset table
+//   uint64   content hash
+//   uint64   offsets[number of command lines + number of urls + 1], into the data
+//   data: command lines then urls, not terminated
+class CampaignManifest {
+ public:
+  CampaignManifest();
+  ~CampaignManifest();
+
+  // Write the manifest of these lists to dir, unless it exists already, and map it
+  bool Create(const base::FilePath& dir, const std::vector<std::string>& command_lines,
+      const std::vector<std::string>& urls);
+
+  // Map the manifest with this content hash in dir
+  bool Open(const base::FilePath& dir, uint64_t hash);
+
+  bool is_open() const;
+
+  uint64_t hash() const { return hash_; }
+
+  size_t num_command_lines() const { return num_command_lines_; }
+  size_t num_urls() const { return num_urls_; }
+
+  // index < num_command_lines(), num_urls()
+  std::string CommandLine(size_t index) const;
+  std::string Url(size_t index) const;
+
+  static base::FilePath PathForHash(const base::FilePath& dir, uint64_t hash);
+
+ private:
+  // Command lines then urls
+  std::string Entry(size_t index) const;
+
+#if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
+    (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
+  std::unique_ptr<base::MemoryMappedFile> file_;
+#else
+  scoped_ptr<base::MemoryMappedFile> file_;
+#endif
+
+  uint64_t hash_;
+  size_t num_command_lines_;
+  size_t num_urls_;
+  const uint64_t* offsets_;
+  const char* data_;
+  size_t data_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(CampaignManifest);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CAMPAIGN_MANIFEST_H_
@@ -0,0 +1,165 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "clock_aligner.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <complex>
+#include <utility>
+#include <vector>
+
+#include "power_window_integrator.h"
+
+namespace {
+
+typedef std::complex<double> Complex;
+
+const double kPi = 3.14159265358979323846;
+
+// In-place iterative radix-2 FFT, data.size() is a power of 2
+void Fft(bool inverse, std::vector<Complex>* data) {
+  std::vector<Complex>& a = *data;
+  size_t n = a.size();
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(a[i], a[j]);
+  }
+
+  for (size_t length = 2; length <= n; length <<= 1) {
+    double angle = 2 * kPi / length * (inverse ? 1 : -1);
+    Complex step(cos(angle), sin(angle));
+    for (size_t i = 0; i < n; i += length) {
+      Complex twiddle(1);
+      for (size_t j = 0; j < length / 2; ++j) {
+        Complex even = a[i + j];
+        Complex odd = a[i + j + length / 2] * twiddle;
+        a[i + j] = even + odd;
+        a[i + j + length / 2] = even - odd;
+        twiddle *= step;
+      }
+    }
+  }
+
+  if (inverse) {
+    for (size_t i = 0; i < n; ++i)
+      a[i] /= static_cast<double>(n);
+  }
+}
+
+// Subtract the mean
+void Center(std::vector<double>* values) {
+  double sum = 0;
+  for (size_t i = 0; i < values->size(); ++i)
+    sum += (*values)[i];
+  double mean = sum / values->size();
+  for (size_t i = 0; i < values->size(); ++i)
+    (*values)[i] -= mean;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+ClockAligner::ClockAligner(const SyncPattern& pattern, double chip_seconds)
+  : pattern_(pattern),
+    chip_seconds_(chip_seconds) {
+}
+
+double ClockAligner::SearchBeginTime(double start_time, double coarse_offset,
+    double max_error) const {
+  return start_time - coarse_offset - max_error;
+}
+
+double ClockAligner::SearchEndTime(double start_time, double coarse_offset,
+    double max_error) const {
+  return start_time - coarse_offset + max_error + pattern_.Duration(chip_seconds_);
+}
+
+bool ClockAligner::Align(double start_time, const double* times, const double* watts,
+    size_t num_samples, double coarse_offset, double max_error, double* offset,
+    double* confidence) const {
+  double step = chip_seconds_ / kStepsPerChip;
+  size_t pattern_length = pattern_.num_chips() * kStepsPerChip;
+  size_t num_lags = static_cast<size_t>(2 * max_error / step) + 1;
+  size_t trace_length = pattern_length + num_lags - 1;
+  double search_begin = SearchBeginTime(start_time, coarse_offset, max_error);
+  if (num_samples < 2 || times[0] > search_begin ||
+      times[num_samples - 1] < search_begin + (trace_length - 1) * step) {
+    return false;
+  }
+
+  // Mean power over each step of the grid: an edge between two grid points
+  // is kept as an intermediate value, which the refinement of the peak needs
+  std::vector<double> trace(trace_length);
+  for (size_t i = 0; i < trace_length; ++i) {
+    double begin = search_begin + i * step;
+    trace[i] = PowerWindowIntegrator::ClippedEnergy(times, watts, num_samples, begin,
+        begin + step) / step;
+  }
+  Center(&trace);
+
+  std::vector<double> pattern(pattern_length);
+  for (size_t i = 0; i < pattern_length; ++i)
+    pattern[i] = pattern_.chip(i / kStepsPerChip) ? 1 : -1;
+  Center(&pattern);
+
+  // correlation[lag] = sum of trace[lag + i] * pattern[i], no wrap-around with this size
+  size_t size = 1;
+  while (size < trace_length + pattern_length)
+    size <<= 1;
+  std::vector<Complex> trace_spectrum(size);
+  std::vector<Complex> pattern_spectrum(size);
+  for (size_t i = 0; i < trace_length; ++i)
+    trace_spectrum[i] = trace[i];
+  for (size_t i = 0; i < pattern_length; ++i)
+    pattern_spectrum[i] = pattern[i];
+  Fft(false, &trace_spectrum);
+  Fft(false, &pattern_spectrum);
+  for (size_t i = 0; i < size; ++i)
+    trace_spectrum[i] *= std::conj(pattern_spectrum[i]);
+  Fft(true, &trace_spectrum);
+
+  // More power while busy: the highest positive peak
+  size_t best_lag = 0;
+  for (size_t lag = 1; lag < num_lags; ++lag) {
+    if (trace_spectrum[lag].real() > trace_spectrum[best_lag].real())
+      best_lag = lag;
+  }
+
+  // Correlation coefficient at the peak, the pattern has a zero mean
+  double segment_sum = 0;
+  double segment_square_sum = 0;
+  double pattern_square_sum = 0;
+  for (size_t i = 0; i < pattern_length; ++i) {
+    segment_sum += trace[best_lag + i];
+    segment_square_sum += trace[best_lag + i] * trace[best_lag + i];
+    pattern_square_sum += pattern[i] * pattern[i];
+  }
+  double segment_variance = segment_square_sum - segment_sum * segment_sum / pattern_length;
+  double denominator = sqrt(segment_variance * pattern_square_sum);
+  *confidence = denominator > 0 ? trace_spectrum[best_lag].real() / denominator : 0;
+
+  // The autocorrelation of the chips is a triangle: fit two lines of opposite slopes
+  // through the peak and its neighbors
+  double refinement = 0;
+  if (best_lag > 0 && best_lag + 1 < num_lags) {
+    double before = trace_spectrum[best_lag - 1].real();
+    double peak = trace_spectrum[best_lag].real();
+    double after = trace_spectrum[best_lag + 1].real();
+    double drop = peak - std::min(before, after);
+    if (drop > 0)
+      refinement = 0.5 * (after - before) / drop;
+  }
+
+  double meter_start_time = search_begin + (best_lag + refinement) * step;
+  *offset = start_time - meter_start_time;
+  return true;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,41 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CLOCK_ALIGNER_H_
+#define BROWSER_PROFILER_CLOCK_ALIGNER_H_
+
+#include <stddef.h>
+
+#include "sync_pattern.h"
+
+namespace browser_profiler {
+
+// Finds a SyncPattern in a power trace: the offset between the device clock and the
+// clock of the power meter
+// The trace is averaged on a grid of kStepsPerChip steps per chip and cross-correlated
+// with the pattern by FFT; the peak is refined between grid points
+class ClockAligner {
+ public:
+  static const int kStepsPerChip = 8;
+
+  ClockAligner(const SyncPattern& pattern, double chip_seconds);
+
+  // The pattern started at start_time on the device clock, the samples are on the meter clock
+  // Search the offsets (device clock - meter clock) within max_error of coarse_offset
+  // confidence: correlation coefficient of the pattern and the trace at the offset, up to 1
+  // Return false if the samples do not span the search
+  bool Align(double start_time, const double* times, const double* watts, size_t num_samples,
+      double coarse_offset, double max_error, double* offset, double* confidence) const;
+
+  // Span of the trace which the search needs, on the meter clock
+  double SearchBeginTime(double start_time, double coarse_offset, double max_error) const;
+  double SearchEndTime(double start_time, double coarse_offset, double max_error) const;
+
+ private:
+  const SyncPattern pattern_;
+  double chip_seconds_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CLOCK_ALIGNER_H_
@@ -0,0 +1,191 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "clock_domain.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+// Reads of all the clocks, the tightest one is kept
+const int kCaptureTries = 5;
+
+int64_t ReadClock(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+double MonotonicNow() {
+  return ReadClock(CLOCK_MONOTONIC) / 1e9;
+}
+
+ClockReference::ClockReference()
+  : monotonic_ns(0),
+    monotonic_raw_ns(0),
+    boottime_ns(0),
+    realtime_ns(0) {
+}
+
+// static
+ClockReference ClockReference::Capture() {
+  ClockReference best;
+  int64_t best_width = INT64_MAX;
+  for (int i = 0; i < kCaptureTries; ++i) {
+    ClockReference reference;
+    int64_t before = ReadClock(CLOCK_MONOTONIC);
+    reference.monotonic_raw_ns = ReadClock(CLOCK_MONOTONIC_RAW);
+    reference.boottime_ns = ReadClock(CLOCK_BOOTTIME);
+    reference.realtime_ns = ReadClock(CLOCK_REALTIME);
+    int64_t after = ReadClock(CLOCK_MONOTONIC);
+    // Preempted reads are wide
+    if (after - before < best_width) {
+      best_width = after - before;
+      reference.monotonic_ns = before + best_width / 2;
+      best = reference;
+    }
+  }
+  return best;
+}
+
+TrialClocks::TrialClocks()
+  : load_start_ns(0),
+    load_end_ns(0),
+    has_power_meter_offset(false),
+    power_meter_offset_ns(0) {
+}
+
+std::string TrialClocks::Serialize() const {
+  std::string text;
+  char line[128];
+  for (size_t i = 0; i < references.size(); ++i) {
+    snprintf(line, sizeof(line), "reference %" PRId64 " %" PRId64 " %" PRId64 " %" PRId64 "\n",
+        references[i].monotonic_ns, references[i].monotonic_raw_ns,
+        references[i].boottime_ns, references[i].realtime_ns);
+    text += line;
+  }
+  if (load_start_ns != 0 || load_end_ns != 0) {
+    snprintf(line, sizeof(line), "load_window %" PRId64 " %" PRId64 "\n", load_start_ns,
+        load_end_ns);
+    text += line;
+  }
+  if (has_power_meter_offset) {
+    snprintf(line, sizeof(line), "power_meter_offset %" PRId64 "\n", power_meter_offset_ns);
+    text += line;
+  }
+  return text;
+}
+
+bool TrialClocks::Parse(const std::string& text, std::string* error) {
+  *this = TrialClocks();
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    if (!(fields >> key))
+      continue;
+
+    bool valid;
+    if (key == "reference") {
+      ClockReference reference;
+      valid = static_cast<bool>(fields >> reference.monotonic_ns >> reference.monotonic_raw_ns >>
+          reference.boottime_ns >> reference.realtime_ns);
+      references.push_back(reference);
+    } else if (key == "load_window") {
+      valid = static_cast<bool>(fields >> load_start_ns >> load_end_ns);
+    } else if (key == "power_meter_offset") {
+      valid = static_cast<bool>(fields >> power_meter_offset_ns);
+      has_power_meter_offset = valid;
+    } else {
+      // Written by a later version
+      continue;
+    }
+    if (!valid) {
+      *error = "invalid line: " + line;
+      return false;
+    }
+  }
+
+  if (references.empty()) {
+    *error = "no clock reference";
+    return false;
+  }
+  return true;
+}
+
+ClockTranslator::ClockTranslator(const TrialClocks& clocks)
+  : references_(clocks.references),
+    has_power_meter_offset_(clocks.has_power_meter_offset),
+    power_meter_offset_ns_(clocks.power_meter_offset_ns) {
+}
+
+bool ClockTranslator::CanTranslate(ClockDomain domain) const {
+  if (domain == kMonotonicClock)
+    return true;
+  if (domain == kPowerMeterClock)
+    return has_power_meter_offset_;
+  return !references_.empty();
+}
+
+int64_t ClockTranslator::ToMonotonic(ClockDomain domain, int64_t ns) const {
+  if (domain == kMonotonicClock || !CanTranslate(domain))
+    return ns;
+  if (domain == kPowerMeterClock)
+    return ns + power_meter_offset_ns_;
+
+  // Offset at the reference points around ns, the references are in time order
+  size_t after = 0;
+  while (after < references_.size() && ClockOf(references_[after], domain) < ns)
+    ++after;
+  const ClockReference& next = references_[std::min(after, references_.size() - 1)];
+  const ClockReference& previous = references_[after == 0 ? 0 : after - 1];
+  int64_t next_offset = next.monotonic_ns - ClockOf(next, domain);
+  int64_t previous_offset = previous.monotonic_ns - ClockOf(previous, domain);
+  int64_t span = ClockOf(next, domain) - ClockOf(previous, domain);
+  if (span <= 0)
+    return ns + previous_offset;
+
+  double fraction = static_cast<double>(ns - ClockOf(previous, domain)) / span;
+  return ns + previous_offset +
+      static_cast<int64_t>(fraction * (next_offset - previous_offset));
+}
+
+// static
+bool ClockTranslator::FtraceClockDomain(const std::string& trace_clock, ClockDomain* domain) {
+  if (trace_clock == "mono") {
+    *domain = kMonotonicClock;
+  } else if (trace_clock == "mono_raw") {
+    *domain = kMonotonicRawClock;
+  } else if (trace_clock == "boot") {
+    *domain = kBoottimeClock;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// static
+int64_t ClockTranslator::ClockOf(const ClockReference& reference, ClockDomain domain) {
+  switch (domain) {
+    case kMonotonicRawClock:
+      return reference.monotonic_raw_ns;
+    case kBoottimeClock:
+      return reference.boottime_ns;
+    case kRealtimeClock:
+      return reference.realtime_ns;
+    default:
+      return reference.monotonic_ns;
+  }
+}
+
+}  // namespace browser_profiler
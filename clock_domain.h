@@ -0,0 +1,95 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CLOCK_DOMAIN_H_
+#define BROWSER_PROFILER_CLOCK_DOMAIN_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace browser_profiler {
+
+// Clocks of the artifacts of a trial
+// Only depends on POSIX so that tools can use it, see tools/timeline_merge
+enum ClockDomain {
+  // Result timestamps, itrace (Chrome's TimeTicks), cpu_util, ftrace with the mono clock
+  kMonotonicClock,
+  // ftrace with the mono_raw clock
+  kMonotonicRawClock,
+  // ftrace with the boot clock
+  kBoottimeClock,
+  // pcap
+  kRealtimeClock,
+  // Power samples of the power tool server
+  kPowerMeterClock,
+};
+
+// CLOCK_MONOTONIC in seconds, the clock of result timestamps
+// Same clock across processes, unlike base::TimeTicks whose internal value may change
+double MonotonicNow();
+
+// The clocks of the device read at one instant, in nanoseconds
+struct ClockReference {
+  ClockReference();
+
+  // Read the clocks a few times and keep the tightest read, within a few microseconds
+  static ClockReference Capture();
+
+  int64_t monotonic_ns;
+  int64_t monotonic_raw_ns;
+  int64_t boottime_ns;
+  int64_t realtime_ns;
+};
+
+// Clock references of a trial and the times the artifacts are aligned on,
+// written by TimelineTracer as <id>.clocks
+//
+// Text lines (nanoseconds):
+//   reference <monotonic> <monotonic raw> <boottime> <realtime>   (trial start, then stop)
+//   load_window <start> <end>                                      (monotonic)
+//   power_meter_offset <device monotonic minus meter clock>        (if measured)
+struct TrialClocks {
+  TrialClocks();
+
+  std::string Serialize() const;
+  // Return false with the reason in error
+  bool Parse(const std::string& text, std::string* error);
+
+  std::vector<ClockReference> references;
+  // 0 if unknown
+  int64_t load_start_ns;
+  int64_t load_end_ns;
+  bool has_power_meter_offset;
+  int64_t power_meter_offset_ns;
+};
+
+// Translates times of any clock domain to CLOCK_MONOTONIC nanoseconds
+// The offset of a clock to the monotonic clock is interpolated between the references,
+// so that a slewed realtime clock or a suspend (boottime) during the trial is followed
+class ClockTranslator {
+ public:
+  explicit ClockTranslator(const TrialClocks& clocks);
+
+  // Whether there are references for domain (or the meter offset)
+  bool CanTranslate(ClockDomain domain) const;
+
+  int64_t ToMonotonic(ClockDomain domain, int64_t ns) const;
+
+  // Domain of an ftrace trace_clock, false if it cannot be related to the others
+  // (e.g., local, the scheduler clock)
+  static bool FtraceClockDomain(const std::string& trace_clock, ClockDomain* domain);
+
+ private:
+  // The clock of domain in a reference
+  static int64_t ClockOf(const ClockReference& reference, ClockDomain domain);
+
+  std::vector<ClockReference> references_;
+  bool has_power_meter_offset_;
+  int64_t power_meter_offset_ns_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CLOCK_DOMAIN_H_
@@ -0,0 +1,346 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "cpu_utilization_sampler.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "clock_domain.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace {
+
+const char kSamplesMagic[] = "BPCPUUTL";
+const uint32_t kSamplesVersion = 1;
+
+// Longest cpu<n> line of /proc/stat: ten 20-digit counters
+const size_t kMaxStatLineLength = 256;
+
+int OpenValue(const std::string& path) {
+  return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// 0 on error
+uint32_t ReadFrequency(int fd) {
+  char buffer[32];
+  ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0)
+    return 0;
+  buffer[length] = '\0';
+  return strtoul(buffer, nullptr, 10);
+}
+
+// Number of possible cpus from a list like "0-3,5", online or not
+size_t CountPossibleCpus(const std::string& cpu_sysfs_dir) {
+  std::string possible;
+  size_t num_cpus = 0;
+  if (base::ReadFileToString(base::FilePath(cpu_sysfs_dir).Append("possible"), &possible)) {
+    const char* cursor = possible.c_str();
+    while (*cursor >= '0' && *cursor <= '9') {
+      char* end;
+      unsigned long last = strtoul(cursor, &end, 10);
+      if (*end == '-')
+        last = strtoul(end + 1, &end, 10);
+      num_cpus = std::max<size_t>(num_cpus, last + 1);
+      cursor = *end == ',' ? end + 1 : end;
+    }
+  }
+  if (num_cpus == 0)
+    num_cpus = std::max(sysconf(_SC_NPROCESSORS_CONF), 1L);
+  return num_cpus;
+}
+
+template <typename T>
+void AppendRaw(const T& value, std::string* output) {
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+const char CpuUtilizationSampler::kProcStatFile[] = "/proc/stat";
+// static
+const char CpuUtilizationSampler::kCpuSysfsDir[] = "/sys/devices/system/cpu";
+// static
+const double CpuUtilizationSampler::kDefaultSampleRateHz = 20;
+// static
+const double CpuUtilizationSampler::kDefaultBufferSeconds = 600;
+
+CpuUtilizationSampler::CpuUtilizationSampler(double sample_rate_hz, double buffer_seconds)
+  : sample_period_(1 / sample_rate_hz),
+    capacity_(std::max(static_cast<size_t>(sample_rate_hz * buffer_seconds), size_t(2))),
+    stat_fd_(-1),
+    head_(0),
+    sampling_(false),
+    stop_requested_(false),
+    thread_cpu_seconds_(0) {
+}
+
+CpuUtilizationSampler::~CpuUtilizationSampler() {
+  if (sampling_)
+    Stop();
+  if (stat_fd_ >= 0)
+    close(stat_fd_);
+  for (size_t i = 0; i < frequency_fds_.size(); ++i) {
+    if (frequency_fds_[i] >= 0)
+      close(frequency_fds_[i]);
+  }
+}
+
+bool CpuUtilizationSampler::Initialize() {
+  stat_fd_ = OpenValue(kProcStatFile);
+  if (stat_fd_ < 0) {
+    PLOG(ERROR) << "Cannot open " << kProcStatFile;
+    return false;
+  }
+
+  // The cpu lines come first, the rest of the file (interrupts, ...) is not read
+  size_t num_cpus = CountPossibleCpus(kCpuSysfsDir);
+  stat_buffer_.resize((num_cpus + 1) * kMaxStatLineLength);
+  for (size_t cpu = 0; cpu < num_cpus; ++cpu) {
+    frequency_fds_.push_back(OpenValue(std::string(kCpuSysfsDir) + "/cpu" +
+        base::SizeTToString(cpu) + "/cpufreq/scaling_cur_freq"));
+  }
+
+  times_.resize(capacity_);
+  cpu_samples_.resize(capacity_ * num_cpus);
+  last_counters_.resize(num_cpus);
+  counters_.resize(num_cpus);
+
+  ssize_t length = pread(stat_fd_, stat_buffer_.data(), stat_buffer_.size(), 0);
+  if (length <= 0 || !ParseProcStat(length)) {
+    LOG(ERROR) << "No cpu in " << kProcStatFile;
+    return false;
+  }
+  return true;
+}
+
+bool CpuUtilizationSampler::Start() {
+  DCHECK(!sampling_);
+  head_.store(0, std::memory_order_release);
+  thread_cpu_seconds_ = 0;
+  TakeSample();
+
+  stop_requested_.store(false);
+  if (!base::PlatformThread::Create(0, this, &thread_handle_)) {
+    LOG(ERROR) << "Cannot start the cpu utilization sampling thread";
+    return false;
+  }
+  sampling_ = true;
+  return true;
+}
+
+void CpuUtilizationSampler::Stop() {
+  if (!sampling_)
+    return;
+  stop_requested_.store(true);
+  base::PlatformThread::Join(thread_handle_);
+  // Close the window right now
+  TakeSample();
+  sampling_ = false;
+}
+
+void CpuUtilizationSampler::ThreadMain() {
+  base::PlatformThread::SetName("CpuUtilSampler");
+
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    PLOG(ERROR) << "Cannot create the cpu utilization sampling timer";
+    return;
+  }
+
+  // Periodic from now: the rate does not drift with the sampling time
+  long period_ns = static_cast<long>(sample_period_ * 1e9);
+  struct itimerspec timer;
+  timer.it_interval.tv_sec = period_ns / 1000000000L;
+  timer.it_interval.tv_nsec = period_ns % 1000000000L;
+  timer.it_value = timer.it_interval;
+  if (timerfd_settime(timer_fd, 0, &timer, nullptr) < 0) {
+    PLOG(ERROR) << "Cannot start the cpu utilization sampling timer";
+    close(timer_fd);
+    return;
+  }
+
+  while (!stop_requested_.load()) {
+    // Expirations since the last read: missed ones, e.g., when preempted, are skipped
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+      continue;
+    TakeSample();
+  }
+  close(timer_fd);
+
+  struct timespec cpu_time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+  thread_cpu_seconds_ = cpu_time.tv_sec + cpu_time.tv_nsec / 1e9;
+}
+
+void CpuUtilizationSampler::TakeSample() {
+  double now = MonotonicNow();
+  ssize_t length = pread(stat_fd_, stat_buffer_.data(), stat_buffer_.size(), 0);
+  if (length <= 0 || !ParseProcStat(length))
+    return;
+
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  size_t slot = head % capacity_;
+  times_[slot] = now;
+  for (size_t cpu = 0; cpu < num_cpus(); ++cpu) {
+    const CpuCounters& last = last_counters_[cpu];
+    const CpuCounters& current = counters_[cpu];
+    CpuSample& sample = cpu_samples_[slot * num_cpus() + cpu];
+    // Offline now or at the last sample
+    if (head == 0 || last.total_ticks == 0 || current.total_ticks < last.total_ticks ||
+        current.busy_ticks < last.busy_ticks) {
+      sample.busy_ticks = 0;
+      sample.total_ticks = 0;
+    } else {
+      sample.busy_ticks = current.busy_ticks - last.busy_ticks;
+      sample.total_ticks = current.total_ticks - last.total_ticks;
+    }
+    sample.frequency_khz = frequency_fds_[cpu] >= 0 && current.total_ticks > 0 ?
+        ReadFrequency(frequency_fds_[cpu]) : 0;
+  }
+  last_counters_.swap(counters_);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+// Lines like "cpu3 user nice system idle iowait irq softirq steal guest guest_nice"
+// Guest time is in user time already
+bool CpuUtilizationSampler::ParseProcStat(size_t length) {
+  for (size_t cpu = 0; cpu < counters_.size(); ++cpu) {
+    counters_[cpu].busy_ticks = 0;
+    counters_[cpu].total_ticks = 0;
+  }
+
+  bool found = false;
+  const char* cursor = stat_buffer_.data();
+  const char* end = cursor + length;
+  while (cursor < end) {
+    const char* line_end = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+    // The first line is the sum of all cpus, the cpu lines end with the first other line
+    if (line_end == nullptr || strncmp(cursor, "cpu", 3) != 0)
+      break;
+    if (cursor[3] < '0' || cursor[3] > '9') {
+      cursor = line_end + 1;
+      continue;
+    }
+
+    char* field_end;
+    unsigned long cpu = strtoul(cursor + 3, &field_end, 10);
+    uint64_t ticks[8] = {};
+    for (size_t i = 0; i < 8 && field_end < line_end; ++i)
+      ticks[i] = strtoull(field_end, &field_end, 10);
+    if (cpu < counters_.size()) {
+      uint64_t idle = ticks[3] + ticks[4];
+      uint64_t total = 0;
+      for (size_t i = 0; i < 8; ++i)
+        total += ticks[i];
+      counters_[cpu].busy_ticks = total - idle;
+      counters_[cpu].total_ticks = total;
+      found = true;
+    }
+    cursor = line_end + 1;
+  }
+  return found;
+}
+
+uint64_t CpuUtilizationSampler::oldest_sample() const {
+  uint64_t head = num_samples();
+  // The slot after the oldest one may be being written
+  return head >= capacity_ ? head - capacity_ + 1 : 0;
+}
+
+bool CpuUtilizationSampler::WindowSummary(double begin_time, double end_time,
+    Summary* summary) const {
+  uint64_t head = num_samples();
+  uint64_t oldest = oldest_sample();
+  if (head < 2 || end_time <= begin_time || sample_time(oldest) > begin_time ||
+      sample_time(head - 1) < end_time) {
+    LOG(ERROR) << "Cpu utilization samples do not cover " << begin_time << " - " << end_time;
+    return false;
+  }
+
+  // The deltas of a sample are since the previous one: take those which overlap the window
+  std::vector<CpuCounters> window(num_cpus(), CpuCounters());
+  double frequency_ticks = 0;
+  uint64_t frequency_total_ticks = 0;
+  for (uint64_t i = oldest + 1; i < head; ++i) {
+    if (sample_time(i) <= begin_time || sample_time(i - 1) >= end_time)
+      continue;
+    for (size_t cpu = 0; cpu < num_cpus(); ++cpu) {
+      const CpuSample& sample = cpu_sample(i, cpu);
+      window[cpu].busy_ticks += sample.busy_ticks;
+      window[cpu].total_ticks += sample.total_ticks;
+      if (sample.frequency_khz > 0) {
+        frequency_ticks += static_cast<double>(sample.frequency_khz) * sample.total_ticks;
+        frequency_total_ticks += sample.total_ticks;
+      }
+    }
+  }
+
+  uint64_t busy_ticks = 0;
+  uint64_t total_ticks = 0;
+  summary->max_cpu_utilization = 0;
+  for (size_t cpu = 0; cpu < num_cpus(); ++cpu) {
+    busy_ticks += window[cpu].busy_ticks;
+    total_ticks += window[cpu].total_ticks;
+    if (window[cpu].total_ticks > 0) {
+      summary->max_cpu_utilization = std::max(summary->max_cpu_utilization,
+          static_cast<double>(window[cpu].busy_ticks) / window[cpu].total_ticks);
+    }
+  }
+  summary->utilization = total_ticks > 0 ?
+      static_cast<double>(busy_ticks) / total_ticks : 0;
+  summary->average_frequency_khz = frequency_total_ticks > 0 ?
+      frequency_ticks / frequency_total_ticks : 0;
+  return true;
+}
+
+// File layout (host byte order):
+//   char[8]  magic "BPCPUUTL"
+//   uint32   version
+//   uint32   number of cpus
+//   uint32   ticks per second (USER_HZ)
+//   uint64   number of samples
+//   samples, oldest first: double CLOCK_MONOTONIC seconds, then for each cpu
+//     uint32 busy ticks, uint32 total ticks, uint32 frequency (kHz)
+bool CpuUtilizationSampler::WriteToFile(const base::FilePath& file) const {
+  uint64_t head = num_samples();
+  uint64_t oldest = oldest_sample();
+
+  std::string output(kSamplesMagic, sizeof(kSamplesMagic) - 1);
+  output.reserve(output.size() + 24 +
+      (head - oldest) * (sizeof(double) + num_cpus() * sizeof(CpuSample)));
+  AppendRaw(kSamplesVersion, &output);
+  AppendRaw(static_cast<uint32_t>(num_cpus()), &output);
+  AppendRaw(static_cast<uint32_t>(sysconf(_SC_CLK_TCK)), &output);
+  AppendRaw(head - oldest, &output);
+  for (uint64_t i = oldest; i < head; ++i) {
+    AppendRaw(sample_time(i), &output);
+    for (size_t cpu = 0; cpu < num_cpus(); ++cpu) {
+      const CpuSample& sample = cpu_sample(i, cpu);
+      AppendRaw(sample.busy_ticks, &output);
+      AppendRaw(sample.total_ticks, &output);
+      AppendRaw(sample.frequency_khz, &output);
+    }
+  }
+
+  if (base::WriteFile(file, output.data(), output.size()) != static_cast<int>(output.size())) {
+    LOG(ERROR) << "Cannot write cpu utilization samples at " << file.value();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace browser_profiler
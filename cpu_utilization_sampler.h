@@ -0,0 +1,128 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CPU_UTILIZATION_SAMPLER_H_
+#define BROWSER_PROFILER_CPU_UTILIZATION_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/threading/platform_thread.h"
+
+namespace browser_profiler {
+
+// Samples the utilization and frequency of each cpu on a dedicated thread, woken by a
+// timerfd, in place of a shell loop polling /proc/stat as root
+//   /proc/stat: busy and total ticks of each cpu
+//   /sys/devices/system/cpu/cpu<n>/cpufreq/scaling_cur_freq
+// The files stay open and are read with pread into buffers allocated once
+//
+// Like SysfsPowerSampler, samples go to a ring buffer written by the sampling thread only
+// and published with a release store; timestamps are CLOCK_MONOTONIC seconds
+class CpuUtilizationSampler : public base::PlatformThread::Delegate {
+ public:
+  // Since the previous sample; an offline cpu has no ticks
+  struct CpuSample {
+    uint32_t busy_ticks;
+    uint32_t total_ticks;
+    // 0 if unknown
+    uint32_t frequency_khz;
+  };
+
+  // Of the load window
+  struct Summary {
+    // Busy over total ticks of the online cpus
+    double utilization;
+    double max_cpu_utilization;
+    // Average over the online time of the cpus, 0 if unknown
+    double average_frequency_khz;
+  };
+
+  static const char kProcStatFile[];
+  static const char kCpuSysfsDir[];
+  // /proc/stat counts in ticks of USER_HZ, usually 100 per second
+  static const double kDefaultSampleRateHz;
+  static const double kDefaultBufferSeconds;
+
+  CpuUtilizationSampler(double sample_rate_hz, double buffer_seconds);
+  ~CpuUtilizationSampler() override;
+
+  // Open the sources, return false if /proc/stat cannot be read
+  bool Initialize();
+
+  // Return false if the thread cannot start
+  // The first sample, the reference of the deltas, is taken before returning
+  bool Start();
+  void Stop();
+
+  bool sampling() const { return sampling_; }
+  size_t num_cpus() const { return frequency_fds_.size(); }
+
+  // Samples of the current (or last) session, oldest ones may be overwritten
+  uint64_t num_samples() const { return head_.load(std::memory_order_acquire); }
+  // Index of the oldest sample still in the buffer
+  uint64_t oldest_sample() const;
+  double sample_time(uint64_t index) const { return times_[index % times_.size()]; }
+  const CpuSample& cpu_sample(uint64_t index, size_t cpu) const {
+    return cpu_samples_[(index % times_.size()) * num_cpus() + cpu];
+  }
+
+  // Over the samples which end in the window
+  // Return false if the window is not covered by the buffered samples
+  bool WindowSummary(double begin_time, double end_time, Summary* summary) const;
+
+  // CPU time of the sampling thread in the last session, seconds
+  double thread_cpu_seconds() const { return thread_cpu_seconds_; }
+
+  // Write the buffered samples as one binary file, see the layout in the .cc
+  bool WriteToFile(const base::FilePath& file) const;
+
+  // base::PlatformThread::Delegate
+  void ThreadMain() override;
+
+ private:
+  struct CpuCounters {
+    uint64_t busy_ticks;
+    uint64_t total_ticks;
+  };
+
+  // Read the sources and append a sample
+  void TakeSample();
+
+  // Parse the cpu<n> lines of /proc/stat into counters_, return false if there is none
+  bool ParseProcStat(size_t length);
+
+  const double sample_period_;
+  const size_t capacity_;
+
+  int stat_fd_;
+  // -1 for a cpu without cpufreq
+  std::vector<int> frequency_fds_;
+  std::vector<char> stat_buffer_;
+
+  std::vector<double> times_;
+  // capacity_ x num_cpus()
+  std::vector<CpuSample> cpu_samples_;
+  std::atomic<uint64_t> head_;
+
+  // Sampling thread only, the counters of the last sample and of this one
+  std::vector<CpuCounters> last_counters_;
+  std::vector<CpuCounters> counters_;
+
+  bool sampling_;
+  std::atomic<bool> stop_requested_;
+  double thread_cpu_seconds_;
+  base::PlatformThreadHandle thread_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuUtilizationSampler);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CPU_UTILIZATION_SAMPLER_H_
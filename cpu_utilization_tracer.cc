@@ -0,0 +1,77 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "cpu_utilization_tracer.h"
+
+#include "browser_profiler_impl_constants.h"
+
+#include "base/logging.h"
+
+namespace browser_profiler {
+
+CpuUtilizationTracer::CpuUtilizationTracer(double sample_rate_hz)
+  : sample_rate_hz_(sample_rate_hz),
+    utilization_metric_(ExperimentResult::kInvalidMetric),
+    max_cpu_utilization_metric_(ExperimentResult::kInvalidMetric),
+    frequency_metric_(ExperimentResult::kInvalidMetric),
+    sampler_time_metric_(ExperimentResult::kInvalidMetric) {
+}
+
+CpuUtilizationTracer::~CpuUtilizationTracer() {
+}
+
+std::vector<std::string> CpuUtilizationTracer::output_artifacts() const {
+  return std::vector<std::string>(1, base_name_);
+}
+
+void CpuUtilizationTracer::RegisterMetrics(ExperimentResult* experiment_result) {
+  // Of the load window
+  utilization_metric_ = experiment_result->RegisterMetric(
+      "CPU Utilization (%)", ExperimentResult::kDoubleMetric);
+  max_cpu_utilization_metric_ = experiment_result->RegisterMetric(
+      "Max Core Utilization (%)", ExperimentResult::kDoubleMetric);
+  frequency_metric_ = experiment_result->RegisterMetric(
+      "CPU Frequency (MHz)", ExperimentResult::kDoubleMetric);
+  // CPU time of the sampling thread, its overhead
+  sampler_time_metric_ = experiment_result->RegisterMetric(
+      "CPU Sampler Time (ms)", ExperimentResult::kDoubleMetric);
+}
+
+bool CpuUtilizationTracer::Initialize(const TracerContext& context) {
+  base_name_ = context.constants->kCpuUtilizationBaseName;
+  sampler_.reset(new CpuUtilizationSampler(sample_rate_hz_,
+      CpuUtilizationSampler::kDefaultBufferSeconds));
+  return sampler_->Initialize();
+}
+
+void CpuUtilizationTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  if (!sampler_->Start())
+    LOG(ERROR) << "Failed to start cpu utilization sampling";
+  done();
+}
+
+void CpuUtilizationTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  if (!sampler_->sampling()) {
+    done();
+    return;
+  }
+  sampler_->Stop();
+
+  ExperimentResult* result = context.experiment_result;
+  CpuUtilizationSampler::Summary summary;
+  if (result->IsSet(ExperimentResult::kLoadStartTime) &&
+      result->IsSet(ExperimentResult::kLoadEndTime) &&
+      sampler_->WindowSummary(result->GetNumber(ExperimentResult::kLoadStartTime),
+          result->GetNumber(ExperimentResult::kLoadEndTime), &summary)) {
+    result->SetDouble(utilization_metric_, summary.utilization * 100);
+    result->SetDouble(max_cpu_utilization_metric_, summary.max_cpu_utilization * 100);
+    if (summary.average_frequency_khz > 0)
+      result->SetDouble(frequency_metric_, summary.average_frequency_khz / 1000);
+  }
+  result->SetDouble(sampler_time_metric_, sampler_->thread_cpu_seconds() * 1000);
+
+  sampler_->WriteToFile(context.OutputFile(base_name_));
+  done();
+}
+
+}  // namespace browser_profiler
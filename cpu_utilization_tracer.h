@@ -0,0 +1,53 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CPU_UTILIZATION_TRACER_H_
+#define BROWSER_PROFILER_CPU_UTILIZATION_TRACER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpu_utilization_sampler.h"
+#include "experiment_result.h"
+#include "tracer.h"
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Utilization and frequency of each cpu, sampled in process (CpuUtilizationSampler)
+// The samples of an experiment are written to <id>.<cpu utilization base name>,
+// the summary of the load window goes to the result
+class CpuUtilizationTracer : public Tracer {
+ public:
+  explicit CpuUtilizationTracer(double sample_rate_hz);
+  ~CpuUtilizationTracer() override;
+
+  // Tracer
+  std::string name() const override { return "cpu utilization"; }
+  StartStage start_stage() const override { return kPreFtraceStage; }
+  StopStage stop_stage() const override { return kPostFtraceStopStage; }
+  Overhead expected_overhead() const override { return kNegligibleOverhead; }
+  std::vector<std::string> output_artifacts() const override;
+  void RegisterMetrics(ExperimentResult* experiment_result) override;
+  bool Initialize(const TracerContext& context) override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+
+ private:
+  const double sample_rate_hz_;
+  std::unique_ptr<CpuUtilizationSampler> sampler_;
+  std::string base_name_;
+
+  ExperimentResult::Metric utilization_metric_;
+  ExperimentResult::Metric max_cpu_utilization_metric_;
+  ExperimentResult::Metric frequency_metric_;
+  ExperimentResult::Metric sampler_time_metric_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuUtilizationTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CPU_UTILIZATION_TRACER_H_
@@ -0,0 +1,38 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "crc32.h"
+
+namespace {
+
+const uint32_t kPolynomial = 0xEDB88320;
+
+struct Crc32Table {
+  Crc32Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; ++bit)
+        value = (value & 1) ? (value >> 1) ^ kPolynomial : value >> 1;
+      entries[i] = value;
+    }
+  }
+
+  uint32_t entries[256];
+};
+
+}  // namespace
+
+namespace browser_profiler {
+
+uint32_t Crc32(const void* data, size_t length, uint32_t crc) {
+  // Function-local: no static initializer
+  static const Crc32Table table;
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  for (size_t i = 0; i < length; ++i)
+    crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,19 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_CRC32_H_
+#define BROWSER_PROFILER_CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace browser_profiler {
+
+// CRC-32 (same as zlib's crc32()), detects torn or corrupted records
+// Pass the previous crc to continue over several buffers
+// Only depends on the C library so that tools can use it
+uint32_t Crc32(const void* data, size_t length, uint32_t crc = 0);
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_CRC32_H_
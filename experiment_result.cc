@@ -3,87 +3,165 @@
 
 #include "experiment_result.h"
 
-#include "base/macros.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "experiment_result_store.h"
+
 #include "base/logging.h"
 #include "base/files/file_util.h"
 
+namespace {
+
+struct BuiltinMetricInfo {
+  const char* name;
+  browser_profiler::ExperimentResult::MetricType type;
+};
+
+// In the order of ExperimentResult::BuiltinMetric
+// Names are the columns of the experiment result log, which the power tool server also reads
+const BuiltinMetricInfo kBuiltinMetrics[] = {
+  { "Browser Config Name", browser_profiler::ExperimentResult::kStringMetric },
+  { "Command Line", browser_profiler::ExperimentResult::kStringMetric },
+  { "Log Prefix", browser_profiler::ExperimentResult::kStringMetric },
+  { "Host", browser_profiler::ExperimentResult::kStringMetric },
+  { "URL", browser_profiler::ExperimentResult::kStringMetric },
+  { "Load Start Time (s)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Load End Time (s)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Page Load Time (s)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Sync Workload End Time (s)", browser_profiler::ExperimentResult::kTimestampMetric },
+  { "User Think Time (ms)", browser_profiler::ExperimentResult::kUint64Metric },
+  { "Energy (J)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Average Power (W)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Root Command Time (ms)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Root Command Round Trips", browser_profiler::ExperimentResult::kUint64Metric },
+  { "Tracer Start Time (ms)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Tracer Stop Time (ms)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Browser Restart Time (ms)", browser_profiler::ExperimentResult::kDoubleMetric },
+  { "Session Trial", browser_profiler::ExperimentResult::kUint64Metric },
+  { "Warm-up Trial", browser_profiler::ExperimentResult::kUint64Metric },
+};
+
+static_assert(arraysize(kBuiltinMetrics) == browser_profiler::ExperimentResult::kNumBuiltinMetrics,
+    "Built-in metrics and their names do not match");
+
+}  // namespace
+
 namespace browser_profiler {
 
 //static
-const char* ExperimentResult::kBrowserConfigNameKey = "Browser Config Name";
-//static
-const char* ExperimentResult::kCommandLineKey = "Command Line";
-//static
-const char* ExperimentResult::kLogPrefixKey = "Log Prefix";
-//static
-const char* ExperimentResult::kHostKey = "Host";
-//static
-const char* ExperimentResult::kUrlKey = "URL";
-//static
-const char* ExperimentResult::kLoadStartTimeKey = "Load Start Time (s)";
-//static
-const char* ExperimentResult::kLoadEndTimeKey = "Load End Time (s)";
-//static
-const char* ExperimentResult::kPageLoadTimeKey = "Page Load Time (s)";
-//static
-const char* ExperimentResult::kSyncWorkloadEndTimeKey = "Sync Workload End Time (s)";
-//static
-const char* ExperimentResult::kUserThinkTimeKey = "User Think Time (ms)";
+const ExperimentResult::Metric ExperimentResult::kInvalidMetric = kMaxMetrics;
 
-//static
-const char* ExperimentResult::kResultLineFields[] = {
-  kBrowserConfigNameKey,
-  kCommandLineKey,
-  kLogPrefixKey,
-  kHostKey,
-  kUrlKey,
-  kLoadStartTimeKey,
-  kLoadEndTimeKey,
-  kPageLoadTimeKey,
-  kSyncWorkloadEndTimeKey,
-  kUserThinkTimeKey 
-};
+ExperimentResult::ExperimentResult()
+  : num_metrics_(0),
+    failure_reason_(nullptr) {
+  for (size_t i = 0; i < arraysize(kBuiltinMetrics); ++i)
+    RegisterMetric(kBuiltinMetrics[i].name, kBuiltinMetrics[i].type);
+}
+
+// static
+const char* ExperimentResult::BuiltinMetricName(BuiltinMetric metric) {
+  return kBuiltinMetrics[metric].name;
+}
+
+ExperimentResult::Metric ExperimentResult::RegisterMetric(const char* name, MetricType type) {
+  for (size_t i = 0; i < num_metrics_; ++i) {
+    if (strcmp(slots_[i].name, name) == 0)
+      return i;
+  }
+
+  if (num_metrics_ == kMaxMetrics) {
+    LOG(ERROR) << "No slot left for metric " << name;
+    return kInvalidMetric;
+  }
 
-ExperimentResult::ExperimentResult() {
+  Slot& slot = slots_[num_metrics_];
+  slot.name = name;
+  slot.type = type;
+  slot.is_set = false;
+  slot.number = 0;
+  slot.integer = 0;
+  return num_metrics_++;
 }
 
-std::string ExperimentResult::LogHeaderLine() {
+double ExperimentResult::GetNumber(Metric metric) const {
+  const Slot& slot = slots_[metric];
+  return slot.type == kUint64Metric ? static_cast<double>(slot.integer) : slot.number;
+}
+
+void ExperimentResult::SetString(Metric metric, const std::string& value) {
+  if (metric >= num_metrics_)
+    return;
+  DCHECK_EQ(kStringMetric, slots_[metric].type);
+  slots_[metric].text = value;
+  slots_[metric].is_set = true;
+}
+
+void ExperimentResult::SetDouble(Metric metric, double value) {
+  if (metric >= num_metrics_)
+    return;
+  DCHECK(slots_[metric].type == kDoubleMetric || slots_[metric].type == kTimestampMetric);
+  slots_[metric].number = value;
+  slots_[metric].is_set = true;
+}
+
+void ExperimentResult::SetUint64(Metric metric, uint64_t value) {
+  if (metric >= num_metrics_)
+    return;
+  DCHECK_EQ(kUint64Metric, slots_[metric].type);
+  slots_[metric].integer = value;
+  slots_[metric].is_set = true;
+}
+
+void ExperimentResult::Clear() {
+  for (size_t i = 0; i < num_metrics_; ++i) {
+    slots_[i].is_set = false;
+    slots_[i].text.clear();
+  }
+  failure_reason_.store(nullptr);
+}
+
+void ExperimentResult::MarkFailed(const char* reason) {
+  const char* no_reason = nullptr;
+  if (failure_reason_.compare_exchange_strong(no_reason, reason))
+    LOG(ERROR) << "Experiment failed: " << reason;
+}
+
+// Every registered metric is a column, set or not: the header is only written by the
+// first trial, and later trials set other metrics (e.g., the browser restart time)
+std::string ExperimentResult::LogHeaderLine() const {
   // Java: return TextUtils.join("\t", mResultLineFields);
   std::string header_line;
 
-  for (size_t i = 0; i < arraysize(kResultLineFields); ++i) {
-    if (key_value_map_.find(kResultLineFields[i]) == key_value_map_.end())
-      continue;
-
+  for (size_t i = 0; i < num_metrics_; ++i) {
     if (i > 0)
       header_line += '\t';
 
-    header_line += kResultLineFields[i];
+    header_line += slots_[i].name;
   }
 
   return header_line;
 }
 
-void ExperimentResult::Put(const std::string& key, const std::string& value) {
-  key_value_map_[key] = value;
-}
-
-std::string ExperimentResult::LogLine() {
+// Unset metrics are empty values
+std::string ExperimentResult::LogLine() const {
   std::string log_line;
 
-  for (size_t i = 0; i < arraysize(kResultLineFields); ++i) {
-    if (key_value_map_.find(kResultLineFields[i]) == key_value_map_.end())
-      continue;
-
+  for (size_t i = 0; i < num_metrics_; ++i) {
     if (i > 0)
       log_line += '\t';
-    log_line += key_value_map_[kResultLineFields[i]];
+
+    if (slots_[i].is_set)
+      AppendValue(i, &log_line);
   }
 
   return log_line;
 }
 
-void ExperimentResult::WriteToFile(const base::FilePath& filepath, bool include_header) {
+void ExperimentResult::WriteToFile(const base::FilePath& filepath, bool include_header) const {
   if (include_header) {
     std::string header = LogHeaderLine() + "\n";
     if (WriteFile(filepath, header.c_str(), header.length()) == -1) {
@@ -97,20 +175,54 @@ void ExperimentResult::WriteToFile(const base::FilePath& filepath, bool include_
   }
 }
 
-/*
-std::string ExperimentResult::ToJson() {
-  std::string json_output = "{";
+bool ExperimentResult::AppendToStore(const base::FilePath& store_path) const {
+  std::vector<ExperimentResultStore::Column> schema;
+  ExperimentResultStore::Row row(num_metrics_);
 
-  for (size_t i = 0; i < arraysize(kResultLineFields); ++i) {
-    std::string key = kResultLineFields[i];
-    if (i > 0)
-      json_output += ",";
-    json_output += "\"" + key + "\" : \"" + key_value_map_[key] + "\"";
+  for (size_t i = 0; i < num_metrics_; ++i) {
+    bool is_string = slots_[i].type == kStringMetric;
+    // The experiment id is unique to each experiment: a dictionary would only grow
+    ExperimentResultStore::ColumnType type = !is_string ? ExperimentResultStore::kDoubleColumn :
+        i == kLogPrefix ? ExperimentResultStore::kTextColumn :
+        ExperimentResultStore::kStringColumn;
+    schema.push_back(ExperimentResultStore::Column(slots_[i].name, type));
+
+    if (!slots_[i].is_set)
+      continue;
+
+    if (is_string)
+      row.SetString(i, slots_[i].text);
+    else
+      row.SetDouble(i, GetNumber(i));
   }
 
-  json_output += "}";
+  ExperimentResultStore store;
+  if (!store.OpenForAppend(store_path.value(), schema) || !store.Append(row)) {
+    PLOG(ERROR) << "Cannot append experiment result to " << store_path.value();
+    return false;
+  }
+  return true;
+}
 
-  return json_output;
-}*/
+void ExperimentResult::AppendValue(Metric metric, std::string* output) const {
+  const Slot& slot = slots_[metric];
+  char buffer[64];
+
+  switch (slot.type) {
+    case kStringMetric:
+      output->append(slot.text);
+      return;
+    case kDoubleMetric:
+      snprintf(buffer, sizeof(buffer), "%g", slot.number);
+      break;
+    case kTimestampMetric:
+      snprintf(buffer, sizeof(buffer), "%.6f", slot.number);
+      break;
+    case kUint64Metric:
+      snprintf(buffer, sizeof(buffer), "%" PRIu64, slot.integer);
+      break;
+  }
+  output->append(buffer);
+}
 
 }  // namespace browser_profiler
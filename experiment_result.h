@@ -4,61 +4,130 @@
 #ifndef BROWSER_PROFILER_EXPERIMENT_RESULT_H_
 #define BROWSER_PROFILER_EXPERIMENT_RESULT_H_
 
-#include <string>
+#include <stddef.h>
+#include <stdint.h>
 
-#if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
-    (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
-#include <unordered_map>
-#else
-// use 'map' as it is not very performance critical and don't want to use tr1::
-#include <map>
-#endif
+#include <atomic>
+#include <string>
 
 #include "base/files/file_path.h"
+#include "base/macros.h"
 
 namespace browser_profiler {
 
-// A map of key/value for log lines
-// Can convert to json or to a tab-separated log line
-// Because all values are string, create json without any library dependency
-// (It would be much easier in Java, by using JsonObject)
+// The result row of an experiment: typed metrics in a flat array of slots
+// Values are formatted only when the row is written out
+// Can convert to a tab-separated log line
+//
+// The built-in metrics come first, in the order of the log line,
+// tracers register theirs (e.g., in Tracer::Initialize()) before the experiment starts
+// Setting different metrics concurrently is safe
 class ExperimentResult {
  public:
-  static const char* kBrowserConfigNameKey;
-  static const char* kCommandLineKey;
-  static const char* kLogPrefixKey;
-  static const char* kHostKey;
-  static const char* kUrlKey;
-  static const char* kLoadStartTimeKey;
-  static const char* kLoadEndTimeKey;
-  static const char* kPageLoadTimeKey;
-  static const char* kSyncWorkloadEndTimeKey;
-  static const char* kUserThinkTimeKey;
-
-  // This array retains the order of fields in the experiment result log file
-  // Use array for easy initialization in C++98
-  static const char* kResultLineFields[];
+  // Index of a metric slot
+  typedef size_t Metric;
+
+  enum BuiltinMetric {
+    kBrowserConfigName,
+    kCommandLine,
+    kLogPrefix,
+    kHost,
+    kUrl,
+    kLoadStartTime,
+    kLoadEndTime,
+    kPageLoadTime,
+    kSyncWorkloadEndTime,
+    kUserThinkTime,
+    // New metrics are appended after the original log columns above
+    // Of the load window, measured by the power tracer
+    kEnergy,
+    kAveragePower,
+    kRootCommandTime,
+    kRootCommandRoundTrips,
+    kTracerStartTime,
+    kTracerStopTime,
+    kBrowserRestartTime,
+    kSessionTrial,
+    kWarmUpTrial,
+    kNumBuiltinMetrics,
+  };
+
+  enum MetricType {
+    kStringMetric,
+    // Formatted like an ostream: 6 significant digits
+    kDoubleMetric,
+    // Seconds with microseconds, e.g., monotonic timestamps
+    kTimestampMetric,
+    kUint64Metric,
+  };
+
+  static const size_t kMaxMetrics = 64;
+  static const Metric kInvalidMetric;
 
   ExperimentResult();
 
-  void Put(const std::string& key, const std::string& value);
+  // Column name of a built-in metric in the log line
+  static const char* BuiltinMetricName(BuiltinMetric metric);
+
+  // Return the slot of the metric, the existing one if name is registered already
+  // name must outlive the result, e.g., a string literal
+  // Return kInvalidMetric if there is no free slot, setting it is ignored
+  Metric RegisterMetric(const char* name, MetricType type);
+
+  size_t num_metrics() const { return num_metrics_; }
+  const char* name(Metric metric) const { return slots_[metric].name; }
+  MetricType type(Metric metric) const { return slots_[metric].type; }
+  bool IsSet(Metric metric) const { return slots_[metric].is_set; }
+  double GetNumber(Metric metric) const;
+  const std::string& GetString(Metric metric) const { return slots_[metric].text; }
+
+  void SetString(Metric metric, const std::string& value);
+  void SetDouble(Metric metric, double value);
+  void SetUint64(Metric metric, uint64_t value);
 
-  // Return tab-separated keys as a log header line
-  std::string LogHeaderLine();
+  // Unset all metrics and the failure, for the next trial in the same process
+  // Registered metrics are kept
+  void Clear();
 
-  // Return tab-separated values as a log line
-  std::string LogLine();
+  // The experiment is invalid, e.g., a tracer could not start: its result is dropped
+  // and it is run again; the first reason is kept
+  // reason must outlive the result, e.g., a string literal; safe to call concurrently
+  void MarkFailed(const char* reason);
+  bool failed() const { return failure_reason_.load() != nullptr; }
+  const char* failure_reason() const { return failure_reason_.load(); }
+
+  // Return tab-separated names of the registered metrics as a log header line
+  std::string LogHeaderLine() const;
+
+  // Return tab-separated values of the registered metrics as a log line,
+  // empty for the unset ones
+  std::string LogLine() const;
 
   // Will write header first, then the log line if include_header is true
-  void WriteToFile(const base::FilePath& filepath, bool include_header);
+  void WriteToFile(const base::FilePath& filepath, bool include_header) const;
+
+  // Append a row to the binary result store, see ExperimentResultStore
+  bool AppendToStore(const base::FilePath& store_path) const;
 
  private:
-#if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
-    (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
-  std::unordered_map<std::string, std::string> key_value_map_;
-#else
-  std::map<std::string, std::string> key_value_map_;
-#endif
+  struct Slot {
+    const char* name;
+    MetricType type;
+    bool is_set;
+    double number;
+    uint64_t integer;
+    std::string text;
+  };
+
+  // Append the formatted value of a set metric
+  void AppendValue(Metric metric, std::string* output) const;
+
+  Slot slots_[kMaxMetrics];
+  size_t num_metrics_;
+
+  std::atomic<const char*> failure_reason_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExperimentResult);
 };
 
 }  // namespace browser_profiler
@@ -0,0 +1,575 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "experiment_result_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "crc32.h"
+
+namespace {
+
+const char kStoreMagic[] = "BPRSTORE";
+const char kDictMagic[] = "BPRSDICT";
+const char kTextMagic[] = "BPRSTEXT";
+const size_t kMagicLength = 8;
+
+const char kDictSuffix[] = ".dict";
+const char kLockSuffix[] = ".lock";
+const char kTextSuffix[] = ".text";
+
+// magic, version, number of columns, row size, header size
+const size_t kFixedHeaderSize = kMagicLength + 4 * sizeof(uint32_t);
+
+// crc32 and padding
+const size_t kRowPrefixSize = 2 * sizeof(uint32_t);
+const size_t kCellSize = 8;
+
+// Guard against garbage
+const uint32_t kMaxColumns = 4096;
+const uint32_t kMaxStringLength = 1024 * 1024;
+
+// Move a store aside at most this many times
+const int kMaxMovedAsideStores = 1000;
+
+size_t AlignTo8(size_t size) {
+  return (size + 7) & ~static_cast<size_t>(7);
+}
+
+void AppendUint32(std::string* buffer, uint32_t value) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t LoadUint32(const char* data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+bool WriteAll(int fd, const char* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool ReadWholeFile(int fd, std::string* content) {
+  content->clear();
+  if (lseek(fd, 0, SEEK_SET) < 0)
+    return false;
+
+  char buffer[64 * 1024];
+  for (;;) {
+    ssize_t num_read = read(fd, buffer, sizeof(buffer));
+    if (num_read < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (num_read == 0)
+      return true;
+    content->append(buffer, num_read);
+  }
+}
+
+bool PathExists(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+// Rename the store with its dictionary and texts
+bool RenameStoreFiles(const std::string& path, const std::string& new_path) {
+  if (rename(path.c_str(), new_path.c_str()) < 0)
+    return false;
+  const char* const suffixes[] = { kDictSuffix, kTextSuffix };
+  for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+    std::string file_path = path + suffixes[i];
+    if (PathExists(file_path) &&
+        rename(file_path.c_str(), (new_path + suffixes[i]).c_str()) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Keep a store of another schema as <path>.<n>
+bool MoveAside(const std::string& path) {
+  for (int i = 0; i < kMaxMovedAsideStores; ++i) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%d", i);
+    std::string new_path = path + suffix;
+    if (!PathExists(new_path))
+      return RenameStoreFiles(path, new_path);
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+const uint32_t ExperimentResultStore::kVersion = 2;
+
+// static
+bool ExperimentResultStore::Prefix(const std::string& path, const std::string& prefix) {
+  std::string::size_type name_start = path.rfind('/');
+  name_start = name_start == std::string::npos ? 0 : name_start + 1;
+  std::string new_path = path.substr(0, name_start) + prefix + "." + path.substr(name_start);
+  if (PathExists(new_path)) {
+    errno = EEXIST;
+    return false;
+  }
+  return RenameStoreFiles(path, new_path);
+}
+
+ExperimentResultStore::Column::Column()
+  : type(kStringColumn) {
+}
+
+ExperimentResultStore::Column::Column(const std::string& name, ColumnType type)
+  : name(name),
+    type(type) {
+}
+
+ExperimentResultStore::Row::Row(size_t num_columns)
+  : cells_(num_columns) {
+  for (size_t i = 0; i < cells_.size(); ++i) {
+    cells_[i].present = false;
+    cells_[i].number = 0;
+  }
+}
+
+void ExperimentResultStore::Row::SetString(size_t column, const std::string& value) {
+  cells_[column].present = true;
+  cells_[column].text = value;
+}
+
+void ExperimentResultStore::Row::SetDouble(size_t column, double value) {
+  cells_[column].present = true;
+  cells_[column].number = value;
+}
+
+ExperimentResultStore::ExperimentResultStore()
+  : header_size_(0),
+    row_size_(0),
+    store_fd_(-1),
+    dict_fd_(-1),
+    text_fd_(-1),
+    lock_fd_(-1),
+    text_size_(0),
+    mapped_data_(nullptr),
+    mapped_length_(0) {
+}
+
+ExperimentResultStore::~ExperimentResultStore() {
+  Close();
+}
+
+bool ExperimentResultStore::OpenForAppend(const std::string& path,
+    const std::vector<Column>& schema) {
+  Close();
+  schema_ = schema;
+  row_size_ = kRowPrefixSize + BitmapSize() + kCellSize * schema_.size();
+  std::string header = EncodeHeader();
+  header_size_ = header.length();
+
+  // Serialize appenders, e.g., parallel instances of a campaign, until Close()
+  // The dictionary ids are only valid while the lock is held
+  lock_fd_ = open((path + kLockSuffix).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+  if (lock_fd_ < 0)
+    return false;
+  int locked;
+  do {
+    locked = flock(lock_fd_, LOCK_EX);
+  } while (locked < 0 && errno == EINTR);
+  if (locked < 0) {
+    Close();
+    return false;
+  }
+
+  store_fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+  if (store_fd_ < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(store_fd_, &st) < 0) {
+    Close();
+    return false;
+  }
+  size_t size = st.st_size;
+
+  if (size > 0) {
+    std::string existing_header(header_size_, '\0');
+    bool same_schema = size >= header_size_ &&
+        pread(store_fd_, &existing_header[0], header_size_, 0) ==
+            static_cast<ssize_t>(header_size_) &&
+        existing_header == header;
+
+    if (!same_schema) {
+      close(store_fd_);
+      store_fd_ = -1;
+      if (!MoveAside(path))
+        return false;
+      store_fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+      if (store_fd_ < 0)
+        return false;
+      size = 0;
+    }
+  }
+
+  if (size == 0) {
+    if (!WriteAll(store_fd_, header.data(), header.length()) || fdatasync(store_fd_) < 0) {
+      Close();
+      return false;
+    }
+  } else {
+    // Drop a torn row at the end
+    size_t num_rows = (size - header_size_) / row_size_;
+    size_t valid_size = header_size_ + num_rows * row_size_;
+    if (num_rows > 0) {
+      std::string last_row(row_size_, '\0');
+      if (pread(store_fd_, &last_row[0], row_size_, valid_size - row_size_) !=
+              static_cast<ssize_t>(row_size_) ||
+          LoadUint32(last_row.data()) !=
+              Crc32(last_row.data() + sizeof(uint32_t), row_size_ - sizeof(uint32_t))) {
+        valid_size -= row_size_;
+      }
+    }
+    if (valid_size != size && ftruncate(store_fd_, valid_size) < 0) {
+      Close();
+      return false;
+    }
+  }
+
+  if (!LoadDictionary(path + kDictSuffix, true) || !OpenText(path + kTextSuffix, true)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool ExperimentResultStore::Append(const Row& row) {
+  if (store_fd_ < 0 || dict_fd_ < 0 || text_fd_ < 0 || row.cells_.size() != schema_.size())
+    return false;
+
+  std::string row_data(row_size_, '\0');
+  char* bitmap = &row_data[kRowPrefixSize];
+  char* cells = bitmap + BitmapSize();
+
+  // New strings and texts first, in one write each
+  std::string new_strings;
+  std::string new_texts;
+  for (size_t i = 0; i < schema_.size(); ++i) {
+    const Row::Cell& cell = row.cells_[i];
+    if (!cell.present)
+      continue;
+
+    bitmap[i / 8] |= 1 << (i % 8);
+    if (schema_[i].type == kDoubleColumn) {
+      memcpy(cells + i * kCellSize, &cell.number, kCellSize);
+      continue;
+    }
+
+    if (cell.text.length() > kMaxStringLength)
+      return false;
+
+    uint64_t id;
+    std::unordered_map<std::string, uint64_t>::const_iterator it;
+    if (schema_[i].type == kTextColumn) {
+      id = text_size_ + new_texts.length();
+      AppendUint32(&new_texts, cell.text.length());
+      AppendUint32(&new_texts, Crc32(cell.text.data(), cell.text.length()));
+      new_texts.append(cell.text);
+    } else if ((it = string_ids_.find(cell.text)) != string_ids_.end()) {
+      id = it->second;
+    } else {
+      id = strings_.size();
+      string_ids_[cell.text] = id;
+      strings_.push_back(cell.text);
+      AppendUint32(&new_strings, cell.text.length());
+      AppendUint32(&new_strings, Crc32(cell.text.data(), cell.text.length()));
+      new_strings.append(cell.text);
+    }
+    memcpy(cells + i * kCellSize, &id, kCellSize);
+  }
+
+  // The row must not refer to strings which may be lost in a crash
+  if (!new_strings.empty() &&
+      (!WriteAll(dict_fd_, new_strings.data(), new_strings.length()) ||
+       fdatasync(dict_fd_) < 0)) {
+    return false;
+  }
+  if (!new_texts.empty()) {
+    if (!WriteAll(text_fd_, new_texts.data(), new_texts.length()) || fdatasync(text_fd_) < 0)
+      return false;
+    text_size_ += new_texts.length();
+  }
+
+  uint32_t crc = Crc32(row_data.data() + sizeof(uint32_t), row_size_ - sizeof(uint32_t));
+  memcpy(&row_data[0], &crc, sizeof(crc));
+  return WriteAll(store_fd_, row_data.data(), row_data.length()) && fdatasync(store_fd_) == 0;
+}
+
+bool ExperimentResultStore::OpenForRead(const std::string& path) {
+  Close();
+
+  store_fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (store_fd_ < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(store_fd_, &st) < 0 || st.st_size < static_cast<off_t>(kFixedHeaderSize)) {
+    Close();
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, store_fd_, 0);
+  if (data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  mapped_data_ = static_cast<const char*>(data);
+  mapped_length_ = st.st_size;
+
+  if (!DecodeHeader(mapped_data_, mapped_length_) ||
+      !LoadDictionary(path + kDictSuffix, false) || !OpenText(path + kTextSuffix, false)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void ExperimentResultStore::Close() {
+  if (mapped_data_ != nullptr)
+    munmap(const_cast<char*>(mapped_data_), mapped_length_);
+  mapped_data_ = nullptr;
+  mapped_length_ = 0;
+
+  if (store_fd_ >= 0)
+    close(store_fd_);
+  store_fd_ = -1;
+
+  if (dict_fd_ >= 0)
+    close(dict_fd_);
+  dict_fd_ = -1;
+
+  if (text_fd_ >= 0)
+    close(text_fd_);
+  text_fd_ = -1;
+  text_size_ = 0;
+
+  // Releases the lock
+  if (lock_fd_ >= 0)
+    close(lock_fd_);
+  lock_fd_ = -1;
+
+  string_ids_.clear();
+  strings_.clear();
+  texts_.clear();
+}
+
+size_t ExperimentResultStore::num_rows() const {
+  if (mapped_data_ == nullptr || row_size_ == 0)
+    return 0;
+  return (mapped_length_ - header_size_) / row_size_;
+}
+
+bool ExperimentResultStore::IsPresent(size_t row, size_t column) const {
+  const char* bitmap = RowData(row) + kRowPrefixSize;
+  return (bitmap[column / 8] >> (column % 8)) & 1;
+}
+
+double ExperimentResultStore::GetDouble(size_t row, size_t column) const {
+  double value;
+  memcpy(&value, RowData(row) + kRowPrefixSize + BitmapSize() + column * kCellSize,
+      sizeof(value));
+  return value;
+}
+
+const std::string& ExperimentResultStore::GetString(size_t row, size_t column) const {
+  static const std::string* const kEmpty = new std::string();
+
+  uint64_t id;
+  memcpy(&id, RowData(row) + kRowPrefixSize + BitmapSize() + column * kCellSize, sizeof(id));
+  if (!IsPresent(row, column))
+    return *kEmpty;
+  if (schema_[column].type == kTextColumn) {
+    std::unordered_map<uint64_t, std::string>::const_iterator it = texts_.find(id);
+    return it != texts_.end() ? it->second : *kEmpty;
+  }
+  if (id >= strings_.size())
+    return *kEmpty;
+  return strings_[id];
+}
+
+bool ExperimentResultStore::IsRowValid(size_t row) const {
+  const char* data = RowData(row);
+  return LoadUint32(data) ==
+      Crc32(data + sizeof(uint32_t), row_size_ - sizeof(uint32_t));
+}
+
+std::string ExperimentResultStore::EncodeHeader() const {
+  std::string columns;
+  for (size_t i = 0; i < schema_.size(); ++i) {
+    AppendUint32(&columns, schema_[i].type);
+    AppendUint32(&columns, schema_[i].name.length());
+    columns.append(schema_[i].name);
+  }
+
+  uint32_t header_size = AlignTo8(kFixedHeaderSize + columns.length() + sizeof(uint32_t));
+
+  std::string header(kStoreMagic, kMagicLength);
+  AppendUint32(&header, kVersion);
+  AppendUint32(&header, schema_.size());
+  AppendUint32(&header, row_size_);
+  AppendUint32(&header, header_size);
+  header.append(columns);
+  AppendUint32(&header, Crc32(header.data(), header.length()));
+  header.resize(header_size, '\0');
+  return header;
+}
+
+bool ExperimentResultStore::DecodeHeader(const char* data, size_t length) {
+  if (length < kFixedHeaderSize || memcmp(data, kStoreMagic, kMagicLength) != 0 ||
+      LoadUint32(data + kMagicLength) != kVersion)
+    return false;
+
+  uint32_t num_columns = LoadUint32(data + kMagicLength + 4);
+  row_size_ = LoadUint32(data + kMagicLength + 8);
+  header_size_ = LoadUint32(data + kMagicLength + 12);
+  if (num_columns > kMaxColumns || header_size_ > length || header_size_ % 8 != 0)
+    return false;
+
+  schema_.clear();
+  size_t offset = kFixedHeaderSize;
+  for (uint32_t i = 0; i < num_columns; ++i) {
+    if (offset + 2 * sizeof(uint32_t) > header_size_)
+      return false;
+    uint32_t type = LoadUint32(data + offset);
+    uint32_t name_length = LoadUint32(data + offset + 4);
+    offset += 2 * sizeof(uint32_t);
+    if (name_length > header_size_ - offset ||
+        (type != kStringColumn && type != kDoubleColumn && type != kTextColumn))
+      return false;
+
+    schema_.push_back(Column(std::string(data + offset, name_length),
+        static_cast<ColumnType>(type)));
+    offset += name_length;
+  }
+
+  return offset + sizeof(uint32_t) <= header_size_ &&
+      LoadUint32(data + offset) == Crc32(data, offset) &&
+      row_size_ == kRowPrefixSize + BitmapSize() + kCellSize * schema_.size();
+}
+
+size_t ExperimentResultStore::BitmapSize() const {
+  return AlignTo8((schema_.size() + 7) / 8);
+}
+
+const char* ExperimentResultStore::RowData(size_t row) const {
+  return mapped_data_ + header_size_ + row * row_size_;
+}
+
+bool ExperimentResultStore::LoadDictionary(const std::string& path, bool repair) {
+  dict_fd_ = repair ?
+      open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666) :
+      open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (dict_fd_ < 0)
+    return false;
+
+  std::string content;
+  if (!ReadWholeFile(dict_fd_, &content))
+    return false;
+
+  if (content.empty() && repair) {
+    return WriteAll(dict_fd_, kDictMagic, kMagicLength) && fdatasync(dict_fd_) == 0;
+  }
+
+  if (content.length() < kMagicLength || memcmp(content.data(), kDictMagic, kMagicLength) != 0)
+    return false;
+
+  size_t offset = kMagicLength;
+  while (offset + 2 * sizeof(uint32_t) <= content.length()) {
+    uint32_t length = LoadUint32(content.data() + offset);
+    uint32_t crc = LoadUint32(content.data() + offset + 4);
+    size_t begin = offset + 2 * sizeof(uint32_t);
+    if (length > content.length() - begin || crc != Crc32(content.data() + begin, length))
+      break;
+
+    std::string value(content.data() + begin, length);
+    string_ids_[value] = strings_.size();
+    strings_.push_back(value);
+    offset = begin + length;
+  }
+
+  // Drop a torn string at the end
+  if (offset != content.length() && repair && ftruncate(dict_fd_, offset) < 0)
+    return false;
+  return true;
+}
+
+// Appending does not read the texts; reading only loads the texts the rows refer to,
+// which skips torn ones
+bool ExperimentResultStore::OpenText(const std::string& path, bool append) {
+  text_fd_ = append ?
+      open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0666) :
+      open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (text_fd_ < 0)
+    return false;
+
+  if (append) {
+    struct stat st;
+    if (fstat(text_fd_, &st) < 0)
+      return false;
+    text_size_ = st.st_size;
+    if (text_size_ == 0) {
+      if (!WriteAll(text_fd_, kTextMagic, kMagicLength) || fdatasync(text_fd_) < 0)
+        return false;
+      text_size_ = kMagicLength;
+    }
+    return true;
+  }
+
+  std::string content;
+  if (!ReadWholeFile(text_fd_, &content) || content.length() < kMagicLength ||
+      memcmp(content.data(), kTextMagic, kMagicLength) != 0) {
+    return false;
+  }
+
+  for (size_t row = 0; row < num_rows(); ++row) {
+    for (size_t column = 0; column < schema_.size(); ++column) {
+      if (schema_[column].type != kTextColumn || !IsPresent(row, column))
+        continue;
+
+      uint64_t offset;
+      memcpy(&offset, RowData(row) + kRowPrefixSize + BitmapSize() + column * kCellSize,
+          sizeof(offset));
+      if (offset < kMagicLength || offset + 2 * sizeof(uint32_t) > content.length())
+        continue;
+      uint32_t length = LoadUint32(content.data() + offset);
+      uint32_t crc = LoadUint32(content.data() + offset + 4);
+      size_t begin = offset + 2 * sizeof(uint32_t);
+      if (length > content.length() - begin || crc != Crc32(content.data() + begin, length))
+        continue;
+      texts_[offset] = std::string(content.data() + begin, length);
+    }
+  }
+  return true;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,166 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_EXPERIMENT_RESULT_STORE_H_
+#define BROWSER_PROFILER_EXPERIMENT_RESULT_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace browser_profiler {
+
+// Append-only binary store of experiment results, one fixed-size row per experiment
+// Written next to the tab-separated experiment result log,
+// tools/result_store_to_tsv converts it back to that log
+// Only depends on POSIX so that tools can read it
+//
+// Strings (command line, url, ...) are dictionary-encoded: each distinct string is
+// written once to <store>.dict and rows refer to it by id
+// Text columns hold strings unique to a row (e.g., the experiment id): they are written
+// to <store>.text as they come and rows refer to them by offset, so that appending
+// does not load a dictionary which grows with every row
+// Numbers are stored as native doubles
+//
+// Store file layout (host byte order):
+//   char[8]  magic "BPRSTORE"
+//   uint32   version
+//   uint32   number of columns
+//   uint32   row size
+//   uint32   header size (multiple of 8)
+//   columns: uint32 type, uint32 name length, name
+//   uint32   crc32 of the header so far, zero padding to the header size
+//   rows until EOF: uint32 crc32 of the rest of the row, uint32 zero,
+//     presence bitmap padded to 8 bytes, 8 bytes per column (double, string id or
+//     text offset)
+// Row i is at header size + i * row size, so readers mmap the file and index it
+//
+// Dictionary file layout:
+//   char[8]  magic "BPRSDICT"
+//   strings until EOF: uint32 length, uint32 crc32, bytes; ids are the order
+//
+// Text file layout:
+//   char[8]  magic "BPRSTEXT"
+//   strings until EOF: uint32 length, uint32 crc32, bytes; offsets are from the file start
+//
+// Appenders lock <store>.lock from OpenForAppend() to Close(), so several processes
+// may append to the same store
+//
+// Appends are crash-safe: new strings reach the dictionary and the text file before
+// the row using them, and a torn row or string at the end is detected by its crc32
+// and truncated when the store is opened again; a torn text is left in place,
+// no row refers to it
+class ExperimentResultStore {
+ public:
+  static const uint32_t kVersion;
+
+  enum ColumnType {
+    kStringColumn = 1,
+    kDoubleColumn = 2,
+    // A string, not deduplicated
+    kTextColumn = 3,
+  };
+
+  struct Column {
+    Column();
+    Column(const std::string& name, ColumnType type);
+
+    std::string name;
+    ColumnType type;
+  };
+
+  // Values of a row being appended, one cell per column of the schema
+  class Row {
+   public:
+    explicit Row(size_t num_columns);
+
+    void SetString(size_t column, const std::string& value);
+    void SetDouble(size_t column, double value);
+
+   private:
+    friend class ExperimentResultStore;
+
+    struct Cell {
+      bool present;
+      double number;
+      std::string text;
+    };
+
+    std::vector<Cell> cells_;
+  };
+
+  // Rename a closed store to <dir>/<prefix>.<name>, with its dictionary and texts
+  // Fail if that store exists
+  static bool Prefix(const std::string& path, const std::string& prefix);
+
+  ExperimentResultStore();
+  ~ExperimentResultStore();
+
+  // Open for appending, create the store with schema if it does not exist
+  // A store with another schema is moved aside to <store>.<n> first
+  bool OpenForAppend(const std::string& path, const std::vector<Column>& schema);
+
+  // O(1): one write to the dictionary for new strings, one to the text file for texts,
+  // one write for the row
+  bool Append(const Row& row);
+
+  // Map the whole store for reading
+  bool OpenForRead(const std::string& path);
+
+  void Close();
+
+  const std::vector<Column>& schema() const { return schema_; }
+
+  // Reading, row < num_rows(), column < schema().size()
+  size_t num_rows() const;
+  bool IsPresent(size_t row, size_t column) const;
+  double GetDouble(size_t row, size_t column) const;
+  const std::string& GetString(size_t row, size_t column) const;
+
+  // Whether row has a valid crc32
+  bool IsRowValid(size_t row) const;
+
+ private:
+  std::string EncodeHeader() const;
+  bool DecodeHeader(const char* data, size_t length);
+  size_t BitmapSize() const;
+  const char* RowData(size_t row) const;
+
+  // Load (and repair if writable) the dictionary
+  bool LoadDictionary(const std::string& path, bool repair);
+  // Open the text file for appending, or load the texts of the rows for reading
+  bool OpenText(const std::string& path, bool append);
+
+  std::vector<Column> schema_;
+  uint32_t header_size_;
+  uint32_t row_size_;
+
+  int store_fd_;
+  int dict_fd_;
+  int text_fd_;
+  int lock_fd_;
+
+  // Appending, the offset of the next text
+  uint64_t text_size_;
+
+  // Reading
+  const char* mapped_data_;
+  size_t mapped_length_;
+
+  // Id of each string, and string of each id
+  std::unordered_map<std::string, uint64_t> string_ids_;
+  std::vector<std::string> strings_;
+  // Reading, text at each offset
+  std::unordered_map<uint64_t, std::string> texts_;
+
+  // Not copyable
+  ExperimentResultStore(const ExperimentResultStore&);
+  void operator=(const ExperimentResultStore&);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_EXPERIMENT_RESULT_STORE_H_
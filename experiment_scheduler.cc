@@ -0,0 +1,238 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "experiment_scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace {
+
+using browser_profiler::ExperimentScheduler;
+
+const char* const kPolicyNames[] = {
+  "blocked",
+  "url-blocked",
+  "interleaved",
+  "randomized",
+  "cost-minimizing",
+};
+static_assert(sizeof(kPolicyNames) / sizeof(kPolicyNames[0]) ==
+    ExperimentScheduler::kNumPolicies, "Policies and their names do not match");
+
+// Weight of a new measurement in the moving average of a transition cost
+const double kCostSmoothing = 0.2;
+
+class BlockedScheduler : public ExperimentScheduler {
+ public:
+  Policy policy() const override { return kBlocked; }
+
+  void Schedule(size_t num_command_lines, size_t num_urls, size_t num_tries,
+      std::vector<Cell>* cells) const override {
+    for (size_t c = 0; c < num_command_lines; ++c) {
+      for (size_t u = 0; u < num_urls; ++u) {
+        for (size_t t = 0; t < num_tries; ++t)
+          cells->push_back(Cell(c, u, t));
+      }
+    }
+  }
+};
+
+class UrlBlockedScheduler : public ExperimentScheduler {
+ public:
+  Policy policy() const override { return kUrlBlocked; }
+
+  void Schedule(size_t num_command_lines, size_t num_urls, size_t num_tries,
+      std::vector<Cell>* cells) const override {
+    for (size_t u = 0; u < num_urls; ++u) {
+      for (size_t c = 0; c < num_command_lines; ++c) {
+        for (size_t t = 0; t < num_tries; ++t)
+          cells->push_back(Cell(c, u, t));
+      }
+    }
+  }
+};
+
+class InterleavedScheduler : public ExperimentScheduler {
+ public:
+  Policy policy() const override { return kInterleaved; }
+
+  void Schedule(size_t num_command_lines, size_t num_urls, size_t num_tries,
+      std::vector<Cell>* cells) const override {
+    for (size_t t = 0; t < num_tries; ++t) {
+      for (size_t u = 0; u < num_urls; ++u) {
+        for (size_t c = 0; c < num_command_lines; ++c)
+          cells->push_back(Cell(c, u, t));
+      }
+    }
+  }
+};
+
+class RandomizedScheduler : public ExperimentScheduler {
+ public:
+  explicit RandomizedScheduler(uint64_t seed) : seed_(seed) {}
+
+  Policy policy() const override { return kRandomized; }
+
+  // Fisher-Yates over each round: std::shuffle differs between standard libraries,
+  // while the schedule must be the same in every browser process of the campaign
+  void Schedule(size_t num_command_lines, size_t num_urls, size_t num_tries,
+      std::vector<Cell>* cells) const override {
+    std::mt19937_64 random(seed_);
+    for (size_t t = 0; t < num_tries; ++t) {
+      size_t round_start = cells->size();
+      for (size_t c = 0; c < num_command_lines; ++c) {
+        for (size_t u = 0; u < num_urls; ++u)
+          cells->push_back(Cell(c, u, t));
+      }
+      for (size_t i = cells->size() - round_start; i > 1; --i)
+        std::swap((*cells)[round_start + i - 1], (*cells)[round_start + random() % i]);
+    }
+  }
+
+ private:
+  uint64_t seed_;
+};
+
+}  // namespace
+
+namespace browser_profiler {
+
+ExperimentScheduler::TransitionCosts::TransitionCosts() {
+  for (size_t i = 0; i < kNumTransitions; ++i) {
+    seconds[i] = 0;
+    counts[i] = 0;
+  }
+}
+
+bool ExperimentScheduler::TransitionCosts::Load(const base::FilePath& file) {
+  // One line per transition: seconds count
+  std::string text;
+  if (!base::ReadFileToString(file, &text))
+    return false;
+
+  const char* line = text.c_str();
+  for (size_t i = 0; i < kNumTransitions; ++i) {
+    unsigned count;
+    if (sscanf(line, "%lf %u", &seconds[i], &count) != 2) {
+      LOG(ERROR) << "Cannot parse transition costs in " << file.value();
+      *this = TransitionCosts();
+      return false;
+    }
+    counts[i] = count;
+    line = strchr(line, '\n');
+    if (line == nullptr)
+      line = "";
+    else
+      ++line;
+  }
+  return true;
+}
+
+bool ExperimentScheduler::TransitionCosts::Save(const base::FilePath& file) const {
+  std::string text;
+  for (size_t i = 0; i < kNumTransitions; ++i) {
+    char line[64];
+    snprintf(line, sizeof(line), "%.6f %u\n", seconds[i], counts[i]);
+    text.append(line);
+  }
+  return base::ImportantFileWriter::WriteFileAtomically(file, text);
+}
+
+void ExperimentScheduler::TransitionCosts::Add(Transition transition, double measured_seconds) {
+  seconds[transition] = counts[transition] == 0 ? measured_seconds :
+      seconds[transition] + kCostSmoothing * (measured_seconds - seconds[transition]);
+  ++counts[transition];
+}
+
+double ExperimentScheduler::TransitionCosts::Cost(Transition transition) const {
+  if (counts[transition] > 0)
+    return seconds[transition];
+
+  double max_cost = 0;
+  for (size_t i = 0; i < kNumTransitions; ++i) {
+    if (counts[i] > 0)
+      max_cost = std::max(max_cost, seconds[i]);
+  }
+  return max_cost;
+}
+
+// static
+bool ExperimentScheduler::ParsePolicy(const std::string& name, Policy* policy) {
+  for (size_t i = 0; i < kNumPolicies; ++i) {
+    if (name == kPolicyNames[i]) {
+      *policy = static_cast<Policy>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// static
+const char* ExperimentScheduler::PolicyName(Policy policy) {
+  return policy < kNumPolicies ? kPolicyNames[policy] : "unknown";
+}
+
+// static
+std::unique_ptr<ExperimentScheduler> ExperimentScheduler::Create(Policy policy, uint64_t seed,
+    size_t num_command_lines, size_t num_urls, size_t num_tries,
+    const TransitionCosts& costs) {
+  switch (policy) {
+    case kUrlBlocked:
+      return std::unique_ptr<ExperimentScheduler>(new UrlBlockedScheduler());
+    case kInterleaved:
+      return std::unique_ptr<ExperimentScheduler>(new InterleavedScheduler());
+    case kRandomized:
+      return std::unique_ptr<ExperimentScheduler>(new RandomizedScheduler(seed));
+    case kCostMinimizing:
+      break;
+    default:
+      return std::unique_ptr<ExperimentScheduler>(new BlockedScheduler());
+  }
+
+  // Blocked first: it wins ties, e.g., when nothing is measured yet
+  const Policy candidates[] = { kBlocked, kUrlBlocked, kInterleaved };
+  std::unique_ptr<ExperimentScheduler> cheapest;
+  double cheapest_cost = 0;
+  for (size_t i = 0; i < arraysize(candidates); ++i) {
+    std::unique_ptr<ExperimentScheduler> candidate =
+        Create(candidates[i], seed, num_command_lines, num_urls, num_tries, costs);
+    std::vector<Cell> cells;
+    candidate->Schedule(num_command_lines, num_urls, num_tries, &cells);
+    double cost = Cost(cells, costs);
+    VLOG(1) << "Schedule " << PolicyName(candidates[i]) << " costs " << cost << " s";
+    if (!cheapest || cost < cheapest_cost) {
+      cheapest = std::move(candidate);
+      cheapest_cost = cost;
+    }
+  }
+  return cheapest;
+}
+
+// static
+ExperimentScheduler::Transition ExperimentScheduler::TransitionBetween(const Cell& from,
+    const Cell& to) {
+  if (from.command_line_index != to.command_line_index)
+    return kCommandLineChange;
+  return from.url_index != to.url_index ? kUrlChange : kSameCell;
+}
+
+// static
+double ExperimentScheduler::Cost(const std::vector<Cell>& schedule,
+    const TransitionCosts& costs) {
+  double cost = 0;
+  for (size_t i = 1; i < schedule.size(); ++i)
+    cost += costs.Cost(TransitionBetween(schedule[i - 1], schedule[i]));
+  return cost;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,104 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_EXPERIMENT_SCHEDULER_H_
+#define BROWSER_PROFILER_EXPERIMENT_SCHEDULER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+
+namespace browser_profiler {
+
+// Order of the trials of a campaign over the command line x url matrix
+// A schedule is a pure function of its policy, seed and the matrix, so only the position
+// in it is kept in the profiler state
+//
+// Policies:
+//   blocked: command line, then url, then try (the classic order)
+//   url-blocked: url, then command line, then try
+//   interleaved: round-robin, each round runs every url on every command line once, so
+//     configurations are compared close in time (drift is not confounded with them)
+//   randomized: each round in a random order, from the seed
+//   cost-minimizing: the cheapest of blocked, url-blocked and interleaved, by the transition
+//     costs measured in the previous campaigns; resolved once when a campaign starts
+class ExperimentScheduler {
+ public:
+  enum Policy {
+    kBlocked,
+    kUrlBlocked,
+    kInterleaved,
+    kRandomized,
+    kCostMinimizing,
+    kNumPolicies,
+  };
+
+  // From one trial to the next one
+  enum Transition {
+    kSameCell,
+    kUrlChange,
+    kCommandLineChange,
+    kNumTransitions,
+    kNoTransition = kNumTransitions,
+  };
+
+  struct Cell {
+    Cell() : command_line_index(0), url_index(0), try_index(0) {}
+    Cell(size_t command_line, size_t url, size_t try_index)
+      : command_line_index(command_line), url_index(url), try_index(try_index) {}
+
+    size_t command_line_index;
+    size_t url_index;
+    size_t try_index;
+  };
+
+  // Average dead time between two trials, by transition, in seconds
+  // Kept across campaigns in a small text file
+  struct TransitionCosts {
+    TransitionCosts();
+
+    bool Load(const base::FilePath& file);
+    bool Save(const base::FilePath& file) const;
+
+    // Moving average
+    void Add(Transition transition, double seconds);
+
+    // An unmeasured transition costs as much as the most expensive measured one
+    double Cost(Transition transition) const;
+
+    double seconds[kNumTransitions];
+    uint32_t counts[kNumTransitions];
+  };
+
+  virtual ~ExperimentScheduler() {}
+
+  // Return false if name is not a policy
+  static bool ParsePolicy(const std::string& name, Policy* policy);
+  static const char* PolicyName(Policy policy);
+
+  // A cost-minimizing scheduler creates the cheapest of the others
+  static std::unique_ptr<ExperimentScheduler> Create(Policy policy, uint64_t seed,
+      size_t num_command_lines, size_t num_urls, size_t num_tries,
+      const TransitionCosts& costs);
+
+  static Transition TransitionBetween(const Cell& from, const Cell& to);
+
+  // Sum of the costs of the transitions of a schedule
+  static double Cost(const std::vector<Cell>& schedule, const TransitionCosts& costs);
+
+  // The concrete policy, never kCostMinimizing
+  virtual Policy policy() const = 0;
+
+  // All trials of the campaign, in order
+  virtual void Schedule(size_t num_command_lines, size_t num_urls, size_t num_tries,
+      std::vector<Cell>* cells) const = 0;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_EXPERIMENT_SCHEDULER_H_
@@ -0,0 +1,446 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "ftrace_controller.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/strings/string_util.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace {
+
+const char kTracefsDir[] = "/sys/kernel/tracing";
+const char kDebugfsTracingDir[] = "/sys/kernel/debug/tracing";
+
+// Drain period: the per-cpu buffer must hold this much of events
+const int kDrainPeriodMillis = 50;
+
+// A pipe holds 16 pages by default
+const size_t kPagesPerSplice = 16;
+
+bool WriteAll(int fd, const void* data, size_t length) {
+  const char* ptr = static_cast<const char*>(data);
+  while (length > 0) {
+    ssize_t written = write(fd, ptr, length);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    ptr += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool WriteUint32(int fd, uint32_t value) {
+  return WriteAll(fd, &value, sizeof(value));
+}
+
+bool WriteSection(int fd, const std::string& name, const std::string& text) {
+  return WriteUint32(fd, name.length()) && WriteAll(fd, name.data(), name.length()) &&
+         WriteUint32(fd, text.length()) && WriteAll(fd, text.data(), text.length());
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+const char FtraceController::kFileMagic[] = "BPFTRACE";
+// static
+const uint32_t FtraceController::kFileVersion = 1;
+
+// Drains the raw ring buffer of one cpu on its own thread
+// splice() moves the pages kernel -> pipe -> file without copying them to user space
+class FtraceController::CpuDrainer : public base::PlatformThread::Delegate {
+ public:
+  CpuDrainer(FtraceController* owner, uint32_t cpu)
+    : owner_(owner),
+      cpu_(cpu),
+      raw_fd_(-1),
+      use_read_(false),
+      failed_(false) {
+    pipe_fds_[0] = pipe_fds_[1] = -1;
+  }
+
+  ~CpuDrainer() {
+    if (raw_fd_ >= 0)
+      close(raw_fd_);
+    if (pipe_fds_[0] >= 0)
+      close(pipe_fds_[0]);
+    if (pipe_fds_[1] >= 0)
+      close(pipe_fds_[1]);
+  }
+
+  bool Open(const base::FilePath& tracing_dir) {
+    base::FilePath raw_pipe = tracing_dir.Append("per_cpu")
+        .Append("cpu" + base::UintToString(cpu_)).Append("trace_pipe_raw");
+    raw_fd_ = open(raw_pipe.value().c_str(), O_RDONLY | O_NONBLOCK);
+    if (raw_fd_ < 0) {
+      PLOG(ERROR) << "Cannot open " << raw_pipe.value();
+      return false;
+    }
+
+    if (pipe(pipe_fds_) < 0) {
+      PLOG(ERROR) << "Cannot create pipe for cpu " << cpu_;
+      return false;
+    }
+    return true;
+  }
+
+  bool StartThread() {
+    return base::PlatformThread::Create(0, this, &thread_handle_);
+  }
+
+  void JoinThread() {
+    base::PlatformThread::Join(thread_handle_);
+  }
+
+  bool failed() const { return failed_; }
+
+  // base::PlatformThread::Delegate
+  void ThreadMain() override {
+    base::PlatformThread::SetName("FtraceDrainer");
+
+    while (!owner_->stop_requested_.load()) {
+      Drain();
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kDrainPeriodMillis));
+    }
+
+    // Tracing is off now, take the remaining full pages then the partial commit page
+    Drain();
+    use_read_ = true;
+    Drain();
+  }
+
+ private:
+  void Drain() {
+    while (!failed_) {
+      ssize_t length = use_read_ ? ReadPage() : SplicePages();
+      if (length <= 0)
+        return;
+    }
+  }
+
+  ssize_t SplicePages() {
+    ssize_t length = splice(raw_fd_, NULL, pipe_fds_[1], NULL,
+        owner_->page_size_ * kPagesPerSplice, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (length < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+        return 0;
+      if (errno == EINVAL) {
+        // Old kernels or filesystems without splice support
+        VLOG(1) << "splice is not supported on cpu " << cpu_ << ", fall back to read";
+        use_read_ = true;
+        return 0;
+      }
+      PLOG(ERROR) << "Cannot splice ring buffer of cpu " << cpu_;
+      failed_ = true;
+      return -1;
+    }
+
+    if (length > 0 && !owner_->AppendPage(cpu_, pipe_fds_[0], length))
+      failed_ = true;
+    return length;
+  }
+
+  ssize_t ReadPage() {
+    if (page_.size() != owner_->page_size_)
+      page_.resize(owner_->page_size_);
+
+    ssize_t length = read(raw_fd_, &page_[0], page_.size());
+    if (length < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+        return 0;
+      PLOG(ERROR) << "Cannot read ring buffer of cpu " << cpu_;
+      failed_ = true;
+      return -1;
+    }
+
+    if (length > 0 && !owner_->AppendPage(cpu_, &page_[0], length))
+      failed_ = true;
+    return length;
+  }
+
+  FtraceController* owner_;
+  uint32_t cpu_;
+  int raw_fd_;
+  int pipe_fds_[2];
+  bool use_read_;
+  bool failed_;
+  std::string page_;
+  base::PlatformThreadHandle thread_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(CpuDrainer);
+};
+
+FtraceController::Config::Config()
+  : buffer_size_kb(0) {
+}
+
+FtraceController::FtraceController(const Config& config)
+  : config_(config),
+    page_size_(getpagesize()),
+    num_cpus_(0),
+    output_fd_(-1),
+    output_error_(false),
+    stop_requested_(false),
+    started_(false) {
+  tracing_dir_ = config_.tracing_dir;
+  if (tracing_dir_.empty()) {
+    tracing_dir_ = base::FilePath(kTracefsDir);
+    if (!base::PathExists(tracing_dir_.Append("tracing_on")))
+      tracing_dir_ = base::FilePath(kDebugfsTracingDir);
+  }
+}
+
+FtraceController::~FtraceController() {
+  if (started_)
+    Stop(NULL);
+}
+
+bool FtraceController::IsAvailable() const {
+  return access(tracing_dir_.Append("tracing_on").value().c_str(), W_OK) == 0;
+}
+
+bool FtraceController::Start(const base::FilePath& output_file) {
+  if (started_) {
+    LOG(ERROR) << "Ftrace has already started";
+    return false;
+  }
+
+  if (!Configure())
+    return false;
+
+  output_fd_ = open(output_file.value().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (output_fd_ < 0) {
+    PLOG(ERROR) << "Cannot open ftrace output at " << output_file.value();
+    return false;
+  }
+  output_error_ = false;
+
+  num_cpus_ = sysconf(_SC_NPROCESSORS_CONF);
+  if (!WriteFileHeader()) {
+    PLOG(ERROR) << "Cannot write ftrace header to " << output_file.value();
+    close(output_fd_);
+    output_fd_ = -1;
+    return false;
+  }
+
+  stop_requested_.store(false);
+  drainers_.clear();
+  for (uint32_t cpu = 0; cpu < num_cpus_; ++cpu) {
+    std::unique_ptr<CpuDrainer> drainer(new CpuDrainer(this, cpu));
+    // Offline cpus on big.LITTLE devices still have a buffer, others may not
+    if (!drainer->Open(tracing_dir_))
+      continue;
+    if (!drainer->StartThread()) {
+      LOG(ERROR) << "Cannot start ftrace drainer thread for cpu " << cpu;
+      continue;
+    }
+    drainers_.push_back(std::move(drainer));
+  }
+
+  // The trace would be empty
+  if (drainers_.empty()) {
+    LOG(ERROR) << "Cannot drain the ftrace buffer of any cpu";
+    close(output_fd_);
+    output_fd_ = -1;
+    return false;
+  }
+
+  started_ = true;
+
+  if (!WriteTracingFile("tracing_on", "1")) {
+    Stop(NULL);
+    return false;
+  }
+
+  return true;
+}
+
+bool FtraceController::Stop(uint64_t* overruns) {
+  if (!started_) {
+    LOG(ERROR) << "Ftrace has not started";
+    return false;
+  }
+
+  bool success = WriteTracingFile("tracing_on", "0");
+
+  stop_requested_.store(true);
+  for (size_t i = 0; i < drainers_.size(); ++i) {
+    drainers_[i]->JoinThread();
+    success = success && !drainers_[i]->failed();
+  }
+  drainers_.clear();
+
+  if (overruns)
+    *overruns = ReadOverruns();
+
+  // Leave no event enabled so that other tools start from a clean state
+  WriteTracingFile("events/enable", "0");
+
+  if (close(output_fd_) < 0) {
+    PLOG(ERROR) << "Cannot close ftrace output";
+    success = false;
+  }
+  output_fd_ = -1;
+  started_ = false;
+
+  return success && !output_error_;
+}
+
+bool FtraceController::WriteTracingFile(const std::string& name,
+    const std::string& value) const {
+  base::FilePath path = tracing_dir_.Append(name);
+  int written = base::WriteFile(path, value.c_str(), value.length());
+  if (written < 0 || static_cast<size_t>(written) != value.length()) {
+    PLOG(ERROR) << "Cannot write '" << value << "' to " << path.value();
+    return false;
+  }
+  return true;
+}
+
+bool FtraceController::Configure() {
+  if (!WriteTracingFile("tracing_on", "0"))
+    return false;
+
+  if (config_.buffer_size_kb > 0 &&
+      !WriteTracingFile("buffer_size_kb", base::UintToString(config_.buffer_size_kb)))
+    return false;
+
+  // Not all kernels have all clocks (e.g., mono appeared in 3.17)
+  if (!config_.clock.empty() && !WriteTracingFile("trace_clock", config_.clock))
+    LOG(WARNING) << "Keep the current trace clock instead of " << config_.clock;
+
+  WriteTracingFile("events/enable", "0");
+  for (size_t i = 0; i < config_.events.size(); ++i) {
+    if (!WriteTracingFile("events/" + config_.events[i] + "/enable", "1"))
+      LOG(WARNING) << "Skip unavailable ftrace event " << config_.events[i];
+  }
+
+  // Truncating the trace file clears the buffers of all cpus
+  return WriteTracingFile("trace", "");
+}
+
+bool FtraceController::WriteFileHeader() {
+  std::vector<std::string> section_names;
+  section_names.push_back("header_page");
+  section_names.push_back("trace_clock");
+  // trace_marker writes are always recorded as ftrace/print
+  section_names.push_back("events/ftrace/print/format");
+  for (size_t i = 0; i < config_.events.size(); ++i)
+    section_names.push_back("events/" + config_.events[i] + "/format");
+
+  std::vector<std::string> texts;
+  for (size_t i = 0; i < section_names.size(); ++i) {
+    std::string text;
+    if (!base::ReadFileToString(tracing_dir_.Append(section_names[i]), &text))
+      LOG(WARNING) << "Cannot read " << section_names[i];
+    texts.push_back(text);
+  }
+
+  if (!WriteAll(output_fd_, kFileMagic, sizeof(kFileMagic) - 1) ||
+      !WriteUint32(output_fd_, kFileVersion) ||
+      !WriteUint32(output_fd_, page_size_) ||
+      !WriteUint32(output_fd_, num_cpus_) ||
+      !WriteUint32(output_fd_, section_names.size()))
+    return false;
+
+  for (size_t i = 0; i < section_names.size(); ++i) {
+    if (!WriteSection(output_fd_, section_names[i], texts[i]))
+      return false;
+  }
+  return true;
+}
+
+uint64_t FtraceController::ReadOverruns() const {
+  uint64_t overruns = 0;
+
+  for (uint32_t cpu = 0; cpu < num_cpus_; ++cpu) {
+    std::string stats;
+    if (!base::ReadFileToString(tracing_dir_.Append("per_cpu")
+            .Append("cpu" + base::UintToString(cpu)).Append("stats"), &stats))
+      continue;
+
+    // Lines of "key: value", e.g., "overrun: 0" and "dropped events: 0"
+    std::vector<std::string> lines =
+        base::SplitString(stats, "\n", base::WhitespaceHandling::TRIM_WHITESPACE,
+                          base::SplitResult::SPLIT_WANT_NONEMPTY);
+    for (size_t i = 0; i < lines.size(); ++i) {
+      std::vector<std::string> key_value =
+          base::SplitString(lines[i], ":", base::WhitespaceHandling::TRIM_WHITESPACE,
+                            base::SplitResult::SPLIT_WANT_NONEMPTY);
+      if (key_value.size() != 2 ||
+          (key_value[0] != "overrun" && key_value[0] != "dropped events"))
+        continue;
+
+      uint64_t value;
+      if (base::StringToUint64(key_value[1], &value))
+        overruns += value;
+    }
+  }
+
+  return overruns;
+}
+
+bool FtraceController::AppendPage(uint32_t cpu, int pipe_read_fd, size_t length) {
+  base::AutoLock lock(output_lock_);
+
+  if (!WriteUint32(output_fd_, cpu) || !WriteUint32(output_fd_, length)) {
+    output_error_ = true;
+    return false;
+  }
+
+  while (length > 0) {
+    ssize_t moved = splice(pipe_read_fd, NULL, output_fd_, NULL, length, SPLICE_F_MOVE);
+    if (moved < 0 && errno == EINTR)
+      continue;
+
+    if (moved < 0 && errno == EINVAL) {
+      // The output filesystem (e.g., FUSE /sdcard) cannot splice, copy instead
+      char buffer[4096];
+      ssize_t num_read = read(pipe_read_fd, buffer, std::min(length, sizeof(buffer)));
+      if (num_read <= 0 || !WriteAll(output_fd_, buffer, num_read)) {
+        output_error_ = true;
+        return false;
+      }
+      moved = num_read;
+    } else if (moved <= 0) {
+      PLOG(ERROR) << "Cannot splice ftrace page of cpu " << cpu << " to file";
+      output_error_ = true;
+      return false;
+    }
+
+    length -= moved;
+  }
+
+  return true;
+}
+
+bool FtraceController::AppendPage(uint32_t cpu, const char* data, size_t length) {
+  base::AutoLock lock(output_lock_);
+
+  if (!WriteUint32(output_fd_, cpu) || !WriteUint32(output_fd_, length) ||
+      !WriteAll(output_fd_, data, length)) {
+    PLOG(ERROR) << "Cannot write ftrace page of cpu " << cpu;
+    output_error_ = true;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,109 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_FTRACE_CONTROLLER_H_
+#define BROWSER_PROFILER_FTRACE_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+
+namespace browser_profiler {
+
+// Controls the kernel tracer in-process through tracefs
+// instead of forking start-ftrace.sh/stop-ftrace.sh through su
+//
+// Start() configures the events, the per-cpu buffer size and the trace clock,
+// then one drain thread per cpu splices pages out of per_cpu/cpuN/trace_pipe_raw
+// into the output file while the page is loading, so nothing is left to copy at Stop()
+//
+// The browser process must be able to write to tracefs
+// (e.g., the campaign setup script makes it world-writable once),
+// IsAvailable() tells whether that is the case
+//
+// Output file layout (host byte order):
+//   char[8]  magic "BPFTRACE"
+//   uint32   version
+//   uint32   page size
+//   uint32   number of cpus
+//   uint32   number of sections
+//   sections: uint32 name length, name, uint32 text length, text
+//     ("header_page", "trace_clock" and "events/<system>/<event>/format")
+//   pages until EOF: uint32 cpu, uint32 length, raw ring buffer page(s)
+class FtraceController {
+ public:
+  static const char kFileMagic[];
+  static const uint32_t kFileVersion;
+
+  struct Config {
+    Config();
+
+    // Empty means auto-detect (/sys/kernel/tracing, then /sys/kernel/debug/tracing)
+    base::FilePath tracing_dir;
+
+    // <system>/<event>, e.g., sched/sched_switch
+    std::vector<std::string> events;
+
+    // Per-cpu buffer size, 0 keeps the current size
+    unsigned buffer_size_kb;
+
+    // Empty keeps the current clock
+    std::string clock;
+  };
+
+  explicit FtraceController(const Config& config);
+  ~FtraceController();
+
+  // Whether tracefs exists and is writable by this process
+  bool IsAvailable() const;
+
+  // Configure tracefs, clear the buffers and start draining to output_file
+  // Return true if tracing is on and the buffer of at least one cpu is drained
+  bool Start(const base::FilePath& output_file);
+
+  // Stop tracing, drain what is left and close the output file
+  // overruns: events lost because the ring buffer was full (summed over cpus)
+  // Return true if the trace is complete
+  bool Stop(uint64_t* overruns);
+
+  bool started() const { return started_; }
+
+ private:
+  class CpuDrainer;
+
+  bool WriteTracingFile(const std::string& name, const std::string& value) const;
+  bool Configure();
+  bool WriteFileHeader();
+  uint64_t ReadOverruns() const;
+
+  // Called by drainers, serializes pages of different cpus in the output file
+  bool AppendPage(uint32_t cpu, int pipe_read_fd, size_t length);
+  bool AppendPage(uint32_t cpu, const char* data, size_t length);
+
+  Config config_;
+  base::FilePath tracing_dir_;
+  size_t page_size_;
+  uint32_t num_cpus_;
+
+  int output_fd_;
+  base::Lock output_lock_;
+  bool output_error_;
+
+  std::atomic<bool> stop_requested_;
+  std::vector<std::unique_ptr<CpuDrainer>> drainers_;
+
+  bool started_;
+
+  DISALLOW_COPY_AND_ASSIGN(FtraceController);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_FTRACE_CONTROLLER_H_
@@ -0,0 +1,482 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "ftrace_decoder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Same layout as FtraceController, which depends on Chromium's base
+const char kFileMagic[] = "BPFTRACE";
+const uint32_t kFileVersion = 1;
+
+// Ring buffer event header: 5 bits of type_len, 27 bits of time delta
+const uint32_t kTypeLenMask = 0x1f;
+const uint32_t kTimeDeltaShift = 5;
+const uint32_t kTypePadding = 29;
+const uint32_t kTypeTimeExtend = 30;
+const uint32_t kTypeTimeStamp = 31;
+const uint32_t kTimeExtendShift = 27;
+
+// Flags in the high bits of the page commit
+const uint64_t kMissedEvents = 1u << 31;
+const uint64_t kMissedFlags = kMissedEvents | 1u << 30;
+
+struct KindName {
+  const char* name;
+  browser_profiler::FtraceDecoder::EventKind kind;
+};
+
+const KindName kKindNames[] = {
+  { "sched/sched_switch", browser_profiler::FtraceDecoder::kSchedSwitch },
+  { "power/cpu_frequency", browser_profiler::FtraceDecoder::kCpuFrequency },
+  { "power/cpu_idle", browser_profiler::FtraceDecoder::kCpuIdle },
+  // trace_marker writes
+  { "ftrace/print", browser_profiler::FtraceDecoder::kTraceMarker },
+};
+
+bool ReadUint32(const char** cursor, const char* end, uint32_t* value) {
+  if (end - *cursor < static_cast<ptrdiff_t>(sizeof(*value)))
+    return false;
+  memcpy(value, *cursor, sizeof(*value));
+  *cursor += sizeof(*value);
+  return true;
+}
+
+bool ReadText(const char** cursor, const char* end, std::string* text) {
+  uint32_t length;
+  if (!ReadUint32(cursor, end, &length) || static_cast<uint32_t>(end - *cursor) < length)
+    return false;
+  text->assign(*cursor, length);
+  *cursor += length;
+  return true;
+}
+
+// Value of "<key>:<value>;" in a field line
+bool FindAttribute(const std::string& line, const char* key, std::string* value) {
+  size_t start = line.find(key);
+  if (start == std::string::npos)
+    return false;
+  start += strlen(key);
+  size_t end = line.find(';', start);
+  if (end == std::string::npos)
+    return false;
+  *value = line.substr(start, end - start);
+  return true;
+}
+
+// Clamped to the range of the timestamps
+uint64_t ToNanoseconds(double seconds) {
+  if (!(seconds > 0))
+    return 0;
+  if (seconds * 1e9 >= 18e18)
+    return UINT64_MAX;
+  return static_cast<uint64_t>(seconds * 1e9);
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+const uint32_t FtraceDecoder::kNoText = 0xffffffff;
+
+FtraceDecoder::CpuEvents::CpuEvents()
+  : num_pages_with_lost_events(0) {
+}
+
+FtraceDecoder::FtraceDecoder()
+  : mapped_data_(nullptr),
+    mapped_length_(0),
+    page_size_(0),
+    page_data_offset_(0) {
+}
+
+FtraceDecoder::~FtraceDecoder() {
+  Close();
+}
+
+bool FtraceDecoder::Open(const std::string& path, std::string* error) {
+  Close();
+  cpus_.clear();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    *error = "empty ftrace artifact " + path;
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    *error = "cannot map " + path + ": " + strerror(errno);
+    return false;
+  }
+  mapped_data_ = static_cast<const char*>(data);
+  mapped_length_ = st.st_size;
+
+  const char* cursor = mapped_data_;
+  const char* end = mapped_data_ + mapped_length_;
+  const size_t magic_size = sizeof(kFileMagic) - 1;
+  uint32_t version;
+  uint32_t num_cpus;
+  uint32_t num_sections;
+  if (mapped_length_ < magic_size || memcmp(cursor, kFileMagic, magic_size) != 0) {
+    *error = "not an ftrace artifact: " + path;
+    Close();
+    return false;
+  }
+  cursor += magic_size;
+  if (!ReadUint32(&cursor, end, &version) || version != kFileVersion ||
+      !ReadUint32(&cursor, end, &page_size_) || !ReadUint32(&cursor, end, &num_cpus) ||
+      !ReadUint32(&cursor, end, &num_sections) || page_size_ == 0) {
+    *error = "ftrace artifact of another version: " + path;
+    Close();
+    return false;
+  }
+
+  // Defaults of a 64-bit kernel
+  page_commit_.offset = 8;
+  page_commit_.size = 8;
+  page_data_offset_ = 16;
+
+  for (uint32_t i = 0; i < num_sections; ++i) {
+    std::string name;
+    std::string text;
+    if (!ReadText(&cursor, end, &name) || !ReadText(&cursor, end, &text)) {
+      *error = "truncated header of " + path;
+      Close();
+      return false;
+    }
+
+    if (name == "header_page") {
+      std::map<std::string, Field> fields;
+      ParseFields(text, &fields);
+      if (fields.count("commit"))
+        page_commit_ = fields["commit"];
+      if (fields.count("data"))
+        page_data_offset_ = fields["data"].offset;
+    } else if (name == "trace_clock") {
+      // The current clock is in brackets, e.g., "local global [mono] ..."
+      size_t open = text.find('[');
+      size_t close = text.find(']', open);
+      if (open != std::string::npos && close != std::string::npos)
+        trace_clock_ = text.substr(open + 1, close - open - 1);
+    } else if (!text.empty()) {
+      ParseEventFormat(name, text);
+    }
+  }
+
+  formats_by_id_.assign(formats_.empty() ? 0 : formats_.rbegin()->first + 1, nullptr);
+  for (std::map<uint16_t, EventFormat>::const_iterator it = formats_.begin();
+       it != formats_.end(); ++it) {
+    formats_by_id_[it->first] = &it->second;
+  }
+
+  // Records of one or more pages, a torn record at the end is dropped
+  pages_.assign(num_cpus, std::vector<Page>());
+  for (;;) {
+    uint32_t cpu;
+    uint32_t length;
+    if (!ReadUint32(&cursor, end, &cpu) || !ReadUint32(&cursor, end, &length) ||
+        static_cast<uint32_t>(end - cursor) < length) {
+      break;
+    }
+    if (cpu >= num_cpus) {
+      *error = "page of an unknown cpu in " + path;
+      Close();
+      return false;
+    }
+    for (uint32_t offset = 0; offset < length; offset += page_size_) {
+      Page page = { cursor + offset, std::min<size_t>(page_size_, length - offset) };
+      pages_[cpu].push_back(page);
+    }
+    cursor += length;
+  }
+  return true;
+}
+
+bool FtraceDecoder::Decode(std::string* error) {
+  if (!mapped_data_) {
+    *error = "no ftrace artifact";
+    return false;
+  }
+
+  cpus_.assign(pages_.size(), CpuEvents());
+  std::vector<std::thread> threads;
+  for (size_t cpu = 0; cpu < pages_.size(); ++cpu) {
+    if (!pages_[cpu].empty())
+      threads.push_back(std::thread(&FtraceDecoder::DecodeCpu, this, cpu));
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  return true;
+}
+
+void FtraceDecoder::Close() {
+  if (mapped_data_)
+    munmap(const_cast<char*>(mapped_data_), mapped_length_);
+  mapped_data_ = nullptr;
+  mapped_length_ = 0;
+  trace_clock_.clear();
+  formats_.clear();
+  formats_by_id_.clear();
+  pages_.clear();
+}
+
+std::string FtraceDecoder::EventName(uint16_t event_id) const {
+  return event_id < formats_by_id_.size() && formats_by_id_[event_id] ?
+      formats_by_id_[event_id]->name : std::string();
+}
+
+std::pair<size_t, size_t> FtraceDecoder::Window(size_t cpu, double start_seconds,
+    double end_seconds) const {
+  const std::vector<uint64_t>& timestamps = cpus_[cpu].timestamps;
+  uint64_t start = ToNanoseconds(start_seconds);
+  uint64_t end = ToNanoseconds(end_seconds);
+  size_t first = std::lower_bound(timestamps.begin(), timestamps.end(), start) -
+      timestamps.begin();
+  size_t last = std::lower_bound(timestamps.begin() + first, timestamps.end(), end) -
+      timestamps.begin();
+  return std::make_pair(first, last);
+}
+
+// Lines like "\tfield:pid_t prev_pid;\toffset:24;\tsize:4;\tsigned:1;"
+// static
+bool FtraceDecoder::ParseFields(const std::string& text, std::map<std::string, Field>* fields) {
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::string declaration;
+    std::string offset;
+    std::string size;
+    if (!FindAttribute(line, "field:", &declaration) ||
+        !FindAttribute(line, "offset:", &offset) || !FindAttribute(line, "size:", &size)) {
+      continue;
+    }
+
+    // The name is the last word of the declaration, without its array bounds
+    size_t bracket = declaration.find('[');
+    std::string name = declaration.substr(0, bracket);
+    name.erase(name.find_last_not_of(' ') + 1);
+    name = name.substr(name.find_last_of(' ') + 1);
+
+    Field field;
+    field.offset = strtoul(offset.c_str(), nullptr, 10);
+    field.size = strtoul(size.c_str(), nullptr, 10);
+    std::string is_signed;
+    field.is_signed = FindAttribute(line, "signed:", &is_signed) && is_signed == "1";
+    field.is_dynamic = declaration.find("__data_loc") != std::string::npos;
+    // A char array of size 0 runs to the end of the record, e.g., ftrace/print buf
+    if (bracket != std::string::npos && declaration.compare(bracket, 2, "[]") == 0 &&
+        !field.is_dynamic) {
+      field.size = 0;
+    }
+    (*fields)[name] = field;
+  }
+  return !fields->empty();
+}
+
+bool FtraceDecoder::ParseEventFormat(const std::string& section_name, const std::string& text) {
+  // events/<system>/<event>/format
+  const char kPrefix[] = "events/";
+  const char kSuffix[] = "/format";
+  if (section_name.compare(0, sizeof(kPrefix) - 1, kPrefix) != 0 ||
+      section_name.size() < sizeof(kPrefix) + sizeof(kSuffix)) {
+    return false;
+  }
+
+  size_t id_start = text.find("ID:");
+  if (id_start == std::string::npos)
+    return false;
+  unsigned long event_id = strtoul(text.c_str() + id_start + 3, nullptr, 10);
+  if (event_id > 0xffff)
+    return false;
+
+  std::map<std::string, Field> fields;
+  if (!ParseFields(text, &fields))
+    return false;
+
+  EventFormat& format = formats_[event_id];
+  format.name = section_name.substr(sizeof(kPrefix) - 1,
+      section_name.size() - (sizeof(kPrefix) - 1) - (sizeof(kSuffix) - 1));
+  format.pid = fields["common_pid"];
+  for (size_t i = 0; i < sizeof(kKindNames) / sizeof(kKindNames[0]); ++i) {
+    if (format.name == kKindNames[i].name)
+      format.kind = kKindNames[i].kind;
+  }
+
+  switch (format.kind) {
+    case kSchedSwitch:
+      format.fields[0] = fields["prev_pid"];
+      format.fields[1] = fields["next_pid"];
+      format.fields[2] = fields["prev_state"];
+      format.text = fields["next_comm"];
+      break;
+    case kCpuFrequency:
+    case kCpuIdle:
+      format.fields[0] = fields["cpu_id"];
+      format.fields[1] = fields["state"];
+      // The idle exit state is (u32)-1
+      format.fields[1].is_signed = format.kind == kCpuIdle;
+      break;
+    case kTraceMarker:
+      format.text = fields["buf"];
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+void FtraceDecoder::DecodeCpu(size_t cpu) {
+  CpuEvents* events = &cpus_[cpu];
+  std::unordered_map<std::string, uint32_t> text_ids;
+
+  for (size_t i = 0; i < pages_[cpu].size(); ++i) {
+    const Page& page = pages_[cpu][i];
+    if (page.length < page_data_offset_ || page.length < page_commit_.offset + 4)
+      continue;
+
+    uint64_t timestamp;
+    memcpy(&timestamp, page.data, sizeof(timestamp));
+    uint64_t commit = 0;
+    memcpy(&commit, page.data + page_commit_.offset, std::min<uint32_t>(page_commit_.size, 8));
+    if (commit & kMissedEvents)
+      ++events->num_pages_with_lost_events;
+    size_t length = std::min<uint64_t>(commit & ~kMissedFlags,
+        page.length - page_data_offset_);
+
+    const char* cursor = page.data + page_data_offset_;
+    const char* end = cursor + length;
+    while (end - cursor >= 4) {
+      uint32_t header;
+      memcpy(&header, cursor, sizeof(header));
+      cursor += sizeof(header);
+      uint32_t type_len = header & kTypeLenMask;
+      uint32_t delta = header >> kTimeDeltaShift;
+
+      uint32_t record_length;
+      if (type_len == kTypePadding) {
+        // The rest of the page, or a discarded event
+        if (delta == 0 || !ReadUint32(&cursor, end, &record_length) ||
+            static_cast<uint32_t>(end - cursor) < record_length) {
+          break;
+        }
+        cursor += record_length;
+        continue;
+      } else if (type_len == kTypeTimeExtend || type_len == kTypeTimeStamp) {
+        uint32_t extend;
+        if (!ReadUint32(&cursor, end, &extend))
+          break;
+        uint64_t value = (static_cast<uint64_t>(extend) << kTimeExtendShift) + delta;
+        timestamp = type_len == kTypeTimeStamp ? value : timestamp + value;
+        continue;
+      } else if (type_len == 0) {
+        // The length includes its own word
+        if (!ReadUint32(&cursor, end, &record_length) || record_length < 4)
+          break;
+        record_length = (record_length - 4 + 3) & ~3u;
+      } else {
+        record_length = type_len * 4;
+      }
+
+      timestamp += delta;
+      if (static_cast<uint32_t>(end - cursor) < record_length)
+        break;
+      DecodeRecord(cursor, record_length, timestamp, &text_ids, events);
+      cursor += record_length;
+    }
+  }
+}
+
+void FtraceDecoder::DecodeRecord(const char* record, size_t length, uint64_t timestamp,
+    std::unordered_map<std::string, uint32_t>* text_ids, CpuEvents* events) const {
+  if (length < sizeof(uint16_t))
+    return;
+
+  uint16_t event_id;
+  memcpy(&event_id, record, sizeof(event_id));
+  const EventFormat* format = event_id < formats_by_id_.size() ? formats_by_id_[event_id] :
+      nullptr;
+
+  EventKind kind = format ? format->kind : kOtherEvent;
+  events->timestamps.push_back(timestamp);
+  events->event_ids.push_back(event_id);
+  events->kinds.push_back(kind);
+  if (!format) {
+    events->pids.push_back(0);
+    events->field0.push_back(0);
+    events->field1.push_back(0);
+    events->field2.push_back(0);
+    events->texts.push_back(kNoText);
+    return;
+  }
+
+  events->pids.push_back(ReadInteger(record, length, format->pid));
+  events->field0.push_back(ReadInteger(record, length, format->fields[0]));
+  events->field1.push_back(ReadInteger(record, length, format->fields[1]));
+  events->field2.push_back(ReadInteger(record, length, format->fields[2]));
+
+  if (kind != kSchedSwitch && kind != kTraceMarker) {
+    events->texts.push_back(kNoText);
+    return;
+  }
+
+  // Up to a NUL, within the field
+  const Field& field = format->text;
+  size_t start = field.offset;
+  size_t size = field.size == 0 ? length - std::min<size_t>(start, length) : field.size;
+  if (field.is_dynamic && field.offset + 4 <= length) {
+    uint32_t location;
+    memcpy(&location, record + field.offset, sizeof(location));
+    start = location & 0xffff;
+    size = location >> 16;
+  }
+  std::string text;
+  if (start < length) {
+    size = std::min(size, length - start);
+    text.assign(record + start, strnlen(record + start, size));
+  }
+  // trace_marker adds a new line
+  if (kind == kTraceMarker && !text.empty() && text[text.size() - 1] == '\n')
+    text.erase(text.size() - 1);
+
+  std::unordered_map<std::string, uint32_t>::const_iterator it = text_ids->find(text);
+  if (it == text_ids->end()) {
+    it = text_ids->insert(std::make_pair(text, events->strings.size())).first;
+    events->strings.push_back(text);
+  }
+  events->texts.push_back(it->second);
+}
+
+// static
+int64_t FtraceDecoder::ReadInteger(const char* record, size_t length, const Field& field) {
+  if (field.size == 0 || field.size > 8 || field.offset + field.size > length)
+    return 0;
+
+  uint64_t value = 0;
+  memcpy(&value, record + field.offset, field.size);
+  if (field.is_signed && field.size < 8 && (value >> (field.size * 8 - 1)) & 1)
+    value |= ~0ull << (field.size * 8);
+  return static_cast<int64_t>(value);
+}
+
+}  // namespace browser_profiler
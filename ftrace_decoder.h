@@ -0,0 +1,152 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_FTRACE_DECODER_H_
+#define BROWSER_PROFILER_FTRACE_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace browser_profiler {
+
+// Decodes the ftrace artifact of an experiment (<id>.ftrace.dat, see FtraceController)
+// natively: the raw ring buffer pages of each cpu are decoded in parallel, one thread
+// per cpu, into columns
+// Only depends on POSIX so that tools can use it, see tools/ftrace_decode
+//
+// Fields are located through the event formats saved in the artifact, so the decoder
+// follows the kernel which recorded it. Decoded kinds:
+//   sched_switch: field0 prev pid, field1 next pid, field2 prev state, text next comm
+//   cpu_frequency: field0 cpu, field1 frequency (kHz)
+//   cpu_idle: field0 cpu, field1 state (-1 when leaving idle)
+//   trace_marker (ftrace/print): text, e.g., Chrome's "trace_event_clock_sync: ..."
+// Other events only have the common columns
+class FtraceDecoder {
+ public:
+  enum EventKind {
+    kOtherEvent,
+    kSchedSwitch,
+    kCpuFrequency,
+    kCpuIdle,
+    kTraceMarker,
+    kNumEventKinds,
+  };
+
+  static const uint32_t kNoText;
+
+  // The events of a cpu in time order, one column per attribute
+  struct CpuEvents {
+    CpuEvents();
+
+    size_t size() const { return timestamps.size(); }
+
+    // Trace clock, in nanoseconds
+    std::vector<uint64_t> timestamps;
+    std::vector<uint16_t> event_ids;
+    std::vector<uint8_t> kinds;
+    std::vector<int32_t> pids;
+    std::vector<int64_t> field0;
+    std::vector<int64_t> field1;
+    std::vector<int64_t> field2;
+    // Into strings, kNoText if the kind has no text
+    std::vector<uint32_t> texts;
+    std::vector<std::string> strings;
+
+    // Pages where the kernel dropped events (ring buffer full)
+    size_t num_pages_with_lost_events;
+  };
+
+  FtraceDecoder();
+  ~FtraceDecoder();
+
+  // Map the artifact, read its header and index its pages
+  // Return false with the reason in error
+  bool Open(const std::string& path, std::string* error);
+
+  // Decode the pages of all cpus, in parallel
+  bool Decode(std::string* error);
+
+  // Unmap the artifact, the decoded events are kept
+  void Close();
+
+  // The clock of the timestamps, e.g., mono for CLOCK_MONOTONIC (--ftrace-clock=mono)
+  const std::string& trace_clock() const { return trace_clock_; }
+
+  const std::vector<CpuEvents>& cpus() const { return cpus_; }
+
+  // Name (<system>/<event>) of an event id, empty if its format is not in the artifact
+  std::string EventName(uint16_t event_id) const;
+
+  // Indexes [first, last) of the events of cpu in [start, end) seconds of the trace
+  // clock, e.g., the load window of the experiment (Load Start Time, Load End Time) when
+  // the trace clock is mono
+  std::pair<size_t, size_t> Window(size_t cpu, double start_seconds, double end_seconds) const;
+
+ private:
+  struct Field {
+    Field() : offset(0), size(0), is_signed(false), is_dynamic(false) {}
+
+    uint32_t offset;
+    // 0 for a string up to the end of the record
+    uint32_t size;
+    bool is_signed;
+    // __data_loc: a uint32 of the offset (low 16 bits) and length of the value
+    bool is_dynamic;
+  };
+
+  // Fields of an event, resolved by kind when the artifact is opened
+  struct EventFormat {
+    EventFormat() : kind(kOtherEvent) {}
+
+    std::string name;
+    EventKind kind;
+    Field pid;
+    Field fields[3];
+    Field text;
+  };
+
+  struct Page {
+    const char* data;
+    size_t length;
+  };
+
+  // Fields of the format text of an event or of the page header
+  static bool ParseFields(const std::string& text, std::map<std::string, Field>* fields);
+  bool ParseEventFormat(const std::string& section_name, const std::string& text);
+
+  void DecodeCpu(size_t cpu);
+  void DecodeRecord(const char* record, size_t length, uint64_t timestamp,
+      std::unordered_map<std::string, uint32_t>* text_ids, CpuEvents* events) const;
+  // 0 if the field is not in the record
+  static int64_t ReadInteger(const char* record, size_t length, const Field& field);
+
+  const char* mapped_data_;
+  size_t mapped_length_;
+
+  std::string trace_clock_;
+  uint32_t page_size_;
+
+  // Ring buffer page header
+  Field page_commit_;
+  uint32_t page_data_offset_;
+
+  std::map<uint16_t, EventFormat> formats_;
+  // By id, null if the format is not in the artifact
+  std::vector<const EventFormat*> formats_by_id_;
+  std::vector<std::vector<Page>> pages_;
+  std::vector<CpuEvents> cpus_;
+
+  // Not copyable
+  FtraceDecoder(const FtraceDecoder&);
+  void operator=(const FtraceDecoder&);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_FTRACE_DECODER_H_
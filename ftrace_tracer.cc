@@ -0,0 +1,120 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "ftrace_tracer.h"
+
+#include "browser_profiler_impl_constants.h"
+#include "browser_profiler_impl_switches.h"
+#include "experiment_result.h"
+#include "root_command_runner.h"
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+
+namespace browser_profiler {
+
+FtraceTracer::FtraceTracer(const base::CommandLine& command_line)
+  : overruns_metric_(ExperimentResult::kInvalidMetric) {
+  config_.clock = "mono";
+
+  config_.events =
+      base::SplitString(command_line.GetSwitchValueASCII(switches::kDoFtrace), ",",
+                        base::WhitespaceHandling::TRIM_WHITESPACE,
+                        base::SplitResult::SPLIT_WANT_NONEMPTY);
+  if (config_.events.empty()) {
+    const char* default_ftrace_events[] = {
+      "sched/sched_switch", "sched/sched_wakeup", "power/cpu_frequency", "power/cpu_idle"
+    };
+    config_.events.assign(default_ftrace_events,
+        default_ftrace_events + arraysize(default_ftrace_events));
+  }
+
+  std::string buffer_str = command_line.GetSwitchValueASCII(switches::kFtraceBufferSizeKb);
+  if (!buffer_str.empty()) {
+    if (!base::StringToUint(buffer_str, &config_.buffer_size_kb)) {
+      LOG(ERROR) << "Cannot parse switch " << switches::kFtraceBufferSizeKb << ": " << buffer_str;
+    }
+  }
+
+  if (command_line.HasSwitch(switches::kFtraceClock))
+    config_.clock = command_line.GetSwitchValueASCII(switches::kFtraceClock);
+}
+
+FtraceTracer::~FtraceTracer() {
+}
+
+std::vector<std::string> FtraceTracer::output_artifacts() const {
+  // The scripts name their output themselves
+  std::vector<std::string> artifacts;
+  if (controller_)
+    artifacts.push_back(base_name_);
+  return artifacts;
+}
+
+void FtraceTracer::RegisterMetrics(ExperimentResult* experiment_result) {
+  overruns_metric_ = experiment_result->RegisterMetric(
+      "Ftrace Overruns", ExperimentResult::kUint64Metric);
+}
+
+bool FtraceTracer::Initialize(const TracerContext& context) {
+  base_name_ = context.constants->kFtraceBaseName;
+  controller_.reset(new FtraceController(config_));
+
+  // Fall back to the ftrace scripts run as root
+  if (!controller_->IsAvailable()) {
+    LOG(WARNING) << "tracefs is not writable, use "
+        << context.constants->kStartFtraceScript.value();
+    controller_.reset();
+  }
+  return true;
+}
+
+void FtraceTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  if (controller_) {
+    if (!controller_->Start(context.OutputFile(base_name_)))
+      context.experiment_result->MarkFailed("ftrace did not start");
+  } else {
+    context.root_runner->RunBatch(StartRootCommands(context));
+  }
+  done();
+}
+
+void FtraceTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  if (!controller_) {
+    context.root_runner->RunBatch(StopRootCommands(context));
+    done();
+    return;
+  }
+
+  if (controller_->started()) {
+    uint64_t overruns = 0;
+    if (!controller_->Stop(&overruns)) {
+      // The trace is truncated and the overruns are unknown
+      context.experiment_result->MarkFailed("ftrace is incomplete");
+      done();
+      return;
+    }
+    if (overruns > 0)
+      LOG(WARNING) << "Ftrace lost " << overruns << " events, consider --"
+          << switches::kFtraceBufferSizeKb;
+
+    context.experiment_result->SetUint64(overruns_metric_, overruns);
+  }
+  done();
+}
+
+std::vector<std::string> FtraceTracer::StartRootCommands(const TracerContext& context) const {
+  if (controller_)
+    return std::vector<std::string>();
+  return std::vector<std::string>(1, context.constants->kStartFtraceScript.value());
+}
+
+std::vector<std::string> FtraceTracer::StopRootCommands(const TracerContext& context) const {
+  if (controller_)
+    return std::vector<std::string>();
+  return std::vector<std::string>(1,
+      context.constants->kStopFtraceScript.value() + " " + context.experiment_id);
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,53 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_FTRACE_TRACER_H_
+#define BROWSER_PROFILER_FTRACE_TRACER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "experiment_result.h"
+#include "ftrace_controller.h"
+#include "tracer.h"
+
+#include "base/command_line.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Kernel tracing, in-process through FtraceController if tracefs is writable,
+// otherwise through the start/stop ftrace scripts run as root
+class FtraceTracer : public Tracer {
+ public:
+  // Reads --do-ftrace=<events>, --ftrace-buffer-size-kb and --ftrace-clock
+  explicit FtraceTracer(const base::CommandLine& command_line);
+  ~FtraceTracer() override;
+
+  // Tracer
+  std::string name() const override { return "ftrace"; }
+  StartStage start_stage() const override { return kFtraceStage; }
+  StopStage stop_stage() const override { return kFtraceStopStage; }
+  Overhead expected_overhead() const override { return kLowOverhead; }
+  std::vector<std::string> output_artifacts() const override;
+  void RegisterMetrics(ExperimentResult* experiment_result) override;
+  bool Initialize(const TracerContext& context) override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  // The ftrace scripts when tracefs is not writable
+  std::vector<std::string> StartRootCommands(const TracerContext& context) const override;
+  std::vector<std::string> StopRootCommands(const TracerContext& context) const override;
+
+ private:
+  FtraceController::Config config_;
+  std::unique_ptr<FtraceController> controller_;
+  std::string base_name_;
+  ExperimentResult::Metric overruns_metric_;
+
+  DISALLOW_COPY_AND_ASSIGN(FtraceTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_FTRACE_TRACER_H_
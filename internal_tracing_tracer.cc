@@ -0,0 +1,72 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "internal_tracing_tracer.h"
+
+#include "browser_profiler_impl_constants.h"
+#include "public/browser_profiler.h"
+
+#include "base/logging.h"
+
+namespace browser_profiler {
+
+InternalTracingTracer::InternalTracingTracer(const std::string& tracing_categories)
+  : tracing_categories_(tracing_categories),
+    started_(false) {
+}
+
+InternalTracingTracer::~InternalTracingTracer() {
+}
+
+std::vector<std::string> InternalTracingTracer::output_artifacts() const {
+  return std::vector<std::string>(1, base_name_);
+}
+
+bool InternalTracingTracer::Initialize(const TracerContext& context) {
+  base_name_ = context.constants->kItraceBaseName;
+  return true;
+}
+
+void InternalTracingTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  VLOG(0) << "Start internal tracing";
+
+  started_ = false;
+  internal_tracing_controller_ = context.client->GetInternalTracingControllerInstance();
+  if (internal_tracing_controller_ == nullptr)
+    LOG(FATAL) << "Fail to initialize internal tracing controller";
+
+  if (internal_tracing_controller_ == nullptr
+      || !internal_tracing_controller_->StartTracing(context.browser_profiler,
+        tracing_categories_, "record-as-much-as-possible")) {
+    LOG(ERROR) << "Failed to start ChromeTracing";
+  } else {
+    started_ = true;
+  }
+  done();
+}
+
+void InternalTracingTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  if (!started_ || internal_tracing_controller_ == nullptr) {
+    done();
+    return;
+  }
+
+  VLOG(0) << "Stop ChromeTracing";
+  started_ = false;
+
+  // if ETracingAsync is OK, OnInternalTracingStopped will be called after done
+  stopped_callback_ = done;
+  if (!internal_tracing_controller_->StopTracing(context.OutputFile(base_name_)))
+    OnInternalTracingStopped(); // fallback to normal flow if internal tracing not supported
+}
+
+void InternalTracingTracer::OnInternalTracingStopped() {
+  if (!stopped_callback_)
+    return;
+
+  DoneCallback done = stopped_callback_;
+  stopped_callback_ = DoneCallback();
+  done();
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,53 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_INTERNAL_TRACING_TRACER_H_
+#define BROWSER_PROFILER_INTERNAL_TRACING_TRACER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "public/internal_tracing_controller.h"
+#include "tracer.h"
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Browser's internal tracing (e.g., about:tracing in Chrome) through the client
+// We call internal tracing and ChromeTracing interchangebly
+class InternalTracingTracer : public Tracer {
+ public:
+  explicit InternalTracingTracer(const std::string& tracing_categories);
+  ~InternalTracingTracer() override;
+
+  // Tracer
+  std::string name() const override { return "itrace"; }
+  StartStage start_stage() const override { return kFtraceStage; }
+  StopStage stop_stage() const override { return kFtraceStopStage; }
+  Overhead expected_overhead() const override { return kHighOverhead; }
+  std::vector<std::string> output_artifacts() const override;
+  bool runs_on_calling_thread() const override { return true; }
+  bool stops_asynchronously() const override { return true; }
+  bool Initialize(const TracerContext& context) override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  void OnInternalTracingStopped() override;
+
+ private:
+  std::string tracing_categories_;
+  std::string base_name_;
+
+  std::shared_ptr<InternalTracingController> internal_tracing_controller_;
+  bool started_;
+
+  // Pending Stop()
+  DoneCallback stopped_callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(InternalTracingTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_INTERNAL_TRACING_TRACER_H_
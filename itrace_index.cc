@@ -0,0 +1,509 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "itrace_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// First '"' or '\\' in [p, end), end if there is none
+const char* FindQuoteOrBackslash(const char* p, const char* end) {
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+        _mm_cmpeq_epi8(chunk, backslash)));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  for (; end - p >= 16; p += 16) {
+    uint8x16_t chunk = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    uint8x16_t matches = vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash));
+    // No movemask on NEON: narrow to 4 bits per byte
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+        vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (mask != 0)
+      return p + (__builtin_ctzll(mask) >> 2);
+  }
+#endif
+  for (; p < end; ++p) {
+    if (*p == '"' || *p == '\\')
+      return p;
+  }
+  return end;
+}
+
+void AppendUtf8(uint32_t code_point, std::string* output) {
+  if (code_point < 0x80) {
+    output->push_back(code_point);
+  } else if (code_point < 0x800) {
+    output->push_back(0xc0 | (code_point >> 6));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    output->push_back(0xe0 | (code_point >> 12));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else {
+    output->push_back(0xf0 | (code_point >> 18));
+    output->push_back(0x80 | ((code_point >> 12) & 0x3f));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  }
+}
+
+bool ParseHex4(const char* p, uint32_t* value) {
+  *value = 0;
+  for (int i = 0; i < 4; ++i) {
+    char c = p[i];
+    int digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      return false;
+    *value = *value << 4 | digit;
+  }
+  return true;
+}
+
+// Slices by start time, an enclosing slice before the ones it contains
+bool SliceBefore(const browser_profiler::ItraceIndex::Slice& a,
+    const browser_profiler::ItraceIndex::Slice& b) {
+  return a.ts != b.ts ? a.ts < b.ts : a.dur > b.dur;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// Tokens of the trace, read in place
+class ItraceIndex::Scanner {
+ public:
+  Scanner(const char* data, size_t length)
+    : begin_(data), p_(data), end_(data + length) {}
+
+  bool AtEnd() {
+    SkipWhitespace();
+    return p_ == end_;
+  }
+
+  // Next character after whitespace, '\0' at the end
+  char Peek() {
+    SkipWhitespace();
+    return p_ < end_ ? *p_ : '\0';
+  }
+
+  bool Consume(char c) {
+    if (Peek() != c)
+      return false;
+    ++p_;
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    if (!Consume('"'))
+      return Fail("expected a string");
+
+    value->clear();
+    for (;;) {
+      const char* stop = FindQuoteOrBackslash(p_, end_);
+      value->append(p_, stop);
+      p_ = stop;
+      if (p_ == end_)
+        return Fail("unterminated string");
+      if (*p_++ == '"')
+        return true;
+      if (!ReadEscape(value))
+        return false;
+    }
+  }
+
+  // A number, or a string of a number
+  bool ReadNumber(double* value) {
+    if (Peek() == '"') {
+      std::string text;
+      if (!ReadString(&text))
+        return false;
+      char* number_end;
+      *value = strtod(text.c_str(), &number_end);
+      return (number_end != text.c_str() && *number_end == '\0') || Fail("expected a number");
+    }
+
+    // The trace is not terminated: copy the number
+    char buffer[64];
+    size_t length = 0;
+    while (p_ < end_ && length < sizeof(buffer) - 1 &&
+           ((*p_ >= '0' && *p_ <= '9') || *p_ == '-' || *p_ == '+' || *p_ == '.' ||
+            *p_ == 'e' || *p_ == 'E')) {
+      buffer[length++] = *p_++;
+    }
+    buffer[length] = '\0';
+    char* number_end;
+    *value = strtod(buffer, &number_end);
+    return (length > 0 && number_end == buffer + length) || Fail("expected a number");
+  }
+
+  bool SkipValue() {
+    char c = Peek();
+    if (c == '"')
+      return SkipString();
+
+    if (c == '{' || c == '[') {
+      int depth = 0;
+      while (p_ < end_) {
+        c = *p_;
+        if (c == '"') {
+          if (!SkipString())
+            return false;
+          continue;
+        }
+        ++p_;
+        if (c == '{' || c == '[')
+          ++depth;
+        else if ((c == '}' || c == ']') && --depth == 0)
+          return true;
+      }
+      return Fail("unterminated object or array");
+    }
+
+    // Number, true, false or null
+    const char* start = p_;
+    while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && *p_ != ' ' &&
+           *p_ != '\n' && *p_ != '\r' && *p_ != '\t') {
+      ++p_;
+    }
+    return p_ != start || Fail("expected a value");
+  }
+
+  bool Fail(const char* reason) {
+    if (error_.empty()) {
+      char offset[32];
+      snprintf(offset, sizeof(offset), "%zu", static_cast<size_t>(p_ - begin_));
+      error_ = std::string(reason) + " at offset " + offset;
+    }
+    return false;
+  }
+
+  const std::string& error() const { return error_; }
+
+ private:
+  void SkipWhitespace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+      ++p_;
+  }
+
+  bool SkipString() {
+    ++p_;
+    for (;;) {
+      p_ = FindQuoteOrBackslash(p_, end_);
+      if (p_ == end_)
+        return Fail("unterminated string");
+      if (*p_++ == '"')
+        return true;
+      // Whatever is escaped
+      if (p_ == end_)
+        return Fail("unterminated string");
+      ++p_;
+    }
+  }
+
+  // After a backslash
+  bool ReadEscape(std::string* value) {
+    if (p_ == end_)
+      return Fail("unterminated string");
+
+    char c = *p_++;
+    switch (c) {
+      case '"': case '\\': case '/': value->push_back(c); return true;
+      case 'b': value->push_back('\b'); return true;
+      case 'f': value->push_back('\f'); return true;
+      case 'n': value->push_back('\n'); return true;
+      case 'r': value->push_back('\r'); return true;
+      case 't': value->push_back('\t'); return true;
+      case 'u': break;
+      default: return Fail("invalid escape");
+    }
+
+    uint32_t code_point;
+    if (end_ - p_ < 4 || !ParseHex4(p_, &code_point))
+      return Fail("invalid unicode escape");
+    p_ += 4;
+
+    // Surrogate pair, a lone surrogate is replaced
+    if (code_point >= 0xd800 && code_point < 0xdc00) {
+      uint32_t low;
+      if (end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u' && ParseHex4(p_ + 2, &low) &&
+          low >= 0xdc00 && low < 0xe000) {
+        code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        p_ += 6;
+      } else {
+        code_point = 0xfffd;
+      }
+    } else if (code_point >= 0xdc00 && code_point < 0xe000) {
+      code_point = 0xfffd;
+    }
+    AppendUtf8(code_point, value);
+    return true;
+  }
+
+  const char* begin_;
+  const char* p_;
+  const char* end_;
+  std::string error_;
+};
+
+const uint32_t ItraceIndex::kNoString = 0;
+
+ItraceIndex::Thread::Thread()
+  : pid(0),
+    tid(0),
+    name(kNoString) {
+}
+
+ItraceIndex::ItraceIndex() {
+  Clear();
+}
+
+bool ItraceIndex::ParseFile(const std::string& path, std::string* error) {
+  Clear();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    *error = "empty trace " + path;
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    *error = "cannot map " + path + ": " + strerror(errno);
+    return false;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  bool parsed = Parse(static_cast<const char*>(data), st.st_size, error);
+  munmap(data, st.st_size);
+  return parsed;
+}
+
+bool ItraceIndex::Parse(const char* data, size_t length, std::string* error) {
+  Clear();
+  Scanner scanner(data, length);
+
+  bool parsed;
+  if (scanner.Peek() == '[') {
+    parsed = ParseEventArray(&scanner);
+  } else if (scanner.Consume('{')) {
+    parsed = true;
+    if (!scanner.Consume('}')) {
+      do {
+        std::string key;
+        parsed = scanner.ReadString(&key) &&
+            (scanner.Consume(':') || scanner.Fail("expected :")) &&
+            (key == "traceEvents" ? ParseEventArray(&scanner) : scanner.SkipValue());
+      } while (parsed && scanner.Consume(','));
+      parsed = parsed && (scanner.Consume('}') || scanner.Fail("expected }"));
+    }
+  } else {
+    parsed = scanner.Fail("not a trace");
+  }
+  parsed = parsed && (scanner.AtEnd() || scanner.Fail("trailing data"));
+
+  if (!parsed) {
+    *error = scanner.error();
+    return false;
+  }
+
+  // Begin events which did not end, e.g., tracing stopped during them
+  for (size_t i = 0; i < open_slices_.size(); ++i)
+    num_unmatched_events_ += open_slices_[i].size();
+  open_slices_.clear();
+
+  for (size_t i = 0; i < threads_.size(); ++i)
+    std::stable_sort(threads_[i].slices.begin(), threads_[i].slices.end(), SliceBefore);
+  return true;
+}
+
+void ItraceIndex::Clear() {
+  threads_.clear();
+  thread_indexes_.clear();
+  open_slices_.clear();
+  string_ids_.clear();
+  strings_.clear();
+  Intern(std::string());
+  num_events_ = 0;
+  num_unmatched_events_ = 0;
+}
+
+// The closing bracket may be missing at the end of the array form, see the
+// trace event format
+bool ItraceIndex::ParseEventArray(Scanner* scanner) {
+  if (!scanner->Consume('['))
+    return scanner->Fail("expected [");
+  if (scanner->Consume(']'))
+    return true;
+
+  do {
+    if (scanner->AtEnd())
+      return true;
+    if (!ParseEvent(scanner))
+      return false;
+  } while (scanner->Consume(','));
+
+  return scanner->Consume(']') || scanner->AtEnd() || scanner->Fail("expected ]");
+}
+
+bool ItraceIndex::ParseEvent(Scanner* scanner) {
+  if (!scanner->Consume('{'))
+    return scanner->Fail("expected an event");
+
+  std::string key;
+  std::string name;
+  std::string category;
+  std::string phase;
+  std::string thread_name;
+  double ts = 0;
+  double dur = 0;
+  double pid = 0;
+  double tid = 0;
+
+  if (!scanner->Consume('}')) {
+    do {
+      if (!scanner->ReadString(&key) || !(scanner->Consume(':') || scanner->Fail("expected :")))
+        return false;
+
+      bool read;
+      if (key == "name") {
+        read = scanner->ReadString(&name);
+      } else if (key == "cat") {
+        read = scanner->ReadString(&category);
+      } else if (key == "ph") {
+        read = scanner->ReadString(&phase);
+      } else if (key == "ts") {
+        read = scanner->ReadNumber(&ts);
+      } else if (key == "dur") {
+        read = scanner->ReadNumber(&dur);
+      } else if (key == "pid") {
+        read = scanner->ReadNumber(&pid);
+      } else if (key == "tid") {
+        read = scanner->ReadNumber(&tid);
+      } else if (key == "args" && scanner->Consume('{')) {
+        // Only the name of thread_name metadata is kept
+        read = true;
+        if (!scanner->Consume('}')) {
+          std::string arg;
+          do {
+            read = scanner->ReadString(&arg) &&
+                (scanner->Consume(':') || scanner->Fail("expected :")) &&
+                (arg == "name" && scanner->Peek() == '"' ?
+                    scanner->ReadString(&thread_name) : scanner->SkipValue());
+          } while (read && scanner->Consume(','));
+          read = read && (scanner->Consume('}') || scanner->Fail("expected }"));
+        }
+      } else {
+        read = scanner->SkipValue();
+      }
+      if (!read)
+        return false;
+    } while (scanner->Consume(','));
+
+    if (!scanner->Consume('}'))
+      return scanner->Fail("expected }");
+  }
+  ++num_events_;
+
+  char ph = phase.empty() ? '\0' : phase[0];
+  if (ph != 'X' && ph != 'B' && ph != 'E' && ph != 'M')
+    return true;
+
+  size_t index = ThreadIndex(static_cast<int64_t>(pid), static_cast<int64_t>(tid));
+  Thread& thread = threads_[index];
+  std::vector<OpenSlice>& open_slices = open_slices_[index];
+  switch (ph) {
+    case 'X': {
+      Slice slice = { Intern(name), Intern(category), ts, dur };
+      thread.slices.push_back(slice);
+      break;
+    }
+    case 'B': {
+      OpenSlice open_slice = { Intern(name), Intern(category), ts };
+      open_slices.push_back(open_slice);
+      break;
+    }
+    case 'E': {
+      if (open_slices.empty()) {
+        ++num_unmatched_events_;
+        break;
+      }
+      const OpenSlice& open_slice = open_slices.back();
+      Slice slice = { open_slice.name, open_slice.category, open_slice.ts, ts - open_slice.ts };
+      thread.slices.push_back(slice);
+      open_slices.pop_back();
+      break;
+    }
+    case 'M':
+      if (name == "thread_name")
+        thread.name = Intern(thread_name);
+      break;
+  }
+  return true;
+}
+
+uint32_t ItraceIndex::Intern(const std::string& value) {
+  std::unordered_map<std::string, uint32_t>::const_iterator it = string_ids_.find(value);
+  if (it != string_ids_.end())
+    return it->second;
+
+  uint32_t id = strings_.size();
+  strings_.push_back(value);
+  string_ids_[value] = id;
+  return id;
+}
+
+size_t ItraceIndex::ThreadIndex(int64_t pid, int64_t tid) {
+  std::pair<int64_t, int64_t> key(pid, tid);
+  std::map<std::pair<int64_t, int64_t>, size_t>::const_iterator it = thread_indexes_.find(key);
+  if (it != thread_indexes_.end())
+    return it->second;
+
+  size_t index = threads_.size();
+  threads_.push_back(Thread());
+  threads_.back().pid = pid;
+  threads_.back().tid = tid;
+  open_slices_.push_back(std::vector<OpenSlice>());
+  thread_indexes_[key] = index;
+  return index;
+}
+
+}  // namespace browser_profiler
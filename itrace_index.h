@@ -0,0 +1,105 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_ITRACE_INDEX_H_
+#define BROWSER_PROFILER_ITRACE_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace browser_profiler {
+
+// Per-thread slices of an internal tracing artifact (<id>.itrace.json, Chrome's
+// trace event format), for phase breakdowns over the traces of a whole campaign
+// Only depends on POSIX so that tools can use it, see tools/itrace_index
+//
+// The file is mapped and scanned once, in place, without building a tree of it:
+// strings are only copied when they are kept (interned) or escaped, the values which
+// are not needed (e.g., args) are skipped. The scan for the end of a string, the
+// bulk of a trace, goes 16 bytes at a time with SSE2 or NEON
+//
+// Slices are complete events (ph X) and matched begin/end pairs (ph B, E) of a thread,
+// sorted by start time; thread names come from thread_name metadata events (ph M)
+// Other events (instant, counter, async, flow) are only counted
+// Both the object form {"traceEvents": [...]} and the bare array form are accepted
+class ItraceIndex {
+ public:
+  // Times in microseconds, as in the trace
+  struct Slice {
+    uint32_t name;
+    uint32_t category;
+    double ts;
+    double dur;
+  };
+
+  struct Thread {
+    Thread();
+
+    int64_t pid;
+    int64_t tid;
+    // String id, kNoString if the trace does not name the thread
+    uint32_t name;
+    std::vector<Slice> slices;
+  };
+
+  static const uint32_t kNoString;
+
+  ItraceIndex();
+
+  // Map and parse a trace file, replacing the current index
+  // Return false with the reason in error, e.g., a syntax error and its offset
+  bool ParseFile(const std::string& path, std::string* error);
+
+  // Parse a trace in memory
+  bool Parse(const char* data, size_t length, std::string* error);
+
+  const std::vector<Thread>& threads() const { return threads_; }
+  // id of a slice or a thread; kNoString is the empty string
+  const std::string& String(uint32_t id) const { return strings_[id]; }
+
+  size_t num_events() const { return num_events_; }
+  // Begin events without their end, and ends without a begin
+  size_t num_unmatched_events() const { return num_unmatched_events_; }
+
+ private:
+  class Scanner;
+
+  // A begin event waiting for its end
+  struct OpenSlice {
+    uint32_t name;
+    uint32_t category;
+    double ts;
+  };
+
+  void Clear();
+  bool ParseEventArray(Scanner* scanner);
+  bool ParseEvent(Scanner* scanner);
+  uint32_t Intern(const std::string& value);
+  // Index of the thread in threads_
+  size_t ThreadIndex(int64_t pid, int64_t tid);
+
+  std::vector<Thread> threads_;
+  std::map<std::pair<int64_t, int64_t>, size_t> thread_indexes_;
+  // Open begin events of each thread, innermost last
+  std::vector<std::vector<OpenSlice>> open_slices_;
+
+  std::unordered_map<std::string, uint32_t> string_ids_;
+  std::vector<std::string> strings_;
+
+  size_t num_events_;
+  size_t num_unmatched_events_;
+
+  // Not copyable
+  ItraceIndex(const ItraceIndex&);
+  void operator=(const ItraceIndex&);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_ITRACE_INDEX_H_
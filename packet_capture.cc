@@ -0,0 +1,433 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "packet_capture.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "clock_domain.h"
+
+// Cellular interfaces (rmnet), not in older headers
+#ifndef ARPHRD_RAWIP
+#define ARPHRD_RAWIP 519
+#endif
+
+namespace {
+
+// pcap link types
+const uint32_t kLinkTypeEthernet = 1;
+const uint32_t kLinkTypeRaw = 101;
+const uint32_t kLinkTypeLinuxSll = 113;
+
+// Timestamps in nanoseconds
+const uint32_t kPcapMagic = 0xa1b23c4d;
+
+struct PcapFileHeader {
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t time_zone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t link_type;
+};
+
+struct PcapRecordHeader {
+  uint32_t seconds;
+  uint32_t nanoseconds;
+  uint32_t captured_length;
+  uint32_t length;
+};
+
+// Linux cooked header, big endian
+struct SllHeader {
+  uint16_t packet_type;
+  uint16_t hardware_type;
+  uint16_t address_length;
+  uint8_t address[8];
+  uint16_t protocol;
+};
+
+const size_t kSllHeaderSize = 16;
+
+std::string ErrorString(const std::string& message) {
+  return message + ": " + strerror(errno);
+}
+
+// ARPHRD_* of an interface, -1 on error
+int HardwareType(const std::string& interface) {
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  struct ifreq request;
+  memset(&request, 0, sizeof(request));
+  strncpy(request.ifr_name, interface.c_str(), sizeof(request.ifr_name) - 1);
+  int result = ioctl(fd, SIOCGIFHWADDR, &request);
+  close(fd);
+  return result < 0 ? -1 : request.ifr_hwaddr.sa_family;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+PacketCapture::Config::Config()
+  : snaplen(262144),
+    block_size(1 << 20),
+    num_blocks(32),
+    block_timeout_ms(20) {
+}
+
+PacketCapture::Stats::Stats()
+  : packets(0),
+    drops(0),
+    bytes_written(0) {
+}
+
+// static
+bool PacketCapture::ParseFilter(const std::string& text, std::vector<sock_filter>* filter,
+    std::string* error) {
+  std::istringstream input(text);
+  size_t count;
+  if (!(input >> count) || count == 0 || count > BPF_MAXINSNS) {
+    *error = "invalid number of filter instructions";
+    return false;
+  }
+
+  filter->clear();
+  for (size_t i = 0; i < count; ++i) {
+    unsigned code;
+    unsigned jump_true;
+    unsigned jump_false;
+    unsigned long k;
+    if (!(input >> code >> jump_true >> jump_false >> k) || code > 0xffff ||
+        jump_true > 0xff || jump_false > 0xff || k > 0xffffffff) {
+      *error = "invalid filter instruction " + std::to_string(i);
+      return false;
+    }
+    sock_filter instruction = { static_cast<uint16_t>(code), static_cast<uint8_t>(jump_true),
+        static_cast<uint8_t>(jump_false), static_cast<uint32_t>(k) };
+    filter->push_back(instruction);
+  }
+  return true;
+}
+
+PacketCapture::PacketCapture(const Config& config)
+  : config_(config),
+    socket_fd_(-1),
+    if_index_(0),
+    link_type_(kLinkTypeLinuxSll),
+    cooked_(true),
+    ring_(nullptr),
+    ring_size_(0),
+    output_fd_(-1),
+    output_error_(false),
+    packets_written_(0),
+    bytes_written_(0),
+    next_block_(0),
+    stop_requested_(false),
+    started_(false) {
+}
+
+PacketCapture::~PacketCapture() {
+  if (started_) {
+    Stats stats;
+    std::string error;
+    Stop(&stats, &error);
+  }
+  Close();
+}
+
+bool PacketCapture::Open(std::string* error) {
+  Close();
+
+  // Interfaces without a link header we know of are captured cooked
+  if (!config_.interface.empty()) {
+    if_index_ = if_nametoindex(config_.interface.c_str());
+    int hardware_type = HardwareType(config_.interface);
+    if (if_index_ == 0 || hardware_type < 0) {
+      *error = ErrorString("unknown interface " + config_.interface);
+      return false;
+    }
+    cooked_ = false;
+    if (hardware_type == ARPHRD_ETHER || hardware_type == ARPHRD_LOOPBACK) {
+      link_type_ = kLinkTypeEthernet;
+    } else if (hardware_type == ARPHRD_RAWIP || hardware_type == ARPHRD_NONE) {
+      link_type_ = kLinkTypeRaw;
+    } else {
+      cooked_ = true;
+      link_type_ = kLinkTypeLinuxSll;
+    }
+  }
+
+  // Protocol 0: nothing is received until Start() binds the socket
+  socket_fd_ = socket(AF_PACKET, (cooked_ ? SOCK_DGRAM : SOCK_RAW) | SOCK_CLOEXEC, 0);
+  if (socket_fd_ < 0) {
+    *error = ErrorString("cannot create a packet socket");
+    return false;
+  }
+
+  // The filter returns how much of a packet to keep, capped by the snaplen
+  std::vector<sock_filter> filter = config_.filter;
+  if (filter.empty()) {
+    sock_filter accept_all = { BPF_RET | BPF_K, 0, 0, config_.snaplen };
+    filter.push_back(accept_all);
+  }
+  for (size_t i = 0; i < filter.size(); ++i) {
+    if (filter[i].code == (BPF_RET | BPF_K))
+      filter[i].k = std::min(filter[i].k, config_.snaplen);
+  }
+  struct sock_fprog program = { static_cast<unsigned short>(filter.size()), filter.data() };
+  if (setsockopt(socket_fd_, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) < 0) {
+    *error = ErrorString("cannot attach the capture filter");
+    Close();
+    return false;
+  }
+
+  int version = TPACKET_V3;
+  if (setsockopt(socket_fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    *error = ErrorString("TPACKET_V3 is not supported");
+    Close();
+    return false;
+  }
+
+  // Frames are of variable size in V3, the frame fields only have to be consistent
+  struct tpacket_req3 request;
+  memset(&request, 0, sizeof(request));
+  request.tp_block_size = config_.block_size;
+  request.tp_block_nr = config_.num_blocks;
+  request.tp_frame_size = TPACKET_ALIGNMENT << 7;
+  request.tp_frame_nr = config_.block_size / request.tp_frame_size * config_.num_blocks;
+  request.tp_retire_blk_tov = config_.block_timeout_ms;
+  if (setsockopt(socket_fd_, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)) < 0) {
+    *error = ErrorString("cannot set up the capture ring");
+    Close();
+    return false;
+  }
+
+  ring_size_ = static_cast<size_t>(config_.block_size) * config_.num_blocks;
+  void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, socket_fd_, 0);
+  if (ring == MAP_FAILED) {
+    *error = ErrorString("cannot map the capture ring");
+    ring_size_ = 0;
+    Close();
+    return false;
+  }
+  ring_ = static_cast<char*>(ring);
+  next_block_ = 0;
+  return true;
+}
+
+bool PacketCapture::Start(const std::string& output_file, std::string* error) {
+  if (started_ || !ring_) {
+    *error = "capture is not open or already started";
+    return false;
+  }
+
+  output_fd_ = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (output_fd_ < 0) {
+    *error = ErrorString("cannot open " + output_file);
+    return false;
+  }
+
+  PcapFileHeader header = { kPcapMagic, 2, 4, 0, 0, config_.snaplen, link_type_ };
+  if (write(output_fd_, &header, sizeof(header)) != sizeof(header)) {
+    *error = ErrorString("cannot write " + output_file);
+    close(output_fd_);
+    output_fd_ = -1;
+    return false;
+  }
+  output_error_ = false;
+  packets_written_ = 0;
+  bytes_written_ = sizeof(header);
+
+  // Reading the counters resets them
+  struct tpacket_stats_v3 kernel_stats;
+  socklen_t length = sizeof(kernel_stats);
+  getsockopt(socket_fd_, SOL_PACKET, PACKET_STATISTICS, &kernel_stats, &length);
+
+  if (!Bind(htons(ETH_P_ALL))) {
+    *error = ErrorString("cannot bind the packet socket");
+    close(output_fd_);
+    output_fd_ = -1;
+    return false;
+  }
+
+  stop_requested_.store(false);
+  writer_ = std::thread(&PacketCapture::WriteBlocks, this);
+  started_ = true;
+  return true;
+}
+
+bool PacketCapture::Stop(Stats* stats, std::string* error) {
+  if (!started_) {
+    *error = "capture is not started";
+    return false;
+  }
+
+  // Nothing new comes in, the writer waits for the last block to retire
+  Bind(0);
+  stop_requested_.store(true);
+  writer_.join();
+  started_ = false;
+
+  struct tpacket_stats_v3 kernel_stats;
+  memset(&kernel_stats, 0, sizeof(kernel_stats));
+  socklen_t length = sizeof(kernel_stats);
+  getsockopt(socket_fd_, SOL_PACKET, PACKET_STATISTICS, &kernel_stats, &length);
+  stats->packets = packets_written_;
+  stats->drops = kernel_stats.tp_drops;
+  stats->bytes_written = bytes_written_;
+
+  if (close(output_fd_) < 0)
+    output_error_ = true;
+  output_fd_ = -1;
+  if (output_error_) {
+    *error = "cannot write the whole capture";
+    return false;
+  }
+  return true;
+}
+
+void PacketCapture::WriteBlocks() {
+  double stop_deadline = 0;
+  for (;;) {
+    // Blocks are retired in ring order
+    for (;;) {
+      tpacket_block_desc* block =
+          reinterpret_cast<tpacket_block_desc*>(ring_ + next_block_ * config_.block_size);
+      if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+        break;
+      if (!output_error_ && !WriteBlock(block))
+        output_error_ = true;
+      __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+      next_block_ = (next_block_ + 1) % config_.num_blocks;
+    }
+
+    // The kernel retires the partial block after its timeout
+    if (stop_requested_.load()) {
+      double now = MonotonicNow();
+      if (stop_deadline == 0)
+        stop_deadline = now + 2 * config_.block_timeout_ms / 1000.0;
+      else if (now >= stop_deadline)
+        break;
+    }
+
+    struct pollfd poll_fd = { socket_fd_, POLLIN | POLLERR, 0 };
+    poll(&poll_fd, 1, config_.block_timeout_ms);
+  }
+}
+
+bool PacketCapture::WriteBlock(const tpacket_block_desc* block) {
+  uint32_t num_packets = block->hdr.bh1.num_pkts;
+  size_t header_size = sizeof(PcapRecordHeader) + (cooked_ ? kSllHeaderSize : 0);
+  // Grows to the largest block once, the iovecs point into it
+  if (headers_.size() < num_packets * header_size)
+    headers_.resize(num_packets * header_size);
+  iovecs_.clear();
+
+  const char* cursor = reinterpret_cast<const char*>(block) + block->hdr.bh1.offset_to_first_pkt;
+  char* header = headers_.data();
+  for (uint32_t i = 0; i < num_packets; ++i) {
+    const tpacket3_hdr* packet = reinterpret_cast<const tpacket3_hdr*>(cursor);
+    const sockaddr_ll* address = reinterpret_cast<const sockaddr_ll*>(
+        cursor + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+    cursor += packet->tp_next_offset;
+
+    // Loopback packets are seen going out and coming in, like tcpdump keep one
+    if (address->sll_hatype == ARPHRD_LOOPBACK && address->sll_pkttype == PACKET_OUTGOING)
+      continue;
+
+    PcapRecordHeader record = { packet->tp_sec, packet->tp_nsec, packet->tp_snaplen,
+        packet->tp_len };
+    if (cooked_) {
+      record.captured_length += kSllHeaderSize;
+      record.length += kSllHeaderSize;
+      SllHeader sll;
+      sll.packet_type = htons(address->sll_pkttype);
+      sll.hardware_type = htons(address->sll_hatype);
+      sll.address_length = htons(address->sll_halen);
+      memset(sll.address, 0, sizeof(sll.address));
+      memcpy(sll.address, address->sll_addr, std::min<size_t>(address->sll_halen, 8));
+      sll.protocol = address->sll_protocol;
+      memcpy(header + sizeof(record), &sll, kSllHeaderSize);
+    }
+    memcpy(header, &record, sizeof(record));
+
+    struct iovec record_header = { header, header_size };
+    // The packet stays in the ring
+    struct iovec data = {
+      const_cast<char*>(reinterpret_cast<const char*>(packet)) +
+          (cooked_ ? packet->tp_net : packet->tp_mac),
+      packet->tp_snaplen,
+    };
+    iovecs_.push_back(record_header);
+    iovecs_.push_back(data);
+    header += header_size;
+    ++packets_written_;
+  }
+  return FlushIovecs();
+}
+
+bool PacketCapture::FlushIovecs() {
+  size_t next = 0;
+  while (next < iovecs_.size()) {
+    int count = std::min<size_t>(iovecs_.size() - next, IOV_MAX);
+    ssize_t written = writev(output_fd_, &iovecs_[next], count);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    bytes_written_ += written;
+
+    // Resume after a partial write
+    size_t remaining = written;
+    while (next < iovecs_.size() && remaining >= iovecs_[next].iov_len) {
+      remaining -= iovecs_[next].iov_len;
+      ++next;
+    }
+    if (remaining > 0) {
+      iovecs_[next].iov_base = static_cast<char*>(iovecs_[next].iov_base) + remaining;
+      iovecs_[next].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+bool PacketCapture::Bind(uint16_t protocol) {
+  struct sockaddr_ll address;
+  memset(&address, 0, sizeof(address));
+  address.sll_family = AF_PACKET;
+  address.sll_protocol = protocol;
+  address.sll_ifindex = if_index_;
+  return bind(socket_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+}
+
+void PacketCapture::Close() {
+  if (ring_)
+    munmap(ring_, ring_size_);
+  ring_ = nullptr;
+  ring_size_ = 0;
+  if (socket_fd_ >= 0)
+    close(socket_fd_);
+  socket_fd_ = -1;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,130 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_PACKET_CAPTURE_H_
+#define BROWSER_PROFILER_PACKET_CAPTURE_H_
+
+#include <linux/filter.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct tpacket_block_desc;
+
+namespace browser_profiler {
+
+// Captures packets into a pcap file without tcpdump: the kernel fills the blocks of a
+// TPACKET_V3 ring mapped in this process, a writer thread hands each retired block to
+// the file in large writev() calls pointing into the ring, then gives it back
+// Only depends on POSIX so that tools can use it, see tools/packet_capture
+//
+// The filter is a classic BPF program, e.g., from tcpdump -ddd; it runs in the kernel
+// on the packet as the socket sees it: from the link header on a named interface,
+// from the network header on all interfaces. The snaplen caps what it accepts
+//
+// Needs CAP_NET_RAW, Open() tells whether this process has it
+// The ring is kept between captures: Start() and Stop() only bind and unbind the socket
+//
+// Output: pcap with nanosecond timestamps (CLOCK_REALTIME); link type of the interface
+// (Ethernet, raw IP), Linux cooked (SLL) for all interfaces
+class PacketCapture {
+ public:
+  struct Config {
+    Config();
+
+    // Empty: all interfaces
+    std::string interface;
+    // Bytes kept of each packet
+    uint32_t snaplen;
+    // Empty: all packets
+    std::vector<sock_filter> filter;
+
+    // Ring of num_blocks blocks; a block goes to the file when full or after the timeout
+    uint32_t block_size;
+    uint32_t num_blocks;
+    uint32_t block_timeout_ms;
+  };
+
+  // Since Start()
+  struct Stats {
+    Stats();
+
+    // Written to the file
+    uint64_t packets;
+    // Dropped by the kernel because the ring was full
+    uint64_t drops;
+    uint64_t bytes_written;
+  };
+
+  // Instructions as written by tcpdump -ddd: their number, then "code jt jf k" lines
+  static bool ParseFilter(const std::string& text, std::vector<sock_filter>* filter,
+      std::string* error);
+
+  explicit PacketCapture(const Config& config);
+  ~PacketCapture();
+
+  // Create the socket, attach the filter and map the ring
+  // Return false with the reason in error, e.g., without CAP_NET_RAW
+  bool Open(std::string* error);
+
+  // Start capturing into a new pcap file
+  bool Start(const std::string& output_file, std::string* error);
+
+  // Stop capturing, write the blocks left and close the file
+  // Return false if the pcap file is incomplete
+  bool Stop(Stats* stats, std::string* error);
+
+  bool started() const { return started_; }
+
+ private:
+  // Writer thread: write the retired blocks in ring order until stopped
+  void WriteBlocks();
+
+  // Write the packets of a block to the output file
+  bool WriteBlock(const tpacket_block_desc* block);
+
+  // Write all iovecs_, IOV_MAX at a time
+  bool FlushIovecs();
+
+  bool Bind(uint16_t protocol);
+  void Close();
+
+  Config config_;
+  int socket_fd_;
+  int if_index_;
+  // Of the interface, pcap LINKTYPE_*
+  uint32_t link_type_;
+  bool cooked_;
+
+  char* ring_;
+  size_t ring_size_;
+
+  int output_fd_;
+  bool output_error_;
+  uint64_t packets_written_;
+  uint64_t bytes_written_;
+
+  // Writer thread only, reused for each block: a record header (and a cooked header)
+  // per packet, and the iovecs over them and the packets in the ring
+  std::vector<char> headers_;
+  std::vector<struct iovec> iovecs_;
+  // Ring order
+  size_t next_block_;
+
+  std::atomic<bool> stop_requested_;
+  std::thread writer_;
+  bool started_;
+
+  // Not copyable
+  PacketCapture(const PacketCapture&);
+  void operator=(const PacketCapture&);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_PACKET_CAPTURE_H_
@@ -0,0 +1,123 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "packet_capture_tracer.h"
+
+#include "browser_profiler_impl_constants.h"
+#include "browser_profiler_impl_switches.h"
+#include "root_command_runner.h"
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace browser_profiler {
+
+PacketCaptureTracer::PacketCaptureTracer(const base::CommandLine& command_line)
+  : packets_metric_(ExperimentResult::kInvalidMetric),
+    drops_metric_(ExperimentResult::kInvalidMetric) {
+  config_.interface = command_line.GetSwitchValueASCII(switches::kCaptureInterface);
+
+  std::string snaplen_str = command_line.GetSwitchValueASCII(switches::kCaptureSnaplen);
+  if (!snaplen_str.empty()) {
+    unsigned snaplen;
+    if (base::StringToUint(snaplen_str, &snaplen) && snaplen > 0)
+      config_.snaplen = snaplen;
+    else
+      LOG(ERROR) << "Cannot parse switch " << switches::kCaptureSnaplen << ": " << snaplen_str;
+  }
+
+  filter_file_ = command_line.GetSwitchValuePath(switches::kCaptureFilter);
+}
+
+PacketCaptureTracer::~PacketCaptureTracer() {
+}
+
+Tracer::Overhead PacketCaptureTracer::expected_overhead() const {
+  // tcpdump copies every packet in another process
+  return capture_ ? kNegligibleOverhead : kLowOverhead;
+}
+
+std::vector<std::string> PacketCaptureTracer::output_artifacts() const {
+  return std::vector<std::string>(1, base_name_);
+}
+
+void PacketCaptureTracer::RegisterMetrics(ExperimentResult* experiment_result) {
+  packets_metric_ = experiment_result->RegisterMetric(
+      "Captured Packets", ExperimentResult::kUint64Metric);
+  drops_metric_ = experiment_result->RegisterMetric(
+      "Dropped Packets", ExperimentResult::kUint64Metric);
+}
+
+bool PacketCaptureTracer::Initialize(const TracerContext& context) {
+  base_name_ = context.constants->kPcapBaseName;
+  std::string error;
+  if (!filter_file_.empty()) {
+    std::string filter;
+    if (!base::ReadFileToString(filter_file_, &filter) ||
+        !PacketCapture::ParseFilter(filter, &config_.filter, &error)) {
+      LOG(ERROR) << "Invalid capture filter " << filter_file_.value() << ": " << error;
+      return false;
+    }
+  }
+
+  // Fall back to the capture scripts run as root
+  capture_.reset(new PacketCapture(config_));
+  if (!capture_->Open(&error)) {
+    LOG(WARNING) << "Cannot capture packets in process (" << error << "), use "
+        << context.constants->kStartCapturePacketsScript.value();
+    capture_.reset();
+  }
+  return true;
+}
+
+void PacketCaptureTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  std::string output = context.OutputFile(base_name_).value();
+  if (capture_) {
+    std::string error;
+    if (!capture_->Start(output, &error))
+      LOG(ERROR) << "Failed to start packet capture: " << error;
+  } else if (!context.root_runner->RunBatch(StartRootCommands(context))) {
+    LOG(ERROR) << "Failed to start packet capture";
+  }
+  done();
+}
+
+void PacketCaptureTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  if (!capture_) {
+    if (!context.root_runner->RunBatch(StopRootCommands(context)))
+      LOG(ERROR) << "Failed to stop packet capture";
+    done();
+    return;
+  }
+
+  if (capture_->started()) {
+    PacketCapture::Stats stats;
+    std::string error;
+    if (!capture_->Stop(&stats, &error))
+      LOG(ERROR) << "Packet capture of " << context.experiment_id << " is incomplete: " << error;
+    if (stats.drops > 0)
+      LOG(WARNING) << "Packet capture dropped " << stats.drops << " packets";
+
+    context.experiment_result->SetUint64(packets_metric_, stats.packets);
+    context.experiment_result->SetUint64(drops_metric_, stats.drops);
+  }
+  done();
+}
+
+std::vector<std::string> PacketCaptureTracer::StartRootCommands(
+    const TracerContext& context) const {
+  if (capture_)
+    return std::vector<std::string>();
+  return std::vector<std::string>(1, context.constants->kStartCapturePacketsScript.value() +
+      " " + context.OutputFile(base_name_).value());
+}
+
+std::vector<std::string> PacketCaptureTracer::StopRootCommands(
+    const TracerContext& context) const {
+  if (capture_)
+    return std::vector<std::string>();
+  return std::vector<std::string>(1, context.constants->kStopCapturePacketsScript.value());
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,57 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_PACKET_CAPTURE_TRACER_H_
+#define BROWSER_PROFILER_PACKET_CAPTURE_TRACER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "experiment_result.h"
+#include "packet_capture.h"
+#include "tracer.h"
+
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Packet capture, in-process through PacketCapture if this process has CAP_NET_RAW,
+// otherwise through the capture-packets scripts run as root (tcpdump)
+class PacketCaptureTracer : public Tracer {
+ public:
+  // Reads --capture-interface, --capture-snaplen and --capture-filter
+  explicit PacketCaptureTracer(const base::CommandLine& command_line);
+  ~PacketCaptureTracer() override;
+
+  // Tracer
+  std::string name() const override { return "packet capture"; }
+  StartStage start_stage() const override { return kFtraceStage; }
+  StopStage stop_stage() const override { return kFtraceStopStage; }
+  Overhead expected_overhead() const override;
+  std::vector<std::string> output_artifacts() const override;
+  void RegisterMetrics(ExperimentResult* experiment_result) override;
+  bool Initialize(const TracerContext& context) override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  // The capture scripts when packets cannot be captured in process
+  std::vector<std::string> StartRootCommands(const TracerContext& context) const override;
+  std::vector<std::string> StopRootCommands(const TracerContext& context) const override;
+
+ private:
+  PacketCapture::Config config_;
+  base::FilePath filter_file_;
+  std::unique_ptr<PacketCapture> capture_;
+  std::string base_name_;
+
+  ExperimentResult::Metric packets_metric_;
+  ExperimentResult::Metric drops_metric_;
+
+  DISALLOW_COPY_AND_ASSIGN(PacketCaptureTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_PACKET_CAPTURE_TRACER_H_
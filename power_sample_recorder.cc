@@ -0,0 +1,60 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "power_sample_recorder.h"
+
+#include <algorithm>
+
+#include "power_window_integrator.h"
+
+namespace browser_profiler {
+
+PowerSampleRecorder::PowerSampleRecorder(double begin_time, double end_time)
+  : begin_time_(begin_time),
+    end_time_(end_time) {
+}
+
+PowerSampleRecorder::~PowerSampleRecorder() {
+}
+
+void PowerSampleRecorder::AddSamples(const double* times, const double* watts,
+    size_t num_samples) {
+  if (num_samples == 0)
+    return;
+  // Nothing to add once the sample after the range is kept
+  if (!times_.empty() && times_.back() > end_time_)
+    return;
+
+  size_t first = std::lower_bound(times, times + num_samples, begin_time_) - times;
+  size_t last = std::upper_bound(times, times + num_samples, end_time_) - times;
+
+  // Only the latest sample before the range is kept
+  if (first > 0) {
+    if (!times_.empty()) {
+      times_.clear();
+      watts_.clear();
+    }
+    times_.push_back(times[first - 1]);
+    watts_.push_back(watts[first - 1]);
+  }
+  times_.insert(times_.end(), times + first, times + last);
+  watts_.insert(watts_.end(), watts + first, watts + last);
+  if (last < num_samples) {
+    times_.push_back(times[last]);
+    watts_.push_back(watts[last]);
+  }
+}
+
+bool PowerSampleRecorder::Covers(double begin_time, double end_time) const {
+  return !times_.empty() && times_.front() <= std::min(begin_time, end_time) &&
+      times_.back() >= std::max(begin_time, end_time);
+}
+
+double PowerSampleRecorder::Energy(double begin_time, double end_time) const {
+  if (end_time < begin_time)
+    return -Energy(end_time, begin_time);
+  return PowerWindowIntegrator::ClippedEnergy(times_.data(), watts_.data(), times_.size(),
+      begin_time, end_time);
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,48 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_POWER_SAMPLE_RECORDER_H_
+#define BROWSER_PROFILER_POWER_SAMPLE_RECORDER_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "power_sample_sink.h"
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Keeps the streamed samples of a time range, and the closest ones outside it
+// so that the power can be interpolated anywhere in the range
+class PowerSampleRecorder : public PowerSampleSink {
+ public:
+  PowerSampleRecorder(double begin_time, double end_time);
+  ~PowerSampleRecorder() override;
+
+  // PowerSampleSink
+  void AddSamples(const double* times, const double* watts, size_t num_samples) override;
+
+  // Whether the samples span from begin_time to end_time, in either order
+  bool Covers(double begin_time, double end_time) const;
+
+  // Trapezoid integral from begin_time to end_time, negative if end_time < begin_time
+  double Energy(double begin_time, double end_time) const;
+
+  const std::vector<double>& times() const { return times_; }
+  const std::vector<double>& watts() const { return watts_; }
+
+ private:
+  double begin_time_;
+  double end_time_;
+
+  std::vector<double> times_;
+  std::vector<double> watts_;
+
+  DISALLOW_COPY_AND_ASSIGN(PowerSampleRecorder);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_POWER_SAMPLE_RECORDER_H_
@@ -0,0 +1,22 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_POWER_SAMPLE_SINK_H_
+#define BROWSER_PROFILER_POWER_SAMPLE_SINK_H_
+
+#include <stddef.h>
+
+namespace browser_profiler {
+
+// Gets the power samples streamed by the power tool server, batch by batch,
+// in time order (server clock, seconds)
+class PowerSampleSink {
+ public:
+  virtual ~PowerSampleSink() {}
+
+  virtual void AddSamples(const double* times, const double* watts, size_t num_samples) = 0;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_POWER_SAMPLE_SINK_H_
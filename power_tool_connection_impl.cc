@@ -1,100 +1,162 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
 #include "power_tool_connection_impl.h"
 
-#include <arpa/inet.h>
-#include <cstdlib>
-#include <cstdio>
-#include <ctime>
 #include <errno.h>
-#include <netinet/in.h>
-#include <string>
-#include <sstream>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <string>
+
+#include "power_tool_protocol.h"
+
 #include "base/logging.h"
 
 namespace {
-int Socket(int family, int type, int protocol) {
-  int n;
-  if ((n = socket(family, type, protocol)) < 0) {
-    PLOG(ERROR) << "Socket creation error";
-  }
-  return n;
+
+const char kMessageTerminator[] = "\r\n\r\n";
+const size_t kMessageTerminatorLength = 4;
+
+const size_t kReadChunkSize = 4096;
+
+// Backoff before the second connect attempt, doubled after each failure
+const int kInitialBackoffMillis = 100;
+
+int64_t MonotonicMillis() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
 }
 
-int Connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
-  int n;
-  if ((n = connect(sockfd, addr, addrlen)) < 0) {
-    PLOG(ERROR) << "Connect error";
-  }
-  return n;
+// Remaining time for poll(), 0 if the deadline passed
+int RemainingMillis(int64_t deadline_millis) {
+  int64_t remaining = deadline_millis - MonotonicMillis();
+  return remaining > 0 ? static_cast<int>(remaining) : 0;
 }
 
-int ConnectTo(const std::string& ip_addr, uint32_t port) {
-  VLOG(1) << "Connect to " << ip_addr << ":" << port;
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(port); // must use htons as sin_port is short
-  if (inet_pton(AF_INET, ip_addr.c_str(), &server_addr.sin_addr) <= 0) {
-    PLOG(ERROR) << "inet_pton failed";
-    return -1;
+// Return > 0 if ready, 0 on timeout, -1 on error
+int PollUntil(int fd, short events, int64_t deadline_millis) {
+  for (;;) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int n = poll(&pfd, 1, RemainingMillis(deadline_millis));
+    if (n < 0 && errno == EINTR)
+      continue;
+    return n;
   }
-  int server_socket = Socket(AF_INET, SOCK_STREAM, 0);
-  Connect(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
-  return server_socket;
 }
 
-ssize_t Send(int sockfd, const void *buf, size_t len, int flags) {
-  ssize_t sent_bytes = send(sockfd, buf, len, flags);
-  if (sent_bytes == -1) {
-    PLOG(ERROR) << "send, socket gone";
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    PLOG(ERROR) << "Cannot set socket non-blocking";
+    return false;
   }
-  return sent_bytes;
+  return true;
 }
 
-// Read until "\r\n\r\n" is encountered
-// Return number of bytes read
-ssize_t ReadLine(int fd, std::string *output) {
-    ssize_t numRead = 0;                    /* # of bytes fetched by last read() */
-    size_t totRead = 0;                     /* Total bytes read so far */
-    char ch;
-    int state = 0;
-
-    for (;;) {
-      numRead = read(fd, &ch, 1);
-
-      if (numRead == -1) {
-        if (errno == EINTR)         /* Interrupted --> restart read() */
-          continue;
-        else
-          return -1;              /* Some other error */
+// Connect a non-blocking socket before the deadline
+// Return the socket, or -1
+int ConnectWithDeadline(int family, const struct sockaddr* addr, socklen_t addrlen,
+    int64_t deadline_millis) {
+  int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    PLOG(ERROR) << "Socket creation error";
+    return -1;
+  }
+  if (!SetNonBlocking(fd)) {
+    close(fd);
+    return -1;
+  }
 
-      } else if (numRead == 0) {      /* EOF */
-        if (totRead == 0)           /* No bytes read; return 0 */
-          return 0;
-        else                        /* Some bytes read; add '\0' */
-          break;
+  if (connect(fd, addr, addrlen) < 0) {
+    if (errno != EINPROGRESS && errno != EINTR) {
+      PLOG(ERROR) << "Connect error";
+      close(fd);
+      return -1;
+    }
+    int n = PollUntil(fd, POLLOUT, deadline_millis);
+    if (n <= 0) {
+      if (n == 0)
+        LOG(ERROR) << "Connect timed out";
+      else
+        PLOG(ERROR) << "poll failed";
+      close(fd);
+      return -1;
+    }
+    int error = 0;
+    socklen_t error_length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length) < 0 || error != 0) {
+      LOG(ERROR) << "Connect error: " << strerror(error);
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
 
-      } else {                        /* 'numRead' must be 1 if we get here */
-        *output += ch;
+// "unix:<path>", "unix:@<abstract name>"
+int ConnectToUnixSocket(const std::string& path, int64_t deadline_millis) {
+  VLOG(1) << "Connect to unix socket " << path;
+  struct sockaddr_un server_addr;
+  memset(&server_addr, 0, sizeof(server_addr));
+  server_addr.sun_family = AF_UNIX;
+  if (path.empty() || path.length() >= sizeof(server_addr.sun_path)) {
+    LOG(ERROR) << "Invalid unix socket path: " << path;
+    return -1;
+  }
+  memcpy(server_addr.sun_path, path.data(), path.length());
+  socklen_t addrlen = sizeof(server_addr);
+  if (path[0] == '@') {
+    // Abstract namespace, the name is not terminated
+    server_addr.sun_path[0] = '\0';
+    addrlen = offsetof(struct sockaddr_un, sun_path) + path.length();
+  }
+  return ConnectWithDeadline(AF_UNIX, reinterpret_cast<struct sockaddr*>(&server_addr),
+      addrlen, deadline_millis);
+}
 
-        if ((state == 0 || state == 2) && ch == '\r') {
-          ++state;
-        } else if ((state == 1 || state == 3) && ch == '\n') {
-          ++state;
-        } else {
-          state = 0;
-        }
+// IPv4, IPv6 (with or without brackets) or a host name
+// Try each resolved address until one connects
+int ConnectToHost(std::string host, uint32_t port, int64_t deadline_millis) {
+  if (host.length() > 2 && host[0] == '[' && host[host.length() - 1] == ']')
+    host = host.substr(1, host.length() - 2);
+  VLOG(1) << "Connect to " << host << " port " << port;
 
-        ++totRead;
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+  char port_string[16];
+  snprintf(port_string, sizeof(port_string), "%u", port);
 
-        if (state == 4)
-          break;
-      }
+  struct addrinfo* addresses = nullptr;
+  int error = getaddrinfo(host.c_str(), port_string, &hints, &addresses);
+  if (error != 0) {
+    LOG(ERROR) << "Cannot resolve " << host << ": " << gai_strerror(error);
+    return -1;
   }
 
-    return totRead;
+  int fd = -1;
+  for (struct addrinfo* address = addresses; address != nullptr && fd < 0;
+       address = address->ai_next) {
+    fd = ConnectWithDeadline(address->ai_family, address->ai_addr, address->ai_addrlen,
+        deadline_millis);
+  }
+  freeaddrinfo(addresses);
+  return fd;
 }
 
 }  // namespace
@@ -102,9 +164,18 @@ ssize_t ReadLine(int fd, std::string *output) {
 
 namespace browser_profiler {
 
+const int PowerToolConnectionImpl::kDefaultConnectTimeoutMillis = 3000;
+// Stopping sampling lets the server save its samples
+const int PowerToolConnectionImpl::kDefaultIoTimeoutMillis = 30000;
+const int PowerToolConnectionImpl::kDefaultMaxConnectAttempts = 3;
+
 PowerToolConnectionImpl::PowerToolConnectionImpl(const std::string& server_ip, uint32_t server_port)
   : PowerToolConnection(server_ip, server_port),
-    socket_to_server_(0) {
+    socket_to_server_(-1),
+    connect_timeout_millis_(kDefaultConnectTimeoutMillis),
+    io_timeout_millis_(kDefaultIoTimeoutMillis),
+    max_connect_attempts_(kDefaultMaxConnectAttempts),
+    num_io_syscalls_(0) {
 }
 
 PowerToolConnectionImpl::PowerToolConnectionImpl(
@@ -113,45 +184,176 @@ PowerToolConnectionImpl::PowerToolConnectionImpl(
 }
 
 PowerToolConnectionImpl::~PowerToolConnectionImpl() {
-  close(socket_to_server_);
-  socket_to_server_ = 0;
+  Disconnect();
 }
-  
+
 bool PowerToolConnectionImpl::Connect() {
-  int socket_to_server = ConnectTo(server_ip_, server_port_);
-  if (socket_to_server < 0) {
-    LOG(ERROR) << "Failed to connection server at " 
-      << server_ip_ << ":" << server_port_;
-    return false;
+  Disconnect();
+
+  int backoff_millis = kInitialBackoffMillis;
+  for (int attempt = 1; attempt <= max_connect_attempts_; ++attempt) {
+    if (ConnectOnce())
+      return true;
+
+    LOG(ERROR) << "Failed to connect to server at " << server_ip_ << ":" << server_port_
+      << ", attempt " << attempt << " of " << max_connect_attempts_;
+    if (attempt < max_connect_attempts_) {
+      usleep(backoff_millis * 1000);
+      backoff_millis *= 2;
+    }
   }
+  return false;
+}
 
-  socket_to_server_ = socket_to_server;
-  return true;
+bool PowerToolConnectionImpl::ConnectOnce() {
+  int64_t deadline_millis = MonotonicMillis() + connect_timeout_millis_;
+  size_t prefix_length = strlen(power_tool::kUnixSocketPrefix);
+  if (server_ip_.compare(0, prefix_length, power_tool::kUnixSocketPrefix) == 0) {
+    socket_to_server_ = ConnectToUnixSocket(server_ip_.substr(prefix_length),
+        deadline_millis);
+  } else {
+    socket_to_server_ = ConnectToHost(server_ip_, server_port_, deadline_millis);
+  }
+  return socket_to_server_ >= 0;
+}
+
+void PowerToolConnectionImpl::Disconnect() {
+  if (socket_to_server_ >= 0) {
+    close(socket_to_server_);
+    socket_to_server_ = -1;
+  }
+  read_buffer_.clear();
 }
 
 bool PowerToolConnectionImpl::SyncReceiveMessage(std::string* message) {
-  if (socket_to_server_ == 0) {
+  return SyncReceiveMessageWithTimeout(message, io_timeout_millis_);
+}
+
+bool PowerToolConnectionImpl::SyncReceiveMessageWithTimeout(std::string* message,
+    int timeout_millis) {
+  if (socket_to_server_ < 0) {
     LOG(ERROR) << "Socket is not connected";
     return false;
   }
 
-  if (ReadLine(socket_to_server_, message) == -1) {
-    LOG(ERROR) << "Cannot read response";
-    return false;
+  int64_t deadline_millis = MonotonicMillis() + timeout_millis;
+  // Only scan the bytes which were not scanned yet
+  size_t scanned = 0;
+  for (;;) {
+    size_t terminator = read_buffer_.find(kMessageTerminator, scanned);
+    if (terminator != std::string::npos) {
+      size_t message_length = terminator + kMessageTerminatorLength;
+      message->append(read_buffer_, 0, message_length);
+      read_buffer_.erase(0, message_length);
+      return true;
+    }
+    if (read_buffer_.length() >= kMessageTerminatorLength)
+      scanned = read_buffer_.length() - kMessageTerminatorLength + 1;
+
+    if (!FillBuffer(deadline_millis)) {
+      LOG(ERROR) << "Cannot read response";
+      Disconnect();
+      return false;
+    }
   }
+}
 
-  return true;
+bool PowerToolConnectionImpl::FillBuffer(int64_t deadline_millis) {
+  for (;;) {
+    char chunk[kReadChunkSize];
+    ssize_t n = recv(socket_to_server_, chunk, sizeof(chunk), 0);
+    ++num_io_syscalls_;
+    if (n > 0) {
+      read_buffer_.append(chunk, n);
+      return true;
+    }
+    if (n == 0) {
+      LOG(ERROR) << "Server closed the connection";
+      return false;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      PLOG(ERROR) << "recv failed";
+      return false;
+    }
+
+    int ready = PollUntil(socket_to_server_, POLLIN, deadline_millis);
+    if (ready == 0) {
+      LOG(ERROR) << "Timed out waiting for the server";
+      return false;
+    }
+    if (ready < 0) {
+      PLOG(ERROR) << "poll failed";
+      return false;
+    }
+  }
+}
+
+bool PowerToolConnectionImpl::PeerClosed() {
+  if (!read_buffer_.empty())
+    return false;
+  struct pollfd pfd;
+  pfd.fd = socket_to_server_;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  if (poll(&pfd, 1, 0) <= 0)
+    return false;
+  char byte;
+  return recv(socket_to_server_, &byte, 1, MSG_PEEK) == 0 || (pfd.revents & POLLHUP);
 }
 
 bool PowerToolConnectionImpl::SyncSendMessage(const std::string& message) {
-  if (socket_to_server_ == 0) {
+  if (socket_to_server_ >= 0 && PeerClosed()) {
+    LOG(WARNING) << "Server closed the connection, reconnecting";
+    Disconnect();
+  }
+  if (socket_to_server_ < 0 && !Connect()) {
     LOG(ERROR) << "Socket is not connected";
     return false;
   }
 
-  if (!Send(socket_to_server_, message.c_str(), message.length(), 0)) {
-    LOG(ERROR) << "Fail to send message";
-    return false;
+  bool nothing_sent = true;
+  if (SendAll(message, &nothing_sent))
+    return true;
+
+  // The server may have dropped an idle connection, sending again cannot duplicate the command
+  if (nothing_sent) {
+    LOG(WARNING) << "Connection broken, reconnecting";
+    if (Connect() && SendAll(message, &nothing_sent))
+      return true;
+  }
+
+  LOG(ERROR) << "Fail to send message";
+  Disconnect();
+  return false;
+}
+
+bool PowerToolConnectionImpl::SendAll(const std::string& data, bool* nothing_sent) {
+  int64_t deadline_millis = MonotonicMillis() + io_timeout_millis_;
+  size_t sent = 0;
+  *nothing_sent = true;
+  while (sent < data.length()) {
+    ssize_t n = send(socket_to_server_, data.data() + sent, data.length() - sent,
+        MSG_NOSIGNAL);
+    ++num_io_syscalls_;
+    if (n > 0) {
+      sent += n;
+      *nothing_sent = false;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      PLOG(ERROR) << "send, socket gone";
+      return false;
+    }
+
+    int ready = PollUntil(socket_to_server_, POLLOUT, deadline_millis);
+    if (ready <= 0) {
+      LOG(ERROR) << "Timed out sending to the server";
+      return false;
+    }
   }
   return true;
 }
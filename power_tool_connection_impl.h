@@ -4,6 +4,11 @@
 #ifndef BROWSER_PROFILER_POWER_TOOL_CONNECTION_IMPL_H_
 #define BROWSER_PROFILER_POWER_TOOL_CONNECTION_IMPL_H_
 
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+
 #include "public/power_tool_connection.h"
 
 #include "base/compiler_specific.h"
@@ -13,7 +18,7 @@ namespace browser_profiler {
 // Use simple protocol
 // Send and receive messages per line because no value contains the new line character
 // Send lines containing tab-separated values because no value has the tab character
-//  Server split the line and interpret 
+//  Server split the line and interpret
 // This way has the following advantage:
 //  Synchronously sending/receiving message
 //  Have no network library (REST client, curl) dependency
@@ -23,29 +28,72 @@ namespace browser_profiler {
 // Disadvantage:
 //  Custom protocol is less flexible as using general-purpose protocols (HTTP), and format (Json)
 // client, server
-// Command: start_sampling, OK
+// Command: start_sampling, WaitForFirstSample: 1 --> OK, FirstSampleTime once sampling
 // Command: stop_sampling, OK
 // Header: ..., OK
 // Result: ..., OK
 //
 // KEY <space> : <space> VALUE
+//
+// Server address: an IPv4 or IPv6 address or a host name with a port,
+// or "unix:<path>" for a Unix domain socket ("unix:@<name>" for the abstract namespace),
+// e.g., a local relay or an adb-forwarded one
+//
+// Every connect, send and receive has a deadline: a dead server is an error, not a hang
+// Received data is buffered, a message costs a few reads instead of one per byte
 class PowerToolConnectionImpl : public PowerToolConnection {
  public:
+  static const int kDefaultConnectTimeoutMillis;
+  static const int kDefaultIoTimeoutMillis;
+  static const int kDefaultMaxConnectAttempts;
+
   PowerToolConnectionImpl(const std::string& server_ip, uint32_t server_port);
 
   PowerToolConnectionImpl(const std::pair<std::string, uint32_t> server_ip_port);
 
   ~PowerToolConnectionImpl();
 
+  // Connect, retrying with backoff up to max_connect_attempts
   virtual bool Connect() override;
 
   virtual bool SyncReceiveMessage(std::string* message) override;
 
+  virtual bool SyncReceiveMessageWithTimeout(std::string* message,
+      int timeout_millis) override;
+
+  // Reconnect if the connection was found broken before the message was sent
   virtual bool SyncSendMessage(const std::string& message) override;
- 
+
+  void set_connect_timeout_millis(int millis) { connect_timeout_millis_ = millis; }
+  void set_io_timeout_millis(int millis) { io_timeout_millis_ = millis; }
+  void set_max_connect_attempts(int attempts) { max_connect_attempts_ = attempts; }
+
+  // Number of read and write syscalls so far
+  size_t num_io_syscalls() const { return num_io_syscalls_; }
+
  private:
+  bool ConnectOnce();
+  void Disconnect();
+
+  // The server closed an idle connection, e.g., restarted between experiments
+  bool PeerClosed();
+
+  // Return false on error or timeout
+  bool SendAll(const std::string& data, bool* nothing_sent);
+  // Append what is available (waiting until the deadline) to read_buffer_
+  bool FillBuffer(int64_t deadline_millis);
+
   int socket_to_server_;
+
+  // Received bytes not returned yet
+  std::string read_buffer_;
+
+  int connect_timeout_millis_;
+  int io_timeout_millis_;
+  int max_connect_attempts_;
+
+  size_t num_io_syscalls_;
 };
 
-} // namespace browser_profiler 
+} // namespace browser_profiler
 #endif // BROWSER_PROFILER_POWER_TOOL_CONNECTION_IMPL_H_
@@ -16,39 +16,35 @@
 #include "base/time/time.h"
   
 #include "power_tool_connection_impl.h"
+#include "power_tool_protocol.h"
 
 namespace {
 
-const char kCommandKey[] = "Command";
-const char kStartSamplingCommand[] = "start_sampling";
-const char kStopSamplingCommand[] = "stop_sampling";
-const char kFinishAllExperimentsCommand[] =  "finish_all_experiments";
+// Power meters take a few hundred ms to start
+const int kStartSamplingTimeoutMillis = 5000;
 
-const char kResultKeysKey[] = "ResultKeys";
-const char kResultValuesKey[] = "ResultValues";
-
-const char kStatusKey[] = "Status";
-const char kOkValue[] = "ok";
-
-const char kKeyValueSeparator[] = ":";
-const char kNewLine[] = "\r\n";
-const char kBlankLine[] = "\r\n\r\n";
-
-std::string ComposeKeyValue(const std::string& key, const std::string& value) {
-  std::string result;
-  result.append(key).append(" ").append(kKeyValueSeparator).append(" ").append(value);
-  return result;
-}
+// For servers which do not acknowledge the first sample
+// Fix warning: approximate navigationStart to 0
+const int kLegacyStartSamplingDelayMillis = 550;
 
 // Configuration file format, example:
 // # Skip lines beginning with '#'
 // server_ip : 10.172.96.40
 // server_port : 3000
+// The address may be IPv6 (server_ip : fe80::1) or a host name,
+// a local or adb-forwarded relay can listen on a unix socket instead:
+// server_unix_socket : /data/local/tmp/power_tool.sock
 const char kServerIp[] = "server_ip";
 const char kServerPort[] = "server_port";
+const char kServerUnixSocket[] = "server_unix_socket";
 
-bool ReadServerIpAndPort(const base::FilePath& server_config_filepath,
-    std::pair<std::string, uint32_t> *server_ip_port) {
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+bool PowerToolController::ReadServerConfig(const base::FilePath& server_config_filepath,
+    std::pair<std::string, uint32_t>* server_ip_port) {
   std::string server_config;
   if (!base::ReadFileToString(server_config_filepath, &server_config)) {
     LOG(ERROR) << "Cannot read server config file at " << server_config_filepath.value();
@@ -63,19 +59,22 @@ bool ReadServerIpAndPort(const base::FilePath& server_config_filepath,
     base::TrimWhitespaceASCII(line, base::TRIM_ALL, &line);
     if (line.empty() || StartsWith(line, "#", base::CompareCase::SENSITIVE))
       continue;
-    std::vector<std::string> components =
-        base::SplitString(line, ":", base::WhitespaceHandling::TRIM_WHITESPACE,
-                          base::SplitResult::SPLIT_WANT_NONEMPTY);
-    if (components.size() != 2) {
+    // Split at the first separator only, IPv6 addresses contain it
+    std::string::size_type separator = line.find(
+        browser_profiler::power_tool::kKeyValueSeparator);
+    if (separator == std::string::npos) {
       LOG(ERROR) << "Error parsing line: " << line;
       continue;
     }
-    for (size_t j = 0; j < components.size(); ++j) {
-      base::TrimWhitespaceASCII(components[i], base::TRIM_ALL, &components[i]);
+    std::string key;
+    std::string value;
+    base::TrimWhitespaceASCII(line.substr(0, separator), base::TRIM_ALL, &key);
+    base::TrimWhitespaceASCII(line.substr(separator + 1), base::TRIM_ALL, &value);
+    if (key.empty() || value.empty()) {
+      LOG(ERROR) << "Error parsing line: " << line;
+      continue;
     }
 
-    std::string key = components[0]; 
-    std::string value = components[1]; 
     if (key.compare(kServerIp) == 0) {
       server_ip_port->first = value;
     } else if (key.compare(kServerPort) == 0) {
@@ -83,17 +82,16 @@ bool ReadServerIpAndPort(const base::FilePath& server_config_filepath,
         LOG(ERROR) << "Error parsing server port: " << value;
         return false;
       }
+    } else if (key.compare(kServerUnixSocket) == 0) {
+      server_ip_port->first =
+          std::string(browser_profiler::power_tool::kUnixSocketPrefix) + value;
     } else {
-      NOTREACHED();
+      LOG(WARNING) << "Unknown server config key: " << key;
     }
   }
   return true;
 }
 
-}  // namespace
-
-namespace browser_profiler {
-
 PowerToolController::Message::Message() {
 }
 
@@ -106,21 +104,22 @@ void PowerToolController::Message::Add(
   key_values_.push_back(std::pair<std::string, std::string>(key, value));
 }
 
-std::string PowerToolController::Message::ToString() const {
-  std::string message;
+bool PowerToolController::Message::Parse(const std::string& message) {
+  return power_tool::ParseMessage(message, &key_values_);
+}
 
-  for (size_t i = 0; i < key_values_.size(); ++i) {
-    message.append(
-        ComposeKeyValue(key_values_[i].first, key_values_[i].second).append(kNewLine));
-  }
-  message.append(kNewLine);
+bool PowerToolController::Message::Find(const std::string& key, std::string* value) const {
+  return power_tool::FindValue(key_values_, key, value);
+}
 
-  return message;
+std::string PowerToolController::Message::ToString() const {
+  return power_tool::ComposeMessage(key_values_);
 }
 
-PowerToolController::PowerToolController(const base::FilePath& server_config_filepath) {
+PowerToolController::PowerToolController(const base::FilePath& server_config_filepath)
+  : streaming_samples_(false) {
   std::pair<std::string, uint32_t> server_ip_port;
-  if (!ReadServerIpAndPort(server_config_filepath, &server_ip_port)) {
+  if (!ReadServerConfig(server_config_filepath, &server_ip_port)) {
     LOG(FATAL) << "Cannot read server config file at " << server_config_filepath.value();
   }
 
@@ -129,69 +128,166 @@ PowerToolController::PowerToolController(const base::FilePath& server_config_fil
   power_tool_connection_.reset(new PowerToolConnectionImpl(server_ip_port));
 }
 
+PowerToolController::PowerToolController(
+    const std::pair<std::string, uint32_t>& server_ip_port)
+  : power_tool_connection_(new PowerToolConnectionImpl(server_ip_port)),
+    streaming_samples_(false) {
+}
+
+PowerToolController::PowerToolController(PowerToolConnection* power_tool_connection)
+  : power_tool_connection_(power_tool_connection),
+    streaming_samples_(false) {
+}
 
-void PowerToolController::Connect() {
+bool PowerToolController::Connect() {
   if (!power_tool_connection_->Connect()) {
-    LOG(FATAL) << "Fail to connection to server";
+    LOG(ERROR) << "Fail to connection to server";
+    return false;
   }
+  return true;
 }
 
-bool PowerToolController::StartSampling() {
-  Message message(kCommandKey, kStartSamplingCommand);
+bool PowerToolController::StartSampling(double* first_sample_time, bool stream_samples) {
+  Message message(power_tool::kCommandKey, power_tool::kStartSamplingCommand);
+  message.Add(power_tool::kWaitForFirstSampleKey, "1");
+  if (stream_samples)
+    message.Add(power_tool::kStreamSamplesKey, "1");
 
-  if (!SyncSendAndCheckResponse(message.ToString())) {
-    LOG(ERROR) << "Failed to send " << kCommandKey;
+  Message response;
+  streaming_samples_ = false;
+  if (!SyncSendAndCheckResponse(message.ToString(), kStartSamplingTimeoutMillis, &response)) {
+    LOG(ERROR) << "Failed to send " << power_tool::kStartSamplingCommand;
     return false;
   }
 
-  // Wait some time for power tool to start
-  // Fix warning: approximate navigationStart to 0
-  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(550));
+  // Servers which do not stream ignore the request
+  std::string stream_samples_value;
+  streaming_samples_ = stream_samples &&
+      response.Find(power_tool::kStreamSamplesKey, &stream_samples_value) &&
+      stream_samples_value == "1";
+
+  std::string first_sample_time_value;
+  if (response.Find(power_tool::kFirstSampleTimeKey, &first_sample_time_value)) {
+    if (!base::StringToDouble(first_sample_time_value, first_sample_time)) {
+      LOG(ERROR) << "Invalid " << power_tool::kFirstSampleTimeKey << ": "
+          << first_sample_time_value;
+      return false;
+    }
+    return true;
+  }
+
+  // The server does not acknowledge the first sample, wait some time for power tool to start
+  *first_sample_time = 0;
+  base::PlatformThread::Sleep(
+      base::TimeDelta::FromMilliseconds(kLegacyStartSamplingDelayMillis));
   return true;
 }
 
 
-bool PowerToolController::SyncSendAndCheckResponse(const std::string& message) {
-  power_tool_connection_->SyncSendMessage(message);
+bool PowerToolController::SyncSendAndCheckResponse(const std::string& message,
+    int timeout_millis, Message* response, const std::vector<PowerSampleSink*>* sample_sinks) {
+  if (!power_tool_connection_->SyncSendMessage(message))
+    return false;
 
-  std::string response;
-  power_tool_connection_->SyncReceiveMessage(&response);
+  std::string response_message;
+  for (;;) {
+    response_message.clear();
+    bool received = timeout_millis > 0 ?
+        power_tool_connection_->SyncReceiveMessageWithTimeout(&response_message,
+            timeout_millis) :
+        power_tool_connection_->SyncReceiveMessage(&response_message);
+    if (!received)
+      return false;
+    if (!power_tool::IsSamplesMessage(response_message))
+      break;
+    if (sample_sinks && !AddStreamedSamples(response_message, *sample_sinks))
+      return false;
+  }
 
-  std::string::size_type blank_line = response.find(kBlankLine);
-  response = response.substr(0, blank_line);
+  Message parsed_response;
+  std::string status;
+  if (!parsed_response.Parse(response_message) ||
+      !parsed_response.Find(power_tool::kStatusKey, &status) ||
+      status.compare(power_tool::kOkValue) != 0) {
+    LOG(ERROR) << "Response message is not OK but: " << response_message;
+    return false;
+  }
 
-  std::vector<std::string> key_values =
-      base::SplitString(response, ":", base::WhitespaceHandling::TRIM_WHITESPACE,
-                        base::SplitResult::SPLIT_WANT_NONEMPTY);
+  if (response)
+    *response = parsed_response;
+  return true;
+}
 
-  if (!(key_values.size() == 2 && key_values[0].compare(kStatusKey) == 0 &&
-        key_values[1].compare(kOkValue) == 0)) {
-    LOG(ERROR) << "Response message is not OK but: " << response;
-    // return false;
+bool PowerToolController::AddStreamedSamples(const std::string& message,
+    const std::vector<PowerSampleSink*>& sample_sinks) {
+  // Skip the generic parser, a message has thousands of samples on one line
+  std::string::size_type begin = message.find(power_tool::kKeyValueSeparator);
+  std::string::size_type end = message.find(power_tool::kNewLine);
+  sample_times_.clear();
+  sample_watts_.clear();
+  if (begin == std::string::npos || end == std::string::npos || end < begin ||
+      !power_tool::ParseSamples(message.substr(begin + 1, end - begin - 1), &sample_times_,
+          &sample_watts_)) {
+    LOG(ERROR) << "Malformed " << power_tool::kSamplesKey << " message";
+    return false;
+  }
+  for (size_t i = 0; i < sample_sinks.size(); ++i) {
+    sample_sinks[i]->AddSamples(sample_times_.data(), sample_watts_.data(),
+        sample_times_.size());
   }
-
   return true;
 }
 
-bool PowerToolController::StopSampling(const std::string& result_keys, const std::string& result_values) {
+bool PowerToolController::StopSampling(const std::string& result_keys,
+    const std::string& result_values, const std::vector<PowerSampleSink*>& sample_sinks,
+    double* energy_joules, double* average_power_watts) {
   Message stop_sampling_message;
-  stop_sampling_message.Add(kCommandKey, kStopSamplingCommand);
-  stop_sampling_message.Add(kResultKeysKey, result_keys);
-  stop_sampling_message.Add(kResultValuesKey, result_values);
-
-  if (!SyncSendAndCheckResponse(stop_sampling_message.ToString())) {
+  stop_sampling_message.Add(power_tool::kCommandKey, power_tool::kStopSamplingCommand);
+  stop_sampling_message.Add(power_tool::kResultKeysKey, result_keys);
+  stop_sampling_message.Add(power_tool::kResultValuesKey, result_values);
+
+  Message response;
+  bool stopped = SyncSendAndCheckResponse(stop_sampling_message.ToString(), 0, &response,
+      streaming_samples_ ? &sample_sinks : nullptr);
+  streaming_samples_ = false;
+  if (!stopped) {
     LOG(ERROR) << "Failed to send stop sampling command";
     return false;
   }
 
+  *energy_joules = -1;
+  *average_power_watts = -1;
+  std::string value;
+  if (response.Find(power_tool::kEnergyKey, &value) &&
+      !base::StringToDouble(value, energy_joules)) {
+    LOG(ERROR) << "Invalid " << power_tool::kEnergyKey << ": " << value;
+    *energy_joules = -1;
+  }
+  if (response.Find(power_tool::kAveragePowerKey, &value) &&
+      !base::StringToDouble(value, average_power_watts)) {
+    LOG(ERROR) << "Invalid " << power_tool::kAveragePowerKey << ": " << value;
+    *average_power_watts = -1;
+  }
+
   return true;
 }
 
 bool PowerToolController::FinishAllExp() {
-  Message message(kCommandKey, kFinishAllExperimentsCommand);
+  Message message(power_tool::kCommandKey, power_tool::kFinishAllExperimentsCommand);
+
+  if (!SyncSendAndCheckResponse(message.ToString())) {
+    LOG(ERROR) << "Failed to send " << power_tool::kFinishAllExperimentsCommand;
+    return false;
+  }
+
+  return true;
+}
+
+bool PowerToolController::ShutdownRelay() {
+  Message message(power_tool::kCommandKey, power_tool::kShutdownRelayCommand);
 
   if (!SyncSendAndCheckResponse(message.ToString())) {
-    LOG(ERROR) << "Failed to send " << kFinishAllExperimentsCommand;
+    LOG(ERROR) << "Failed to send " << power_tool::kShutdownRelayCommand;
     return false;
   }
 
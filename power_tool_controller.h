@@ -11,8 +11,11 @@
 #endif
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "public/power_tool_connection.h"
+#include "power_sample_sink.h"
 #include "base/files/file_path.h"
 
 namespace browser_profiler {
@@ -23,23 +26,49 @@ namespace browser_profiler {
 //  Need portability: don't want to introduce dependency on external libraries
 class PowerToolController {
  public:
-  // init server ip and port from a file containing 1 line, server_ip:port
-  // 10.172.96.40:3000
+  // init server address from a config file of "key : value" lines
+  // server_ip : 10.172.96.40
+  // server_port : 3000
   PowerToolController(const base::FilePath& server_config_filepath);
 
-  // Connect to the server
-  void Connect();
+  // A server at this address and port, e.g., power_tool_relay
+  explicit PowerToolController(const std::pair<std::string, uint32_t>& server_ip_port);
 
-  bool StartSampling();
+  // Talk through this connection, e.g., SysfsPowerConnection, take its ownership
+  explicit PowerToolController(PowerToolConnection* power_tool_connection);
+
+  // Read the server address of a config file
+  // Return false if the file cannot be read or has an invalid port
+  static bool ReadServerConfig(const base::FilePath& server_config_filepath,
+      std::pair<std::string, uint32_t>* server_ip_port);
+
+  // Connect to the server, return true if succeed
+  bool Connect();
+
+  // Return once the server samples, which it acknowledges with the time of its first sample
+  // (server clock, seconds), or 0 if the server does not report it
+  // Ask the server to stream the samples if stream_samples, see streaming_samples()
+  // Return false on a non-OK status or if the acknowledgement does not come in time
+  bool StartSampling(double* first_sample_time, bool stream_samples);
+
+  // Whether the server streams the samples of the current sampling
+  bool streaming_samples() const { return streaming_samples_; }
 
   // Stop sampling with experiment result
   // exp_result_fields: tab-separated field names
   // exp_result_values: corresponding tab-separated values
+  // sample_sinks get the streamed samples, if any
+  // energy_joules, average_power_watts: of the load window, -1 if the server does not report them
   bool StopSampling(const std::string& exp_result_fields,
-        const std::string& exp_result_values);
+        const std::string& exp_result_values,
+        const std::vector<PowerSampleSink*>& sample_sinks, double* energy_joules,
+        double* average_power_watts);
 
   bool FinishAllExp();
 
+  // Ask tools/power_tool_relay to exit, e.g., after all experiments
+  bool ShutdownRelay();
+
  private:
   // Represents a message to send
   // Contains pairs of key-value of strings
@@ -51,6 +80,13 @@ class PowerToolController {
     // Add a pair of key-value to message
     void Add(const std::string& key, const std::string& value);
 
+    // Parse newline-separated key-values, e.g., a response
+    // Return false if a line is not a key-value
+    bool Parse(const std::string& message);
+
+    // Return false if there is no such key
+    bool Find(const std::string& key, std::string* value) const;
+
     // Return a message: newline-separated key-value
     // Ending by a blank line
     std::string ToString() const;
@@ -59,7 +95,16 @@ class PowerToolController {
   };
 
   // Send a message which is appended a blank line
-  bool SyncSendAndCheckResponse(const std::string& message);
+  // Wait for the response at most timeout_millis, 0 for the connection's default
+  // Samples streamed before the response go to sample_sinks if not null, otherwise are dropped
+  // Return true if its status is ok, response (if not null) gets its key-values
+  bool SyncSendAndCheckResponse(const std::string& message, int timeout_millis = 0,
+      Message* response = nullptr,
+      const std::vector<PowerSampleSink*>* sample_sinks = nullptr);
+
+  // Return false if the samples are malformed
+  bool AddStreamedSamples(const std::string& message,
+      const std::vector<PowerSampleSink*>& sample_sinks);
 
 #if defined(COMPILER_GCC) && __cplusplus >= 201103L && \
     (__GNUC__ * 10000 + __GNUC_MINOR__ * 100) >= 40900
@@ -67,6 +112,12 @@ class PowerToolController {
 #else
   scoped_ptr<PowerToolConnection> power_tool_connection_;
 #endif
+
+  bool streaming_samples_;
+
+  // Reused by each Samples message
+  std::vector<double> sample_times_;
+  std::vector<double> sample_watts_;
 };
 
 }  // namespace browser_profiler
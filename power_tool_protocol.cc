@@ -0,0 +1,277 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "power_tool_protocol.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace browser_profiler {
+namespace power_tool {
+
+const char kCommandKey[] = "Command";
+const char kStartSamplingCommand[] = "start_sampling";
+const char kStopSamplingCommand[] = "stop_sampling";
+const char kFinishAllExperimentsCommand[] = "finish_all_experiments";
+const char kPingCommand[] = "ping";
+const char kShutdownRelayCommand[] = "shutdown_relay";
+
+const char kResultKeysKey[] = "ResultKeys";
+const char kResultValuesKey[] = "ResultValues";
+
+const char kStatusKey[] = "Status";
+const char kOkValue[] = "ok";
+const char kErrorValue[] = "error";
+
+const char kWaitForFirstSampleKey[] = "WaitForFirstSample";
+const char kFirstSampleTimeKey[] = "FirstSampleTime";
+const char kStreamSamplesKey[] = "StreamSamples";
+const char kSamplesKey[] = "Samples";
+const char kEnergyKey[] = "Energy";
+const char kAveragePowerKey[] = "AveragePower";
+
+const char kKeyValueSeparator[] = ":";
+const char kNewLine[] = "\r\n";
+const char kBlankLine[] = "\r\n\r\n";
+
+const char kUnixSocketPrefix[] = "unix:";
+
+const char kDefaultRelayAddress[] = "unix:@browser_profiler_power_tool_relay";
+
+namespace {
+
+const size_t kReadChunkSize = 4096;
+
+std::string Trim(const std::string& text) {
+  const char kWhitespace[] = " \t\r\n";
+  std::string::size_type begin = text.find_first_not_of(kWhitespace);
+  if (begin == std::string::npos)
+    return std::string();
+  std::string::size_type end = text.find_last_not_of(kWhitespace);
+  return text.substr(begin, end - begin + 1);
+}
+
+// Fill a Unix socket address, return its length or 0 if the path is invalid
+socklen_t UnixAddress(const std::string& path, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (path.empty() || path.length() >= sizeof(address->sun_path))
+    return 0;
+  memcpy(address->sun_path, path.data(), path.length());
+  if (path[0] != '@')
+    return sizeof(*address);
+  // Abstract namespace, the name is not terminated
+  address->sun_path[0] = '\0';
+  return offsetof(struct sockaddr_un, sun_path) + path.length();
+}
+
+bool IsUnixAddress(const std::string& address) {
+  return address.compare(0, strlen(kUnixSocketPrefix), kUnixSocketPrefix) == 0;
+}
+
+// Create a socket for each address of host:port until setup() succeeds on one
+template <typename Setup>
+int ForEachAddress(const std::string& address, uint32_t port, bool passive, Setup setup) {
+  if (IsUnixAddress(address)) {
+    struct sockaddr_un unix_address;
+    socklen_t length = UnixAddress(address.substr(strlen(kUnixSocketPrefix)), &unix_address);
+    if (length == 0) {
+      fprintf(stderr, "Invalid unix socket path: %s\n", address.c_str());
+      return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && !setup(fd, reinterpret_cast<struct sockaddr*>(&unix_address), length)) {
+      close(fd);
+      fd = -1;
+    }
+    return fd;
+  }
+
+  std::string host = address;
+  if (host.length() > 2 && host[0] == '[' && host[host.length() - 1] == ']')
+    host = host.substr(1, host.length() - 2);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+  char port_string[16];
+  snprintf(port_string, sizeof(port_string), "%u", port);
+
+  struct addrinfo* addresses = nullptr;
+  int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port_string, &hints,
+      &addresses);
+  if (error != 0) {
+    fprintf(stderr, "Cannot resolve %s: %s\n", host.c_str(), gai_strerror(error));
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo* info = addresses; info != nullptr && fd < 0; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+    if (fd >= 0 && !setup(fd, info->ai_addr, info->ai_addrlen)) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  return fd;
+}
+
+}  // namespace
+
+std::string ComposeMessage(const KeyValues& key_values) {
+  std::string message;
+  for (size_t i = 0; i < key_values.size(); ++i) {
+    message.append(key_values[i].first).append(" ").append(kKeyValueSeparator).append(" ")
+        .append(key_values[i].second).append(kNewLine);
+  }
+  message.append(kNewLine);
+  return message;
+}
+
+bool ParseMessage(const std::string& message, KeyValues* key_values) {
+  key_values->clear();
+  std::string::size_type begin = 0;
+  while (begin < message.length()) {
+    std::string::size_type end = message.find(kNewLine, begin);
+    if (end == std::string::npos)
+      end = message.length();
+    std::string line = message.substr(begin, end - begin);
+    begin = end + strlen(kNewLine);
+
+    if (Trim(line).empty())
+      continue;
+    // Split at the first separator only, values may contain it
+    std::string::size_type separator = line.find(kKeyValueSeparator);
+    if (separator == std::string::npos)
+      return false;
+    key_values->push_back(std::make_pair(Trim(line.substr(0, separator)),
+        Trim(line.substr(separator + 1))));
+  }
+  return true;
+}
+
+bool FindValue(const KeyValues& key_values, const std::string& key, std::string* value) {
+  for (size_t i = 0; i < key_values.size(); ++i) {
+    if (key_values[i].first == key) {
+      *value = key_values[i].second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void AppendSamples(const double* times, const double* watts, size_t num_samples,
+    std::string* value) {
+  char sample[64];
+  for (size_t i = 0; i < num_samples; ++i) {
+    int length = snprintf(sample, sizeof(sample), "%s%.6f,%.6g", value->empty() ? "" : " ",
+        times[i], watts[i]);
+    value->append(sample, length);
+  }
+}
+
+bool ParseSamples(const std::string& value, std::vector<double>* times,
+    std::vector<double>* watts) {
+  const char* current = value.c_str();
+  for (;;) {
+    while (*current == ' ')
+      ++current;
+    if (*current == '\0')
+      return true;
+    char* end;
+    double time = strtod(current, &end);
+    if (end == current || *end != ',')
+      return false;
+    current = end + 1;
+    double power = strtod(current, &end);
+    if (end == current || (*end != ' ' && *end != '\0'))
+      return false;
+    current = end;
+    times->push_back(time);
+    watts->push_back(power);
+  }
+}
+
+bool IsSamplesMessage(const std::string& message) {
+  return message.compare(0, strlen(kSamplesKey), kSamplesKey) == 0;
+}
+
+bool ReadMessage(int fd, std::string* buffer, std::string* message) {
+  // Only scan the bytes which were not scanned yet
+  size_t scanned = 0;
+  const size_t blank_line_length = strlen(kBlankLine);
+  for (;;) {
+    std::string::size_type end = buffer->find(kBlankLine, scanned);
+    if (end != std::string::npos) {
+      message->assign(*buffer, 0, end + blank_line_length);
+      buffer->erase(0, end + blank_line_length);
+      return true;
+    }
+    if (buffer->length() >= blank_line_length)
+      scanned = buffer->length() - blank_line_length + 1;
+
+    char chunk[kReadChunkSize];
+    ssize_t num_read = read(fd, chunk, sizeof(chunk));
+    if (num_read < 0 && errno == EINTR)
+      continue;
+    if (num_read <= 0)
+      return false;
+    buffer->append(chunk, num_read);
+  }
+}
+
+bool WriteMessage(int fd, const std::string& message) {
+  size_t written = 0;
+  while (written < message.length()) {
+    ssize_t n = send(fd, message.data() + written, message.length() - written, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  return true;
+}
+
+int Listen(const std::string& address, uint32_t port) {
+  if (IsUnixAddress(address) && address[strlen(kUnixSocketPrefix)] != '@') {
+    int owner_fd = Connect(address, port);
+    if (owner_fd >= 0) {
+      close(owner_fd);
+      errno = EADDRINUSE;
+      return -1;
+    }
+    // A stale socket file of a previous run
+    unlink(address.c_str() + strlen(kUnixSocketPrefix));
+  }
+  return ForEachAddress(address, port, true,
+      [](int fd, const struct sockaddr* addr, socklen_t length) {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        return bind(fd, addr, length) == 0 && listen(fd, 16) == 0;
+      });
+}
+
+int Connect(const std::string& address, uint32_t port) {
+  return ForEachAddress(address, port, false,
+      [](int fd, const struct sockaddr* addr, socklen_t length) {
+        int result;
+        do {
+          result = connect(fd, addr, length);
+        } while (result < 0 && errno == EINTR);
+        return result == 0;
+      });
+}
+
+}  // namespace power_tool
+}  // namespace browser_profiler
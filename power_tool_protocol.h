@@ -0,0 +1,108 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_POWER_TOOL_PROTOCOL_H_
+#define BROWSER_PROFILER_POWER_TOOL_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace browser_profiler {
+namespace power_tool {
+
+// Protocol between PowerToolController and the power tool server,
+// also spoken by the tools standing in for it (tools/power_tool_mock_server)
+// Only depends on POSIX so that the tools build anywhere
+//
+// A message is "KEY : VALUE" lines ended by "\r\n", and a blank line
+// Client: Command : start_sampling [WaitForFirstSample : 1] [StreamSamples : 1]
+//   Server: Status : ok [FirstSampleTime : <server clock, s>], once sampling if asked to
+//     [StreamSamples : 1], if it streams the samples
+// Client: Command : stop_sampling, ResultKeys : <tab-separated>, ResultValues : <tab-separated>
+//   Server: Status : ok [Energy : <J>, AveragePower : <W>], of the load window if measured
+// While streaming, the server sends messages of samples, without status, until its
+// response to stop_sampling: Samples : <time>,<watts> <time>,<watts> ... (server clock, s)
+// The client reads them as they come, before that response
+// Client: Command : finish_all_experiments
+//   Server: Status : ok
+// Any other status is an error
+
+extern const char kCommandKey[];
+extern const char kStartSamplingCommand[];
+extern const char kStopSamplingCommand[];
+extern const char kFinishAllExperimentsCommand[];
+// Not sent by the profiler, answered with Status : ok, for benchmarks
+extern const char kPingCommand[];
+// Answered and obeyed by tools/power_tool_relay, not forwarded
+extern const char kShutdownRelayCommand[];
+
+extern const char kResultKeysKey[];
+extern const char kResultValuesKey[];
+
+extern const char kStatusKey[];
+extern const char kOkValue[];
+extern const char kErrorValue[];
+
+extern const char kWaitForFirstSampleKey[];
+extern const char kFirstSampleTimeKey[];
+extern const char kStreamSamplesKey[];
+extern const char kSamplesKey[];
+extern const char kEnergyKey[];
+extern const char kAveragePowerKey[];
+
+extern const char kKeyValueSeparator[];
+extern const char kNewLine[];
+extern const char kBlankLine[];
+
+// Address of a server: "unix:<path>", "unix:@<abstract name>", or a host and a port
+extern const char kUnixSocketPrefix[];
+
+// Where tools/power_tool_relay listens by default
+extern const char kDefaultRelayAddress[];
+
+typedef std::vector<std::pair<std::string, std::string>> KeyValues;
+
+// Lines of key-values, ended by a blank line
+std::string ComposeMessage(const KeyValues& key_values);
+
+// Parse a message with or without its blank line
+// Return false if a line is not a key-value
+bool ParseMessage(const std::string& message, KeyValues* key_values);
+
+// Return false if there is no such key
+bool FindValue(const KeyValues& key_values, const std::string& key, std::string* value);
+
+// Append the samples to the value of a Samples message
+void AppendSamples(const double* times, const double* watts, size_t num_samples,
+    std::string* value);
+
+// Append the samples of the value of a Samples message
+// Return false if a sample is malformed
+bool ParseSamples(const std::string& value, std::vector<double>* times,
+    std::vector<double>* watts);
+
+// Whether a message is a Samples message, without parsing it
+bool IsSamplesMessage(const std::string& message);
+
+// Read a whole message, blocking, from a buffered socket
+// buffer keeps the bytes received after the message
+// Return false on error or end of stream
+bool ReadMessage(int fd, std::string* buffer, std::string* message);
+
+// Return false on error
+bool WriteMessage(int fd, const std::string& message);
+
+// Return a listening socket or -1, with errno EADDRINUSE if a server owns the address
+int Listen(const std::string& address, uint32_t port);
+
+// Return a connected (blocking) socket or -1
+int Connect(const std::string& address, uint32_t port);
+
+}  // namespace power_tool
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_POWER_TOOL_PROTOCOL_H_
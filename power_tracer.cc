@@ -0,0 +1,402 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "power_tracer.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "clock_aligner.h"
+#include "clock_domain.h"
+#include "experiment_result.h"
+#include "power_sample_recorder.h"
+#include "power_tool_protocol.h"
+#include "root_command_runner.h"
+#include "sysfs_power_connection.h"
+#include "public/browser_profiler.h"
+
+#include "base/command_line.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/process/launch.h"
+#include "base/process/process.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/threading/platform_thread.h"
+#include "base/third_party/android_cpu_tools/src/cpu_info/cpu_info.h"
+#include "base/third_party/android_cpu_tools/src/workload_generator/workload_generator.h"
+#include "base/time/time.h"
+
+namespace {
+
+// 63 chips
+const int kSyncPatternDegree = 6;
+const double kDefaultSyncChipSeconds = 0.005;
+// A few samples per chip even for slow meters
+const double kMinSyncChipSeconds = 0.001;
+const double kMaxSyncChipSeconds = 0.02;
+const double kSyncChipShrinkFactor = 0.8;
+const double kSyncChipGrowthFactor = 1.5;
+
+// Below it, the pattern is not trusted and the coarse offset is kept
+const double kMinAlignmentConfidence = 0.5;
+// Above it, the pattern stands out enough to try shorter chips
+const double kHighAlignmentConfidence = 0.8;
+
+// The coarse offset is off by the latency of the start acknowledgement
+const int kMaxCoarseClockErrorMillis = 100;
+
+// The relay listens before it detaches, it is reachable once launched
+const int kRelayConnectRetries = 3;
+const int kRelayConnectRetryMillis = 50;
+
+}  // namespace
+
+namespace browser_profiler {
+
+const char PowerTracer::kClockOffsetMetric[] = "Power Clock Offset (s)";
+
+PowerTracer::Config::Config()
+  : sample_rate_hz(SysfsPowerSampler::kDefaultSampleRateHz),
+    stream_samples(true) {
+}
+
+PowerTracer::PowerTracer(const Config& config)
+  : config_(config),
+    use_relay_(false),
+    sampling_(false),
+    logged_legacy_sync_(false),
+    first_sample_time_metric_(ExperimentResult::kInvalidMetric),
+    start_latency_metric_(ExperimentResult::kInvalidMetric),
+    server_clock_offset_(0),
+    sync_pattern_(kSyncPatternDegree),
+    sync_chip_seconds_(kDefaultSyncChipSeconds),
+    clock_offset_metric_(ExperimentResult::kInvalidMetric),
+    alignment_confidence_metric_(ExperimentResult::kInvalidMetric) {
+}
+
+PowerTracer::~PowerTracer() {
+}
+
+std::vector<std::string> PowerTracer::output_artifacts() const {
+  return std::vector<std::string>();
+}
+
+void PowerTracer::RegisterMetrics(ExperimentResult* experiment_result) {
+  // Server clock
+  first_sample_time_metric_ = experiment_result->RegisterMetric(
+      "Power First Sample Time (s)", ExperimentResult::kTimestampMetric);
+  start_latency_metric_ = experiment_result->RegisterMetric(
+      "Power Start Latency (ms)", ExperimentResult::kDoubleMetric);
+
+  // Device clock - meter clock, by the sync pattern
+  clock_offset_metric_ = experiment_result->RegisterMetric(
+      kClockOffsetMetric, ExperimentResult::kTimestampMetric);
+  alignment_confidence_metric_ = experiment_result->RegisterMetric(
+      "Power Clock Alignment Confidence", ExperimentResult::kDoubleMetric);
+}
+
+bool PowerTracer::Initialize(const TracerContext& context) {
+  // Chips calibrated by the previous experiments on this device
+  std::string calibration;
+  double chip_millis;
+  if (!config_.sync_calibration_file.empty() &&
+      base::ReadFileToString(config_.sync_calibration_file, &calibration) &&
+      base::StringToDouble(calibration, &chip_millis)) {
+    sync_chip_seconds_ = std::max(kMinSyncChipSeconds,
+        std::min(kMaxSyncChipSeconds, chip_millis / 1000));
+  }
+
+  if (!config_.sysfs_root.empty()) {
+    sysfs_power_sampler_.reset(new SysfsPowerSampler(config_.sysfs_root,
+        config_.sample_rate_hz, SysfsPowerSampler::kDefaultBufferSeconds));
+    return sysfs_power_sampler_->Initialize();
+  }
+
+  // The relay outlives browser restarts, later processes just reconnect
+  if (!config_.relay_executable.empty()) {
+    use_relay_ = ConnectOrLaunchRelay();
+    if (!use_relay_)
+      LOG(WARNING) << "Power tool relay is not available, connect to the server directly";
+  }
+  return true;
+}
+
+bool PowerTracer::ConnectOrLaunchRelay() {
+  std::pair<std::string, uint32_t> relay_address(power_tool::kDefaultRelayAddress, 0);
+
+  // Usually running already: launched by an earlier browser process of this campaign
+  if (PowerToolController(relay_address).Connect())
+    return true;
+
+  std::pair<std::string, uint32_t> server_ip_port;
+  if (!PowerToolController::ReadServerConfig(config_.server_config_file, &server_ip_port))
+    return false;
+
+  base::CommandLine relay_cmd(config_.relay_executable);
+  relay_cmd.AppendArg("--server=" + server_ip_port.first);
+  relay_cmd.AppendArg("--port=" + base::UintToString(server_ip_port.second));
+  relay_cmd.AppendArg("--allowed-uid=" + base::UintToString(getuid()));
+  relay_cmd.AppendArg("--daemonize");
+  VLOG(1) << "Launch power tool relay: " << relay_cmd.GetCommandLineString();
+
+  base::Process process = base::LaunchProcess(relay_cmd, base::LaunchOptions());
+  int exit_code = -1;
+  if (!process.IsValid() || !process.WaitForExit(&exit_code) || exit_code != 0) {
+    LOG(ERROR) << "Cannot launch power tool relay at " << config_.relay_executable.value();
+    return false;
+  }
+
+  for (int i = 0; i < kRelayConnectRetries; ++i) {
+    if (PowerToolController(relay_address).Connect())
+      return true;
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kRelayConnectRetryMillis));
+  }
+  LOG(ERROR) << "Power tool relay launched but not reachable";
+  return false;
+}
+
+PowerToolController* PowerTracer::NewPowerToolController() const {
+  if (sysfs_power_sampler_)
+    return new PowerToolController(new SysfsPowerConnection(sysfs_power_sampler_.get()));
+  if (use_relay_) {
+    return new PowerToolController(
+        std::pair<std::string, uint32_t>(power_tool::kDefaultRelayAddress, 0));
+  }
+  return new PowerToolController(config_.server_config_file);
+}
+
+void PowerTracer::Prepare(const TracerContext& context) {
+  // Use Delegation/Factory method design pattern when there is another power tool controller
+  power_tool_controller_.reset(NewPowerToolController());
+
+  // Connect here, at preparation step to avoid delay later
+  // The experiment runs again in a new browser, which connects again
+  if (!power_tool_controller_->Connect()) {
+    LOG(ERROR) << "Cannot connect to the power tool server";
+    context.experiment_result->MarkFailed("power tool server is not reachable");
+    power_tool_controller_.reset();
+  }
+}
+
+bool PowerTracer::IsReady() const {
+  return power_tool_controller_ != nullptr;
+}
+
+void PowerTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  double start_time = MonotonicNow();
+  double first_sample_time = 0;
+  sampling_ = power_tool_controller_->StartSampling(&first_sample_time, config_.stream_samples);
+  if (!sampling_) {
+    context.experiment_result->MarkFailed("power sampling did not start");
+    done();
+    return;
+  }
+
+  double acknowledged_time = MonotonicNow();
+  context.experiment_result->SetDouble(start_latency_metric_,
+      (acknowledged_time - start_time) * 1000);
+  // The acknowledgement comes with the first sample, off by the latency of the reply
+  server_clock_offset_ = 0;
+  if (first_sample_time > 0) {
+    context.experiment_result->SetDouble(first_sample_time_metric_, first_sample_time);
+    server_clock_offset_ = acknowledged_time - first_sample_time;
+  }
+  done();
+}
+
+void PowerTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  // The experiment is discarded already
+  if (!sampling_) {
+    done();
+    return;
+  }
+  sampling_ = false;
+
+  context.client->CloseActiveShell(); // reduce power noise
+
+  // Same clock as the load window
+  if (sysfs_power_sampler_) {
+    StopSamplingAndRecordEnergy(context, 0);
+    done();
+    return;
+  }
+
+  // wait 500ms for other threads to finish
+  // hotfix: sleep on Java layer instead of here?
+  // base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(500));
+
+  context.root_runner->Run(*context.sync_workload_cpu_setup_command);
+
+  // The streamed samples align the clocks right away: a short burst pattern is enough
+  if (power_tool_controller_->streaming_samples()) {
+    double sync_pattern_start_time = RunSyncPattern();
+    // The samples of the pattern come until the largest error of the coarse offset
+    base::PlatformThread::Sleep(
+        base::TimeDelta::FromMilliseconds(kMaxCoarseClockErrorMillis));
+    context.root_runner->Run(*context.default_cpu_setup_command);
+    StopSamplingAndRecordEnergy(context, sync_pattern_start_time);
+    done();
+    return;
+  }
+
+  // Legacy server: the sync workload marks the end of the trial in the power trace
+  if (config_.stream_samples && !logged_legacy_sync_) {
+    LOG(WARNING) << "Power tool server does not stream samples, align with the sync workload";
+    logged_legacy_sync_ = true;
+  }
+
+  // Run a single thread (avoid thread migration issues)
+  // on max core id (typically a big core)
+  // Run a 0.9 sec workload Exynos 5422
+  android_cpu_tools::WorkloadGenerator::RunWorkload(
+      std::vector<size_t>(1, android_cpu_tools::CommandLineCpuInfo::MaxCoreId()),
+      15000);
+
+  double sync_workload_end_time = MonotonicNow();
+
+  // wait for cpu usage to drop
+  base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1000));
+
+  // set back to default power management in case we test other things
+  context.root_runner->Run(*context.default_cpu_setup_command);
+
+  // stop sampling first, avoid the rising of cpu power in the end of power trace
+  context.experiment_result->SetDouble(
+      ExperimentResult::kSyncWorkloadEndTime, sync_workload_end_time);
+
+  StopSamplingAndRecordEnergy(context, 0);
+  done();
+}
+
+double PowerTracer::RunSyncPattern() const {
+  // Single thread on max core id (typically a big core), no migration
+  cpu_set_t previous_cpus;
+  cpu_set_t max_core;
+  CPU_ZERO(&max_core);
+  CPU_SET(android_cpu_tools::CommandLineCpuInfo::MaxCoreId(), &max_core);
+  bool pinned = sched_getaffinity(0, sizeof(previous_cpus), &previous_cpus) == 0 &&
+      sched_setaffinity(0, sizeof(max_core), &max_core) == 0;
+  if (!pinned)
+    PLOG(WARNING) << "Cannot pin the sync pattern to the max core";
+
+  double start_time = sync_pattern_.Run(sync_chip_seconds_);
+
+  if (pinned)
+    sched_setaffinity(0, sizeof(previous_cpus), &previous_cpus);
+  return start_time;
+}
+
+void PowerTracer::CalibrateSyncPattern(double confidence) {
+  double chip_seconds = sync_chip_seconds_;
+  if (confidence >= kHighAlignmentConfidence)
+    chip_seconds *= kSyncChipShrinkFactor;
+  else if (confidence < kMinAlignmentConfidence)
+    chip_seconds *= kSyncChipGrowthFactor;
+  chip_seconds = std::max(kMinSyncChipSeconds, std::min(kMaxSyncChipSeconds, chip_seconds));
+  if (chip_seconds == sync_chip_seconds_)
+    return;
+
+  VLOG(1) << "Sync pattern chip: " << chip_seconds * 1000 << " ms";
+  sync_chip_seconds_ = chip_seconds;
+  if (config_.sync_calibration_file.empty())
+    return;
+  std::string calibration = base::DoubleToString(chip_seconds * 1000);
+  if (base::WriteFile(config_.sync_calibration_file, calibration.data(),
+          calibration.size()) != static_cast<int>(calibration.size())) {
+    LOG(ERROR) << "Cannot write " << config_.sync_calibration_file.value();
+  }
+}
+
+void PowerTracer::StopSamplingAndRecordEnergy(const TracerContext& context,
+    double sync_pattern_start_time) {
+  ExperimentResult* result = context.experiment_result;
+  bool streaming = power_tool_controller_->streaming_samples();
+  bool align = streaming && sync_pattern_start_time > 0;
+  double max_error = align ? kMaxCoarseClockErrorMillis / 1000.0 : 0;
+  std::vector<PowerSampleSink*> sample_sinks;
+
+  // The load window on the server clock, by the coarse offset
+  std::unique_ptr<PowerWindowIntegrator> load_window;
+  double load_start_time = result->GetNumber(ExperimentResult::kLoadStartTime);
+  double load_end_time = result->GetNumber(ExperimentResult::kLoadEndTime);
+  if (streaming && result->IsSet(ExperimentResult::kLoadStartTime) &&
+      result->IsSet(ExperimentResult::kLoadEndTime)) {
+    load_window.reset(new PowerWindowIntegrator(load_start_time - server_clock_offset_,
+        load_end_time - server_clock_offset_, max_error));
+    sample_sinks.push_back(load_window.get());
+  }
+
+  ClockAligner aligner(sync_pattern_, sync_chip_seconds_);
+  std::unique_ptr<PowerSampleRecorder> sync_pattern_samples;
+  if (align) {
+    sync_pattern_samples.reset(new PowerSampleRecorder(
+        aligner.SearchBeginTime(sync_pattern_start_time, server_clock_offset_, max_error),
+        aligner.SearchEndTime(sync_pattern_start_time, server_clock_offset_, max_error)));
+    sample_sinks.push_back(sync_pattern_samples.get());
+  }
+
+  double energy_joules;
+  double average_power_watts;
+  if (!power_tool_controller_->StopSampling(result->LogHeaderLine(), result->LogLine(),
+        sample_sinks, &energy_joules, &average_power_watts)) {
+    result->MarkFailed("power sampling did not stop");
+    return;
+  }
+
+  double clock_offset = server_clock_offset_;
+  if (sync_pattern_samples) {
+    double aligned_offset;
+    double confidence;
+    if (aligner.Align(sync_pattern_start_time, sync_pattern_samples->times().data(),
+            sync_pattern_samples->watts().data(), sync_pattern_samples->times().size(),
+            server_clock_offset_, max_error, &aligned_offset, &confidence)) {
+      result->SetDouble(alignment_confidence_metric_, confidence);
+      if (confidence >= kMinAlignmentConfidence)
+        clock_offset = aligned_offset;
+      else
+        LOG(WARNING) << "Sync pattern not found in the power trace, confidence " << confidence;
+      CalibrateSyncPattern(confidence);
+    } else {
+      LOG(WARNING) << "Streamed power samples do not span the sync pattern";
+    }
+    result->SetDouble(clock_offset_metric_, clock_offset);
+  }
+
+  // The server knows best, otherwise integrate the streamed samples
+  if (energy_joules < 0 && load_window) {
+    VLOG(1) << "Integrated " << load_window->num_samples() << " streamed power samples";
+    if (load_window->ShiftedEnergy(server_clock_offset_ - clock_offset, &energy_joules)) {
+      average_power_watts = energy_joules / (load_end_time - load_start_time);
+    } else {
+      LOG(WARNING) << "Streamed power samples do not cover the load window";
+      energy_joules = -1;
+    }
+  }
+  if (energy_joules >= 0)
+    result->SetDouble(ExperimentResult::kEnergy, energy_joules);
+  if (average_power_watts >= 0)
+    result->SetDouble(ExperimentResult::kAveragePower, average_power_watts);
+}
+
+void PowerTracer::FinishAllExperiments(const TracerContext& context) {
+  // Create a new connection when all experiments finished
+  power_tool_controller_.reset(NewPowerToolController());
+  if (!power_tool_controller_->Connect())
+    LOG(FATAL) << "Cannot connect to the power tool server";
+
+  if (!power_tool_controller_->FinishAllExp()) {
+    LOG(FATAL) << "Cannot send finish all experiments command";
+  }
+
+  // End of the campaign, the next one launches its own relay
+  if (use_relay_ && !power_tool_controller_->ShutdownRelay())
+    LOG(ERROR) << "Cannot shut down the power tool relay";
+
+  // Disconnect the connection to the server
+  power_tool_controller_.reset();
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,126 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_POWER_TRACER_H_
+#define BROWSER_PROFILER_POWER_TRACER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "experiment_result.h"
+#include "power_tool_controller.h"
+#include "power_window_integrator.h"
+#include "sync_pattern.h"
+#include "sysfs_power_sampler.h"
+#include "tracer.h"
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Samples power through the power tool server (an external power meter)
+// The end of the page load is marked in the power trace by a sync workload
+//
+// With a relay executable, goes through tools/power_tool_relay, launched by the first
+// browser process of the campaign, so each experiment only connects to a local socket
+//
+// With a sysfs root, samples powercap and power_supply in process instead (SysfsPowerSampler),
+// on the clock of the result: no server, no sync workload
+//
+// The energy of the load window comes from the server if it reports it, otherwise
+// from the samples the server streams, integrated as they come (PowerWindowIntegrator)
+// Streamed samples also align the clocks: a short pseudo-random burst pattern (SyncPattern)
+// is found in the trace (ClockAligner) instead of running the long sync workload for the
+// server; its chips shorten or lengthen with the confidence of the alignment, per device
+class PowerTracer : public Tracer {
+ public:
+  struct Config {
+    Config();
+
+    base::FilePath server_config_file;
+    // Empty: connect to the server directly
+    base::FilePath relay_executable;
+    // Empty: use the power tool server
+    base::FilePath sysfs_root;
+    double sample_rate_hz;
+    // Ask the server to stream its samples, servers which do not stream ignore it
+    bool stream_samples;
+    // Keeps the chip duration of the sync pattern across experiments, may be empty
+    base::FilePath sync_calibration_file;
+  };
+
+  // Device clock - meter clock (s), e.g., to align the power trace (TimelineTracer)
+  static const char kClockOffsetMetric[];
+
+  explicit PowerTracer(const Config& config);
+  ~PowerTracer() override;
+
+  // Tracer
+  std::string name() const override { return "power"; }
+  // Might break app --> start this first, if it breaks, other things have not been started
+  StartStage start_stage() const override { return kPowerStage; }
+  // Alone in its stage: the sync workload must not compete with other tracers
+  StopStage stop_stage() const override { return kPowerStopStage; }
+  Overhead expected_overhead() const override { return kNegligibleOverhead; }
+  // The power trace is kept by the server
+  std::vector<std::string> output_artifacts() const override;
+  bool runs_on_calling_thread() const override { return true; }
+  void RegisterMetrics(ExperimentResult* experiment_result) override;
+  bool Initialize(const TracerContext& context) override;
+  void Prepare(const TracerContext& context) override;
+  bool IsReady() const override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  void FinishAllExperiments(const TracerContext& context) override;
+
+ private:
+  // Connect to a running relay, launch it first if it is not running
+  // Return true if the relay is reachable
+  bool ConnectOrLaunchRelay();
+
+  // Run the sync pattern on the max core, return its start time
+  double RunSyncPattern() const;
+
+  // Adapt the chip duration of the sync pattern to the confidence of an alignment
+  void CalibrateSyncPattern(double confidence);
+
+  // Send the result, which has the load window, record the energy of the window if known
+  // Align the clocks with the sync pattern if it started at sync_pattern_start_time (not 0)
+  // Mark the result failed if sampling does not stop
+  void StopSamplingAndRecordEnergy(const TracerContext& context,
+      double sync_pattern_start_time);
+
+  // Through the sysfs sampler, or the relay if it is reachable
+  PowerToolController* NewPowerToolController() const;
+
+  const Config config_;
+  bool use_relay_;
+  std::unique_ptr<SysfsPowerSampler> sysfs_power_sampler_;
+  std::unique_ptr<PowerToolController> power_tool_controller_;
+
+  // Sampling started in this experiment
+  bool sampling_;
+
+  // Once per browser process: the server ignored the request to stream
+  bool logged_legacy_sync_;
+
+  ExperimentResult::Metric first_sample_time_metric_;
+  ExperimentResult::Metric start_latency_metric_;
+
+  // Client clock minus server clock, measured when sampling starts
+  double server_clock_offset_;
+
+  const SyncPattern sync_pattern_;
+  double sync_chip_seconds_;
+
+  ExperimentResult::Metric clock_offset_metric_;
+  ExperimentResult::Metric alignment_confidence_metric_;
+
+  DISALLOW_COPY_AND_ASSIGN(PowerTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_POWER_TRACER_H_
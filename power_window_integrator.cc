@@ -0,0 +1,147 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "power_window_integrator.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "power_sample_recorder.h"
+
+namespace {
+
+// Independent partial sums, so that the loop has no carried dependency
+// and the compiler can vectorize it
+const size_t kNumLanes = 4;
+
+}  // namespace
+
+namespace browser_profiler {
+
+PowerWindowIntegrator::PowerWindowIntegrator(double begin_time, double end_time,
+    double max_shift)
+  : begin_time_(begin_time),
+    end_time_(end_time),
+    max_shift_(max_shift),
+    energy_joules_(0),
+    num_samples_(0),
+    first_time_(0),
+    last_time_(0),
+    last_watts_(0) {
+  if (max_shift_ > 0) {
+    begin_samples_.reset(new PowerSampleRecorder(begin_time_ - max_shift_,
+        begin_time_ + max_shift_));
+    end_samples_.reset(new PowerSampleRecorder(end_time_ - max_shift_, end_time_ + max_shift_));
+  }
+}
+
+PowerWindowIntegrator::~PowerWindowIntegrator() {
+}
+
+// static
+double PowerWindowIntegrator::TrapezoidEnergy(const double* times, const double* watts,
+    size_t num_samples) {
+  if (num_samples < 2)
+    return 0;
+
+  double sums[kNumLanes] = {};
+  size_t num_segments = num_samples - 1;
+  size_t i = 0;
+  for (; i + kNumLanes <= num_segments; i += kNumLanes) {
+    for (size_t lane = 0; lane < kNumLanes; ++lane) {
+      size_t j = i + lane;
+      sums[lane] += (watts[j] + watts[j + 1]) * (times[j + 1] - times[j]);
+    }
+  }
+  for (; i < num_segments; ++i)
+    sums[0] += (watts[i] + watts[i + 1]) * (times[i + 1] - times[i]);
+
+  double sum = 0;
+  for (size_t lane = 0; lane < kNumLanes; ++lane)
+    sum += sums[lane];
+  return 0.5 * sum;
+}
+
+// static
+double PowerWindowIntegrator::SegmentEnergy(double time0, double watts0, double time1,
+    double watts1, double begin_time, double end_time) {
+  double begin = std::max(time0, begin_time);
+  double end = std::min(time1, end_time);
+  if (end <= begin)
+    return 0;
+  double slope = (watts1 - watts0) / (time1 - time0);
+  double begin_watts = watts0 + slope * (begin - time0);
+  double end_watts = watts0 + slope * (end - time0);
+  return 0.5 * (begin_watts + end_watts) * (end - begin);
+}
+
+// static
+double PowerWindowIntegrator::ClippedEnergy(const double* times, const double* watts,
+    size_t num_samples, double begin_time, double end_time) {
+  // Samples [first, last) are between the times, the segments between them are whole
+  size_t first = std::lower_bound(times, times + num_samples, begin_time) - times;
+  size_t last = std::upper_bound(times, times + num_samples, end_time) - times;
+  double energy = 0;
+  if (last > first)
+    energy += TrapezoidEnergy(times + first, watts + first, last - first);
+
+  // Segments crossing the times
+  if (first > 0 && first < num_samples) {
+    energy += SegmentEnergy(times[first - 1], watts[first - 1], times[first], watts[first],
+        begin_time, end_time);
+  }
+  if (last > 0 && last < num_samples && last != first) {
+    energy += SegmentEnergy(times[last - 1], watts[last - 1], times[last], watts[last],
+        begin_time, end_time);
+  }
+  return energy;
+}
+
+void PowerWindowIntegrator::AddSamples(const double* times, const double* watts,
+    size_t num_samples) {
+  if (num_samples == 0)
+    return;
+
+  if (num_samples_ == 0) {
+    first_time_ = times[0];
+  } else {
+    energy_joules_ += SegmentEnergy(last_time_, last_watts_, times[0], watts[0],
+        begin_time_, end_time_);
+  }
+  energy_joules_ += ClippedEnergy(times, watts, num_samples, begin_time_, end_time_);
+
+  if (begin_samples_) {
+    begin_samples_->AddSamples(times, watts, num_samples);
+    end_samples_->AddSamples(times, watts, num_samples);
+  }
+
+  num_samples_ += num_samples;
+  last_time_ = times[num_samples - 1];
+  last_watts_ = watts[num_samples - 1];
+}
+
+bool PowerWindowIntegrator::covers_window() const {
+  return num_samples_ > 0 && first_time_ <= begin_time_ && last_time_ >= end_time_;
+}
+
+double PowerWindowIntegrator::average_power_watts() const {
+  return end_time_ > begin_time_ ? energy_joules_ / (end_time_ - begin_time_) : 0;
+}
+
+bool PowerWindowIntegrator::ShiftedEnergy(double shift, double* energy_joules) const {
+  if (shift == 0) {
+    *energy_joules = energy_joules_;
+    return covers_window();
+  }
+  if (!begin_samples_ || fabs(shift) > max_shift_ ||
+      !begin_samples_->Covers(begin_time_, begin_time_ + shift) ||
+      !end_samples_->Covers(end_time_, end_time_ + shift)) {
+    return false;
+  }
+  *energy_joules = energy_joules_ - begin_samples_->Energy(begin_time_, begin_time_ + shift) +
+      end_samples_->Energy(end_time_, end_time_ + shift);
+  return true;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,79 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_POWER_WINDOW_INTEGRATOR_H_
+#define BROWSER_PROFILER_POWER_WINDOW_INTEGRATOR_H_
+
+#include <stddef.h>
+
+#include <memory>
+
+#include "power_sample_sink.h"
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+class PowerSampleRecorder;
+
+// Energy of a time window, integrated online from batches of power samples
+// as they are streamed: only the samples around the window ends are kept
+// Samples come in time order; the power is linear between two samples (trapezoids),
+// the segments crossing the window ends are cut by interpolation
+//
+// The window may be shifted by up to max_shift afterwards, e.g., once the clocks are aligned
+class PowerWindowIntegrator : public PowerSampleSink {
+ public:
+  // Times on the clock of the samples, in seconds
+  PowerWindowIntegrator(double begin_time, double end_time, double max_shift);
+  ~PowerWindowIntegrator() override;
+
+  // PowerSampleSink
+  void AddSamples(const double* times, const double* watts, size_t num_samples) override;
+
+  // Whether the samples span the whole window
+  bool covers_window() const;
+
+  double energy_joules() const { return energy_joules_; }
+  // Over the window
+  double average_power_watts() const;
+  size_t num_samples() const { return num_samples_; }
+
+  // Energy of the window moved by shift seconds
+  // Return false if |shift| > max_shift or the samples do not span the moved window
+  bool ShiftedEnergy(double shift, double* energy_joules) const;
+
+  // Trapezoid integral of the samples, in joules
+  static double TrapezoidEnergy(const double* times, const double* watts, size_t num_samples);
+
+  // Trapezoid integral of the samples between two times
+  static double ClippedEnergy(const double* times, const double* watts, size_t num_samples,
+      double begin_time, double end_time);
+
+ private:
+  // Integral of the segment between two samples which is between two times
+  static double SegmentEnergy(double time0, double watts0, double time1, double watts1,
+      double begin_time, double end_time);
+
+  double begin_time_;
+  double end_time_;
+  double max_shift_;
+
+  double energy_joules_;
+  size_t num_samples_;
+  double first_time_;
+
+  // The last sample, the first segment of the next batch starts there
+  double last_time_;
+  double last_watts_;
+
+  // Samples within max_shift of the window ends, null if max_shift is 0
+  std::unique_ptr<PowerSampleRecorder> begin_samples_;
+  std::unique_ptr<PowerSampleRecorder> end_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(PowerWindowIntegrator);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_POWER_WINDOW_INTEGRATOR_H_
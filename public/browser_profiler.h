@@ -96,6 +96,15 @@ class BrowserProfilerClient {
   // Close the currently active shell
   virtual void CloseActiveShell() = 0;
 
+  // Optional, for in-session trials (without a browser restart)
+  // Open a new shell which loads the url from BrowserProfiler::Prepare(), may be asynchronous
+  // Return false if not supported
+  virtual bool OpenExperimentShell() { return false; }
+
+  // Optional, for in-session trials with a cleared cache
+  // Return false if not supported
+  virtual bool ClearHttpCache() { return false; }
+
   // Get an instance of Internal Tracing Controller
   virtual std::shared_ptr<InternalTracingController> GetInternalTracingControllerInstance() {
     return nullptr;
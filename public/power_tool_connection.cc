@@ -13,4 +13,9 @@ PowerToolConnection::PowerToolConnection(const std::string& server_ip, uint32_t
 PowerToolConnection::~PowerToolConnection() {
 }
 
+bool PowerToolConnection::SyncReceiveMessageWithTimeout(std::string* message,
+    int timeout_millis) {
+  return SyncReceiveMessage(message);
+}
+
 } // namespace browser_profiler 
@@ -25,6 +25,10 @@ class PowerToolConnection {
   // Receive a message synchronously
   virtual bool SyncReceiveMessage(std::string* message) = 0;
 
+  // Receive a message synchronously, fail after timeout_millis
+  // By default, the connection's own timeout applies
+  virtual bool SyncReceiveMessageWithTimeout(std::string* message, int timeout_millis);
+
   // Send a message synchronously
   virtual bool SyncSendMessage(const std::string& message) = 0;
 
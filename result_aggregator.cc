@@ -0,0 +1,362 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "result_aggregator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "crc32.h"
+#include "experiment_result.h"
+
+#include "base/files/file_util.h"
+#include "base/files/important_file_writer.h"
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace {
+
+const char kAggregateMagic[] = "BPAGGR01";
+const uint32_t kAggregateVersion = 1;
+
+// Quantiles of the report
+const double kReportQuantiles[] = { 0.5, 0.9, 0.95, 0.99 };
+
+// Host byte order, like the state file
+template <typename T>
+void AppendRaw(const T& value, std::string* output) {
+  output->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(const std::string& value, std::string* output) {
+  AppendRaw(static_cast<uint32_t>(value.size()), output);
+  output->append(value);
+}
+
+template <typename T>
+bool ReadRaw(const char** input, const char* end, T* value) {
+  if (static_cast<size_t>(end - *input) < sizeof(*value))
+    return false;
+  memcpy(value, *input, sizeof(*value));
+  *input += sizeof(*value);
+  return true;
+}
+
+bool ReadString(const char** input, const char* end, std::string* value) {
+  uint32_t size;
+  if (!ReadRaw(input, end, &size) || static_cast<size_t>(end - *input) < size)
+    return false;
+  value->assign(*input, size);
+  *input += size;
+  return true;
+}
+
+std::string FormatNumber(double value) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.6g", value);
+  return text;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+const double QuantileSketch::kRelativeAccuracy = 0.01;
+// static
+const size_t QuantileSketch::kMaxBuckets;
+
+QuantileSketch::QuantileSketch()
+  : gamma_((1 + kRelativeAccuracy) / (1 - kRelativeAccuracy)),
+    log_gamma_(log(gamma_)),
+    zero_count_(0),
+    count_(0) {
+}
+
+void QuantileSketch::Add(double value) {
+  if (std::isnan(value))
+    return;
+
+  ++count_;
+  if (value > 0) {
+    ++positive_[BucketIndex(value)];
+    Collapse(&positive_);
+  } else if (value < 0) {
+    ++negative_[BucketIndex(-value)];
+    Collapse(&negative_);
+  } else {
+    ++zero_count_;
+  }
+}
+
+double QuantileSketch::Quantile(double q) const {
+  if (count_ == 0)
+    return 0;
+
+  // From the most negative value to the most positive one
+  double rank = std::min(std::max(q, 0.0), 1.0) * (count_ - 1);
+  uint64_t seen = 0;
+  for (Buckets::const_reverse_iterator it = negative_.rbegin(); it != negative_.rend(); ++it) {
+    seen += it->second;
+    if (seen > rank)
+      return -BucketValue(it->first);
+  }
+
+  seen += zero_count_;
+  if (seen > rank)
+    return 0;
+
+  for (Buckets::const_iterator it = positive_.begin(); it != positive_.end(); ++it) {
+    seen += it->second;
+    if (seen > rank)
+      return BucketValue(it->first);
+  }
+  return positive_.empty() ? 0 : BucketValue(positive_.rbegin()->first);
+}
+
+void QuantileSketch::Serialize(std::string* output) const {
+  AppendRaw(zero_count_, output);
+  const Buckets* signs[] = { &positive_, &negative_ };
+  for (size_t i = 0; i < 2; ++i) {
+    AppendRaw(static_cast<uint32_t>(signs[i]->size()), output);
+    for (Buckets::const_iterator it = signs[i]->begin(); it != signs[i]->end(); ++it) {
+      AppendRaw(it->first, output);
+      AppendRaw(it->second, output);
+    }
+  }
+}
+
+bool QuantileSketch::Deserialize(const char** input, const char* end) {
+  positive_.clear();
+  negative_.clear();
+  if (!ReadRaw(input, end, &zero_count_))
+    return false;
+
+  count_ = zero_count_;
+  Buckets* signs[] = { &positive_, &negative_ };
+  for (size_t i = 0; i < 2; ++i) {
+    uint32_t num_buckets;
+    if (!ReadRaw(input, end, &num_buckets) || num_buckets > kMaxBuckets)
+      return false;
+    for (uint32_t j = 0; j < num_buckets; ++j) {
+      int32_t index;
+      uint64_t count;
+      if (!ReadRaw(input, end, &index) || !ReadRaw(input, end, &count))
+        return false;
+      (*signs[i])[index] = count;
+      count_ += count;
+    }
+  }
+  return true;
+}
+
+int32_t QuantileSketch::BucketIndex(double magnitude) const {
+  return static_cast<int32_t>(ceil(log(magnitude) / log_gamma_));
+}
+
+// Within kRelativeAccuracy of the whole bucket
+double QuantileSketch::BucketValue(int32_t index) const {
+  return 2 * pow(gamma_, index) / (gamma_ + 1);
+}
+
+void QuantileSketch::Collapse(Buckets* buckets) {
+  while (buckets->size() > kMaxBuckets) {
+    Buckets::iterator smallest = buckets->begin();
+    Buckets::iterator next = smallest;
+    ++next;
+    next->second += smallest->second;
+    buckets->erase(smallest);
+  }
+}
+
+ResultAggregator::MetricSummary::MetricSummary()
+  : count(0),
+    mean(0),
+    m2(0),
+    min(0),
+    max(0) {
+}
+
+void ResultAggregator::MetricSummary::Add(double value) {
+  if (std::isnan(value))
+    return;
+
+  min = count == 0 ? value : std::min(min, value);
+  max = count == 0 ? value : std::max(max, value);
+  ++count;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+  sketch.Add(value);
+}
+
+double ResultAggregator::MetricSummary::variance() const {
+  return count > 1 ? m2 / (count - 1) : 0;
+}
+
+ResultAggregator::ResultAggregator() {
+}
+
+void ResultAggregator::Clear() {
+  groups_.clear();
+}
+
+void ResultAggregator::Add(const ExperimentResult& result) {
+  if (result.IsSet(ExperimentResult::kWarmUpTrial) &&
+      result.GetNumber(ExperimentResult::kWarmUpTrial) != 0) {
+    return;
+  }
+
+  GroupKey key(result.GetString(ExperimentResult::kBrowserConfigName),
+      result.GetString(ExperimentResult::kHost));
+  Group& group = groups_[key];
+  for (ExperimentResult::Metric i = 0; i < result.num_metrics(); ++i) {
+    // Timestamps are not comparable between trials
+    if (!result.IsSet(i) || result.type(i) == ExperimentResult::kStringMetric ||
+        result.type(i) == ExperimentResult::kTimestampMetric) {
+      continue;
+    }
+    FindOrAddMetric(&group, result.name(i))->Add(result.GetNumber(i));
+  }
+}
+
+// File layout (host byte order):
+//   char[8]  magic "BPAGGR01"
+//   uint32   version
+//   uint32   number of groups
+//   groups: config, host, number of metrics, then each metric:
+//     name, count, mean, m2, min, max, quantile sketch
+//   uint32   crc32 of all the above
+// A string is its uint32 size then its bytes
+bool ResultAggregator::SaveToFile(const base::FilePath& file) const {
+  std::string output(kAggregateMagic, sizeof(kAggregateMagic) - 1);
+  AppendRaw(kAggregateVersion, &output);
+  AppendRaw(static_cast<uint32_t>(groups_.size()), &output);
+  for (std::map<GroupKey, Group>::const_iterator it = groups_.begin(); it != groups_.end();
+       ++it) {
+    AppendString(it->first.first, &output);
+    AppendString(it->first.second, &output);
+    AppendRaw(static_cast<uint32_t>(it->second.size()), &output);
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      const MetricSummary& summary = it->second[i].second;
+      AppendString(it->second[i].first, &output);
+      AppendRaw(summary.count, &output);
+      AppendRaw(summary.mean, &output);
+      AppendRaw(summary.m2, &output);
+      AppendRaw(summary.min, &output);
+      AppendRaw(summary.max, &output);
+      summary.sketch.Serialize(&output);
+    }
+  }
+  AppendRaw(Crc32(output.data(), output.size()), &output);
+
+  return base::ImportantFileWriter::WriteFileAtomically(file, output);
+}
+
+bool ResultAggregator::LoadFromFile(const base::FilePath& file) {
+  Clear();
+
+  std::string input;
+  if (!base::ReadFileToString(file, &input))
+    return false;
+
+  const size_t magic_size = sizeof(kAggregateMagic) - 1;
+  uint32_t version;
+  uint32_t crc;
+  if (input.size() < magic_size + sizeof(version) + sizeof(crc) ||
+      memcmp(input.data(), kAggregateMagic, magic_size) != 0) {
+    LOG(ERROR) << "Not a result aggregate file: " << file.value();
+    return false;
+  }
+
+  const char* end = input.data() + input.size() - sizeof(crc);
+  memcpy(&crc, end, sizeof(crc));
+  if (crc != Crc32(input.data(), end - input.data())) {
+    LOG(ERROR) << "Corrupted result aggregate file: " << file.value();
+    return false;
+  }
+
+  const char* cursor = input.data() + magic_size;
+  uint32_t num_groups;
+  if (!ReadRaw(&cursor, end, &version) || version != kAggregateVersion ||
+      !ReadRaw(&cursor, end, &num_groups)) {
+    LOG(ERROR) << "Result aggregate file of another version: " << file.value();
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_groups; ++i) {
+    GroupKey key;
+    uint32_t num_metrics;
+    if (!ReadString(&cursor, end, &key.first) || !ReadString(&cursor, end, &key.second) ||
+        !ReadRaw(&cursor, end, &num_metrics)) {
+      break;
+    }
+
+    Group& group = groups_[key];
+    for (uint32_t j = 0; j < num_metrics; ++j) {
+      std::string name;
+      MetricSummary summary;
+      if (!ReadString(&cursor, end, &name) || !ReadRaw(&cursor, end, &summary.count) ||
+          !ReadRaw(&cursor, end, &summary.mean) || !ReadRaw(&cursor, end, &summary.m2) ||
+          !ReadRaw(&cursor, end, &summary.min) || !ReadRaw(&cursor, end, &summary.max) ||
+          !summary.sketch.Deserialize(&cursor, end)) {
+        LOG(ERROR) << "Truncated result aggregate file: " << file.value();
+        Clear();
+        return false;
+      }
+      group.push_back(std::make_pair(name, summary));
+    }
+  }
+
+  if (cursor != end) {
+    LOG(ERROR) << "Truncated result aggregate file: " << file.value();
+    Clear();
+    return false;
+  }
+  return true;
+}
+
+bool ResultAggregator::WriteReport(const base::FilePath& file) const {
+  std::string report("Browser Config\tHost\tMetric\tCount\tMean\tStandard Deviation\tMin");
+  for (size_t i = 0; i < arraysize(kReportQuantiles); ++i)
+    report += "\tP" + FormatNumber(kReportQuantiles[i] * 100);
+  report += "\tMax\n";
+
+  for (std::map<GroupKey, Group>::const_iterator it = groups_.begin(); it != groups_.end();
+       ++it) {
+    for (size_t i = 0; i < it->second.size(); ++i) {
+      const MetricSummary& summary = it->second[i].second;
+      report += it->first.first + "\t" + it->first.second + "\t" + it->second[i].first;
+      report += "\t" + FormatNumber(summary.count);
+      report += "\t" + FormatNumber(summary.mean);
+      report += "\t" + FormatNumber(sqrt(summary.variance()));
+      report += "\t" + FormatNumber(summary.min);
+      // The sketch is within 1% of the exact quantile, clamp it to the exact range
+      for (size_t j = 0; j < arraysize(kReportQuantiles); ++j) {
+        double quantile = summary.sketch.Quantile(kReportQuantiles[j]);
+        report += "\t" + FormatNumber(std::min(std::max(quantile, summary.min), summary.max));
+      }
+      report += "\t" + FormatNumber(summary.max) + "\n";
+    }
+  }
+
+  if (base::WriteFile(file, report.data(), report.size()) != static_cast<int>(report.size())) {
+    LOG(ERROR) << "Cannot write result summary at " << file.value();
+    return false;
+  }
+  return true;
+}
+
+ResultAggregator::MetricSummary* ResultAggregator::FindOrAddMetric(Group* group,
+    const std::string& name) {
+  for (size_t i = 0; i < group->size(); ++i) {
+    if ((*group)[i].first == name)
+      return &(*group)[i].second;
+  }
+  group->push_back(std::make_pair(name, MetricSummary()));
+  return &group->back().second;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,108 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_RESULT_AGGREGATOR_H_
+#define BROWSER_PROFILER_RESULT_AGGREGATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/files/file_path.h"
+
+namespace browser_profiler {
+
+class ExperimentResult;
+
+// Quantiles of a stream of values within a relative error, in bounded memory
+// Log-bucketed like an HDR histogram: bucket i holds (gamma^(i-1), gamma^i] and
+// its values are estimated by one point within kRelativeAccuracy of all of them
+// (DDSketch). Negative values are mirrored, zeros counted apart
+// When there are more than kMaxBuckets buckets, the smallest magnitudes are collapsed
+class QuantileSketch {
+ public:
+  static const double kRelativeAccuracy;
+  static const size_t kMaxBuckets = 1024;
+
+  QuantileSketch();
+
+  void Add(double value);
+
+  // q in [0, 1], 0 if there is no value
+  double Quantile(double q) const;
+
+  uint64_t count() const { return count_; }
+
+  void Serialize(std::string* output) const;
+  // Return false if input is truncated
+  bool Deserialize(const char** input, const char* end);
+
+ private:
+  typedef std::map<int32_t, uint64_t> Buckets;
+
+  int32_t BucketIndex(double magnitude) const;
+  double BucketValue(int32_t index) const;
+  void Collapse(Buckets* buckets);
+
+  double gamma_;
+  double log_gamma_;
+  Buckets positive_;
+  Buckets negative_;
+  uint64_t zero_count_;
+  uint64_t count_;
+};
+
+// Summary statistics of the trials of a campaign, updated after each trial so that
+// they are ready when the campaign ends; memory does not grow with the trials
+// For each (browser config, host): mean and variance (Welford), min, max and quantiles
+// of each number metric, timestamps aside. Warm-up trials are left out
+class ResultAggregator {
+ public:
+  struct MetricSummary {
+    MetricSummary();
+
+    void Add(double value);
+    double variance() const;
+
+    uint64_t count;
+    double mean;
+    // Sum of squared differences from the mean
+    double m2;
+    double min;
+    double max;
+    QuantileSketch sketch;
+  };
+
+  ResultAggregator();
+
+  void Clear();
+
+  // Add the number metrics of a successful trial
+  void Add(const ExperimentResult& result);
+
+  // Kept in a small binary file, rewritten atomically after each trial
+  bool SaveToFile(const base::FilePath& file) const;
+  // Return false if the file is missing, of another version or corrupted
+  bool LoadFromFile(const base::FilePath& file);
+
+  // Tab-separated: one line per config, host and metric, with the quantiles
+  bool WriteReport(const base::FilePath& file) const;
+
+ private:
+  // (browser config, host)
+  typedef std::pair<std::string, std::string> GroupKey;
+  // Metrics in the order of their first value
+  typedef std::vector<std::pair<std::string, MetricSummary>> Group;
+
+  MetricSummary* FindOrAddMetric(Group* group, const std::string& name);
+
+  std::map<GroupKey, Group> groups_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_RESULT_AGGREGATOR_H_
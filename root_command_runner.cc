@@ -0,0 +1,325 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "root_command_runner.h"
+
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/process/launch.h"
+#include "base/process/process.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace {
+
+// The helper daemonizes right away, wait for it to listen
+const int kHelperConnectRetries = 20;
+const int kHelperConnectRetryMillis = 50;
+
+// Extra time for the helper to reply on top of the command timeouts
+const uint32_t kHelperReplyMarginMillis = 5000;
+
+// Execute a shell command like system() in C++
+// Because any failure will make an experiment fail,
+// use FATAL here
+bool ExecuteCommand(const base::CommandLine& cmd) {
+  VLOG(1) << "Execute command: " << cmd.GetCommandLineString();
+
+  base::Process process = base::LaunchProcess(cmd, base::LaunchOptions());
+  if (!process.IsValid()) {
+    LOG(ERROR) << "Cannot run command " << cmd.GetCommandLineString();
+    return false;
+  }
+
+  int exit_code;
+  if (!process.WaitForExit(&exit_code)) {
+    LOG(ERROR) << "Cannot get return code for command " << cmd.GetCommandLineString();
+    return false;
+  }
+
+  if (exit_code != 0) {
+    LOG(ERROR) << "Running " << cmd.GetCommandLineString()
+        << " failed with code " << exit_code;
+    return false;
+  }
+
+  return true;
+}
+
+bool ExecuteCommand(const std::string& cmd_str) {
+  std::vector<std::string> cmd_argv =
+      base::SplitString(cmd_str, " ", base::WhitespaceHandling::TRIM_WHITESPACE,
+                        base::SplitResult::SPLIT_WANT_NONEMPTY);
+
+  return ExecuteCommand(base::CommandLine(cmd_argv));
+}
+
+// Any app can bind the abstract socket name first: only talk to a helper running as root
+int ConnectToRootHelper() {
+  int helper_fd = browser_profiler::root_helper::ConnectToHelper(
+      browser_profiler::root_helper::kDefaultSocketName);
+  if (helper_fd < 0)
+    return -1;
+
+  int peer_uid = browser_profiler::root_helper::PeerUid(helper_fd);
+  if (peer_uid != 0) {
+    LOG(ERROR) << "Root helper socket is held by uid " << peer_uid << ", not root";
+    close(helper_fd);
+    return -1;
+  }
+  return helper_fd;
+}
+
+double MillisSince(const base::TimeTicks& start) {
+  return (base::TimeTicks::Now() - start).InMillisecondsF();
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+const uint32_t RootCommandRunner::kDefaultTimeoutMillis = 60 * 1000;
+
+RootCommandRunner::RootCommandRunner()
+  : helper_available_(false),
+    elapsed_millis_(0),
+    num_commands_(0),
+    num_round_trips_(0) {
+}
+
+RootCommandRunner::~RootCommandRunner() {
+  for (size_t i = 0; i < idle_helper_fds_.size(); ++i)
+    close(idle_helper_fds_[i]);
+}
+
+bool RootCommandRunner::ConnectOrLaunchHelper(const base::FilePath& helper_executable) {
+  base::AutoLock lock(lock_);
+  if (helper_available_)
+    return true;
+
+  // Usually running already: launched by an earlier browser process of this campaign
+  int helper_fd = ConnectToRootHelper();
+
+  if (helper_fd < 0) {
+    base::CommandLine helper_cmd(helper_executable);
+    helper_cmd.AppendArg(root_helper::kAllowedUidFlag + base::UintToString(getuid()));
+    helper_cmd.AppendArg(root_helper::kDaemonizeFlag);
+    helper_cmd.PrependWrapper("su -c");
+    if (!ExecuteCommand(helper_cmd)) {
+      LOG(ERROR) << "Cannot launch root helper at " << helper_executable.value();
+      return false;
+    }
+
+    for (int i = 0; i < kHelperConnectRetries && helper_fd < 0; ++i) {
+      base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(kHelperConnectRetryMillis));
+      helper_fd = ConnectToRootHelper();
+    }
+  }
+
+  if (helper_fd < 0) {
+    LOG(ERROR) << "Root helper launched but not reachable, fall back to su";
+    return false;
+  }
+
+  idle_helper_fds_.push_back(helper_fd);
+  helper_available_ = true;
+  return true;
+}
+
+void RootCommandRunner::ShutdownHelper() {
+  std::vector<root_helper::Command> commands(1,
+      root_helper::Command(root_helper::kShutdown, std::string(), 0));
+  std::vector<root_helper::Result> results;
+  bool nothing_sent;
+  RunThroughHelper(commands, &results, &nothing_sent);
+
+  base::AutoLock lock(lock_);
+  helper_available_ = false;
+  for (size_t i = 0; i < idle_helper_fds_.size(); ++i)
+    close(idle_helper_fds_[i]);
+  idle_helper_fds_.clear();
+}
+
+bool RootCommandRunner::helper_connected() const {
+  base::AutoLock lock(lock_);
+  return helper_available_;
+}
+
+bool RootCommandRunner::Run(const std::string& cmd, uint32_t timeout_ms) {
+  return RunBatch(std::vector<std::string>(1, cmd), timeout_ms);
+}
+
+bool RootCommandRunner::Run(const base::CommandLine& cmd, uint32_t timeout_ms) {
+  return Run(cmd.GetCommandLineString(), timeout_ms);
+}
+
+bool RootCommandRunner::Run(const base::FilePath& cmd, uint32_t timeout_ms) {
+  return Run(cmd.value(), timeout_ms);
+}
+
+bool RootCommandRunner::RunBatch(const std::vector<std::string>& cmds, uint32_t timeout_ms) {
+  if (cmds.empty())
+    return true;
+
+  base::TimeTicks start = base::TimeTicks::Now();
+
+  std::vector<root_helper::Command> commands;
+  for (size_t i = 0; i < cmds.size(); ++i)
+    commands.push_back(root_helper::Command::Shell(cmds[i], timeout_ms));
+
+  std::vector<root_helper::Result> results;
+  bool success = true;
+  bool nothing_sent;
+  if (RunThroughHelper(commands, &results, &nothing_sent)) {
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (results[i].status != 0) {
+        LOG(ERROR) << "Running " << cmds[i] << " as root failed with code "
+            << results[i].status << ": " << results[i].output;
+        success = false;
+      }
+    }
+    Count(cmds.size(), MillisSince(start));
+    return success;
+  }
+
+  // The helper may have run some commands, running them again could do them twice
+  if (!nothing_sent) {
+    LOG(ERROR) << "Root helper failed during a batch of " << cmds.size() << " commands";
+    Count(cmds.size(), MillisSince(start));
+    return false;
+  }
+
+  for (size_t i = 0; i < cmds.size(); ++i)
+    success = RunThroughSu(cmds[i]) && success;
+
+  Count(cmds.size(), MillisSince(start));
+  return success;
+}
+
+bool RootCommandRunner::WriteFile(const base::FilePath& file_path, const std::string& content) {
+  base::TimeTicks start = base::TimeTicks::Now();
+
+  std::vector<root_helper::Command> commands(1,
+      root_helper::Command::WriteFile(file_path.value(), content + "\n"));
+  std::vector<root_helper::Result> results;
+  bool nothing_sent;
+  if (RunThroughHelper(commands, &results, &nothing_sent)) {
+    Count(1, MillisSince(start));
+    if (results[0].status != 0) {
+      LOG(ERROR) << "Root helper cannot write " << file_path.value() << ": " << results[0].output;
+      return false;
+    }
+    return true;
+  }
+
+  if (!nothing_sent) {
+    LOG(ERROR) << "Root helper failed while writing " << file_path.value();
+    Count(1, MillisSince(start));
+    return false;
+  }
+
+  std::string cmd = "su -c echo '" + content + "' > " + file_path.value();
+  // ExecuteCommandAsRoot does not work well, maybe because of the ' sign in the command
+  // E.g., The command line becomes su -c --easure-power --v=0' echo 'chrome
+  bool success = system(cmd.c_str()) >= 0;
+  success = success && RunThroughSu("chmod 666 " + file_path.value());
+
+  Count(2, MillisSince(start));
+  return success;
+}
+
+void RootCommandRunner::ResetCounters() {
+  base::AutoLock lock(lock_);
+  elapsed_millis_ = 0;
+  num_commands_ = 0;
+  num_round_trips_ = 0;
+}
+
+double RootCommandRunner::elapsed_millis() const {
+  base::AutoLock lock(lock_);
+  return elapsed_millis_;
+}
+
+size_t RootCommandRunner::num_commands() const {
+  base::AutoLock lock(lock_);
+  return num_commands_;
+}
+
+size_t RootCommandRunner::num_round_trips() const {
+  base::AutoLock lock(lock_);
+  return num_round_trips_;
+}
+
+bool RootCommandRunner::RunThroughHelper(
+    const std::vector<root_helper::Command>& commands,
+    std::vector<root_helper::Result>* results, bool* nothing_sent) {
+  *nothing_sent = true;
+  int helper_fd = -1;
+  {
+    base::AutoLock lock(lock_);
+    if (!helper_available_)
+      return false;
+    if (!idle_helper_fds_.empty()) {
+      helper_fd = idle_helper_fds_.back();
+      idle_helper_fds_.pop_back();
+    }
+  }
+
+  // Another batch is running on the idle connection, open one more
+  if (helper_fd < 0)
+    helper_fd = ConnectToRootHelper();
+
+  uint64_t reply_timeout_ms = kHelperReplyMarginMillis;
+  for (size_t i = 0; i < commands.size(); ++i)
+    reply_timeout_ms += commands[i].timeout_ms;
+
+  struct timeval reply_timeout;
+  reply_timeout.tv_sec = reply_timeout_ms / 1000;
+  reply_timeout.tv_usec = (reply_timeout_ms % 1000) * 1000;
+
+  // The helper only runs complete batches: nothing ran until the whole batch is written
+  bool success = helper_fd >= 0 &&
+      setsockopt(helper_fd, SOL_SOCKET, SO_RCVTIMEO, &reply_timeout, sizeof(reply_timeout)) == 0 &&
+      root_helper::WriteCommands(helper_fd, commands);
+  *nothing_sent = !success;
+  success = success && root_helper::ReadResults(helper_fd, results) &&
+      results->size() == commands.size();
+
+  if (!success) {
+    PLOG(ERROR) << "Lost root helper";
+    if (helper_fd >= 0)
+      close(helper_fd);
+
+    base::AutoLock lock(lock_);
+    helper_available_ = false;
+    return false;
+  }
+
+  base::AutoLock lock(lock_);
+  idle_helper_fds_.push_back(helper_fd);
+  ++num_round_trips_;
+  return true;
+}
+
+bool RootCommandRunner::RunThroughSu(const std::string& cmd) {
+  {
+    base::AutoLock lock(lock_);
+    ++num_round_trips_;
+  }
+  return ExecuteCommand("su -c " + cmd);
+}
+
+void RootCommandRunner::Count(size_t num_commands, double elapsed_millis) {
+  base::AutoLock lock(lock_);
+  num_commands_ += num_commands;
+  elapsed_millis_ += elapsed_millis;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,91 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_ROOT_COMMAND_RUNNER_H_
+#define BROWSER_PROFILER_ROOT_COMMAND_RUNNER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "root_helper_protocol.h"
+
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+
+namespace browser_profiler {
+
+// Run commands as root
+// Through the long-lived root helper when it is connected: a batch of commands
+// costs one round trip over a Unix domain socket
+// Otherwise fork su -c for each command, which starts a new su and shell every time
+//
+// Thread-safe: tracers may run their commands concurrently,
+// each concurrent caller gets its own connection to the helper
+class RootCommandRunner {
+ public:
+  static const uint32_t kDefaultTimeoutMillis;
+
+  RootCommandRunner();
+  ~RootCommandRunner();
+
+  // Connect to a running helper, launch it through su first if it is not running
+  // Return true if commands will go through the helper
+  bool ConnectOrLaunchHelper(const base::FilePath& helper_executable);
+
+  // Ask the helper to exit, e.g., after all experiments
+  void ShutdownHelper();
+
+  bool helper_connected() const;
+
+  // Return true if the command exits with 0
+  bool Run(const std::string& cmd, uint32_t timeout_ms = kDefaultTimeoutMillis);
+  bool Run(const base::CommandLine& cmd, uint32_t timeout_ms = kDefaultTimeoutMillis);
+  bool Run(const base::FilePath& cmd, uint32_t timeout_ms = kDefaultTimeoutMillis);
+
+  // Run commands in order, a failing command does not stop the following ones
+  // Return true if all commands exit with 0
+  bool RunBatch(const std::vector<std::string>& cmds,
+      uint32_t timeout_ms = kDefaultTimeoutMillis);
+
+  // Write content and a new line (like echo) to a file only root can write to,
+  // and make it world-writable
+  bool WriteFile(const base::FilePath& file_path, const std::string& content);
+
+  // Latency counters, e.g., per experiment
+  void ResetCounters();
+  double elapsed_millis() const;
+  size_t num_commands() const;
+  size_t num_round_trips() const;
+
+ private:
+  // Return false if the helper is gone; results are valid only if true
+  // nothing_sent: the helper did not get the batch, so it ran none of its commands
+  bool RunThroughHelper(const std::vector<root_helper::Command>& commands,
+      std::vector<root_helper::Result>* results, bool* nothing_sent);
+  bool RunThroughSu(const std::string& cmd);
+  void Count(size_t num_commands, double elapsed_millis);
+
+  // Guards everything below, not held during a round trip
+  mutable base::Lock lock_;
+
+  bool helper_available_;
+
+  // Idle connections to the helper
+  // The helper serves each connection in its own process,
+  // so batches sent over different connections run in parallel
+  std::vector<int> idle_helper_fds_;
+
+  double elapsed_millis_;
+  size_t num_commands_;
+  size_t num_round_trips_;
+
+  DISALLOW_COPY_AND_ASSIGN(RootCommandRunner);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_ROOT_COMMAND_RUNNER_H_
@@ -0,0 +1,219 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "root_helper_protocol.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace {
+
+const uint32_t kBatchMagic = 0x42505248;   // "BPRH"
+const uint32_t kResultMagic = 0x42505252;  // "BPRR"
+
+// Guard against garbage lengths
+const uint32_t kMaxCommands = 256;
+const uint32_t kMaxPayloadLength = 1024 * 1024;
+
+bool WriteAll(int fd, const void* data, size_t length) {
+  const char* ptr = static_cast<const char*>(data);
+  while (length > 0) {
+    ssize_t written = send(fd, ptr, length, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    ptr += written;
+    length -= written;
+  }
+  return true;
+}
+
+bool ReadAll(int fd, void* data, size_t length) {
+  char* ptr = static_cast<char*>(data);
+  while (length > 0) {
+    ssize_t num_read = read(fd, ptr, length);
+    if (num_read < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (num_read == 0)
+      return false;
+    ptr += num_read;
+    length -= num_read;
+  }
+  return true;
+}
+
+void AppendUint32(std::string* buffer, uint32_t value) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool ReadUint32(int fd, uint32_t* value) {
+  return ReadAll(fd, value, sizeof(*value));
+}
+
+bool ReadString(int fd, uint32_t max_length, std::string* str) {
+  uint32_t length;
+  if (!ReadUint32(fd, &length) || length > max_length)
+    return false;
+  str->resize(length);
+  return length == 0 || ReadAll(fd, &(*str)[0], length);
+}
+
+socklen_t AbstractAddress(const std::string& socket_name, struct sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  // Abstract namespace: leading '\0', no file to clean up or to chmod
+  size_t name_length = std::min(socket_name.length(), sizeof(addr->sun_path) - 1);
+  memcpy(addr->sun_path + 1, socket_name.data(), name_length);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + name_length;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+namespace root_helper {
+
+const char kDefaultSocketName[] = "browser_profiler_root_helper";
+const char kAllowedUidFlag[] = "--allowed-uid=";
+const char kSocketNameFlag[] = "--socket-name=";
+const char kDaemonizeFlag[] = "--daemonize";
+
+Command::Command()
+  : type(kPing),
+    timeout_ms(0) {
+}
+
+Command::Command(CommandType type, const std::string& payload, uint32_t timeout_ms)
+  : type(type),
+    timeout_ms(timeout_ms),
+    payload(payload) {
+}
+
+// static
+Command Command::Shell(const std::string& command_line, uint32_t timeout_ms) {
+  return Command(kShell, command_line, timeout_ms);
+}
+
+// static
+Command Command::WriteFile(const std::string& path, const std::string& content) {
+  std::string payload(path);
+  payload.push_back('\0');
+  payload.append(content);
+  return Command(kWriteFile, payload, 0);
+}
+
+Result::Result()
+  : status(kStatusFailedToRun),
+    elapsed_us(0) {
+}
+
+bool WriteCommands(int fd, const std::vector<Command>& commands) {
+  // Compose the batch first to send it with as few syscalls as possible
+  std::string buffer;
+  AppendUint32(&buffer, kBatchMagic);
+  AppendUint32(&buffer, commands.size());
+  for (size_t i = 0; i < commands.size(); ++i) {
+    AppendUint32(&buffer, commands[i].type);
+    AppendUint32(&buffer, commands[i].timeout_ms);
+    AppendUint32(&buffer, commands[i].payload.length());
+    buffer.append(commands[i].payload);
+  }
+  return WriteAll(fd, buffer.data(), buffer.length());
+}
+
+bool ReadCommands(int fd, std::vector<Command>* commands) {
+  uint32_t magic, count;
+  if (!ReadUint32(fd, &magic) || magic != kBatchMagic ||
+      !ReadUint32(fd, &count) || count > kMaxCommands)
+    return false;
+
+  commands->resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Command& command = (*commands)[i];
+    if (!ReadUint32(fd, &command.type) || !ReadUint32(fd, &command.timeout_ms) ||
+        !ReadString(fd, kMaxPayloadLength, &command.payload))
+      return false;
+  }
+  return true;
+}
+
+bool WriteResults(int fd, const std::vector<Result>& results) {
+  std::string buffer;
+  AppendUint32(&buffer, kResultMagic);
+  AppendUint32(&buffer, results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    AppendUint32(&buffer, static_cast<uint32_t>(results[i].status));
+    AppendUint32(&buffer, results[i].elapsed_us);
+    AppendUint32(&buffer, results[i].output.length());
+    buffer.append(results[i].output);
+  }
+  return WriteAll(fd, buffer.data(), buffer.length());
+}
+
+bool ReadResults(int fd, std::vector<Result>* results) {
+  uint32_t magic, count;
+  if (!ReadUint32(fd, &magic) || magic != kResultMagic ||
+      !ReadUint32(fd, &count) || count > kMaxCommands)
+    return false;
+
+  results->resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Result& result = (*results)[i];
+    uint32_t status;
+    if (!ReadUint32(fd, &status) || !ReadUint32(fd, &result.elapsed_us) ||
+        !ReadString(fd, kMaxOutputLength, &result.output))
+      return false;
+    result.status = static_cast<int32_t>(status);
+  }
+  return true;
+}
+
+int ConnectToHelper(const std::string& socket_name) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_un addr;
+  socklen_t addr_length = AbstractAddress(socket_name, &addr);
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), addr_length) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ListenForClients(const std::string& socket_name) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  struct sockaddr_un addr;
+  socklen_t addr_length = AbstractAddress(socket_name, &addr);
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), addr_length) < 0 ||
+      listen(fd, 8) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int PeerUid(int socket_fd) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0)
+    return -1;
+  return credentials.uid;
+}
+
+}  // namespace root_helper
+}  // namespace browser_profiler
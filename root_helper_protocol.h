@@ -0,0 +1,94 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_ROOT_HELPER_PROTOCOL_H_
+#define BROWSER_PROFILER_ROOT_HELPER_PROTOCOL_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace browser_profiler {
+namespace root_helper {
+
+// Protocol between the profiler and the long-lived root helper
+// (tools/root_helper), spoken over an abstract Unix domain socket
+// Only depends on POSIX so that the helper stays small
+//
+// Client sends a batch, helper runs the commands in order and replies
+// with one result per command, so one round trip covers a whole phase
+//   batch:  uint32 magic, uint32 count, count x {uint32 type, uint32 timeout_ms,
+//           uint32 length, payload}
+//   result: uint32 magic, uint32 count, count x {int32 status, uint32 elapsed_us,
+//           uint32 length, output}
+// All integers are in host byte order (both ends run on the same device)
+
+extern const char kDefaultSocketName[];
+
+// Flags of the helper executable
+// Only the given uid (the browser's) may connect, everybody else is rejected
+extern const char kAllowedUidFlag[];
+extern const char kSocketNameFlag[];
+extern const char kDaemonizeFlag[];
+
+enum CommandType {
+  // Payload: a shell command line run by sh -c
+  kShell = 1,
+  // Payload: path '\0' content, file is truncated and made world-readable/writable
+  kWriteFile = 2,
+  // No payload, checks that the helper is alive
+  kPing = 3,
+  // No payload, helper exits after replying
+  kShutdown = 4,
+};
+
+// Status of commands which did not produce an exit code
+const int32_t kStatusFailedToRun = -1000;
+const int32_t kStatusTimedOut = -1001;
+const int32_t kStatusBadCommand = -1002;
+
+struct Command {
+  Command();
+  Command(CommandType type, const std::string& payload, uint32_t timeout_ms);
+
+  static Command Shell(const std::string& command_line, uint32_t timeout_ms);
+  static Command WriteFile(const std::string& path, const std::string& content);
+
+  uint32_t type;
+  uint32_t timeout_ms;
+  std::string payload;
+};
+
+struct Result {
+  Result();
+
+  // Exit code of the command or one of kStatus*
+  int32_t status;
+  uint32_t elapsed_us;
+  // Captured stdout and stderr, truncated to kMaxOutputLength
+  std::string output;
+};
+
+const size_t kMaxOutputLength = 64 * 1024;
+
+// Return false on I/O error or malformed data
+bool WriteCommands(int fd, const std::vector<Command>& commands);
+bool ReadCommands(int fd, std::vector<Command>* commands);
+bool WriteResults(int fd, const std::vector<Result>& results);
+bool ReadResults(int fd, std::vector<Result>* results);
+
+// Return a connected socket or -1
+int ConnectToHelper(const std::string& socket_name);
+
+// Return a listening socket or -1
+int ListenForClients(const std::string& socket_name);
+
+// Return the uid of the peer of a connected socket or -1
+int PeerUid(int socket_fd);
+
+}  // namespace root_helper
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_ROOT_HELPER_PROTOCOL_H_
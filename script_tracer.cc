@@ -0,0 +1,52 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "script_tracer.h"
+
+#include "root_command_runner.h"
+
+#include "base/logging.h"
+
+namespace browser_profiler {
+
+ScriptTracer::Config::Config()
+  : start_stage(kPreFtraceStage),
+    stop_stage(kPostFtraceStopStage),
+    overhead(kHighOverhead) {
+}
+
+ScriptTracer::ScriptTracer(const Config& config)
+  : config_(config) {
+}
+
+std::vector<std::string> ScriptTracer::output_artifacts() const {
+  std::vector<std::string> artifacts;
+  if (!config_.output_base_name.empty())
+    artifacts.push_back(config_.output_base_name);
+  return artifacts;
+}
+
+// Usually batched by the launcher, see StartRootCommands()
+void ScriptTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  if (!context.root_runner->RunBatch(StartRootCommands(context)))
+    LOG(ERROR) << "Failed to start " << config_.name;
+  done();
+}
+
+void ScriptTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  if (!context.root_runner->RunBatch(StopRootCommands(context)))
+    LOG(ERROR) << "Failed to stop " << config_.name;
+  done();
+}
+
+std::vector<std::string> ScriptTracer::StartRootCommands(const TracerContext& context) const {
+  std::string output = config_.output_base_name.empty() ?
+      context.experiment_id : context.OutputFile(config_.output_base_name).value();
+  return std::vector<std::string>(1, config_.start_script.value() + " " + output);
+}
+
+std::vector<std::string> ScriptTracer::StopRootCommands(const TracerContext& context) const {
+  return std::vector<std::string>(1, config_.stop_script.value());
+}
+
+}  // namespace browser_profiler
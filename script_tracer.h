@@ -0,0 +1,55 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_SCRIPT_TRACER_H_
+#define BROWSER_PROFILER_SCRIPT_TRACER_H_
+
+#include <string>
+#include <vector>
+
+#include "tracer.h"
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Tracer driven by a pair of scripts run as root
+// The start script gets the output file if output_base_name is set,
+// otherwise the experiment id, after which the script names its output
+class ScriptTracer : public Tracer {
+ public:
+  struct Config {
+    Config();
+
+    std::string name;
+    base::FilePath start_script;
+    base::FilePath stop_script;
+    std::string output_base_name;
+    StartStage start_stage;
+    StopStage stop_stage;
+    Overhead overhead;
+  };
+
+  explicit ScriptTracer(const Config& config);
+
+  // Tracer
+  std::string name() const override { return config_.name; }
+  StartStage start_stage() const override { return config_.start_stage; }
+  StopStage stop_stage() const override { return config_.stop_stage; }
+  Overhead expected_overhead() const override { return config_.overhead; }
+  std::vector<std::string> output_artifacts() const override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  std::vector<std::string> StartRootCommands(const TracerContext& context) const override;
+  std::vector<std::string> StopRootCommands(const TracerContext& context) const override;
+
+ private:
+  const Config config_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScriptTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_SCRIPT_TRACER_H_
@@ -0,0 +1,79 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "sync_pattern.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "base/logging.h"
+
+namespace {
+
+// Galois LFSR feedback masks of maximal length, indexed by degree
+const uint32_t kFeedbackMasks[] = {
+  0, 0, 0, 0x6, 0xC, 0x14, 0x30, 0x60, 0xB8, 0x110, 0x240,
+};
+
+const long kNanosecondsPerSecond = 1000000000L;
+
+double ToSeconds(const struct timespec& time) {
+  return time.tv_sec + static_cast<double>(time.tv_nsec) / kNanosecondsPerSecond;
+}
+
+void AddNanoseconds(long nanoseconds, struct timespec* time) {
+  time->tv_nsec += nanoseconds;
+  while (time->tv_nsec >= kNanosecondsPerSecond) {
+    time->tv_nsec -= kNanosecondsPerSecond;
+    ++time->tv_sec;
+  }
+}
+
+bool Before(const struct timespec& a, const struct timespec& b) {
+  return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+SyncPattern::SyncPattern(int degree) {
+  if (degree < kMinDegree || degree > kMaxDegree) {
+    LOG(ERROR) << "Unsupported sync pattern degree: " << degree;
+    degree = degree < kMinDegree ? kMinDegree : kMaxDegree;
+  }
+
+  uint32_t state = 1;
+  size_t num_chips = (1u << degree) - 1;
+  chips_.reserve(num_chips);
+  for (size_t i = 0; i < num_chips; ++i) {
+    bool bit = state & 1;
+    chips_.push_back(bit);
+    state >>= 1;
+    if (bit)
+      state ^= kFeedbackMasks[degree];
+  }
+}
+
+double SyncPattern::Run(double chip_seconds) const {
+  long chip_nanoseconds = static_cast<long>(chip_seconds * kNanosecondsPerSecond);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  struct timespec deadline = start;
+  for (size_t i = 0; i < chips_.size(); ++i) {
+    AddNanoseconds(chip_nanoseconds, &deadline);
+    if (chips_[i]) {
+      struct timespec now;
+      do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+      } while (Before(now, deadline));
+    } else {
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+    }
+  }
+  return ToSeconds(start);
+}
+
+}  // namespace browser_profiler
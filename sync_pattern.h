@@ -0,0 +1,41 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_SYNC_PATTERN_H_
+#define BROWSER_PROFILER_SYNC_PATTERN_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace browser_profiler {
+
+// Pseudo-random on/off CPU bursts which mark the power trace, see ClockAligner
+// The chips follow a maximal length sequence: its autocorrelation has a single sharp peak,
+// so a short pattern aligns the clocks better than one long workload
+class SyncPattern {
+ public:
+  static const int kMinDegree = 3;
+  static const int kMaxDegree = 10;
+
+  // 2^degree - 1 chips
+  explicit SyncPattern(int degree);
+
+  size_t num_chips() const { return chips_.size(); }
+  // Busy if true, idle otherwise
+  bool chip(size_t index) const { return chips_[index]; }
+
+  double Duration(double chip_seconds) const { return num_chips() * chip_seconds; }
+
+  // Spin during the busy chips and sleep during the idle ones, on the calling thread
+  // Chips end on absolute deadlines, they do not drift
+  // Return the start time of the first chip (CLOCK_MONOTONIC, seconds)
+  double Run(double chip_seconds) const;
+
+ private:
+  std::vector<bool> chips_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_SYNC_PATTERN_H_
@@ -0,0 +1,135 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "sysfs_power_connection.h"
+
+#include <utility>
+#include <vector>
+
+#include "experiment_result.h"
+#include "power_tool_protocol.h"
+#include "sysfs_power_sampler.h"
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+
+namespace {
+
+// Return false if the tab-separated results have no such number
+bool FindResult(const std::vector<std::string>& keys, const std::vector<std::string>& values,
+    const std::string& key, double* value) {
+  for (size_t i = 0; i < keys.size() && i < values.size(); ++i) {
+    if (keys[i] == key)
+      return base::StringToDouble(values[i], value);
+  }
+  return false;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+SysfsPowerConnection::SysfsPowerConnection(SysfsPowerSampler* sampler)
+  : PowerToolConnection("sysfs", 0),
+    sampler_(sampler) {
+}
+
+SysfsPowerConnection::~SysfsPowerConnection() {
+}
+
+bool SysfsPowerConnection::Connect() {
+  return true;
+}
+
+bool SysfsPowerConnection::SyncReceiveMessage(std::string* message) {
+  if (response_.empty()) {
+    LOG(ERROR) << "No message to respond to";
+    return false;
+  }
+  message->swap(response_);
+  response_.clear();
+  return true;
+}
+
+bool SysfsPowerConnection::SyncSendMessage(const std::string& message) {
+  response_ = HandleMessage(message);
+  return true;
+}
+
+std::string SysfsPowerConnection::HandleMessage(const std::string& message) {
+  power_tool::KeyValues error;
+  error.push_back(std::make_pair(power_tool::kStatusKey, power_tool::kErrorValue));
+  power_tool::KeyValues ok;
+  ok.push_back(std::make_pair(power_tool::kStatusKey, power_tool::kOkValue));
+
+  power_tool::KeyValues request;
+  std::string command;
+  if (!power_tool::ParseMessage(message, &request) ||
+      !power_tool::FindValue(request, power_tool::kCommandKey, &command)) {
+    LOG(ERROR) << "Invalid message: " << message;
+    return power_tool::ComposeMessage(error);
+  }
+
+  if (command == power_tool::kStartSamplingCommand) {
+    if (sampler_->sampling())
+      sampler_->Stop();
+    if (!sampler_->Start())
+      return power_tool::ComposeMessage(error);
+    ok.push_back(std::make_pair(power_tool::kFirstSampleTimeKey,
+        base::DoubleToString(sampler_->sample(0).time)));
+    return power_tool::ComposeMessage(ok);
+  }
+
+  if (command == power_tool::kStopSamplingCommand) {
+    if (!sampler_->sampling()) {
+      LOG(ERROR) << "Power sampler is not sampling";
+      return power_tool::ComposeMessage(error);
+    }
+    sampler_->Stop();
+
+    std::string result_keys;
+    std::string result_values;
+    power_tool::FindValue(request, power_tool::kResultKeysKey, &result_keys);
+    power_tool::FindValue(request, power_tool::kResultValuesKey, &result_values);
+    std::vector<std::string> keys = base::SplitString(result_keys, "\t",
+        base::KEEP_WHITESPACE, base::SPLIT_WANT_ALL);
+    std::vector<std::string> values = base::SplitString(result_values, "\t",
+        base::KEEP_WHITESPACE, base::SPLIT_WANT_ALL);
+
+    double load_start_time;
+    double load_end_time;
+    if (!FindResult(keys, values,
+            ExperimentResult::BuiltinMetricName(ExperimentResult::kLoadStartTime),
+            &load_start_time) ||
+        !FindResult(keys, values,
+            ExperimentResult::BuiltinMetricName(ExperimentResult::kLoadEndTime),
+            &load_end_time)) {
+      LOG(ERROR) << "The result has no load window";
+      return power_tool::ComposeMessage(error);
+    }
+
+    double energy_joules;
+    double average_power_watts;
+    if (!sampler_->WindowEnergy(load_start_time, load_end_time, &energy_joules,
+            &average_power_watts)) {
+      return power_tool::ComposeMessage(error);
+    }
+    VLOG(1) << "Load energy " << energy_joules << " J over "
+        << sampler_->num_samples() << " samples";
+    ok.push_back(std::make_pair(power_tool::kEnergyKey, base::DoubleToString(energy_joules)));
+    ok.push_back(std::make_pair(power_tool::kAveragePowerKey,
+        base::DoubleToString(average_power_watts)));
+    return power_tool::ComposeMessage(ok);
+  }
+
+  if (command == power_tool::kFinishAllExperimentsCommand ||
+      command == power_tool::kPingCommand) {
+    return power_tool::ComposeMessage(ok);
+  }
+
+  LOG(ERROR) << "Unknown command: " << command;
+  return power_tool::ComposeMessage(error);
+}
+
+}  // namespace browser_profiler
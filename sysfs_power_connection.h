@@ -0,0 +1,52 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_SYSFS_POWER_CONNECTION_H_
+#define BROWSER_PROFILER_SYSFS_POWER_CONNECTION_H_
+
+#include <string>
+
+#include "public/power_tool_connection.h"
+
+#include "base/compiler_specific.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+class SysfsPowerSampler;
+
+// Power tool "server" in the profiler process, no meter nor network needed
+// Answers the messages of PowerToolController with a SysfsPowerSampler:
+//  start_sampling: start the sampler, reply the time of its first sample
+//  stop_sampling: stop it, reply the energy and average power between the
+//    Load Start Time and Load End Time of the result
+// The sampler and the result share the monotonic clock, no sync workload is needed
+class SysfsPowerConnection : public PowerToolConnection {
+ public:
+  // sampler is not owned, it must be initialized
+  explicit SysfsPowerConnection(SysfsPowerSampler* sampler);
+  ~SysfsPowerConnection() override;
+
+  bool Connect() override;
+
+  // Return the response to the last message sent
+  bool SyncReceiveMessage(std::string* message) override;
+
+  // Handle the message right away
+  bool SyncSendMessage(const std::string& message) override;
+
+ private:
+  // Return the response to the message
+  std::string HandleMessage(const std::string& message);
+
+  SysfsPowerSampler* sampler_;
+
+  // Empty if no message is waiting for its response
+  std::string response_;
+
+  DISALLOW_COPY_AND_ASSIGN(SysfsPowerConnection);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_SYSFS_POWER_CONNECTION_H_
@@ -0,0 +1,306 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "sysfs_power_sampler.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "clock_domain.h"
+
+#include "base/logging.h"
+
+namespace {
+
+const double kMicroToUnit = 1e-6;
+// charge_counter is in uAh
+const double kMicroAmpereHoursToCoulombs = 3600 * 1e-6;
+
+int OpenValue(const std::string& path) {
+  return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+// sysfs attributes are regenerated on each read from offset 0
+// Return NAN on error
+double ReadValue(int fd) {
+  char buffer[32];
+  ssize_t length = pread(fd, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0)
+    return NAN;
+  buffer[length] = '\0';
+  char* end;
+  double value = strtod(buffer, &end);
+  return end == buffer ? NAN : value;
+}
+
+// Subdirectories of dir
+std::vector<std::string> ListDirectory(const std::string& dir) {
+  std::vector<std::string> names;
+  DIR* directory = opendir(dir.c_str());
+  if (directory == nullptr)
+    return names;
+  while (struct dirent* entry = readdir(directory)) {
+    if (entry->d_name[0] != '.')
+      names.push_back(entry->d_name);
+  }
+  closedir(directory);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+// static
+const char SysfsPowerSampler::kDefaultSysfsRoot[] = "/sys";
+// static
+const double SysfsPowerSampler::kDefaultSampleRateHz = 1000;
+// static
+const double SysfsPowerSampler::kDefaultBufferSeconds = 120;
+
+SysfsPowerSampler::SysfsPowerSampler(const base::FilePath& sysfs_root, double sample_rate_hz,
+    double buffer_seconds)
+  : sysfs_root_(sysfs_root),
+    sample_period_(1 / sample_rate_hz),
+    samples_(std::max(static_cast<size_t>(sample_rate_hz * buffer_seconds), size_t(2))),
+    head_(0),
+    energy_joules_(0),
+    last_time_(0),
+    sampling_(false),
+    stop_requested_(false) {
+}
+
+SysfsPowerSampler::~SysfsPowerSampler() {
+  if (sampling_)
+    Stop();
+  for (size_t i = 0; i < energy_counters_.size(); ++i)
+    close(energy_counters_[i].fd);
+  for (size_t i = 0; i < power_supplies_.size(); ++i) {
+    if (power_supplies_[i].current_fd >= 0)
+      close(power_supplies_[i].current_fd);
+    close(power_supplies_[i].voltage_fd);
+    if (power_supplies_[i].charge_fd >= 0)
+      close(power_supplies_[i].charge_fd);
+  }
+}
+
+bool SysfsPowerSampler::Initialize() {
+  // Subzones (e.g., intel-rapl:0:0) are included in their zone (intel-rapl:0)
+  std::string powercap_dir = sysfs_root_.Append("class/powercap").value();
+  std::vector<std::string> zones = ListDirectory(powercap_dir);
+  for (size_t i = 0; i < zones.size(); ++i) {
+    if (std::count(zones[i].begin(), zones[i].end(), ':') > 1)
+      continue;
+    std::string zone_dir = powercap_dir + "/" + zones[i] + "/";
+    EnergyCounter counter;
+    counter.fd = OpenValue(zone_dir + "energy_uj");
+    if (counter.fd < 0)
+      continue;
+    int range_fd = OpenValue(zone_dir + "max_energy_range_uj");
+    counter.max_energy_joules = range_fd >= 0 ? ReadValue(range_fd) * kMicroToUnit : NAN;
+    if (range_fd >= 0)
+      close(range_fd);
+    counter.last_energy_joules = 0;
+    VLOG(1) << "Energy counter " << zone_dir;
+    energy_counters_.push_back(counter);
+  }
+
+  std::string power_supply_dir = sysfs_root_.Append("class/power_supply").value();
+  std::vector<std::string> supplies = ListDirectory(power_supply_dir);
+  for (size_t i = 0; i < supplies.size(); ++i) {
+    std::string supply_dir = power_supply_dir + "/" + supplies[i] + "/";
+    PowerSupply supply;
+    supply.voltage_fd = OpenValue(supply_dir + "voltage_now");
+    supply.current_fd = OpenValue(supply_dir + "current_now");
+    supply.charge_fd = OpenValue(supply_dir + "charge_counter");
+    supply.last_charge_coulombs = 0;
+    if (supply.voltage_fd < 0 || (supply.current_fd < 0 && supply.charge_fd < 0)) {
+      if (supply.voltage_fd >= 0)
+        close(supply.voltage_fd);
+      if (supply.current_fd >= 0)
+        close(supply.current_fd);
+      if (supply.charge_fd >= 0)
+        close(supply.charge_fd);
+      continue;
+    }
+    VLOG(1) << "Power supply " << supply_dir;
+    power_supplies_.push_back(supply);
+  }
+
+  if (energy_counters_.empty() && power_supplies_.empty()) {
+    LOG(ERROR) << "No energy counter nor power supply under " << sysfs_root_.value();
+    return false;
+  }
+  return true;
+}
+
+bool SysfsPowerSampler::Start() {
+  DCHECK(!sampling_);
+  head_.store(0, std::memory_order_release);
+  energy_joules_ = 0;
+  last_time_ = 0;
+  for (size_t i = 0; i < energy_counters_.size(); ++i)
+    energy_counters_[i].last_energy_joules = ReadValue(energy_counters_[i].fd) * kMicroToUnit;
+  for (size_t i = 0; i < power_supplies_.size(); ++i) {
+    if (power_supplies_[i].charge_fd >= 0) {
+      power_supplies_[i].last_charge_coulombs =
+          ReadValue(power_supplies_[i].charge_fd) * kMicroAmpereHoursToCoulombs;
+    }
+  }
+  TakeSample();
+
+  stop_requested_.store(false);
+  if (!base::PlatformThread::Create(0, this, &thread_handle_)) {
+    LOG(ERROR) << "Cannot start the power sampling thread";
+    return false;
+  }
+  sampling_ = true;
+  return true;
+}
+
+void SysfsPowerSampler::Stop() {
+  if (!sampling_)
+    return;
+  stop_requested_.store(true);
+  base::PlatformThread::Join(thread_handle_);
+  // Close the window right now
+  TakeSample();
+  sampling_ = false;
+}
+
+void SysfsPowerSampler::ThreadMain() {
+  base::PlatformThread::SetName("PowerSampler");
+
+  // Absolute deadlines: the rate does not drift with the sampling time
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  long period_ns = static_cast<long>(sample_period_ * 1e9);
+  while (!stop_requested_.load()) {
+    next.tv_nsec += period_ns;
+    while (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      ++next.tv_sec;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+    // Fell behind by more than a period, e.g., preempted: skip the missed samples
+    double now = MonotonicNow();
+    double next_time = next.tv_sec + next.tv_nsec / 1e9;
+    if (now - next_time > sample_period_)
+      clock_gettime(CLOCK_MONOTONIC, &next);
+
+    TakeSample();
+  }
+}
+
+void SysfsPowerSampler::TakeSample() {
+  double now = MonotonicNow();
+  double elapsed = last_time_ > 0 ? now - last_time_ : 0;
+
+  double counter_energy = 0;
+  for (size_t i = 0; i < energy_counters_.size(); ++i) {
+    EnergyCounter& counter = energy_counters_[i];
+    double energy = ReadValue(counter.fd) * kMicroToUnit;
+    if (isnan(energy))
+      continue;
+    double delta = energy - counter.last_energy_joules;
+    if (delta < 0 && !isnan(counter.max_energy_joules))
+      delta += counter.max_energy_joules;
+    counter_energy += delta;
+    counter.last_energy_joules = energy;
+  }
+
+  // Batteries report a negative current when discharging on some devices
+  double supply_power = 0;
+  for (size_t i = 0; i < power_supplies_.size(); ++i) {
+    PowerSupply& supply = power_supplies_[i];
+    double voltage = fabs(ReadValue(supply.voltage_fd)) * kMicroToUnit;
+    double current = NAN;
+    if (supply.current_fd >= 0)
+      current = fabs(ReadValue(supply.current_fd)) * kMicroToUnit;
+    if (supply.charge_fd >= 0) {
+      double charge = ReadValue(supply.charge_fd) * kMicroAmpereHoursToCoulombs;
+      if (isnan(current) && elapsed > 0)
+        current = fabs(charge - supply.last_charge_coulombs) / elapsed;
+      supply.last_charge_coulombs = charge;
+    }
+    if (!isnan(voltage) && !isnan(current))
+      supply_power += voltage * current;
+  }
+
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  double power;
+  if (!energy_counters_.empty()) {
+    energy_joules_ += counter_energy;
+    power = !power_supplies_.empty() ? supply_power :
+        (elapsed > 0 ? counter_energy / elapsed : 0);
+  } else {
+    // Trapezoid between the previous sample and this one
+    if (head > 0)
+      energy_joules_ += 0.5 * (sample(head - 1).power_watts + supply_power) * elapsed;
+    power = supply_power;
+  }
+
+  Sample& slot = samples_[head % samples_.size()];
+  slot.time = now;
+  slot.energy_joules = energy_joules_;
+  slot.power_watts = power;
+  head_.store(head + 1, std::memory_order_release);
+  last_time_ = now;
+}
+
+uint64_t SysfsPowerSampler::oldest_sample() const {
+  uint64_t head = num_samples();
+  // The slot after the oldest one may be being written
+  return head >= samples_.size() ? head - samples_.size() + 1 : 0;
+}
+
+double SysfsPowerSampler::EnergyAt(double time, uint64_t after) const {
+  const Sample& next = sample(after);
+  if (after == 0 || next.time <= time)
+    return next.energy_joules;
+  const Sample& previous = sample(after - 1);
+  double fraction = (time - previous.time) / (next.time - previous.time);
+  return previous.energy_joules + fraction * (next.energy_joules - previous.energy_joules);
+}
+
+bool SysfsPowerSampler::WindowEnergy(double begin_time, double end_time,
+    double* energy_joules, double* average_power_watts) const {
+  uint64_t head = num_samples();
+  uint64_t oldest = oldest_sample();
+  if (head < 2 || end_time <= begin_time || sample(oldest).time > begin_time ||
+      sample(head - 1).time < end_time) {
+    LOG(ERROR) << "Power samples do not cover " << begin_time << " - " << end_time;
+    return false;
+  }
+
+  // First sample at or after a time, samples are in time order
+  auto first_at = [this, oldest, head](double time) {
+    uint64_t low = oldest;
+    uint64_t high = head - 1;
+    while (low < high) {
+      uint64_t middle = low + (high - low) / 2;
+      if (sample(middle).time < time)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  };
+
+  double begin_energy = EnergyAt(begin_time, first_at(begin_time));
+  double end_energy = EnergyAt(end_time, first_at(end_time));
+  *energy_joules = end_energy - begin_energy;
+  *average_power_watts = *energy_joules / (end_time - begin_time);
+  return true;
+}
+
+}  // namespace browser_profiler
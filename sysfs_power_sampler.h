@@ -0,0 +1,122 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_SYSFS_POWER_SAMPLER_H_
+#define BROWSER_PROFILER_SYSFS_POWER_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/macros.h"
+#include "base/threading/platform_thread.h"
+
+namespace browser_profiler {
+
+// Samples the energy counters and power supplies of the kernel on a dedicated thread
+//   <sysfs root>/class/powercap/<zone>/energy_uj (RAPL), top-level zones only
+//   <sysfs root>/class/power_supply/<supply>/{current_now,voltage_now,charge_counter}
+// The sysfs root is configurable, so that a fake tree can stand in for the kernel
+//
+// Samples go to a ring buffer allocated once, written by the sampling thread only
+// and published with a release store: readers need no lock
+// Timestamps are CLOCK_MONOTONIC seconds, the clock of the experiment result
+class SysfsPowerSampler : public base::PlatformThread::Delegate {
+ public:
+  struct Sample {
+    // CLOCK_MONOTONIC, seconds
+    double time;
+    // Since the first sample: from the energy counters if any,
+    // otherwise the integral of the power of the power supplies
+    double energy_joules;
+    // Power supplies if any, otherwise from the energy counters
+    double power_watts;
+  };
+
+  static const char kDefaultSysfsRoot[];
+  static const double kDefaultSampleRateHz;
+  // Capacity of the ring buffer, in seconds of samples
+  static const double kDefaultBufferSeconds;
+
+  SysfsPowerSampler(const base::FilePath& sysfs_root, double sample_rate_hz,
+      double buffer_seconds);
+  ~SysfsPowerSampler() override;
+
+  // Find and open the sources, return false if there is none
+  bool Initialize();
+
+  // Return false if the thread cannot start
+  // The first sample is taken before returning
+  bool Start();
+  void Stop();
+
+  bool sampling() const { return sampling_; }
+
+  // Samples of the current (or last) session, oldest ones may be overwritten
+  // Return the number of samples written so far
+  uint64_t num_samples() const { return head_.load(std::memory_order_acquire); }
+  // index < num_samples(), still in the buffer: index + capacity >= num_samples()
+  const Sample& sample(uint64_t index) const { return samples_[index % samples_.size()]; }
+  // Index of the oldest sample still in the buffer
+  uint64_t oldest_sample() const;
+
+  // Energy and average power between two timestamps, interpolated between samples
+  // Return false if the window is not covered by the buffered samples
+  bool WindowEnergy(double begin_time, double end_time, double* energy_joules,
+      double* average_power_watts) const;
+
+  size_t num_energy_counters() const { return energy_counters_.size(); }
+  size_t num_power_supplies() const { return power_supplies_.size(); }
+
+  // base::PlatformThread::Delegate
+  void ThreadMain() override;
+
+ private:
+  struct EnergyCounter {
+    int fd;
+    // The counter wraps around at this value
+    double max_energy_joules;
+    double last_energy_joules;
+  };
+
+  struct PowerSupply {
+    int current_fd;
+    int voltage_fd;
+    // -1 if not available
+    int charge_fd;
+    double last_charge_coulombs;
+  };
+
+  // Read the sources and append a sample
+  void TakeSample();
+
+  // Energy at a time between two consecutive samples
+  double EnergyAt(double time, uint64_t after) const;
+
+  base::FilePath sysfs_root_;
+  double sample_period_;
+
+  std::vector<EnergyCounter> energy_counters_;
+  std::vector<PowerSupply> power_supplies_;
+
+  std::vector<Sample> samples_;
+  std::atomic<uint64_t> head_;
+
+  // Sampling thread only
+  double energy_joules_;
+  double last_time_;
+
+  bool sampling_;
+  std::atomic<bool> stop_requested_;
+  base::PlatformThreadHandle thread_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(SysfsPowerSampler);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_SYSFS_POWER_SAMPLER_H_
@@ -0,0 +1,190 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "timeline_merger.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace {
+
+// Microseconds with the nanoseconds, as the format wants
+void AppendMicroseconds(int64_t ns, std::string* output) {
+  char text[32];
+  const char* sign = ns < 0 ? "-" : "";
+  uint64_t magnitude = ns < 0 ? -static_cast<uint64_t>(ns) : ns;
+  snprintf(text, sizeof(text), "%s%" PRIu64 ".%03" PRIu64, sign, magnitude / 1000,
+      magnitude % 1000);
+  *output += text;
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+TimelineEvent::TimelineEvent()
+  : timestamp_ns(0),
+    duration_ns(0),
+    type(kInstant),
+    track(0),
+    value(0) {
+}
+
+TimelineTracks::TimelineTracks() {
+}
+
+uint32_t TimelineTracks::Find(const std::string& group, const std::string& name) {
+  std::pair<std::string, std::string> key(group, name);
+  std::map<std::pair<std::string, std::string>, uint32_t>::const_iterator it =
+      track_ids_.find(key);
+  if (it != track_ids_.end())
+    return it->second;
+
+  std::vector<std::string>::const_iterator group_it =
+      std::find(groups_.begin(), groups_.end(), group);
+  if (group_it == groups_.end())
+    group_it = groups_.insert(groups_.end(), group);
+
+  Track track = { static_cast<uint32_t>(group_it - groups_.begin()), name };
+  tracks_.push_back(track);
+  uint32_t id = tracks_.size() - 1;
+  track_ids_[key] = id;
+  return id;
+}
+
+TimelineMerger::TimelineMerger() {
+}
+
+TimelineMerger::~TimelineMerger() {
+}
+
+void TimelineMerger::AddSource(std::unique_ptr<TimelineSource> source) {
+  sources_.push_back(std::move(source));
+}
+
+size_t TimelineMerger::Merge(TimelineWriter* writer) {
+  // The next event of each source; the heap is ordered by (time, source)
+  std::vector<TimelineEvent> heads(sources_.size());
+  typedef std::pair<int64_t, size_t> HeapEntry;
+  std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry>> heap;
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (sources_[i]->Next(&heads[i]))
+      heap.push(HeapEntry(heads[i].timestamp_ns, i));
+  }
+
+  size_t num_events = 0;
+  while (!heap.empty()) {
+    size_t source = heap.top().second;
+    heap.pop();
+    if (!writer->Write(heads[source]))
+      break;
+    ++num_events;
+    if (sources_[source]->Next(&heads[source]))
+      heap.push(HeapEntry(heads[source].timestamp_ns, source));
+  }
+  return num_events;
+}
+
+TraceJsonWriter::TraceJsonWriter(FILE* file, const TimelineTracks* tracks)
+  : file_(file),
+    tracks_(tracks),
+    first_event_(true) {
+}
+
+TraceJsonWriter::~TraceJsonWriter() {
+}
+
+bool TraceJsonWriter::Begin() {
+  buffer_ = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  first_event_ = true;
+  return Flush();
+}
+
+// Sources add tracks as they go: the names come last, groups are pids from 1 and
+// tracks are tids from 1
+bool TraceJsonWriter::End() {
+  buffer_.clear();
+  const std::vector<std::string>& groups = tracks_->groups();
+  for (size_t i = 0; i < groups.size(); ++i) {
+    buffer_ += first_event_ ? "" : ",\n";
+    first_event_ = false;
+    buffer_ += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + std::to_string(i + 1) +
+        ",\"tid\":0,\"args\":{\"name\":";
+    AppendString(groups[i]);
+    buffer_ += "}}";
+  }
+
+  const std::vector<TimelineTracks::Track>& tracks = tracks_->tracks();
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    buffer_ += ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" +
+        std::to_string(tracks[i].group + 1) + ",\"tid\":" + std::to_string(i + 1) +
+        ",\"args\":{\"name\":";
+    AppendString(tracks[i].name);
+    buffer_ += "}}";
+  }
+  buffer_ += "\n]}\n";
+  return Flush() && fflush(file_) == 0;
+}
+
+bool TraceJsonWriter::Write(const TimelineEvent& event) {
+  const TimelineTracks::Track& track = tracks_->tracks()[event.track];
+  buffer_ = first_event_ ? "" : ",\n";
+  first_event_ = false;
+
+  static const char* const kPhases[] = { "X", "i", "C" };
+  buffer_ += "{\"ph\":\"";
+  buffer_ += kPhases[event.type];
+  buffer_ += "\",\"pid\":" + std::to_string(track.group + 1) +
+      ",\"tid\":" + std::to_string(event.track + 1) + ",\"ts\":";
+  AppendMicroseconds(event.timestamp_ns, &buffer_);
+  buffer_ += ",\"name\":";
+  AppendString(event.type == TimelineEvent::kCounter ? track.name : event.name);
+
+  switch (event.type) {
+    case TimelineEvent::kSlice:
+      buffer_ += ",\"dur\":";
+      AppendMicroseconds(event.duration_ns, &buffer_);
+      break;
+    case TimelineEvent::kInstant:
+      buffer_ += ",\"s\":\"t\"";
+      break;
+    case TimelineEvent::kCounter: {
+      char value[32];
+      snprintf(value, sizeof(value), "%.9g", event.value);
+      buffer_ += ",\"args\":{\"value\":";
+      buffer_ += value;
+      buffer_ += "}";
+      break;
+    }
+  }
+  buffer_ += "}";
+  return Flush();
+}
+
+void TraceJsonWriter::AppendString(const std::string& value) {
+  buffer_ += '"';
+  for (size_t i = 0; i < value.size(); ++i) {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\') {
+      buffer_ += '\\';
+      buffer_ += c;
+    } else if (c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      buffer_ += escaped;
+    } else {
+      buffer_ += c;
+    }
+  }
+  buffer_ += '"';
+}
+
+// stdio buffers the small writes into large ones
+bool TraceJsonWriter::Flush() {
+  return fwrite(buffer_.data(), 1, buffer_.size(), file_) == buffer_.size();
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,140 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TIMELINE_MERGER_H_
+#define BROWSER_PROFILER_TIMELINE_MERGER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace browser_profiler {
+
+// An event of one of the sources of a trial, on the CLOCK_MONOTONIC nanoseconds of the
+// device (see ClockTranslator)
+struct TimelineEvent {
+  enum Type {
+    kSlice,
+    kInstant,
+    kCounter,
+  };
+
+  TimelineEvent();
+
+  int64_t timestamp_ns;
+  // Slices
+  int64_t duration_ns;
+  Type type;
+  // See TimelineTracks
+  uint32_t track;
+  // Counters are named by their track
+  std::string name;
+  double value;
+};
+
+// Tracks of the timeline: a group (e.g., "ftrace") and a track in it (e.g., "cpu 0"),
+// a process and a thread in the trace viewer
+class TimelineTracks {
+ public:
+  struct Track {
+    uint32_t group;
+    std::string name;
+  };
+
+  TimelineTracks();
+
+  // Id of a track, the existing one if it is known
+  uint32_t Find(const std::string& group, const std::string& name);
+
+  const std::vector<std::string>& groups() const { return groups_; }
+  const std::vector<Track>& tracks() const { return tracks_; }
+
+ private:
+  std::vector<std::string> groups_;
+  std::vector<Track> tracks_;
+  std::map<std::pair<std::string, std::string>, uint32_t> track_ids_;
+
+  // Not copyable
+  TimelineTracks(const TimelineTracks&);
+  void operator=(const TimelineTracks&);
+};
+
+// Events of an artifact, in time order, see timeline_sources.h
+class TimelineSource {
+ public:
+  virtual ~TimelineSource() {}
+
+  // Return false when there is no event left
+  virtual bool Next(TimelineEvent* event) = 0;
+};
+
+class TimelineWriter {
+ public:
+  virtual ~TimelineWriter() {}
+
+  virtual bool Write(const TimelineEvent& event) = 0;
+};
+
+// Merges the sources of a trial into one stream in time order: each source only
+// has its next event in the merge (k-way merge over a heap), so a source can stream
+// its artifact
+// Only depends on POSIX so that tools can use it, see tools/timeline_merge
+class TimelineMerger {
+ public:
+  TimelineMerger();
+  ~TimelineMerger();
+
+  void AddSource(std::unique_ptr<TimelineSource> source);
+
+  // Write the events of all sources in time order, equal times in source order
+  // Return the number of events, stop at the first failed write
+  size_t Merge(TimelineWriter* writer);
+
+ private:
+  std::vector<std::unique_ptr<TimelineSource>> sources_;
+
+  // Not copyable
+  TimelineMerger(const TimelineMerger&);
+  void operator=(const TimelineMerger&);
+};
+
+// Writes Chrome's JSON trace event format as it goes, which Perfetto's UI and
+// trace processor open: a group is a process, a track a thread, a counter track a counter
+class TraceJsonWriter : public TimelineWriter {
+ public:
+  // Does not own file
+  TraceJsonWriter(FILE* file, const TimelineTracks* tracks);
+  ~TraceJsonWriter() override;
+
+  // Before and after the events
+  bool Begin();
+  bool End();
+
+  // TimelineWriter
+  bool Write(const TimelineEvent& event) override;
+
+ private:
+  // A JSON string of value
+  void AppendString(const std::string& value);
+  bool Flush();
+
+  FILE* file_;
+  const TimelineTracks* tracks_;
+  // Reused for each event
+  std::string buffer_;
+  bool first_event_;
+
+  // Not copyable
+  TraceJsonWriter(const TraceJsonWriter&);
+  void operator=(const TraceJsonWriter&);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TIMELINE_MERGER_H_
@@ -0,0 +1,400 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "timeline_sources.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "ftrace_decoder.h"
+#include "itrace_index.h"
+
+namespace {
+
+// Same layout as CpuUtilizationSampler, which depends on Chromium's base
+const char kCpuUtilizationMagic[] = "BPCPUUTL";
+const uint32_t kCpuUtilizationVersion = 1;
+const size_t kCpuUtilizationHeaderSize = 28;
+const size_t kCpuSampleSize = 12;
+
+// pcap
+const uint32_t kPcapMicrosecondMagic = 0xa1b2c3d4;
+const uint32_t kPcapNanosecondMagic = 0xa1b23c4d;
+const uint32_t kLinkTypeEthernet = 1;
+const uint32_t kLinkTypeRaw = 101;
+const uint32_t kLinkTypeLinuxSll = 113;
+// Enough for the link, IPv6 and transport headers
+const size_t kPacketHeadLength = 128;
+
+const uint16_t kEtherTypeIpv4 = 0x0800;
+const uint16_t kEtherTypeIpv6 = 0x86dd;
+const uint16_t kEtherTypeVlan = 0x8100;
+
+int64_t SecondsToNanoseconds(double seconds) {
+  return llround(seconds * 1e9);
+}
+
+uint16_t ReadBigEndian16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] << 8 | data[1]);
+}
+
+uint32_t Swap32(uint32_t value, bool swapped) {
+  return swapped ? __builtin_bswap32(value) : value;
+}
+
+std::string CpuName(int64_t cpu) {
+  return "cpu " + std::to_string(cpu);
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+FtraceCpuSource::FtraceCpuSource(const FtraceDecoder* decoder, size_t cpu, ClockDomain domain,
+    const ClockTranslator* translator, TimelineTracks* tracks)
+  : decoder_(decoder),
+    cpu_(cpu),
+    domain_(domain),
+    translator_(translator),
+    tracks_(tracks),
+    cpu_track_(tracks->Find("ftrace", CpuName(cpu))),
+    next_(0),
+    next_switch_(0) {
+}
+
+bool FtraceCpuSource::Next(TimelineEvent* event) {
+  const FtraceDecoder::CpuEvents& events = decoder_->cpus()[cpu_];
+  while (next_ < events.size()) {
+    size_t index = next_++;
+    event->timestamp_ns = Timestamp(index);
+    event->track = cpu_track_;
+
+    switch (events.kinds[index]) {
+      case FtraceDecoder::kSchedSwitch: {
+        // Until the next switch, or the end of the trace of this cpu
+        if (next_switch_ <= index) {
+          next_switch_ = index + 1;
+          while (next_switch_ < events.size() &&
+                 events.kinds[next_switch_] != FtraceDecoder::kSchedSwitch) {
+            ++next_switch_;
+          }
+        }
+        // The idle task
+        if (events.field1[index] == 0)
+          continue;
+        size_t end = std::min(next_switch_, events.size() - 1);
+        event->type = TimelineEvent::kSlice;
+        event->duration_ns = Timestamp(end) - event->timestamp_ns;
+        event->name = Text(index);
+        return true;
+      }
+      case FtraceDecoder::kCpuFrequency:
+        event->type = TimelineEvent::kCounter;
+        event->track = tracks_->Find("ftrace",
+            CpuName(events.field0[index]) + " frequency (MHz)");
+        event->value = events.field1[index] / 1000.0;
+        return true;
+      case FtraceDecoder::kCpuIdle:
+        event->type = TimelineEvent::kCounter;
+        event->track = tracks_->Find("ftrace", CpuName(events.field0[index]) + " idle state");
+        event->value = events.field1[index];
+        return true;
+      case FtraceDecoder::kTraceMarker:
+        event->type = TimelineEvent::kInstant;
+        event->name = Text(index);
+        return true;
+      default:
+        event->type = TimelineEvent::kInstant;
+        event->name = decoder_->EventName(events.event_ids[index]);
+        return true;
+    }
+  }
+  return false;
+}
+
+std::string FtraceCpuSource::Text(size_t index) const {
+  const FtraceDecoder::CpuEvents& events = decoder_->cpus()[cpu_];
+  if (events.texts[index] == FtraceDecoder::kNoText)
+    return decoder_->EventName(events.event_ids[index]);
+  return events.strings[events.texts[index]];
+}
+
+int64_t FtraceCpuSource::Timestamp(size_t index) const {
+  return translator_->ToMonotonic(domain_, decoder_->cpus()[cpu_].timestamps[index]);
+}
+
+ItraceThreadSource::ItraceThreadSource(const ItraceIndex* index, size_t thread,
+    TimelineTracks* tracks)
+  : index_(index),
+    thread_(thread),
+    next_(0) {
+  const ItraceIndex::Thread& info = index->threads()[thread];
+  std::string name = info.name != ItraceIndex::kNoString ? index->String(info.name) :
+      "tid " + std::to_string(info.tid);
+  track_ = tracks->Find("itrace " + std::to_string(info.pid), name);
+}
+
+bool ItraceThreadSource::Next(TimelineEvent* event) {
+  const std::vector<ItraceIndex::Slice>& slices = index_->threads()[thread_].slices;
+  if (next_ >= slices.size())
+    return false;
+
+  // Microseconds
+  const ItraceIndex::Slice& slice = slices[next_++];
+  event->type = TimelineEvent::kSlice;
+  event->track = track_;
+  event->timestamp_ns = llround(slice.ts * 1000);
+  event->duration_ns = llround(slice.dur * 1000);
+  event->name = index_->String(slice.name);
+  return true;
+}
+
+PcapSource::PcapSource(const ClockTranslator* translator, TimelineTracks* tracks)
+  : translator_(translator),
+    track_(tracks->Find("network", "packets")),
+    file_(nullptr),
+    swapped_(false),
+    nanoseconds_(false),
+    link_type_(0),
+    packet_(kPacketHeadLength) {
+}
+
+PcapSource::~PcapSource() {
+  if (file_)
+    fclose(file_);
+}
+
+bool PcapSource::Open(const std::string& path, std::string* error) {
+  file_ = fopen(path.c_str(), "rb");
+  if (!file_) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+
+  uint32_t header[6];
+  if (fread(header, sizeof(header), 1, file_) != 1) {
+    *error = "truncated pcap " + path;
+    return false;
+  }
+  uint32_t magic = header[0];
+  swapped_ = magic == __builtin_bswap32(kPcapMicrosecondMagic) ||
+      magic == __builtin_bswap32(kPcapNanosecondMagic);
+  magic = Swap32(magic, swapped_);
+  if (magic != kPcapMicrosecondMagic && magic != kPcapNanosecondMagic) {
+    *error = "not a pcap file: " + path;
+    return false;
+  }
+  nanoseconds_ = magic == kPcapNanosecondMagic;
+  link_type_ = Swap32(header[5], swapped_);
+  return true;
+}
+
+bool PcapSource::Next(TimelineEvent* event) {
+  uint32_t record[4];
+  if (!file_ || fread(record, sizeof(record), 1, file_) != 1)
+    return false;
+  uint32_t seconds = Swap32(record[0], swapped_);
+  uint32_t fraction = Swap32(record[1], swapped_);
+  uint32_t captured_length = Swap32(record[2], swapped_);
+  uint32_t length = Swap32(record[3], swapped_);
+
+  // Only the headers are read, the payload is skipped
+  size_t head_length = std::min<size_t>(captured_length, packet_.size());
+  if (fread(packet_.data(), 1, head_length, file_) != head_length ||
+      fseek(file_, captured_length - head_length, SEEK_CUR) != 0) {
+    return false;
+  }
+
+  int64_t realtime_ns = static_cast<int64_t>(seconds) * 1000000000 +
+      (nanoseconds_ ? fraction : static_cast<int64_t>(fraction) * 1000);
+  event->type = TimelineEvent::kInstant;
+  event->track = track_;
+  event->timestamp_ns = translator_->ToMonotonic(kRealtimeClock, realtime_ns);
+  event->name = Describe(packet_.data(), head_length) + " " + std::to_string(length);
+  return true;
+}
+
+// E.g., "TCP 10.0.0.2:51234 > 93.184.216.34:443"
+std::string PcapSource::Describe(const uint8_t* data, size_t length) const {
+  size_t offset;
+  uint16_t ether_type;
+  if (link_type_ == kLinkTypeEthernet && length >= 14) {
+    offset = 14;
+    ether_type = ReadBigEndian16(data + 12);
+    if (ether_type == kEtherTypeVlan && length >= 18) {
+      offset = 18;
+      ether_type = ReadBigEndian16(data + 16);
+    }
+  } else if (link_type_ == kLinkTypeLinuxSll && length >= 16) {
+    offset = 16;
+    ether_type = ReadBigEndian16(data + 14);
+  } else if (link_type_ == kLinkTypeRaw && length >= 1) {
+    offset = 0;
+    ether_type = data[0] >> 4 == 6 ? kEtherTypeIpv6 : kEtherTypeIpv4;
+  } else {
+    return "packet";
+  }
+
+  const uint8_t* ip = data + offset;
+  size_t ip_length = length - offset;
+  char source[INET6_ADDRSTRLEN];
+  char destination[INET6_ADDRSTRLEN];
+  uint8_t protocol;
+  size_t transport_offset;
+  if (ether_type == kEtherTypeIpv4 && ip_length >= 20) {
+    protocol = ip[9];
+    transport_offset = (ip[0] & 0xf) * 4;
+    inet_ntop(AF_INET, ip + 12, source, sizeof(source));
+    inet_ntop(AF_INET, ip + 16, destination, sizeof(destination));
+  } else if (ether_type == kEtherTypeIpv6 && ip_length >= 40) {
+    protocol = ip[6];
+    transport_offset = 40;
+    inet_ntop(AF_INET6, ip + 8, source, sizeof(source));
+    inet_ntop(AF_INET6, ip + 24, destination, sizeof(destination));
+  } else {
+    return "packet";
+  }
+
+  std::string name = protocol == IPPROTO_TCP ? "TCP " : protocol == IPPROTO_UDP ? "UDP " :
+      "IP " + std::to_string(protocol) + " ";
+  if ((protocol == IPPROTO_TCP || protocol == IPPROTO_UDP) &&
+      ip_length >= transport_offset + 4) {
+    return name + source + ":" + std::to_string(ReadBigEndian16(ip + transport_offset)) +
+        " > " + destination + ":" + std::to_string(ReadBigEndian16(ip + transport_offset + 2));
+  }
+  return name + source + " > " + destination;
+}
+
+CpuUtilizationSource::CpuUtilizationSource(TimelineTracks* tracks)
+  : tracks_(tracks),
+    num_cpus_(0),
+    num_samples_(0),
+    sample_(1),
+    cpu_(0),
+    frequency_(false) {
+}
+
+// The samples of a trial are small: read at once
+bool CpuUtilizationSource::Open(const std::string& path, std::string* error) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  char buffer[65536];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data_.append(buffer, length);
+  fclose(file);
+
+  const size_t magic_size = sizeof(kCpuUtilizationMagic) - 1;
+  uint32_t version;
+  if (data_.size() < kCpuUtilizationHeaderSize ||
+      memcmp(data_.data(), kCpuUtilizationMagic, magic_size) != 0) {
+    *error = "not a cpu utilization file: " + path;
+    return false;
+  }
+  memcpy(&version, data_.data() + magic_size, sizeof(version));
+  memcpy(&num_cpus_, data_.data() + magic_size + 4, sizeof(num_cpus_));
+  memcpy(&num_samples_, data_.data() + magic_size + 12, sizeof(num_samples_));
+  size_t sample_size = sizeof(double) + num_cpus_ * kCpuSampleSize;
+  if (version != kCpuUtilizationVersion ||
+      (data_.size() - kCpuUtilizationHeaderSize) / sample_size < num_samples_) {
+    *error = "truncated cpu utilization file or of another version: " + path;
+    return false;
+  }
+  return true;
+}
+
+// The first sample only has the reference counters
+bool CpuUtilizationSource::Next(TimelineEvent* event) {
+  size_t sample_size = sizeof(double) + num_cpus_ * kCpuSampleSize;
+  while (sample_ < num_samples_) {
+    const char* sample = data_.data() + kCpuUtilizationHeaderSize + sample_ * sample_size;
+    double time;
+    uint32_t counters[3];
+    memcpy(&time, sample, sizeof(time));
+    memcpy(counters, sample + sizeof(time) + cpu_ * kCpuSampleSize, sizeof(counters));
+
+    bool frequency = frequency_;
+    uint32_t cpu = cpu_;
+    frequency_ = !frequency_;
+    if (!frequency_ && ++cpu_ == num_cpus_) {
+      cpu_ = 0;
+      ++sample_;
+    }
+
+    // Offline, or no cpufreq
+    if (counters[1] == 0 || (frequency && counters[2] == 0))
+      continue;
+    event->type = TimelineEvent::kCounter;
+    event->timestamp_ns = SecondsToNanoseconds(time);
+    event->track = tracks_->Find("cpu_util", CpuName(cpu) +
+        (frequency ? " frequency (MHz)" : " utilization (%)"));
+    event->value = frequency ? counters[2] / 1000.0 : 100.0 * counters[0] / counters[1];
+    return true;
+  }
+  return false;
+}
+
+PowerSampleSource::PowerSampleSource(const ClockTranslator* translator,
+    TimelineTracks* tracks)
+  : translator_(translator),
+    track_(tracks->Find("power", "power (W)")),
+    file_(nullptr) {
+}
+
+PowerSampleSource::~PowerSampleSource() {
+  if (file_)
+    fclose(file_);
+}
+
+bool PowerSampleSource::Open(const std::string& path, std::string* error) {
+  file_ = fopen(path.c_str(), "r");
+  if (!file_) {
+    *error = "cannot open " + path + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool PowerSampleSource::Next(TimelineEvent* event) {
+  char line[256];
+  while (file_ && fgets(line, sizeof(line), file_)) {
+    char* end;
+    double seconds = strtod(line, &end);
+    if (end == line || (*end != ',' && *end != ' ' && *end != '\t'))
+      continue;
+    char* watts_end;
+    double watts = strtod(end + 1, &watts_end);
+    if (watts_end == end + 1)
+      continue;
+
+    event->type = TimelineEvent::kCounter;
+    event->track = track_;
+    event->timestamp_ns =
+        translator_->ToMonotonic(kPowerMeterClock, SecondsToNanoseconds(seconds));
+    event->value = watts;
+    return true;
+  }
+  return false;
+}
+
+TimelineEventList::TimelineEventList(const std::vector<TimelineEvent>& events)
+  : events_(events),
+    next_(0) {
+}
+
+bool TimelineEventList::Next(TimelineEvent* event) {
+  if (next_ >= events_.size())
+    return false;
+  *event = events_[next_++];
+  return true;
+}
+
+}  // namespace browser_profiler
@@ -0,0 +1,149 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TIMELINE_SOURCES_H_
+#define BROWSER_PROFILER_TIMELINE_SOURCES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "clock_domain.h"
+#include "timeline_merger.h"
+
+namespace browser_profiler {
+
+class FtraceDecoder;
+class ItraceIndex;
+
+// Sources of the timeline, one per artifact (or per cpu, thread of an artifact)
+// Each one translates its clock to CLOCK_MONOTONIC nanoseconds (ClockTranslator) and
+// gives its events in time order
+// Only depend on POSIX so that tools can use them, see tools/timeline_merge
+
+// A cpu of a decoded ftrace artifact, group "ftrace":
+//   sched_switch: a slice of the next task until the next switch, on "cpu <n>"
+//   cpu_frequency, cpu_idle: counters "cpu <n> frequency (MHz)", "cpu <n> idle state"
+//   trace_marker and other events: instants on "cpu <n>"
+class FtraceCpuSource : public TimelineSource {
+ public:
+  FtraceCpuSource(const FtraceDecoder* decoder, size_t cpu, ClockDomain domain,
+      const ClockTranslator* translator, TimelineTracks* tracks);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  int64_t Timestamp(size_t index) const;
+  // The event name if the event has no text
+  std::string Text(size_t index) const;
+
+  const FtraceDecoder* decoder_;
+  const size_t cpu_;
+  const ClockDomain domain_;
+  const ClockTranslator* translator_;
+  TimelineTracks* tracks_;
+  uint32_t cpu_track_;
+
+  size_t next_;
+  // The switch after the current one
+  size_t next_switch_;
+};
+
+// A thread of an internal tracing artifact, group "itrace <pid>"
+// Chrome's trace clock is CLOCK_MONOTONIC
+class ItraceThreadSource : public TimelineSource {
+ public:
+  ItraceThreadSource(const ItraceIndex* index, size_t thread, TimelineTracks* tracks);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  const ItraceIndex* index_;
+  const size_t thread_;
+  uint32_t track_;
+  size_t next_;
+};
+
+// Packets of a pcap artifact (CLOCK_REALTIME), in capture order, as instants
+// named by protocol and addresses on "network", "packets"
+class PcapSource : public TimelineSource {
+ public:
+  PcapSource(const ClockTranslator* translator, TimelineTracks* tracks);
+  ~PcapSource() override;
+
+  // Return false with the reason in error
+  bool Open(const std::string& path, std::string* error);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  // Protocol, addresses and ports of a packet from its captured bytes
+  std::string Describe(const uint8_t* data, size_t length) const;
+
+  const ClockTranslator* translator_;
+  uint32_t track_;
+  FILE* file_;
+  bool swapped_;
+  bool nanoseconds_;
+  uint32_t link_type_;
+  // First bytes of a packet, enough for the headers
+  std::vector<uint8_t> packet_;
+};
+
+// Samples of CpuUtilizationSampler (<id>.cpu_util.bin), group "cpu_util":
+// counters "cpu <n> utilization (%)" and "cpu <n> frequency (MHz)"
+class CpuUtilizationSource : public TimelineSource {
+ public:
+  explicit CpuUtilizationSource(TimelineTracks* tracks);
+
+  bool Open(const std::string& path, std::string* error);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  TimelineTracks* tracks_;
+  std::string data_;
+  uint32_t num_cpus_;
+  uint64_t num_samples_;
+  // Position in the samples: sample, cpu, then utilization or frequency
+  uint64_t sample_;
+  uint32_t cpu_;
+  bool frequency_;
+};
+
+// Power samples of the power tool server on its clock, lines of "<seconds>,<watts>",
+// as the counter "power", "power (W)"; other lines (e.g., a header) are skipped
+class PowerSampleSource : public TimelineSource {
+ public:
+  PowerSampleSource(const ClockTranslator* translator, TimelineTracks* tracks);
+  ~PowerSampleSource() override;
+
+  bool Open(const std::string& path, std::string* error);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  const ClockTranslator* translator_;
+  uint32_t track_;
+  FILE* file_;
+};
+
+// Events known up front, e.g., the load window of the result
+class TimelineEventList : public TimelineSource {
+ public:
+  // Sorted by time
+  explicit TimelineEventList(const std::vector<TimelineEvent>& events);
+
+  bool Next(TimelineEvent* event) override;
+
+ private:
+  std::vector<TimelineEvent> events_;
+  size_t next_;
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TIMELINE_SOURCES_H_
@@ -0,0 +1,85 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "timeline_tracer.h"
+
+#include <math.h>
+
+#include "browser_profiler_impl_constants.h"
+#include "power_tracer.h"
+
+#include "base/files/file_util.h"
+#include "base/logging.h"
+
+namespace {
+
+int64_t SecondsToNanoseconds(double seconds) {
+  return llround(seconds * 1e9);
+}
+
+}  // namespace
+
+namespace browser_profiler {
+
+TimelineTracer::TimelineTracer()
+  : power_clock_offset_metric_(ExperimentResult::kInvalidMetric) {
+}
+
+TimelineTracer::~TimelineTracer() {
+}
+
+std::vector<std::string> TimelineTracer::output_artifacts() const {
+  return std::vector<std::string>(1, base_name_);
+}
+
+void TimelineTracer::RegisterMetrics(ExperimentResult* experiment_result) {
+  // Set by PowerTracer, if it runs
+  power_clock_offset_metric_ = experiment_result->RegisterMetric(
+      PowerTracer::kClockOffsetMetric, ExperimentResult::kTimestampMetric);
+}
+
+bool TimelineTracer::Initialize(const TracerContext& context) {
+  base_name_ = context.constants->kClocksBaseName;
+  return true;
+}
+
+void TimelineTracer::Start(const TracerContext& context, const DoneCallback& done) {
+  clocks_ = TrialClocks();
+  clocks_.references.push_back(ClockReference::Capture());
+  done();
+}
+
+void TimelineTracer::Stop(const TracerContext& context, const DoneCallback& done) {
+  clocks_.references.push_back(ClockReference::Capture());
+  done();
+}
+
+// After all stops: the power clock offset is known
+void TimelineTracer::Flush(const TracerContext& context) {
+  if (clocks_.references.empty())
+    return;
+
+  // Both on CLOCK_MONOTONIC (s)
+  const ExperimentResult* result = context.experiment_result;
+  if (result->IsSet(ExperimentResult::kLoadStartTime) &&
+      result->IsSet(ExperimentResult::kLoadEndTime)) {
+    clocks_.load_start_ns =
+        SecondsToNanoseconds(result->GetNumber(ExperimentResult::kLoadStartTime));
+    clocks_.load_end_ns =
+        SecondsToNanoseconds(result->GetNumber(ExperimentResult::kLoadEndTime));
+  }
+  if (power_clock_offset_metric_ != ExperimentResult::kInvalidMetric &&
+      result->IsSet(power_clock_offset_metric_)) {
+    clocks_.has_power_meter_offset = true;
+    clocks_.power_meter_offset_ns =
+        SecondsToNanoseconds(result->GetNumber(power_clock_offset_metric_));
+  }
+
+  std::string text = clocks_.Serialize();
+  base::FilePath file = context.OutputFile(base_name_);
+  if (base::WriteFile(file, text.data(), text.size()) != static_cast<int>(text.size()))
+    LOG(ERROR) << "Cannot write the clocks of the trial at " << file.value();
+  clocks_ = TrialClocks();
+}
+
+}  // namespace browser_profiler
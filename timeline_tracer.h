@@ -0,0 +1,50 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TIMELINE_TRACER_H_
+#define BROWSER_PROFILER_TIMELINE_TRACER_H_
+
+#include <string>
+#include <vector>
+
+#include "clock_domain.h"
+#include "experiment_result.h"
+#include "tracer.h"
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+// Records what tools/timeline_merge needs to put the artifacts of a trial on
+// CLOCK_MONOTONIC: reference points of the clocks at the first start and the last
+// stop, the load window and the offset of the power meter clock, to <id>.<clocks base name>
+class TimelineTracer : public Tracer {
+ public:
+  TimelineTracer();
+  ~TimelineTracer() override;
+
+  // Tracer
+  std::string name() const override { return "timeline"; }
+  // Around all other tracers
+  StartStage start_stage() const override { return kPowerStage; }
+  StopStage stop_stage() const override { return kPostFtraceStopStage; }
+  Overhead expected_overhead() const override { return kNegligibleOverhead; }
+  std::vector<std::string> output_artifacts() const override;
+  void RegisterMetrics(ExperimentResult* experiment_result) override;
+  bool Initialize(const TracerContext& context) override;
+  void Start(const TracerContext& context, const DoneCallback& done) override;
+  void Stop(const TracerContext& context, const DoneCallback& done) override;
+  void Flush(const TracerContext& context) override;
+
+ private:
+  std::string base_name_;
+  TrialClocks clocks_;
+
+  ExperimentResult::Metric power_clock_offset_metric_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimelineTracer);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TIMELINE_TRACER_H_
@@ -0,0 +1,178 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Decodes ftrace artifacts (<id>.ftrace.dat), e.g., of all the trials of a campaign
+// Artifacts are decoded in parallel, and the cpus of each one too, see FtraceDecoder
+//
+// Usage: ftrace_decode [--jobs=<n>] [--window=<start>,<end>] [--dump] <ftrace.dat>...
+// Writes tab-separated lines to stdout, in the order of the artifacts:
+//   default: per cpu, the number of events of each kind and the pages with lost events
+//   dump: one line per event: artifact, cpu, time (s), event, pid, fields, text
+// window: only the events in [start, end) seconds of the trace clock, e.g., the load
+//   window of the experiment with --ftrace-clock=mono
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ftrace_decoder.h"
+
+namespace {
+
+using browser_profiler::FtraceDecoder;
+
+const char* const kKindColumns[] = {
+  "Other", "Sched Switch", "Cpu Frequency", "Cpu Idle", "Trace Marker",
+};
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+struct Options {
+  Options() : window_start(0), window_end(1e18), dump(false) {}
+
+  double window_start;
+  double window_end;
+  bool dump;
+};
+
+struct ArtifactResult {
+  ArtifactResult() : decoded(false) {}
+
+  bool decoded;
+  std::string error;
+  std::string lines;
+};
+
+void Summarize(const std::string& artifact, const FtraceDecoder& decoder,
+    const Options& options, std::string* lines) {
+  for (size_t cpu = 0; cpu < decoder.cpus().size(); ++cpu) {
+    const FtraceDecoder::CpuEvents& events = decoder.cpus()[cpu];
+    std::pair<size_t, size_t> window =
+        decoder.Window(cpu, options.window_start, options.window_end);
+
+    size_t counts[FtraceDecoder::kNumEventKinds] = {};
+    for (size_t i = window.first; i < window.second; ++i)
+      ++counts[events.kinds[i]];
+
+    char line[256];
+    snprintf(line, sizeof(line), "\t%zu\t%zu", cpu, window.second - window.first);
+    *lines += artifact + line;
+    for (size_t kind = 0; kind < FtraceDecoder::kNumEventKinds; ++kind) {
+      snprintf(line, sizeof(line), "\t%zu", counts[kind]);
+      *lines += line;
+    }
+    snprintf(line, sizeof(line), "\t%zu\n", events.num_pages_with_lost_events);
+    *lines += line;
+  }
+}
+
+void Dump(const std::string& artifact, const FtraceDecoder& decoder, const Options& options,
+    std::string* lines) {
+  for (size_t cpu = 0; cpu < decoder.cpus().size(); ++cpu) {
+    const FtraceDecoder::CpuEvents& events = decoder.cpus()[cpu];
+    std::pair<size_t, size_t> window =
+        decoder.Window(cpu, options.window_start, options.window_end);
+    for (size_t i = window.first; i < window.second; ++i) {
+      char line[256];
+      snprintf(line, sizeof(line), "\t%zu\t%.6f\t", cpu, events.timestamps[i] / 1e9);
+      *lines += artifact + line + decoder.EventName(events.event_ids[i]);
+      snprintf(line, sizeof(line), "\t%d\t%lld\t%lld\t%lld\t", events.pids[i],
+          static_cast<long long>(events.field0[i]), static_cast<long long>(events.field1[i]),
+          static_cast<long long>(events.field2[i]));
+      *lines += line;
+      if (events.texts[i] != FtraceDecoder::kNoText)
+        *lines += events.strings[events.texts[i]];
+      *lines += "\n";
+    }
+  }
+}
+
+void DecodeArtifact(const std::string& artifact, const Options& options,
+    ArtifactResult* result) {
+  FtraceDecoder decoder;
+  result->decoded = decoder.Open(artifact, &result->error) && decoder.Decode(&result->error);
+  if (!result->decoded)
+    return;
+
+  if (options.dump)
+    Dump(artifact, decoder, options, &result->lines);
+  else
+    Summarize(artifact, decoder, options, &result->lines);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  Options options;
+  std::vector<std::string> artifacts;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--jobs=")) {
+      jobs = std::max(1, atoi(strchr(arg, '=') + 1));
+    } else if (StartsWith(arg, "--window=")) {
+      if (sscanf(strchr(arg, '=') + 1, "%lf,%lf", &options.window_start,
+              &options.window_end) != 2) {
+        fprintf(stderr, "Invalid window: %s\n", arg);
+        return 1;
+      }
+    } else if (strcmp(arg, "--dump") == 0) {
+      options.dump = true;
+    } else if (StartsWith(arg, "--")) {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    } else {
+      artifacts.push_back(arg);
+    }
+  }
+
+  if (artifacts.empty()) {
+    fprintf(stderr, "Usage: %s [--jobs=<n>] [--window=<start>,<end>] [--dump] "
+        "<ftrace.dat>...\n", argv[0]);
+    return 1;
+  }
+
+  // Workers take the next artifact until there is none
+  std::vector<ArtifactResult> results(artifacts.size());
+  std::atomic<size_t> next_artifact(0);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::min<size_t>(jobs, artifacts.size()); ++i) {
+    workers.push_back(std::thread([&]() {
+      for (size_t artifact = next_artifact++; artifact < artifacts.size();
+           artifact = next_artifact++) {
+        DecodeArtifact(artifacts[artifact], options, &results[artifact]);
+      }
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+
+  if (options.dump) {
+    printf("Artifact\tCpu\tTime (s)\tEvent\tPid\tField 0\tField 1\tField 2\tText\n");
+  } else {
+    printf("Artifact\tCpu\tEvents");
+    for (size_t kind = 0; kind < FtraceDecoder::kNumEventKinds; ++kind)
+      printf("\t%s", kKindColumns[kind]);
+    printf("\tPages With Lost Events\n");
+  }
+
+  int num_failed = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].decoded) {
+      fprintf(stderr, "%s: %s\n", artifacts[i].c_str(), results[i].error.c_str());
+      ++num_failed;
+      continue;
+    }
+    fputs(results[i].lines.c_str(), stdout);
+  }
+  return num_failed > 0 ? 1 : 0;
+}
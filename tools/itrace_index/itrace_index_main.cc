@@ -0,0 +1,176 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Phase breakdown of internal tracing artifacts (<id>.itrace.json), e.g., of all the
+// trials of a campaign: total and maximum duration of the slices of each thread
+// The traces are parsed in parallel, see ItraceIndex
+//
+// Usage: itrace_index [--jobs=<n>] [--names=<slice>,...] [--thread=<thread name>]
+//   <trace>...
+// Writes tab-separated lines to stdout, in the order of the traces:
+//   trace, pid, tid, thread name, slice name, count, total (ms), max (ms)
+// names: only these slices; thread: only the threads of this name, e.g., CrRendererMain
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clock_domain.h"
+#include "itrace_index.h"
+
+namespace {
+
+using browser_profiler::ItraceIndex;
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+struct Filter {
+  std::set<std::string> names;
+  std::string thread;
+};
+
+struct Breakdown {
+  Breakdown() : count(0), total(0), max(0) {}
+
+  size_t count;
+  double total;
+  double max;
+};
+
+struct TraceResult {
+  TraceResult() : parsed(false), num_events(0), num_unmatched_events(0) {}
+
+  bool parsed;
+  std::string error;
+  size_t num_events;
+  size_t num_unmatched_events;
+  std::string lines;
+};
+
+std::string FormatLine(const std::string& trace, const ItraceIndex::Thread& thread,
+    const std::string& thread_name, const std::string& name, const Breakdown& breakdown) {
+  char numbers[160];
+  snprintf(numbers, sizeof(numbers), "%lld\t%lld", static_cast<long long>(thread.pid),
+      static_cast<long long>(thread.tid));
+  std::string line = trace + "\t" + numbers + "\t" + thread_name + "\t" + name;
+  snprintf(numbers, sizeof(numbers), "\t%zu\t%.3f\t%.3f\n", breakdown.count,
+      breakdown.total / 1000, breakdown.max / 1000);
+  return line + numbers;
+}
+
+void IndexTrace(const std::string& trace, const Filter& filter, TraceResult* result) {
+  ItraceIndex index;
+  result->parsed = index.ParseFile(trace, &result->error);
+  if (!result->parsed)
+    return;
+  result->num_events = index.num_events();
+  result->num_unmatched_events = index.num_unmatched_events();
+
+  for (size_t i = 0; i < index.threads().size(); ++i) {
+    const ItraceIndex::Thread& thread = index.threads()[i];
+    const std::string& thread_name = index.String(thread.name);
+    if (!filter.thread.empty() && thread_name != filter.thread)
+      continue;
+
+    // By slice name
+    std::map<std::string, Breakdown> breakdowns;
+    for (size_t j = 0; j < thread.slices.size(); ++j) {
+      const ItraceIndex::Slice& slice = thread.slices[j];
+      const std::string& name = index.String(slice.name);
+      if (!filter.names.empty() && filter.names.count(name) == 0)
+        continue;
+      Breakdown& breakdown = breakdowns[name];
+      ++breakdown.count;
+      breakdown.total += slice.dur;
+      breakdown.max = std::max(breakdown.max, slice.dur);
+    }
+
+    for (std::map<std::string, Breakdown>::const_iterator it = breakdowns.begin();
+         it != breakdowns.end(); ++it) {
+      result->lines += FormatLine(trace, thread, thread_name, it->first, it->second);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  Filter filter;
+  std::vector<std::string> traces;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--jobs=")) {
+      jobs = std::max(1, atoi(strchr(arg, '=') + 1));
+    } else if (StartsWith(arg, "--names=")) {
+      std::string names(strchr(arg, '=') + 1);
+      size_t start = 0;
+      while (start <= names.size()) {
+        size_t comma = std::min(names.find(',', start), names.size());
+        if (comma > start)
+          filter.names.insert(names.substr(start, comma - start));
+        start = comma + 1;
+      }
+    } else if (StartsWith(arg, "--thread=")) {
+      filter.thread = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--")) {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    } else {
+      traces.push_back(arg);
+    }
+  }
+
+  if (traces.empty()) {
+    fprintf(stderr, "Usage: %s [--jobs=<n>] [--names=<slice>,...] [--thread=<name>] "
+        "<trace>...\n", argv[0]);
+    return 1;
+  }
+
+  // Workers take the next trace until there is none
+  double start_time = browser_profiler::MonotonicNow();
+  std::vector<TraceResult> results(traces.size());
+  std::atomic<size_t> next_trace(0);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::min<size_t>(jobs, traces.size()); ++i) {
+    workers.push_back(std::thread([&]() {
+      for (size_t trace = next_trace++; trace < traces.size(); trace = next_trace++)
+        IndexTrace(traces[trace], filter, &results[trace]);
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+
+  printf("Trace\tPid\tTid\tThread\tSlice\tCount\tTotal (ms)\tMax (ms)\n");
+  size_t num_events = 0;
+  size_t num_failed = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].parsed) {
+      fprintf(stderr, "%s: %s\n", traces[i].c_str(), results[i].error.c_str());
+      ++num_failed;
+      continue;
+    }
+    if (results[i].num_unmatched_events > 0) {
+      fprintf(stderr, "%s: %zu unmatched begin/end events\n", traces[i].c_str(),
+          results[i].num_unmatched_events);
+    }
+    num_events += results[i].num_events;
+    fputs(results[i].lines.c_str(), stdout);
+  }
+
+  fprintf(stderr, "%zu traces, %zu events in %.2f s with %zu jobs\n",
+      traces.size() - num_failed, num_events, browser_profiler::MonotonicNow() - start_time,
+      workers.size());
+  return num_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Captures packets into a pcap file with PacketCapture, e.g., on loopback to check it,
+// or as root on a device where the browser lacks CAP_NET_RAW
+//
+// Usage: packet_capture [--interface=<name>] [--snaplen=<bytes>] [--filter=<file>]
+//            [--duration=<seconds>] <output.pcap>
+// filter: tcpdump -ddd output, e.g., tcpdump -i lo -ddd 'tcp port 8000' > filter
+// Captures until SIGINT or SIGTERM, or for duration; prints the counters to stderr
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "packet_capture.h"
+
+namespace {
+
+volatile sig_atomic_t g_stop_requested = 0;
+
+void OnSignal(int) {
+  g_stop_requested = 1;
+}
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  browser_profiler::PacketCapture::Config config;
+  double duration = 0;
+  std::string output_file;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = strchr(arg, '=') ? strchr(arg, '=') + 1 : "";
+    if (StartsWith(arg, "--interface=")) {
+      config.interface = value;
+    } else if (StartsWith(arg, "--snaplen=")) {
+      config.snaplen = strtoul(value, nullptr, 10);
+    } else if (StartsWith(arg, "--duration=")) {
+      duration = atof(value);
+    } else if (StartsWith(arg, "--filter=")) {
+      std::ifstream filter_file(value);
+      std::stringstream text;
+      text << filter_file.rdbuf();
+      std::string error;
+      if (!filter_file ||
+          !browser_profiler::PacketCapture::ParseFilter(text.str(), &config.filter, &error)) {
+        fprintf(stderr, "Invalid filter %s: %s\n", value, error.c_str());
+        return 1;
+      }
+    } else if (StartsWith(arg, "--")) {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    } else {
+      output_file = arg;
+    }
+  }
+
+  if (output_file.empty() || config.snaplen == 0) {
+    fprintf(stderr, "Usage: %s [--interface=<name>] [--snaplen=<bytes>] [--filter=<file>] "
+        "[--duration=<seconds>] <output.pcap>\n", argv[0]);
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnSignal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  browser_profiler::PacketCapture capture(config);
+  std::string error;
+  if (!capture.Open(&error) || !capture.Start(output_file, &error)) {
+    fprintf(stderr, "Cannot capture: %s\n", error.c_str());
+    return 1;
+  }
+
+  // Signals interrupt the sleep
+  const double kPollSeconds = 0.05;
+  for (double elapsed = 0; !g_stop_requested && (duration <= 0 || elapsed < duration);
+       elapsed += kPollSeconds) {
+    usleep(static_cast<useconds_t>(kPollSeconds * 1e6));
+  }
+
+  browser_profiler::PacketCapture::Stats stats;
+  bool complete = capture.Stop(&stats, &error);
+  fprintf(stderr, "%llu packets captured, %llu dropped, %llu bytes written\n",
+      static_cast<unsigned long long>(stats.packets),
+      static_cast<unsigned long long>(stats.drops),
+      static_cast<unsigned long long>(stats.bytes_written));
+  if (!complete) {
+    fprintf(stderr, "Incomplete capture: %s\n", error.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,336 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Runs a campaign on several browser instances at once, for metrics which do not
+// need the whole device, e.g., page load time (not with --measure-power)
+// The manifest must have a single command line: instances share the browser command line file
+// Each instance runs its share of the url x command line matrix (--num-instances and
+// --instance-index are appended to the browser arguments), keeps its state and logs
+// apart, and appends to the shared result store out/experiment_result.bpr, which is
+// prefixed with the last experiment id at the end
+// An instance which exits is started again (a browser restart), until it marks its end
+// The root helper which the instances share is shut down once they all finished
+//
+// Usage: parallel_runner --num-instances=<n> [--writable-dir=<dir>]
+//   [--cpus-per-instance=<k> [--first-cpu=<cpu>]]
+//   [--profile-switch=<switch> --profile-root=<dir>] -- <browser> [arguments]
+// cpus-per-instance: instance i is pinned to cpus first-cpu + [i * k, (i + 1) * k)
+// profile-switch: the browser switch of its profile directory, e.g., --user-data-dir;
+//   instance i gets <profile-root>/instance-<i>
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "clock_domain.h"
+#include "experiment_result_store.h"
+#include "root_helper_protocol.h"
+
+namespace {
+
+// Same layout as BrowserProfilerImplConstants
+const char kDefaultWritableDir[] = "/sdcard/bp/";
+const char kInstanceDirPrefix[] = "instance-";
+const char kAllExperimentsFinishedName[] = "all-experiments-finished";
+const char kOutDirName[] = "/out/";
+const char kExperimentResultStoreName[] = "experiment_result.bpr";
+
+// An instance which keeps exiting this fast is broken, e.g., a bad argument
+const int kQuickExitSeconds = 2;
+const int kMaxQuickExits = 10;
+
+volatile sig_atomic_t g_stop = 0;
+
+void OnStopSignal(int) {
+  g_stop = 1;
+}
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+std::string IntToString(size_t value) {
+  char text[32];
+  snprintf(text, sizeof(text), "%zu", value);
+  return text;
+}
+
+std::string InstanceDirName(size_t index) {
+  return kInstanceDirPrefix + IntToString(index);
+}
+
+bool ReadFileToString(const std::string& path, std::string* content) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file)
+    return false;
+  content->clear();
+  char buffer[256];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    content->append(buffer, num_read);
+  fclose(file);
+  return true;
+}
+
+// The instances share the root helper of the campaign, shut it down once they all finished
+void ShutdownRootHelper() {
+  namespace root_helper = browser_profiler::root_helper;
+  int fd = root_helper::ConnectToHelper(root_helper::kDefaultSocketName);
+  if (fd < 0)
+    return;  // The instances ran root commands through su
+
+  // Same check as RootCommandRunner: only talk to a helper running as root
+  if (root_helper::PeerUid(fd) != 0) {
+    fprintf(stderr, "Root helper socket is not held by root, leave it\n");
+    close(fd);
+    return;
+  }
+
+  std::vector<root_helper::Command> commands(1,
+      root_helper::Command(root_helper::kShutdown, std::string(), 0));
+  std::vector<root_helper::Result> results;
+  if (!root_helper::WriteCommands(fd, commands) || !root_helper::ReadResults(fd, &results))
+    fprintf(stderr, "Cannot shut down the root helper\n");
+  close(fd);
+}
+
+struct Instance {
+  Instance() : pid(-1), start_time(0), quick_exits(0), finished(false) {}
+
+  pid_t pid;
+  double start_time;
+  int quick_exits;
+  bool finished;
+};
+
+class Runner {
+ public:
+  Runner(const std::vector<std::string>& browser_args, int num_instances,
+      const std::string& writable_dir, int cpus_per_instance, int first_cpu,
+      const std::string& profile_switch, const std::string& profile_root)
+    : browser_args_(browser_args),
+      instances_(num_instances),
+      writable_dir_(writable_dir),
+      cpus_per_instance_(cpus_per_instance),
+      first_cpu_(first_cpu),
+      profile_switch_(profile_switch),
+      profile_root_(profile_root) {}
+
+  // Return the number of instances which did not finish
+  int Run() {
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      unlink(FinishedFile(i).c_str());
+      Launch(i);
+    }
+
+    int running = instances_.size();
+    while (running > 0 && !g_stop) {
+      int status;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0) {
+        if (errno == EINTR)
+          continue;
+        perror("waitpid");
+        break;
+      }
+
+      std::map<pid_t, size_t>::iterator it = indexes_.find(pid);
+      if (it == indexes_.end())
+        continue;
+      size_t index = it->second;
+      indexes_.erase(it);
+      Instance& instance = instances_[index];
+      instance.pid = -1;
+
+      if (access(FinishedFile(index).c_str(), F_OK) == 0) {
+        instance.finished = true;
+        // The file holds the last experiment id of the instance
+        ReadFileToString(FinishedFile(index), &last_experiment_id_);
+        --running;
+        printf("Instance %zu finished\n", index);
+        continue;
+      }
+
+      if (browser_profiler::MonotonicNow() - instance.start_time < kQuickExitSeconds) {
+        if (++instance.quick_exits >= kMaxQuickExits) {
+          fprintf(stderr, "Instance %zu keeps exiting, give up on it\n", index);
+          --running;
+          continue;
+        }
+      } else {
+        instance.quick_exits = 0;
+      }
+      Launch(index);
+    }
+
+    // Interrupted: stop the browsers
+    for (size_t i = 0; i < instances_.size(); ++i) {
+      if (instances_[i].pid > 0)
+        kill(instances_[i].pid, SIGTERM);
+    }
+    while (!indexes_.empty()) {
+      pid_t pid = waitpid(-1, nullptr, 0);
+      if (pid < 0 && errno != EINTR)
+        break;
+      indexes_.erase(pid);
+    }
+
+    int unfinished = 0;
+    for (size_t i = 0; i < instances_.size(); ++i)
+      unfinished += instances_[i].finished ? 0 : 1;
+    return unfinished;
+  }
+
+  // Of the instance which finished last, empty if none did
+  const std::string& last_experiment_id() const { return last_experiment_id_; }
+
+ private:
+  std::string FinishedFile(size_t index) const {
+    return writable_dir_ + "/tmp/" + InstanceDirName(index) + "/" + kAllExperimentsFinishedName;
+  }
+
+  void Launch(size_t index) {
+    std::vector<std::string> args(browser_args_);
+    args.push_back("--num-instances=" + IntToString(instances_.size()));
+    args.push_back("--instance-index=" + IntToString(index));
+    if (!profile_switch_.empty()) {
+      std::string profile_dir = profile_root_ + "/" + InstanceDirName(index);
+      mkdir(profile_dir.c_str(), 0777);
+      args.push_back(profile_switch_ + "=" + profile_dir);
+    }
+
+    std::vector<char*> argv;
+    for (size_t i = 0; i < args.size(); ++i)
+      argv.push_back(const_cast<char*>(args[i].c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return;
+    }
+
+    if (pid == 0) {
+      // Disjoint cpus, inherited by all the threads of the browser
+      if (cpus_per_instance_ > 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < cpus_per_instance_; ++i)
+          CPU_SET(first_cpu_ + index * cpus_per_instance_ + i, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) < 0)
+          perror("sched_setaffinity");
+      }
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      execvp(argv[0], argv.data());
+      perror("execvp");
+      _exit(127);
+    }
+
+    instances_[index].pid = pid;
+    instances_[index].start_time = browser_profiler::MonotonicNow();
+    indexes_[pid] = index;
+  }
+
+  std::vector<std::string> browser_args_;
+  std::vector<Instance> instances_;
+  std::map<pid_t, size_t> indexes_;
+  std::string writable_dir_;
+  int cpus_per_instance_;
+  int first_cpu_;
+  std::string profile_switch_;
+  std::string profile_root_;
+  std::string last_experiment_id_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int num_instances = 0;
+  std::string writable_dir(kDefaultWritableDir);
+  int cpus_per_instance = 0;
+  int first_cpu = 0;
+  std::string profile_switch;
+  std::string profile_root;
+  std::vector<std::string> browser_args;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--") == 0) {
+      browser_args.assign(argv + i + 1, argv + argc);
+      break;
+    } else if (StartsWith(arg, "--num-instances=")) {
+      num_instances = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--writable-dir=")) {
+      writable_dir = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--cpus-per-instance=")) {
+      cpus_per_instance = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--first-cpu=")) {
+      first_cpu = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--profile-switch=")) {
+      profile_switch = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--profile-root=")) {
+      profile_root = strchr(arg, '=') + 1;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (num_instances < 1 || browser_args.empty()) {
+    fprintf(stderr, "Usage: %s --num-instances=<n> [options] -- <browser> [arguments]\n",
+        argv[0]);
+    return 1;
+  }
+  if (!profile_switch.empty() && profile_root.empty()) {
+    fprintf(stderr, "Missing --profile-root=<dir>\n");
+    return 1;
+  }
+
+  long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if (cpus_per_instance > 0 && first_cpu + num_instances * cpus_per_instance > num_cpus) {
+    fprintf(stderr, "%d instances of %d cpus from cpu %d do not fit in %ld cpus\n",
+        num_instances, cpus_per_instance, first_cpu, num_cpus);
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = OnStopSignal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  Runner runner(browser_args, num_instances, writable_dir, cpus_per_instance, first_cpu,
+      profile_switch, profile_root);
+  int unfinished = runner.Run();
+  if (unfinished > 0) {
+    fprintf(stderr, "%d instances did not finish\n", unfinished);
+    return 1;
+  }
+
+  ShutdownRootHelper();
+
+  // Prefixed like the store of a single instance, which the instances leave to the runner
+  const std::string& prefix = runner.last_experiment_id();
+  std::string store_path = writable_dir + kOutDirName + kExperimentResultStoreName;
+  if (!prefix.empty() && access(store_path.c_str(), F_OK) == 0) {
+    if (browser_profiler::ExperimentResultStore::Prefix(store_path, prefix))
+      store_path = writable_dir + kOutDirName + prefix + "." + kExperimentResultStoreName;
+    else
+      perror("Cannot prefix the result store");
+  }
+
+  printf("Results: %s\n", store_path.c_str());
+  return 0;
+}
@@ -0,0 +1,226 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Measure the client side of the power tool protocol: PowerToolConnectionImpl
+// against a server, typically tools/power_tool_mock_server
+//
+// Usage: power_tool_benchmark [--server=<address>] [--port=<port>]
+//   [--mode=ping|cycle] [--iterations=<n>] [--warmup=<n>] [--payload-bytes=<n>]
+//   [--timeout-ms=<ms>]
+// ping: one round trip per iteration (mock server only)
+// cycle: start_sampling then stop_sampling with a result payload, as in an experiment
+//
+// Prints latency percentiles (us), throughput and the failures, e.g., injected faults
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "power_tool_connection_impl.h"
+#include "power_tool_protocol.h"
+
+namespace {
+
+using browser_profiler::PowerToolConnectionImpl;
+using browser_profiler::power_tool::KeyValues;
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+int64_t MonotonicMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+std::string Command(const char* command) {
+  KeyValues message;
+  message.push_back(std::make_pair(browser_profiler::power_tool::kCommandKey, command));
+  return browser_profiler::power_tool::ComposeMessage(message);
+}
+
+std::string StartSampling() {
+  KeyValues message;
+  message.push_back(std::make_pair(browser_profiler::power_tool::kCommandKey,
+      browser_profiler::power_tool::kStartSamplingCommand));
+  message.push_back(std::make_pair(browser_profiler::power_tool::kWaitForFirstSampleKey, "1"));
+  return browser_profiler::power_tool::ComposeMessage(message);
+}
+
+// A result payload of about payload_bytes tab-separated values
+std::string StopSampling(size_t payload_bytes) {
+  std::string keys;
+  std::string values;
+  for (size_t i = 0; values.length() < payload_bytes; ++i) {
+    char field[32];
+    snprintf(field, sizeof(field), "%sMetric %zu", i ? "\t" : "", i);
+    keys.append(field);
+    snprintf(field, sizeof(field), "%s%zu.123456", i ? "\t" : "", i);
+    values.append(field);
+  }
+  KeyValues message;
+  message.push_back(std::make_pair(browser_profiler::power_tool::kCommandKey,
+      browser_profiler::power_tool::kStopSamplingCommand));
+  message.push_back(std::make_pair(browser_profiler::power_tool::kResultKeysKey, keys));
+  message.push_back(std::make_pair(browser_profiler::power_tool::kResultValuesKey, values));
+  return browser_profiler::power_tool::ComposeMessage(message);
+}
+
+// Return true if the server answered ok
+bool RoundTrip(PowerToolConnectionImpl* connection, const std::string& request) {
+  std::string response;
+  KeyValues response_key_values;
+  std::string status;
+  return connection->SyncSendMessage(request) &&
+      connection->SyncReceiveMessage(&response) &&
+      browser_profiler::power_tool::ParseMessage(response, &response_key_values) &&
+      browser_profiler::power_tool::FindValue(response_key_values,
+          browser_profiler::power_tool::kStatusKey, &status) &&
+      status == browser_profiler::power_tool::kOkValue;
+}
+
+void PrintLatencies(const char* name, std::vector<int64_t> latencies) {
+  if (latencies.empty()) {
+    printf("%-12s no sample\n", name);
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  int64_t total = 0;
+  for (size_t i = 0; i < latencies.size(); ++i)
+    total += latencies[i];
+  size_t n = latencies.size();
+  printf("%-12s n=%zu mean=%.1f min=%lld p50=%lld p90=%lld p99=%lld max=%lld (us)\n",
+      name, n, static_cast<double>(total) / n,
+      static_cast<long long>(latencies[0]),
+      static_cast<long long>(latencies[n / 2]),
+      static_cast<long long>(latencies[n * 9 / 10]),
+      static_cast<long long>(latencies[std::min(n - 1, n * 99 / 100)]),
+      static_cast<long long>(latencies[n - 1]));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string server("127.0.0.1");
+  uint32_t port = 3000;
+  std::string mode("ping");
+  int iterations = 1000;
+  int warmup = 10;
+  size_t payload_bytes = 1024;
+  int timeout_ms = 2000;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--server=")) {
+      server = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--port=")) {
+      port = strtoul(strchr(arg, '=') + 1, nullptr, 10);
+    } else if (StartsWith(arg, "--mode=")) {
+      mode = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--iterations=")) {
+      iterations = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--warmup=")) {
+      warmup = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--payload-bytes=")) {
+      payload_bytes = strtoul(strchr(arg, '=') + 1, nullptr, 10);
+    } else if (StartsWith(arg, "--timeout-ms=")) {
+      timeout_ms = atoi(strchr(arg, '=') + 1);
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (mode != "ping" && mode != "cycle") {
+    fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+    return 1;
+  }
+
+  PowerToolConnectionImpl connection(server, port);
+  connection.set_io_timeout_millis(timeout_ms);
+  connection.set_connect_timeout_millis(timeout_ms);
+
+  std::vector<int64_t> connect_latencies;
+  int64_t start = MonotonicMicros();
+  if (!connection.Connect()) {
+    fprintf(stderr, "Cannot connect to %s port %u\n", server.c_str(), port);
+    return 1;
+  }
+  connect_latencies.push_back(MonotonicMicros() - start);
+
+  std::string ping = Command(browser_profiler::power_tool::kPingCommand);
+  std::string start_sampling = StartSampling();
+  std::string stop_sampling = StopSampling(payload_bytes);
+
+  std::vector<int64_t> first_latencies;
+  std::vector<int64_t> second_latencies;
+  int failures = 0;
+  size_t bytes_sent = 0;
+  size_t syscalls_before = 0;
+  int64_t measure_start = 0;
+
+  for (int i = -warmup; i < iterations; ++i) {
+    if (i == 0) {
+      syscalls_before = connection.num_io_syscalls();
+      measure_start = MonotonicMicros();
+    }
+
+    bool ok;
+    int64_t begin = MonotonicMicros();
+    if (mode == "ping") {
+      ok = RoundTrip(&connection, ping);
+      if (ok && i >= 0) {
+        first_latencies.push_back(MonotonicMicros() - begin);
+        bytes_sent += ping.length();
+      }
+    } else {
+      ok = RoundTrip(&connection, start_sampling);
+      int64_t middle = MonotonicMicros();
+      ok = ok && RoundTrip(&connection, stop_sampling);
+      if (ok && i >= 0) {
+        first_latencies.push_back(middle - begin);
+        second_latencies.push_back(MonotonicMicros() - middle);
+        bytes_sent += start_sampling.length() + stop_sampling.length();
+      }
+    }
+
+    if (!ok) {
+      ++failures;
+      // The reply may still come, start over on a new connection
+      begin = MonotonicMicros();
+      if (!connection.Connect()) {
+        fprintf(stderr, "Cannot reconnect after %d failures\n", failures);
+        return 1;
+      }
+      connect_latencies.push_back(MonotonicMicros() - begin);
+    }
+  }
+
+  double elapsed_s = (MonotonicMicros() - measure_start) / 1e6;
+  size_t round_trips = first_latencies.size() + second_latencies.size();
+
+  printf("server=%s port=%u mode=%s iterations=%d\n", server.c_str(), port, mode.c_str(),
+      iterations);
+  PrintLatencies("connect", connect_latencies);
+  if (mode == "ping") {
+    PrintLatencies("ping", first_latencies);
+  } else {
+    PrintLatencies("start", first_latencies);
+    PrintLatencies("stop", second_latencies);
+  }
+  printf("throughput: %.0f round trips/s, %.2f MB/s sent\n",
+      elapsed_s > 0 ? round_trips / elapsed_s : 0,
+      elapsed_s > 0 ? bytes_sent / elapsed_s / 1e6 : 0);
+  printf("syscalls per round trip: %.2f\n", round_trips ?
+      static_cast<double>(connection.num_io_syscalls() - syscalls_before) / round_trips : 0);
+  printf("failures: %d\n", failures);
+  return 0;
+}
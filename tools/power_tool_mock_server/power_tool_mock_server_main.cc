@@ -0,0 +1,355 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Mock power tool server, stands in for the lab server on any Linux box
+// Speaks the protocol of PowerToolController (see power_tool_protocol.h),
+// synthesizes a power sample stream and can inject faults
+//
+// Usage: power_tool_mock_server [--listen=<address>] [--port=<port>]
+//   [--sample-rate-hz=<hz>] [--base-power-watts=<w>] [--peak-power-watts=<w>]
+//   [--noise-watts=<w>] [--start-delay-ms=<ms>] [--legacy]
+//   [--reply-delay-ms=<ms>] [--drop-rate=<p>] [--malformed-rate=<p>] [--error-rate=<p>]
+//   [--seed=<n>] [--result-log=<file>] [--verbose]
+// address: a host (default 127.0.0.1), or unix:<path>, unix:@<abstract name>
+// --legacy: acknowledge start_sampling right away, without FirstSampleTime, like old servers
+// Streams the samples, before its response to stop_sampling, if the client asks to
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "clock_domain.h"
+#include "power_tool_protocol.h"
+
+namespace {
+
+using browser_profiler::power_tool::KeyValues;
+
+const double kPi = 3.14159265358979323846;
+
+// The synthesized load oscillates at this frequency between base and peak power
+const double kLoadFrequencyHz = 0.5;
+
+const size_t kSamplesPerMessage = 1000;
+
+struct Options {
+  Options()
+    : address("127.0.0.1"),
+      port(3000),
+      sample_rate_hz(5000),
+      base_power_watts(1.2),
+      peak_power_watts(3.5),
+      noise_watts(0.05),
+      start_delay_ms(300),
+      legacy(false),
+      reply_delay_ms(0),
+      drop_rate(0),
+      malformed_rate(0),
+      error_rate(0),
+      seed(1),
+      verbose(false) {
+  }
+
+  std::string address;
+  uint32_t port;
+  double sample_rate_hz;
+  double base_power_watts;
+  double peak_power_watts;
+  double noise_watts;
+  int start_delay_ms;
+  bool legacy;
+  int reply_delay_ms;
+  double drop_rate;
+  double malformed_rate;
+  double error_rate;
+  uint64_t seed;
+  std::string result_log;
+  bool verbose;
+};
+
+Options g_options;
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+void SleepMillis(int millis) {
+  if (millis <= 0)
+    return;
+  struct timespec duration;
+  duration.tv_sec = millis / 1000;
+  duration.tv_nsec = (millis % 1000) * 1000000L;
+  while (nanosleep(&duration, &duration) < 0 && errno == EINTR) {}
+}
+
+// xorshift64*, deterministic for a seed
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+  // In [0, 1)
+  double Next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return ((state_ * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+// The synthesized sample stream of a sampling session
+class SampleStream {
+ public:
+  explicit SampleStream(uint64_t seed) : random_(seed) {}
+
+  // Power of the sample at time t (s)
+  double PowerAt(double t) {
+    double load = 0.5 + 0.5 * sin(2 * kPi * kLoadFrequencyHz * t);
+    double noise = (2 * random_.Next() - 1) * g_options.noise_watts;
+    return g_options.base_power_watts +
+        (g_options.peak_power_watts - g_options.base_power_watts) * load + noise;
+  }
+
+  // Samples from first_sample_time to end_time, at the sampling rate
+  // times and watts get the samples if not null
+  void Integrate(double first_sample_time, double end_time, uint64_t* num_samples,
+      double* energy_joules, std::vector<double>* times, std::vector<double>* watts) {
+    double period = 1 / g_options.sample_rate_hz;
+    *num_samples = 0;
+    *energy_joules = 0;
+    for (double t = first_sample_time; t < end_time; t += period) {
+      double power = PowerAt(t);
+      *energy_joules += power * period;
+      ++*num_samples;
+      if (times) {
+        times->push_back(t);
+        watts->push_back(power);
+      }
+    }
+  }
+
+ private:
+  Random random_;
+};
+
+std::string FormatDouble(double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.6f", value);
+  return buffer;
+}
+
+void AppendResult(const std::string& keys, const std::string& values,
+    uint64_t num_samples, double energy_joules) {
+  if (g_options.result_log.empty())
+    return;
+  FILE* log = fopen(g_options.result_log.c_str(), "a");
+  if (log == nullptr) {
+    perror(g_options.result_log.c_str());
+    return;
+  }
+  // Header then values, like the experiment result log, with the server's columns
+  fprintf(log, "%s\tNum Samples\tServer Energy (J)\n%s\t%llu\t%.6f\n", keys.c_str(),
+      values.c_str(), static_cast<unsigned long long>(num_samples), energy_joules);
+  fclose(log);
+}
+
+// Send the samples in messages of kSamplesPerMessage
+bool StreamSamples(int client_fd, const std::vector<double>& times,
+    const std::vector<double>& watts) {
+  for (size_t begin = 0; begin < times.size(); begin += kSamplesPerMessage) {
+    size_t count = std::min(kSamplesPerMessage, times.size() - begin);
+    std::string samples;
+    browser_profiler::power_tool::AppendSamples(&times[begin], &watts[begin], count, &samples);
+    KeyValues message;
+    message.push_back(std::make_pair(browser_profiler::power_tool::kSamplesKey, samples));
+    if (!browser_profiler::power_tool::WriteMessage(client_fd,
+            browser_profiler::power_tool::ComposeMessage(message)))
+      return false;
+  }
+  return true;
+}
+
+// Serve one client until it disconnects
+void ServeClient(int client_fd, uint64_t seed) {
+  Random faults(seed ^ 0x9e3779b97f4a7c15ULL);
+  SampleStream stream(seed);
+  std::string buffer;
+  std::string message;
+  bool sampling = false;
+  bool streaming = false;
+  double first_sample_time = 0;
+
+  while (browser_profiler::power_tool::ReadMessage(client_fd, &buffer, &message)) {
+    KeyValues request;
+    KeyValues reply;
+    std::string command;
+    bool valid = browser_profiler::power_tool::ParseMessage(message, &request) &&
+        browser_profiler::power_tool::FindValue(request,
+            browser_profiler::power_tool::kCommandKey, &command);
+    if (g_options.verbose)
+      fprintf(stderr, "[%d] %s\n", getpid(), valid ? command.c_str() : "malformed request");
+
+    bool ok = true;
+    if (!valid) {
+      ok = false;
+    } else if (command == browser_profiler::power_tool::kStartSamplingCommand) {
+      std::string wait;
+      bool wait_for_first_sample = !g_options.legacy && browser_profiler::power_tool::FindValue(
+          request, browser_profiler::power_tool::kWaitForFirstSampleKey, &wait) && wait == "1";
+      std::string stream;
+      streaming = !g_options.legacy && browser_profiler::power_tool::FindValue(
+          request, browser_profiler::power_tool::kStreamSamplesKey, &stream) && stream == "1";
+      first_sample_time = browser_profiler::MonotonicNow() + g_options.start_delay_ms / 1000.0;
+      sampling = true;
+      if (wait_for_first_sample) {
+        SleepMillis(g_options.start_delay_ms);
+        reply.push_back(std::make_pair(browser_profiler::power_tool::kFirstSampleTimeKey,
+            FormatDouble(first_sample_time)));
+      }
+      if (streaming)
+        reply.push_back(std::make_pair(browser_profiler::power_tool::kStreamSamplesKey, "1"));
+    } else if (command == browser_profiler::power_tool::kStopSamplingCommand) {
+      ok = sampling;
+      if (sampling) {
+        uint64_t num_samples = 0;
+        double energy_joules = 0;
+        std::vector<double> times;
+        std::vector<double> watts;
+        stream.Integrate(first_sample_time, browser_profiler::MonotonicNow(), &num_samples,
+            &energy_joules, streaming ? &times : nullptr, streaming ? &watts : nullptr);
+        // A real server streams them while sampling, the mock sends them all at once
+        if (streaming && !StreamSamples(client_fd, times, watts))
+          return;
+        std::string keys;
+        std::string values;
+        browser_profiler::power_tool::FindValue(request,
+            browser_profiler::power_tool::kResultKeysKey, &keys);
+        browser_profiler::power_tool::FindValue(request,
+            browser_profiler::power_tool::kResultValuesKey, &values);
+        AppendResult(keys, values, num_samples, energy_joules);
+        sampling = false;
+      }
+    } else if (command != browser_profiler::power_tool::kFinishAllExperimentsCommand &&
+               command != browser_profiler::power_tool::kPingCommand) {
+      ok = false;
+    }
+
+    SleepMillis(g_options.reply_delay_ms);
+
+    // Injected faults
+    double fault = faults.Next();
+    if (fault < g_options.drop_rate)
+      return;
+    fault -= g_options.drop_rate;
+    std::string response;
+    if (fault < g_options.malformed_rate) {
+      response = std::string("Status ok, no separator") +
+          browser_profiler::power_tool::kBlankLine;
+    } else {
+      fault -= g_options.malformed_rate;
+      if (fault < g_options.error_rate)
+        ok = false;
+      reply.insert(reply.begin(), std::make_pair(browser_profiler::power_tool::kStatusKey,
+          ok ? browser_profiler::power_tool::kOkValue :
+               browser_profiler::power_tool::kErrorValue));
+      response = browser_profiler::power_tool::ComposeMessage(reply);
+    }
+
+    if (!browser_profiler::power_tool::WriteMessage(client_fd, response))
+      return;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--listen=")) {
+      g_options.address = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--port=")) {
+      g_options.port = strtoul(strchr(arg, '=') + 1, nullptr, 10);
+    } else if (StartsWith(arg, "--sample-rate-hz=")) {
+      g_options.sample_rate_hz = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--base-power-watts=")) {
+      g_options.base_power_watts = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--peak-power-watts=")) {
+      g_options.peak_power_watts = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--noise-watts=")) {
+      g_options.noise_watts = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--start-delay-ms=")) {
+      g_options.start_delay_ms = atoi(strchr(arg, '=') + 1);
+    } else if (strcmp(arg, "--legacy") == 0) {
+      g_options.legacy = true;
+    } else if (StartsWith(arg, "--reply-delay-ms=")) {
+      g_options.reply_delay_ms = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--drop-rate=")) {
+      g_options.drop_rate = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--malformed-rate=")) {
+      g_options.malformed_rate = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--error-rate=")) {
+      g_options.error_rate = atof(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--seed=")) {
+      g_options.seed = strtoull(strchr(arg, '=') + 1, nullptr, 10);
+    } else if (StartsWith(arg, "--result-log=")) {
+      g_options.result_log = strchr(arg, '=') + 1;
+    } else if (strcmp(arg, "--verbose") == 0) {
+      g_options.verbose = true;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (g_options.sample_rate_hz <= 0) {
+    fprintf(stderr, "Invalid sample rate\n");
+    return 1;
+  }
+
+  int listen_fd = browser_profiler::power_tool::Listen(g_options.address, g_options.port);
+  if (listen_fd < 0) {
+    perror("Cannot listen");
+    return 1;
+  }
+  fprintf(stderr, "Listening on %s port %u\n", g_options.address.c_str(), g_options.port);
+
+  // Connection handlers are reaped automatically
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (uint64_t connection = 0;; ++connection) {
+    int client_fd = accept(listen_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("accept");
+      return 1;
+    }
+
+    // One handler per connection: an injected delay only blocks its own client
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listen_fd);
+      ServeClient(client_fd, g_options.seed + connection);
+      close(client_fd);
+      _exit(0);
+    }
+    close(client_fd);
+  }
+
+  return 0;
+}
@@ -0,0 +1,287 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// On-device relay to the power tool server
+// Started once per campaign, it keeps one connection to the server for all
+// experiments, while each browser process only connects to the relay over a
+// local socket. A browser crash does not break the connection to the server
+//
+// Usage: power_tool_relay --server=<address> [--port=<port>] [--listen=<address>]
+//   [--allowed-uid=<uid>] [--io-timeout-ms=<ms>] [--daemonize]
+// address: a host, or unix:<path>, unix:@<abstract name>
+// Listens on power_tool::kDefaultRelayAddress by default
+//
+// Answers ping and shutdown_relay itself, forwards everything else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+
+#include "power_tool_protocol.h"
+
+namespace {
+
+using browser_profiler::power_tool::KeyValues;
+
+const int kReconnectRetries = 3;
+const int kReconnectRetryMillis = 200;
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+void SleepMillis(int millis) {
+  struct timespec duration;
+  duration.tv_sec = millis / 1000;
+  duration.tv_nsec = (millis % 1000) * 1000000L;
+  while (nanosleep(&duration, &duration) < 0 && errno == EINTR) {}
+}
+
+// Return the uid of the peer of a Unix socket, -1 if unknown, e.g., over TCP
+int PeerUid(int socket_fd) {
+  struct ucred credentials;
+  socklen_t length = sizeof(credentials);
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0)
+    return -1;
+  return credentials.uid;
+}
+
+std::string Reply(const char* status) {
+  KeyValues reply;
+  reply.push_back(std::make_pair(browser_profiler::power_tool::kStatusKey, status));
+  return browser_profiler::power_tool::ComposeMessage(reply);
+}
+
+// The connection to the power tool server, shared by all clients
+class Upstream {
+ public:
+  Upstream(const std::string& address, uint32_t port, int io_timeout_ms)
+    : address_(address), port_(port), io_timeout_ms_(io_timeout_ms), fd_(-1) {}
+
+  bool Connect() {
+    Close();
+    for (int i = 0; i < kReconnectRetries && fd_ < 0; ++i) {
+      if (i > 0)
+        SleepMillis(kReconnectRetryMillis << (i - 1));
+      fd_ = browser_profiler::power_tool::Connect(address_, port_);
+    }
+    if (fd_ < 0) {
+      fprintf(stderr, "Cannot connect to %s port %u\n", address_.c_str(), port_);
+      return false;
+    }
+
+    // Requests are small and synchronous
+    int no_delay = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    // A dead server is an error, not a hang
+    struct timeval timeout;
+    timeout.tv_sec = io_timeout_ms_ / 1000;
+    timeout.tv_usec = (io_timeout_ms_ % 1000) * 1000;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return true;
+  }
+
+  // Return false if the server did not answer, the connection is dropped then
+  // Samples streamed before the response are passed on to client_fd as they come
+  bool Forward(const std::string& request, int client_fd, std::string* response) {
+    if (fd_ < 0 && !Connect())
+      return false;
+
+    // The server may have closed the idle connection: retry once on a new one
+    // when the request could not be sent; a request which was sent is never repeated
+    if (!browser_profiler::power_tool::WriteMessage(fd_, request) &&
+        (!Connect() || !browser_profiler::power_tool::WriteMessage(fd_, request))) {
+      Close();
+      return false;
+    }
+
+    // A client which left still gets its samples drained, the response stays in order
+    bool client_connected = true;
+    for (;;) {
+      if (!browser_profiler::power_tool::ReadMessage(fd_, &buffer_, response)) {
+        fprintf(stderr, "No response from the server: %s\n", strerror(errno));
+        Close();
+        return false;
+      }
+      if (!browser_profiler::power_tool::IsSamplesMessage(*response))
+        return true;
+      if (client_connected)
+        client_connected = browser_profiler::power_tool::WriteMessage(client_fd, *response);
+    }
+  }
+
+  void Close() {
+    if (fd_ >= 0)
+      close(fd_);
+    fd_ = -1;
+    buffer_.clear();
+  }
+
+ private:
+  std::string address_;
+  uint32_t port_;
+  int io_timeout_ms_;
+  int fd_;
+  std::string buffer_;
+};
+
+// Serve one client until it disconnects
+// Return true if the client asked the relay to shut down
+bool ServeClient(int client_fd, Upstream* upstream) {
+  std::string buffer;
+  std::string request;
+  bool sampling = false;
+
+  while (browser_profiler::power_tool::ReadMessage(client_fd, &buffer, &request)) {
+    KeyValues key_values;
+    std::string command;
+    browser_profiler::power_tool::ParseMessage(request, &key_values);
+    browser_profiler::power_tool::FindValue(key_values,
+        browser_profiler::power_tool::kCommandKey, &command);
+
+    if (command == browser_profiler::power_tool::kPingCommand) {
+      if (!browser_profiler::power_tool::WriteMessage(client_fd,
+              Reply(browser_profiler::power_tool::kOkValue)))
+        break;
+      continue;
+    }
+
+    if (command == browser_profiler::power_tool::kShutdownRelayCommand) {
+      browser_profiler::power_tool::WriteMessage(client_fd,
+          Reply(browser_profiler::power_tool::kOkValue));
+      return true;
+    }
+
+    std::string response;
+    if (!upstream->Forward(request, client_fd, &response))
+      response = Reply(browser_profiler::power_tool::kErrorValue);
+
+    if (command == browser_profiler::power_tool::kStartSamplingCommand)
+      sampling = true;
+    else if (command == browser_profiler::power_tool::kStopSamplingCommand)
+      sampling = false;
+
+    if (!browser_profiler::power_tool::WriteMessage(client_fd, response))
+      break;
+  }
+
+  // The next experiment starts sampling again, the server keeps its connection
+  if (sampling)
+    fprintf(stderr, "Client left while sampling, e.g., the browser crashed\n");
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string server;
+  uint32_t port = 0;
+  std::string listen_address(browser_profiler::power_tool::kDefaultRelayAddress);
+  int allowed_uid = -1;
+  int io_timeout_ms = 30000;
+  bool daemonize = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--server=")) {
+      server = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--port=")) {
+      port = strtoul(strchr(arg, '=') + 1, nullptr, 10);
+    } else if (StartsWith(arg, "--listen=")) {
+      listen_address = strchr(arg, '=') + 1;
+    } else if (StartsWith(arg, "--allowed-uid=")) {
+      allowed_uid = atoi(strchr(arg, '=') + 1);
+    } else if (StartsWith(arg, "--io-timeout-ms=")) {
+      io_timeout_ms = atoi(strchr(arg, '=') + 1);
+    } else if (strcmp(arg, "--daemonize") == 0) {
+      daemonize = true;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+      return 1;
+    }
+  }
+
+  if (server.empty()) {
+    fprintf(stderr, "Missing --server=<address>\n");
+    return 1;
+  }
+
+  int listen_fd = browser_profiler::power_tool::Listen(listen_address, 0);
+  if (listen_fd < 0) {
+    // Another relay of this campaign owns the address already
+    if (errno == EADDRINUSE)
+      return 0;
+    perror("Cannot listen");
+    return 1;
+  }
+
+  // Connect now, out of the experiments; a failure is retried on the first request
+  Upstream upstream(server, port, io_timeout_ms);
+  upstream.Connect();
+
+  // Listen and connect before detaching, so the client can connect as soon as we return
+  if (daemonize) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pid > 0)
+      return 0;
+
+    setsid();
+    if (chdir("/") < 0)
+      perror("chdir");
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+      if (null_fd > STDERR_FILENO)
+        close(null_fd);
+    }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  // One client at a time: one browser process runs at a time
+  for (;;) {
+    int client_fd = accept(listen_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("accept");
+      return 1;
+    }
+
+    if (allowed_uid >= 0) {
+      int peer_uid = PeerUid(client_fd);
+      if (peer_uid != allowed_uid && peer_uid != 0) {
+        fprintf(stderr, "Reject connection from uid %d\n", peer_uid);
+        close(client_fd);
+        continue;
+      }
+    }
+
+    bool shutdown = ServeClient(client_fd, &upstream);
+    close(client_fd);
+    if (shutdown)
+      break;
+  }
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Convert a binary experiment result store (experiment_result.bpr)
+// to the tab-separated experiment result log
+//
+// Usage: result_store_to_tsv <store> [<output tsv>]
+// Writes to stdout if no output file is given
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "experiment_result_store.h"
+
+namespace {
+
+using browser_profiler::ExperimentResultStore;
+
+// Shortest text which reads back as the same double,
+// the same as an ostream with default formatting for values written by the profiler
+std::string FormatDouble(double value) {
+  char buffer[32];
+  for (int precision = 6; precision <= 17; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+    if (strtod(buffer, nullptr) == value)
+      break;
+  }
+  return buffer;
+}
+
+std::string FormatCell(const ExperimentResultStore& store, size_t row, size_t column) {
+  if (store.schema()[column].type != ExperimentResultStore::kDoubleColumn)
+    return store.GetString(row, column);
+  return FormatDouble(store.GetDouble(row, column));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s <store> [<output tsv>]\n", argv[0]);
+    return 1;
+  }
+
+  ExperimentResultStore store;
+  if (!store.OpenForRead(argv[1])) {
+    fprintf(stderr, "Cannot read result store %s\n", argv[1]);
+    return 1;
+  }
+
+  FILE* output = argc == 3 ? fopen(argv[2], "w") : stdout;
+  if (output == nullptr) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  // Like experiment_result.log: every column in the header, empty values for the
+  // fields absent from an experiment
+  for (size_t column = 0; column < store.schema().size(); ++column)
+    fprintf(output, "%s%s", column > 0 ? "\t" : "", store.schema()[column].name.c_str());
+  fprintf(output, "\n");
+
+  for (size_t row = 0; row < store.num_rows(); ++row) {
+    if (!store.IsRowValid(row)) {
+      fprintf(stderr, "Skip corrupted row %zu\n", row);
+      continue;
+    }
+
+    std::string line;
+    for (size_t column = 0; column < store.schema().size(); ++column) {
+      if (column > 0)
+        line += '\t';
+      if (store.IsPresent(row, column))
+        line += FormatCell(store, row, column);
+    }
+    fprintf(output, "%s\n", line.c_str());
+  }
+
+  if (output != stdout && fclose(output) != 0) {
+    perror(argv[2]);
+    return 1;
+  }
+  return 0;
+}
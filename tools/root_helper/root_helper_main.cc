@@ -0,0 +1,291 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Long-lived root helper of Browser Profiler
+// Started once per campaign through su, then runs the profiler's root commands
+// received over an abstract Unix domain socket, so that each command costs
+// a fork/exec of sh instead of a full su + shell startup
+//
+// Usage: root_helper --allowed-uid=<browser uid> [--socket-name=<name>] [--daemonize]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "root_helper_protocol.h"
+
+namespace {
+
+using browser_profiler::root_helper::Command;
+using browser_profiler::root_helper::Result;
+
+// How often to check whether the command exited while collecting its output
+const int kPollMillis = 20;
+
+const char* const kShells[] = { "/system/bin/sh", "/bin/sh" };
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+int64_t MonotonicMicros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+void AppendOutput(int fd, std::string* output) {
+  char buffer[4096];
+  for (;;) {
+    ssize_t num_read = read(fd, buffer, sizeof(buffer));
+    if (num_read <= 0)
+      return;
+    size_t room = browser_profiler::root_helper::kMaxOutputLength - output->length();
+    output->append(buffer, std::min(static_cast<size_t>(num_read), room));
+  }
+}
+
+// Run a command line with sh -c, capturing stdout and stderr
+// Commands may leave background processes (e.g., screenrecord) holding the pipe,
+// so stop reading as soon as the shell exits
+void RunShell(const Command& command, Result* result) {
+  int pipe_fds[2];
+  if (pipe(pipe_fds) < 0) {
+    result->status = browser_profiler::root_helper::kStatusFailedToRun;
+    result->output = strerror(errno);
+    return;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    result->status = browser_profiler::root_helper::kStatusFailedToRun;
+    result->output = strerror(errno);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return;
+  }
+
+  if (pid == 0) {
+    // Own process group, so that a timeout kills everything the command started
+    setpgid(0, 0);
+    signal(SIGCHLD, SIG_DFL);
+    dup2(pipe_fds[1], STDOUT_FILENO);
+    dup2(pipe_fds[1], STDERR_FILENO);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    for (size_t i = 0; i < sizeof(kShells) / sizeof(kShells[0]); ++i)
+      execl(kShells[i], "sh", "-c", command.payload.c_str(), static_cast<char*>(NULL));
+    _exit(127);
+  }
+
+  close(pipe_fds[1]);
+  fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+
+  int64_t deadline = command.timeout_ms > 0 ?
+      MonotonicMicros() + static_cast<int64_t>(command.timeout_ms) * 1000 : 0;
+  int status = 0;
+  for (;;) {
+    struct pollfd poll_fd = { pipe_fds[0], POLLIN, 0 };
+    poll(&poll_fd, 1, kPollMillis);
+    AppendOutput(pipe_fds[0], &result->output);
+
+    pid_t waited = waitpid(pid, &status, WNOHANG);
+    if (waited == pid) {
+      AppendOutput(pipe_fds[0], &result->output);
+      result->status = WIFEXITED(status) ? WEXITSTATUS(status) :
+          browser_profiler::root_helper::kStatusFailedToRun;
+      break;
+    }
+
+    if (deadline > 0 && MonotonicMicros() >= deadline) {
+      kill(-pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      result->status = browser_profiler::root_helper::kStatusTimedOut;
+      break;
+    }
+  }
+
+  close(pipe_fds[0]);
+}
+
+void WriteFile(const Command& command, Result* result) {
+  size_t separator = command.payload.find('\0');
+  if (separator == std::string::npos) {
+    result->status = browser_profiler::root_helper::kStatusBadCommand;
+    return;
+  }
+
+  std::string path = command.payload.substr(0, separator);
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
+    result->status = errno;
+    result->output = strerror(errno);
+    return;
+  }
+
+  const char* data = command.payload.data() + separator + 1;
+  size_t length = command.payload.length() - separator - 1;
+  result->status = 0;
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written < 0) {
+      result->status = errno;
+      result->output = strerror(errno);
+      break;
+    }
+    data += written;
+    length -= written;
+  }
+
+  // Overrides the umask, same as the former chmod 666
+  fchmod(fd, 0666);
+  close(fd);
+}
+
+// Serve one client until it disconnects
+// Return true if the client asked the helper to shut down
+bool ServeClient(int client_fd) {
+  std::vector<Command> commands;
+  while (browser_profiler::root_helper::ReadCommands(client_fd, &commands)) {
+    bool shutdown = false;
+    std::vector<Result> results(commands.size());
+
+    for (size_t i = 0; i < commands.size(); ++i) {
+      int64_t start = MonotonicMicros();
+      switch (commands[i].type) {
+        case browser_profiler::root_helper::kShell:
+          RunShell(commands[i], &results[i]);
+          break;
+        case browser_profiler::root_helper::kWriteFile:
+          WriteFile(commands[i], &results[i]);
+          break;
+        case browser_profiler::root_helper::kPing:
+          results[i].status = 0;
+          break;
+        case browser_profiler::root_helper::kShutdown:
+          results[i].status = 0;
+          shutdown = true;
+          break;
+        default:
+          results[i].status = browser_profiler::root_helper::kStatusBadCommand;
+          break;
+      }
+      results[i].elapsed_us = MonotonicMicros() - start;
+    }
+
+    if (!browser_profiler::root_helper::WriteResults(client_fd, results) || shutdown)
+      return shutdown;
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string socket_name(browser_profiler::root_helper::kDefaultSocketName);
+  int allowed_uid = -1;
+  bool daemonize = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (StartsWith(argv[i], browser_profiler::root_helper::kAllowedUidFlag)) {
+      allowed_uid = atoi(argv[i] + strlen(browser_profiler::root_helper::kAllowedUidFlag));
+    } else if (StartsWith(argv[i], browser_profiler::root_helper::kSocketNameFlag)) {
+      socket_name = argv[i] + strlen(browser_profiler::root_helper::kSocketNameFlag);
+    } else if (strcmp(argv[i], browser_profiler::root_helper::kDaemonizeFlag) == 0) {
+      daemonize = true;
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (allowed_uid < 0) {
+    fprintf(stderr, "Missing %s<uid>\n", browser_profiler::root_helper::kAllowedUidFlag);
+    return 1;
+  }
+
+  int listen_fd = browser_profiler::root_helper::ListenForClients(socket_name);
+  if (listen_fd < 0) {
+    // Another helper of this campaign owns the name already
+    if (errno == EADDRINUSE)
+      return 0;
+    perror("Cannot listen");
+    return 1;
+  }
+
+  // Listen before detaching, so the client can connect as soon as su returns
+  if (daemonize) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pid > 0)
+      return 0;
+
+    setsid();
+    if (chdir("/") < 0)
+      perror("chdir");
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+      dup2(null_fd, STDOUT_FILENO);
+      dup2(null_fd, STDERR_FILENO);
+      if (null_fd > STDERR_FILENO)
+        close(null_fd);
+    }
+  }
+
+  // Connection handlers are reaped automatically
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    int client_fd = accept(listen_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("accept");
+      return 1;
+    }
+
+    // The helper runs anything as root, only serve the browser
+    int peer_uid = browser_profiler::root_helper::PeerUid(client_fd);
+    if (peer_uid != allowed_uid && peer_uid != 0) {
+      fprintf(stderr, "Reject connection from uid %d\n", peer_uid);
+      close(client_fd);
+      continue;
+    }
+
+    // One handler per connection: a hung command only blocks its own client
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listen_fd);
+      signal(SIGCHLD, SIG_DFL);
+      bool shutdown = ServeClient(client_fd);
+      close(client_fd);
+      if (shutdown)
+        kill(getppid(), SIGTERM);
+      _exit(0);
+    }
+    close(client_fd);
+  }
+
+  return 0;
+}
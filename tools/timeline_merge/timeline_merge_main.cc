@@ -0,0 +1,183 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+// Merges the artifacts of a trial into one timeline on CLOCK_MONOTONIC, in Chrome's
+// JSON trace format (open it in Perfetto's UI or chrome://tracing)
+// The trial must be run with --record-timeline, which writes <id>.clocks
+//
+// Usage: timeline_merge [--power=<csv>] [--output=<file>] <dir>/<experiment id>
+// Reads the artifacts of the trial that exist: <id>.ftrace.dat, <id>.itrace.json,
+// <id>.pcap and <id>.cpu_util.bin
+// power: the samples of the power tool server, lines of "<seconds>,<watts>" on the
+//   meter clock, aligned by the power clock offset of the trial
+// output: <dir>/<experiment id>.timeline.json by default
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clock_domain.h"
+#include "ftrace_decoder.h"
+#include "itrace_index.h"
+#include "timeline_merger.h"
+#include "timeline_sources.h"
+
+namespace {
+
+using namespace browser_profiler;
+
+bool StartsWith(const char* str, const char* prefix) {
+  return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+bool Exists(const std::string& path) {
+  return access(path.c_str(), R_OK) == 0;
+}
+
+bool ReadFile(const std::string& path, std::string* contents) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file)
+    return false;
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    contents->append(buffer, length);
+  fclose(file);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string power_file;
+  std::string output_file;
+  std::string prefix;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (StartsWith(arg, "--power=")) {
+      power_file = arg + strlen("--power=");
+    } else if (StartsWith(arg, "--output=")) {
+      output_file = arg + strlen("--output=");
+    } else if (arg[0] != '-' && prefix.empty()) {
+      prefix = arg;
+    } else {
+      prefix.clear();
+      break;
+    }
+  }
+  if (prefix.empty()) {
+    fprintf(stderr, "Usage: %s [--power=<csv>] [--output=<file>] <dir>/<experiment id>\n",
+        argv[0]);
+    return 1;
+  }
+  if (output_file.empty())
+    output_file = prefix + ".timeline.json";
+
+  std::string text;
+  std::string error;
+  TrialClocks clocks;
+  if (!ReadFile(prefix + ".clocks", &text) || !clocks.Parse(text, &error)) {
+    fprintf(stderr, "Cannot read %s.clocks %s, run the trial with --record-timeline\n",
+        prefix.c_str(), error.c_str());
+    return 1;
+  }
+  ClockTranslator translator(clocks);
+  TimelineTracks tracks;
+  TimelineMerger merger;
+
+  // The decoded artifacts are read by their sources during the merge
+  FtraceDecoder ftrace;
+  std::string path = prefix + ".ftrace.dat";
+  if (Exists(path)) {
+    ClockDomain domain;
+    if (!ftrace.Open(path, &error) || !ftrace.Decode(&error)) {
+      fprintf(stderr, "Skip %s: %s\n", path.c_str(), error.c_str());
+    } else if (!ClockTranslator::FtraceClockDomain(ftrace.trace_clock(), &domain)) {
+      fprintf(stderr, "Skip %s: trace clock %s is not translatable, use --ftrace-clock=mono\n",
+          path.c_str(), ftrace.trace_clock().c_str());
+    } else {
+      for (size_t cpu = 0; cpu < ftrace.cpus().size(); ++cpu) {
+        merger.AddSource(std::unique_ptr<TimelineSource>(
+            new FtraceCpuSource(&ftrace, cpu, domain, &translator, &tracks)));
+      }
+    }
+  }
+
+  ItraceIndex itrace;
+  path = prefix + ".itrace.json";
+  if (Exists(path)) {
+    if (!itrace.ParseFile(path, &error)) {
+      fprintf(stderr, "Skip %s: %s\n", path.c_str(), error.c_str());
+    } else {
+      for (size_t thread = 0; thread < itrace.threads().size(); ++thread) {
+        merger.AddSource(std::unique_ptr<TimelineSource>(
+            new ItraceThreadSource(&itrace, thread, &tracks)));
+      }
+    }
+  }
+
+  path = prefix + ".pcap";
+  if (Exists(path)) {
+    std::unique_ptr<PcapSource> source(new PcapSource(&translator, &tracks));
+    if (source->Open(path, &error))
+      merger.AddSource(std::move(source));
+    else
+      fprintf(stderr, "Skip %s: %s\n", path.c_str(), error.c_str());
+  }
+
+  path = prefix + ".cpu_util.bin";
+  if (Exists(path)) {
+    std::unique_ptr<CpuUtilizationSource> source(new CpuUtilizationSource(&tracks));
+    if (source->Open(path, &error))
+      merger.AddSource(std::move(source));
+    else
+      fprintf(stderr, "Skip %s: %s\n", path.c_str(), error.c_str());
+  }
+
+  if (!power_file.empty()) {
+    std::unique_ptr<PowerSampleSource> source(new PowerSampleSource(&translator, &tracks));
+    if (!translator.CanTranslate(kPowerMeterClock)) {
+      fprintf(stderr, "Skip %s: no power clock offset in the trial\n", power_file.c_str());
+    } else if (source->Open(power_file, &error)) {
+      merger.AddSource(std::move(source));
+    } else {
+      fprintf(stderr, "Skip %s: %s\n", power_file.c_str(), error.c_str());
+    }
+  }
+
+  if (clocks.load_end_ns > clocks.load_start_ns) {
+    std::vector<TimelineEvent> events(1);
+    events[0].type = TimelineEvent::kSlice;
+    events[0].timestamp_ns = clocks.load_start_ns;
+    events[0].duration_ns = clocks.load_end_ns - clocks.load_start_ns;
+    events[0].track = tracks.Find("profiler", "load window");
+    events[0].name = "page load";
+    merger.AddSource(std::unique_ptr<TimelineSource>(new TimelineEventList(events)));
+  }
+
+  FILE* output = fopen(output_file.c_str(), "w");
+  if (!output) {
+    fprintf(stderr, "Cannot open %s: %s\n", output_file.c_str(), strerror(errno));
+    return 1;
+  }
+  TraceJsonWriter writer(output, &tracks);
+  size_t num_events = 0;
+  bool written = writer.Begin();
+  if (written)
+    num_events = merger.Merge(&writer);
+  written = written && writer.End();
+  written = fclose(output) == 0 && written;
+  if (!written) {
+    fprintf(stderr, "Cannot write %s\n", output_file.c_str());
+    return 1;
+  }
+  fprintf(stderr, "%zu events on %zu tracks to %s\n", num_events, tracks.tracks().size(),
+      output_file.c_str());
+  return 0;
+}
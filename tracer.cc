@@ -0,0 +1,37 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "tracer.h"
+
+#include "browser_profiler_impl_constants.h"
+
+namespace browser_profiler {
+
+TracerContext::TracerContext()
+  : constants(nullptr),
+    root_runner(nullptr),
+    client(nullptr),
+    browser_profiler(nullptr),
+    default_cpu_setup_command(nullptr),
+    sync_workload_cpu_setup_command(nullptr),
+    experiment_result(nullptr) {
+}
+
+base::FilePath TracerContext::OutputFile(const std::string& base_name) const {
+  return base::FilePath(constants->kBpOutDir.Append(experiment_id).value() + "." + base_name);
+}
+
+// static
+const char* Tracer::OverheadName(Overhead overhead) {
+  switch (overhead) {
+    case kNegligibleOverhead:
+      return "negligible";
+    case kLowOverhead:
+      return "low";
+    case kHighOverhead:
+      return "high";
+  }
+  return "unknown";
+}
+
+}  // namespace browser_profiler
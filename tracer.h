@@ -0,0 +1,133 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TRACER_H_
+#define BROWSER_PROFILER_TRACER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+
+namespace browser_profiler {
+
+class BrowserProfiler;
+class BrowserProfilerClient;
+class ExperimentResult;
+class RootCommandRunner;
+struct BrowserProfilerImplConstants;
+
+// What a tracer may use, owned by the profiler
+struct TracerContext {
+  TracerContext();
+
+  // Per-experiment output file: <out dir>/<experiment id>.<base name>
+  base::FilePath OutputFile(const std::string& base_name) const;
+
+  // Live as long as the profiler
+  const BrowserProfilerImplConstants* constants;
+  RootCommandRunner* root_runner;
+  BrowserProfilerClient* client;
+  BrowserProfiler* browser_profiler;
+  const base::CommandLine* default_cpu_setup_command;
+  const base::CommandLine* sync_workload_cpu_setup_command;
+
+  // Of the current experiment
+  std::string experiment_id;
+  ExperimentResult* experiment_result;
+};
+
+// A measurement source, e.g., ftrace, packet capture, power meter
+// Created by TracerRegistry only when its switch is given
+//
+// Per experiment: Prepare(), IsReady(), Start() ... page load ... Stop(), Flush()
+class Tracer {
+ public:
+  typedef std::function<void()> DoneCallback;
+
+  // Tracers of a stage start (stop) concurrently,
+  // a stage starts (stops) after the previous one is done
+  enum StartStage {
+    // Used by the profiler itself, e.g., cpu setup
+    kEnvironmentStage,
+    kPowerStage,
+    kPreFtraceStage,
+    kFtraceStage,
+  };
+
+  enum StopStage {
+    kPowerStopStage,
+    kFtraceStopStage,
+    kPostFtraceStopStage,
+  };
+
+  // Expected perturbation of the measured page load
+  enum Overhead {
+    kNegligibleOverhead,
+    kLowOverhead,
+    kHighOverhead,
+  };
+
+  static const char* OverheadName(Overhead overhead);
+
+  virtual ~Tracer() {}
+
+  virtual std::string name() const = 0;
+  virtual StartStage start_stage() const = 0;
+  virtual StopStage stop_stage() const = 0;
+  virtual Overhead expected_overhead() const = 0;
+
+  // Base names of the files written per experiment, see TracerContext::OutputFile()
+  virtual std::vector<std::string> output_artifacts() const = 0;
+
+  // Start() and Stop() call the client, which lives on the browser's thread
+  virtual bool runs_on_calling_thread() const { return false; }
+
+  // Stop() completes later on the browser's thread
+  // Such tracers are stopped first, the staged stops follow when all are done
+  virtual bool stops_asynchronously() const { return false; }
+
+  // Once per browser process, before Initialize(), also for the tracers of the other
+  // command lines of the campaign so that all rows share the columns
+  virtual void RegisterMetrics(ExperimentResult* experiment_result) {}
+
+  // Once per browser process, e.g., open a device; return false to disable the tracer
+  virtual bool Initialize(const TracerContext& context) { return true; }
+
+  // Before each experiment, out of the measured window, e.g., connect to a device
+  virtual void Prepare(const TracerContext& context) {}
+
+  // A tracer which is not ready is skipped in the experiment
+  virtual bool IsReady() const { return true; }
+
+  // Call done once tracing (stopped), possibly on another thread
+  // A tracer running on the calling thread must not wait for the browser's thread
+  // to call done in Start(), nor in Stop() unless it stops asynchronously
+  virtual void Start(const TracerContext& context, const DoneCallback& done) = 0;
+  virtual void Stop(const TracerContext& context, const DoneCallback& done) = 0;
+
+  // Shell commands run as root instead of Start() (Stop()), e.g., scripts: the root
+  // commands of all tracers of a stage go to the root helper as one batch
+  // Empty: Start() (Stop()) is called
+  virtual std::vector<std::string> StartRootCommands(const TracerContext& context) const {
+    return std::vector<std::string>();
+  }
+  virtual std::vector<std::string> StopRootCommands(const TracerContext& context) const {
+    return std::vector<std::string>();
+  }
+
+  // After all tracers stopped, before the experiment result is written
+  virtual void Flush(const TracerContext& context) {}
+
+  // After all experiments of a campaign
+  virtual void FinishAllExperiments(const TracerContext& context) {}
+
+  // Forwarded from BrowserProfiler
+  virtual void OnInternalTracingStopped() {}
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TRACER_H_
@@ -0,0 +1,155 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "tracer_launcher.h"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "root_command_runner.h"
+
+#include "base/logging.h"
+#include "base/threading/platform_thread.h"
+#include "base/time/time.h"
+
+namespace browser_profiler {
+
+// Runs one task and measures it, on its own thread or inline
+class TracerLauncher::TaskRunner : public base::PlatformThread::Delegate {
+ public:
+  TaskRunner(const Task& task, double* millis)
+    : task_(task),
+      millis_(millis),
+      thread_started_(false) {
+  }
+
+  void Start() {
+    thread_started_ = base::PlatformThread::Create(0, this, &thread_handle_);
+    if (!thread_started_) {
+      LOG(ERROR) << "Cannot create tracer thread, run the task inline";
+      ThreadMain();
+    }
+  }
+
+  void Join() {
+    if (thread_started_)
+      base::PlatformThread::Join(thread_handle_);
+  }
+
+  // base::PlatformThread::Delegate
+  void ThreadMain() override {
+    base::TimeTicks start = base::TimeTicks::Now();
+    task_();
+    *millis_ = (base::TimeTicks::Now() - start).InMillisecondsF();
+  }
+
+ private:
+  Task task_;
+  double* millis_;
+  bool thread_started_;
+  base::PlatformThreadHandle thread_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskRunner);
+};
+
+TracerLauncher::TracerLauncher(RootCommandRunner* root_runner)
+  : root_runner_(root_runner),
+    total_millis_(0) {
+}
+
+TracerLauncher::~TracerLauncher() {
+}
+
+void TracerLauncher::Add(int stage, const std::string& name, const Task& task) {
+  Entry entry = { stage, name, task, false, std::vector<std::string>() };
+  entries_.push_back(entry);
+}
+
+void TracerLauncher::AddOnCallingThread(int stage, const std::string& name, const Task& task) {
+  Entry entry = { stage, name, task, true, std::vector<std::string>() };
+  entries_.push_back(entry);
+}
+
+void TracerLauncher::AddRootCommands(int stage, const std::string& name,
+    const std::vector<std::string>& commands) {
+  Entry entry = { stage, name, Task(), false, commands };
+  entries_.push_back(entry);
+}
+
+void TracerLauncher::Run() {
+  base::TimeTicks start = base::TimeTicks::Now();
+
+  latencies_.resize(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    latencies_[i].name = entries_[i].name;
+    latencies_[i].millis = 0;
+  }
+
+  std::set<int> stages;
+  for (size_t i = 0; i < entries_.size(); ++i)
+    stages.insert(entries_[i].stage);
+
+  for (std::set<int>::const_iterator stage = stages.begin(); stage != stages.end(); ++stage) {
+    std::vector<size_t> threaded;
+    std::vector<size_t> inline_tasks;
+    std::vector<size_t> root_entries;
+    std::vector<std::string> root_commands;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].stage != *stage)
+        continue;
+      if (!entries_[i].root_commands.empty()) {
+        root_entries.push_back(i);
+        root_commands.insert(root_commands.end(), entries_[i].root_commands.begin(),
+            entries_[i].root_commands.end());
+      } else if (entries_[i].on_calling_thread) {
+        inline_tasks.push_back(i);
+      } else {
+        threaded.push_back(i);
+      }
+    }
+
+    std::vector<std::pair<Task, double*>> tasks;
+    for (size_t i = 0; i < threaded.size(); ++i)
+      tasks.push_back(std::make_pair(entries_[threaded[i]].task, &latencies_[threaded[i]].millis));
+
+    double batch_millis = 0;
+    if (!root_commands.empty()) {
+      RootCommandRunner* root_runner = root_runner_;
+      tasks.push_back(std::make_pair(
+          [root_runner, root_commands]() { root_runner->RunBatch(root_commands); },
+          &batch_millis));
+    }
+
+    // A lone task does not need a thread
+    std::vector<std::unique_ptr<TaskRunner>> runners;
+    for (size_t i = 0; i < tasks.size(); ++i) {
+      runners.push_back(std::unique_ptr<TaskRunner>(
+          new TaskRunner(tasks[i].first, tasks[i].second)));
+      if (inline_tasks.empty() && tasks.size() == 1)
+        runners.back()->ThreadMain();
+      else
+        runners.back()->Start();
+    }
+
+    for (size_t i = 0; i < inline_tasks.size(); ++i) {
+      TaskRunner runner(entries_[inline_tasks[i]].task, &latencies_[inline_tasks[i]].millis);
+      runner.ThreadMain();
+    }
+
+    // Barrier
+    for (size_t i = 0; i < runners.size(); ++i)
+      runners[i]->Join();
+
+    for (size_t i = 0; i < root_entries.size(); ++i)
+      latencies_[root_entries[i]].millis = batch_millis;
+  }
+
+  total_millis_ = (base::TimeTicks::Now() - start).InMillisecondsF();
+
+  for (size_t i = 0; i < latencies_.size(); ++i)
+    VLOG(1) << latencies_[i].name << " took " << latencies_[i].millis << " ms";
+}
+
+}  // namespace browser_profiler
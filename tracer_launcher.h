@@ -0,0 +1,77 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TRACER_LAUNCHER_H_
+#define BROWSER_PROFILER_TRACER_LAUNCHER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+class RootCommandRunner;
+
+// Starts or stops tracers in stages to cut the dead time between page loads
+// Tasks of a stage run concurrently, a stage begins only after all tasks of
+// the previous stage finished (barrier), which expresses the ordering constraints
+// between tracers, e.g., power sampling before everything else
+//
+// Tasks which must run on the browser's thread (e.g., calling the client)
+// are run on the calling thread while the other tasks of the stage run on
+// their own threads
+//
+// Root commands of a stage (e.g., tracer scripts) are run as one batch, one round
+// trip to the root helper, concurrently with the other tasks of the stage
+class TracerLauncher {
+ public:
+  typedef std::function<void()> Task;
+
+  struct Latency {
+    std::string name;
+    double millis;
+  };
+
+  explicit TracerLauncher(RootCommandRunner* root_runner);
+  ~TracerLauncher();
+
+  void Add(int stage, const std::string& name, const Task& task);
+  void AddOnCallingThread(int stage, const std::string& name, const Task& task);
+  // The latency of each one is the latency of the batch of its stage
+  void AddRootCommands(int stage, const std::string& name,
+      const std::vector<std::string>& commands);
+
+  // Run all stages in increasing order, return when all tasks finished
+  void Run();
+
+  // Latency of each task of the last Run(), in the order they were added
+  const std::vector<Latency>& latencies() const { return latencies_; }
+
+  // Wall time of the last Run()
+  double total_millis() const { return total_millis_; }
+
+ private:
+  class TaskRunner;
+
+  struct Entry {
+    int stage;
+    std::string name;
+    Task task;
+    bool on_calling_thread;
+    // Run in the batch of the stage instead of task, if not empty
+    std::vector<std::string> root_commands;
+  };
+
+  RootCommandRunner* root_runner_;
+  std::vector<Entry> entries_;
+  std::vector<Latency> latencies_;
+  double total_millis_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracerLauncher);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TRACER_LAUNCHER_H_
@@ -0,0 +1,121 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#include "tracer_registry.h"
+
+#include "browser_profiler_impl_constants.h"
+#include "browser_profiler_impl_switches.h"
+#include "cpu_utilization_tracer.h"
+#include "ftrace_tracer.h"
+#include "internal_tracing_tracer.h"
+#include "packet_capture_tracer.h"
+#include "power_tracer.h"
+#include "script_tracer.h"
+#include "timeline_tracer.h"
+
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+
+namespace browser_profiler {
+
+TracerRegistry::TracerRegistry() {
+  Register(switches::kMeasurePower,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        PowerTracer::Config config;
+        config.server_config_file = constants.kPowerToolServerConfigFile;
+        if (command_line.HasSwitch(switches::kUsePowerToolRelay))
+          config.relay_executable = constants.kPowerToolRelayExecutable;
+        config.stream_samples = !command_line.HasSwitch(switches::kNoStreamPowerSamples);
+        config.sync_calibration_file = constants.kPowerSyncCalibrationFile;
+        if (command_line.HasSwitch(switches::kPowerSysfsRoot)) {
+          config.sysfs_root = command_line.GetSwitchValuePath(switches::kPowerSysfsRoot);
+          if (config.sysfs_root.empty())
+            config.sysfs_root = base::FilePath(SysfsPowerSampler::kDefaultSysfsRoot);
+        }
+        std::string sample_rate = command_line.GetSwitchValueASCII(switches::kPowerSampleRateHz);
+        if (!sample_rate.empty() &&
+            (!base::StringToDouble(sample_rate, &config.sample_rate_hz) ||
+             config.sample_rate_hz <= 0)) {
+          LOG(ERROR) << "Invalid --" << switches::kPowerSampleRateHz << ": " << sample_rate;
+          return static_cast<Tracer*>(nullptr);
+        }
+        return static_cast<Tracer*>(new PowerTracer(config));
+      });
+
+  // don't want to include screen record into ftrace:
+  // it starts a stage before ftrace and stops a stage after
+  Register(switches::kScreenRecord,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        ScriptTracer::Config config;
+        config.name = "screen record";
+        config.start_script = constants.kStartScreenRecordScript;
+        config.stop_script = constants.kStopScreenRecordScript;
+        return static_cast<Tracer*>(new ScriptTracer(config));
+      });
+
+  Register(switches::kMonitorCpuUtilization,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        double sample_rate_hz = CpuUtilizationSampler::kDefaultSampleRateHz;
+        std::string sample_rate = command_line.GetSwitchValueASCII(switches::kCpuSampleRateHz);
+        if (!sample_rate.empty() &&
+            (!base::StringToDouble(sample_rate, &sample_rate_hz) || sample_rate_hz <= 0)) {
+          LOG(ERROR) << "Invalid --" << switches::kCpuSampleRateHz << ": " << sample_rate;
+          return static_cast<Tracer*>(nullptr);
+        }
+        return static_cast<Tracer*>(new CpuUtilizationTracer(sample_rate_hz));
+      });
+
+  Register(switches::kDoFtrace,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        return static_cast<Tracer*>(new FtraceTracer(command_line));
+      });
+
+  Register(switches::kDoItrace,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        return static_cast<Tracer*>(new InternalTracingTracer(
+            command_line.GetSwitchValueASCII(switches::kDoItrace)));
+      });
+
+  Register(switches::kCapturePackets,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        return static_cast<Tracer*>(new PacketCaptureTracer(command_line));
+      });
+
+  Register(switches::kRecordTimeline,
+      [](const base::CommandLine& command_line, const BrowserProfilerImplConstants& constants) {
+        return static_cast<Tracer*>(new TimelineTracer());
+      });
+}
+
+TracerRegistry::~TracerRegistry() {
+}
+
+void TracerRegistry::Register(const std::string& switch_name, const Factory& factory) {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].switch_name == switch_name) {
+      entries_[i].factory = factory;
+      return;
+    }
+  }
+
+  Entry entry = { switch_name, factory };
+  entries_.push_back(entry);
+}
+
+void TracerRegistry::CreateEnabledTracers(const base::CommandLine& command_line,
+    const BrowserProfilerImplConstants& constants,
+    std::vector<std::unique_ptr<Tracer>>* tracers) const {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (!command_line.HasSwitch(entries_[i].switch_name))
+      continue;
+
+    Tracer* tracer = entries_[i].factory(command_line, constants);
+    if (tracer == nullptr) {
+      LOG(ERROR) << "Cannot create tracer for --" << entries_[i].switch_name;
+      continue;
+    }
+    tracers->push_back(std::unique_ptr<Tracer>(tracer));
+  }
+}
+
+}  // namespace browser_profiler
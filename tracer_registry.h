@@ -0,0 +1,54 @@
+// Copyright 2016 Duc Hoang Bui, KAIST. All rights reserved.
+// Licensed under MIT (https://github.com/ducalpha/browser_profiler/blob/master/LICENSE)
+
+#ifndef BROWSER_PROFILER_TRACER_REGISTRY_H_
+#define BROWSER_PROFILER_TRACER_REGISTRY_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tracer.h"
+
+#include "base/command_line.h"
+#include "base/macros.h"
+
+namespace browser_profiler {
+
+struct BrowserProfilerImplConstants;
+
+// Maps command line switches to tracers
+// Only tracers whose switch is given are created, others cost nothing
+class TracerRegistry {
+ public:
+  // Return a new tracer owned by the caller
+  typedef std::function<Tracer*(const base::CommandLine& command_line,
+      const BrowserProfilerImplConstants& constants)> Factory;
+
+  // Registers the built-in tracers
+  TracerRegistry();
+  ~TracerRegistry();
+
+  // A tracer registered again for the same switch replaces the previous one
+  void Register(const std::string& switch_name, const Factory& factory);
+
+  // Append the tracers enabled on command_line, in registration order
+  void CreateEnabledTracers(const base::CommandLine& command_line,
+      const BrowserProfilerImplConstants& constants,
+      std::vector<std::unique_ptr<Tracer>>* tracers) const;
+
+ private:
+  struct Entry {
+    std::string switch_name;
+    Factory factory;
+  };
+
+  std::vector<Entry> entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(TracerRegistry);
+};
+
+}  // namespace browser_profiler
+
+#endif  // BROWSER_PROFILER_TRACER_REGISTRY_H_